@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <tuple>
+
 #if defined(MAPPER_5)
 #include "mapper5.h"
 #elif defined(MAPPER_4)
@@ -7,3 +10,64 @@
 #else
 #error "Mapper not found"
 #endif
+
+namespace pixel::graphics::mapper {
+
+// Metadata which is not a property of the allocation: the producer can change it during the life
+// of a buffer, or it refers to the handle, whose fds differ for every import of the same buffer.
+// Only the Pixel keys have a metadata::ReturnType, the standard keys cannot be cached at all.
+constexpr bool is_mutable(MetadataType meta) {
+    switch (meta) {
+        case MetadataType::PLANE_DMA_BUFS:
+        case MetadataType::VIDEO_HDR:
+        case MetadataType::VIDEO_ROI:
+        case MetadataType::VIDEO_GMV:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Keeps the metadata of the buffer last queried, and fetches them again only when the handle
+// refers to another buffer, told by its buffer id. One cache is meant per buffer slot. A buffer
+// id keeps its value across frames and imports, so only metadata fixed at allocation can be cached,
+// that is COMPRESSED_PLANE_LAYOUTS, PIXEL_FORMAT_ALLOCATED and FORMAT_TYPE.
+template <MetadataType... metas>
+class MetadataCache {
+    static_assert((!is_mutable(metas) && ...),
+                  "MetadataCache only holds metadata which cannot change after allocation");
+
+public:
+    using Values = std::tuple<typename metadata::ReturnType<metas>::type...>;
+
+    // Returns nullptr if the metadata cannot be fetched
+    const Values* get(buffer_handle_t handle, uint64_t buffer_id) {
+        if (valid_ && buffer_id == buffer_id_) {
+            return &values_;
+        }
+
+        valid_ = std::apply([&](auto&... out) { return get_all<metas...>(handle, out...); },
+                            values_);
+        buffer_id_ = buffer_id;
+
+        return valid_ ? &values_ : nullptr;
+    }
+
+    const Values* get(buffer_handle_t handle) {
+        auto buffer_id = get_buffer_id(handle);
+        if (!buffer_id) {
+            return nullptr;
+        }
+
+        return get(handle, *buffer_id);
+    }
+
+    void invalidate() { valid_ = false; }
+
+private:
+    Values values_{};
+    uint64_t buffer_id_ = 0;
+    bool valid_ = false;
+};
+
+} // namespace pixel::graphics::mapper
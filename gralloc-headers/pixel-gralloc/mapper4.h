@@ -26,29 +26,72 @@ static inline android::sp<IMapper> get_mapper() {
     return mapper;
 }
 
-} // namespace
-
 template <MetadataType meta>
-std::optional<typename metadata::ReturnType<meta>::type> get(buffer_handle_t handle) {
-    auto mapper = get_mapper();
+bool get_into(const android::sp<IMapper>& mapper, buffer_handle_t handle,
+              typename metadata::ReturnType<meta>::type& out) {
     IMapper::MetadataType type = {
             .name = kPixelMetadataTypeName,
             .value = static_cast<int64_t>(meta),
     };
 
-    android::hardware::hidl_vec<uint8_t> vec;
-    Error error;
+    bool decoded = false;
     auto ret = mapper->get(const_cast<native_handle_t*>(handle), type,
                            [&](const auto& tmpError,
                                const android::hardware::hidl_vec<uint8_t>& tmpVec) {
-                               error = tmpError;
-                               vec = tmpVec;
+                               decoded = tmpError == Error::NONE &&
+                                       utils::decode_into(tmpVec.data(), tmpVec.size(), out);
+                           });
+
+    return ret.isOk() && decoded;
+}
+
+} // namespace
+
+template <MetadataType meta>
+std::optional<typename metadata::ReturnType<meta>::type> get(buffer_handle_t handle) {
+    auto mapper = get_mapper();
+    typename metadata::ReturnType<meta>::type data;
+
+    if (!mapper || !get_into<meta>(mapper, handle, data)) {
+        return {};
+    }
+
+    return data;
+}
+
+// Fetches several metadata in one pass, decoding each into the storage given in the same order.
+// Returns false as soon as one of them cannot be fetched, leaving the rest untouched.
+template <MetadataType... metas>
+bool get_all(buffer_handle_t handle, typename metadata::ReturnType<metas>::type&... out) {
+    auto mapper = get_mapper();
+    if (!mapper) {
+        return false;
+    }
+
+    return (get_into<metas>(mapper, handle, out) && ...);
+}
+
+inline std::optional<uint64_t> get_buffer_id(buffer_handle_t handle) {
+    auto mapper = get_mapper();
+    if (!mapper) {
+        return {};
+    }
+
+    uint64_t buffer_id;
+    bool decoded = false;
+    auto ret = mapper->get(const_cast<native_handle_t*>(handle),
+                           android::gralloc4::MetadataType_BufferId,
+                           [&](const auto& tmpError,
+                               const android::hardware::hidl_vec<uint8_t>& tmpVec) {
+                               decoded = tmpError == Error::NONE &&
+                                       android::gralloc4::decodeBufferId(tmpVec, &buffer_id) ==
+                                               android::NO_ERROR;
                            });
-    if (!ret.isOk()) {
+    if (!ret.isOk() || !decoded) {
         return {};
     }
 
-    return utils::decode<typename metadata::ReturnType<meta>::type>(vec);
+    return buffer_id;
 }
 
 template <MetadataType meta>
@@ -37,6 +37,34 @@ AIMapper* get_mapper() {
     }
 }
 
+template <MetadataType meta>
+bool get_into(AIMapper* mapper, buffer_handle_t handle,
+              typename metadata::ReturnType<meta>::type& out) {
+    AIMapper_MetadataType type = {
+            .name = kPixelMetadataTypeName,
+            .value = static_cast<int64_t>(meta),
+    };
+
+    // Most of the metadata fit on the stack, the others are fetched again once the size is known
+    uint8_t inline_buf[128];
+    auto ret = mapper->v5.getMetadata(handle, type, inline_buf, sizeof(inline_buf));
+    if (ret < 0) {
+        return false;
+    }
+
+    if (static_cast<size_t>(ret) <= sizeof(inline_buf)) {
+        return utils::decode_into(inline_buf, ret, out);
+    }
+
+    std::vector<uint8_t> metabuf(ret);
+    ret = mapper->v5.getMetadata(handle, type, metabuf.data(), metabuf.size());
+    if (ret < 0 || static_cast<size_t>(ret) > metabuf.size()) {
+        return false;
+    }
+
+    return utils::decode_into(metabuf.data(), ret, out);
+}
+
 } // namespace
 
 template <MetadataType meta>
@@ -63,6 +91,35 @@ std::optional<typename metadata::ReturnType<meta>::type> get(buffer_handle_t han
     return utils::decode<typename metadata::ReturnType<meta>::type>(metabuf);
 }
 
+// Fetches several metadata in one pass, decoding each into the storage given in the same order.
+// Returns false as soon as one of them cannot be fetched, leaving the rest untouched.
+template <MetadataType... metas>
+bool get_all(buffer_handle_t handle, typename metadata::ReturnType<metas>::type&... out) {
+    auto mapper = get_mapper();
+    if (!mapper) {
+        return false;
+    }
+
+    return (get_into<metas>(mapper, handle, out) && ...);
+}
+
+inline std::optional<uint64_t> get_buffer_id(buffer_handle_t handle) {
+    auto mapper = get_mapper();
+    if (!mapper) {
+        return {};
+    }
+
+    uint64_t buffer_id;
+    auto ret = mapper->v5.getStandardMetadata(handle,
+                                              static_cast<int64_t>(StandardMetadataType::BUFFER_ID),
+                                              &buffer_id, sizeof(buffer_id));
+    if (ret != static_cast<int32_t>(sizeof(buffer_id))) {
+        return {};
+    }
+
+    return buffer_id;
+}
+
 template <MetadataType meta>
 int64_t set(buffer_handle_t handle, typename metadata::ReturnType<meta>::type data) {
     auto encoded_data = utils::encode<typename metadata::ReturnType<meta>::type>(data);
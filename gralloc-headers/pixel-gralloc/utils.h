@@ -74,6 +74,32 @@ std::optional<Container> decode_helper(const std::vector<uint8_t>& bytes) {
     return t;
 }
 
+// Trivial type
+template <typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
+bool decode_into_helper(const uint8_t* bytes, size_t size, T& out) {
+    if (sizeof(out) != size) {
+        return false;
+    }
+
+    std::memcpy(&out, bytes, size);
+    return true;
+}
+
+// Container type, reuses the storage of the container
+template <typename Container,
+          std::enable_if_t<!std::is_trivially_copyable_v<Container>, bool> = true>
+bool decode_into_helper(const uint8_t* bytes, size_t size, Container& out) {
+    size_t member_size = sizeof(typename Container::value_type);
+
+    if (size % member_size != 0) {
+        return false;
+    }
+
+    out.resize(size / member_size);
+    std::memcpy(out.data(), bytes, size);
+    return true;
+}
+
 } // namespace
 
 namespace pixel::graphics::utils {
@@ -89,6 +115,12 @@ std::optional<T> decode(const std::vector<uint8_t>& bytes) {
     return decode_helper<T>(bytes);
 }
 
+// Decodes into out without allocating unless out is a container that has to grow
+template <typename T>
+bool decode_into(const uint8_t* bytes, size_t size, T& out) {
+    return decode_into_helper(bytes, size, out);
+}
+
 enum class Compression {
     UNCOMPRESSED,
 };
@@ -867,9 +867,8 @@ int32_t HalImpl::setClientTarget(int64_t display, buffer_handle_t target,
     a2h::translate(dataspace, hwcDataspace);
     a2h::translate(damage, hwcDamage);
     hwc_region_t region = { hwcDamage.size(), hwcDamage.data() };
-    UNUSED(region);
 
-    return halDisplay->setClientTarget(target, hwcFence, hwcDataspace);
+    return halDisplay->setClientTarget(target, hwcFence, hwcDataspace, region);
 }
 
 int32_t HalImpl::getHasClientComposition(int64_t display, bool& outHasClientComp) {
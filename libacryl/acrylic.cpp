@@ -26,7 +26,7 @@
 Acrylic::Acrylic(const HW2DCapability &capability)
     : mCapability(capability), mHasBackgroundColor(false),
       mMaxTargetLuminance(100), mMinTargetLuminance(0), mTargetDisplayInfo(nullptr),
-      mCanvas(this, AcrylicCanvas::CANVAS_TARGET)
+      mTargetDisplayInfoSerial(0), mCanvas(this, AcrylicCanvas::CANVAS_TARGET)
 {
     ALOGD_TEST("Created a new Acrylic on %p", this);
 }
@@ -1114,6 +1114,8 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
 
     mTask.commands.target[G2DSFR_DST_YCBCRMODE] |= (G2D_LAYER_YCBCRMODE_OFFX | G2D_LAYER_YCBCRMODE_OFFY);
 
+    mHdrWriter.reset();
+
     for (unsigned int i = baseidx; i < layercount; i++) {
         AcrylicLayer &layer = *getLayer(i - baseidx);
 
@@ -1144,7 +1146,8 @@ bool AcrylicCompositorG2D::executeG2D(int fence[], unsigned int num_fences, bool
         }
     }
 
-    mHdrWriter.setTargetInfo(getCanvas().getDataspace(), getTargetDisplayInfo());
+    mHdrWriter.setTargetInfo(getCanvas().getDataspace(), getTargetDisplayInfo(),
+                             getTargetDisplayInfoSerial());
     mHdrWriter.setTargetDisplayLuminance(getMinTargetDisplayLuminance(), getMaxTargetDisplayLuminance());
 
     mHdrWriter.getCommands();
@@ -0,0 +1,66 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "acrylic_g2d_hdr.h"
+
+void G2DHdrWriter::getCommands()
+{
+    mCmds = nullptr;
+
+    if (!mWriter)
+        return;
+
+    for (auto it = mCache.begin(); it != mCache.end(); ++it) {
+        if (it->setting == mSetting) {
+            mCache.splice(mCache.begin(), mCache, it);
+            mCmds = &mCache.front();
+            return;
+        }
+    }
+
+    for (LayerInfo &layer : mSetting.layers) {
+        mWriter->setLayerStaticMetadata(layer.index, layer.dataspace,
+                                        layer.min_luminance, layer.max_luminance);
+        mWriter->setLayerImageInfo(layer.index, layer.pixfmt, layer.alpha_premult);
+        mWriter->setLayerOpaqueData(layer.index, layer.data.empty() ? nullptr : layer.data.data(),
+                                    layer.data.size());
+    }
+
+    mWriter->setTargetInfo(mSetting.target_dataspace, mSetting.target_data);
+    mWriter->setTargetDisplayLuminance(mSetting.target_min_luminance, mSetting.target_max_luminance);
+
+    g2d_commandlist *cmds = mWriter->getCommands();
+    if (!cmds)
+        return;
+
+    CommandList entry;
+
+    entry.layer_hdr_mode.assign(cmds->layer_hdr_mode, cmds->layer_hdr_mode + cmds->layer_count);
+    entry.commands.assign(cmds->commands, cmds->commands + cmds->command_count);
+    entry.has_color_fill_layer = mWriter->hasColorFillLayer();
+
+    mWriter->putCommands(cmds);
+
+    entry.setting = std::move(mSetting);
+    mSetting = Setting();
+
+    mCache.push_front(std::move(entry));
+    if (mCache.size() > MAX_CACHED_COMMANDS)
+        mCache.pop_back();
+
+    mCmds = &mCache.front();
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D_HDR_H__
+#define __HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D_HDR_H__
+
+#include <cstring>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <hardware/exynos/g2d_hdr_plugin.h>
+
+#include <uapi/g2d.h>
+
+/*
+ * Command lists of the HDR plugin are cached by the settings that generated
+ * them. The settings of a task are collected until getCommands() which asks
+ * the plugin only if no cached command list was generated with the same
+ * settings. Otherwise, the tone mapping and gamut registers are replayed
+ * from the cache without the plugin regenerating them.
+ */
+class G2DHdrWriter {
+    struct LayerInfo {
+        int index;
+        int dataspace = 0;
+        unsigned int min_luminance = 0;
+        unsigned int max_luminance = 0;
+        unsigned int pixfmt = 0;
+        bool alpha_premult = false;
+        std::vector<uint8_t> data;
+
+        bool operator==(const LayerInfo &other) const {
+            return (index == other.index) && (dataspace == other.dataspace) &&
+                   (min_luminance == other.min_luminance) &&
+                   (max_luminance == other.max_luminance) && (pixfmt == other.pixfmt) &&
+                   (alpha_premult == other.alpha_premult) && (data == other.data);
+        }
+    };
+
+    struct Setting {
+        std::vector<LayerInfo> layers;
+        int target_dataspace = 0;
+        void *target_data = nullptr; // opaque to libacryl
+        // the data may change behind the same address, the serial tells it
+        unsigned int target_info_serial = 0;
+        unsigned int target_min_luminance = 0;
+        unsigned int target_max_luminance = 0;
+
+        bool operator==(const Setting &other) const {
+            return (layers == other.layers) && (target_dataspace == other.target_dataspace) &&
+                   (target_data == other.target_data) &&
+                   (target_info_serial == other.target_info_serial) &&
+                   (target_min_luminance == other.target_min_luminance) &&
+                   (target_max_luminance == other.target_max_luminance);
+        }
+    };
+
+    struct CommandList {
+        Setting setting;
+        std::vector<g2d_reg> layer_hdr_mode;
+        std::vector<g2d_reg> commands;
+        bool has_color_fill_layer;
+    };
+
+    static const size_t MAX_CACHED_COMMANDS = 4;
+
+    std::unique_ptr<IG2DHdr10CommandWriter> mWriter;
+    Setting mSetting;
+    // the most recently used first
+    std::list<CommandList> mCache;
+    CommandList *mCmds = nullptr;
+
+    LayerInfo &layerInfo(int layer_index) {
+        if (mSetting.layers.empty() || (mSetting.layers.back().index != layer_index)) {
+            mSetting.layers.emplace_back();
+            mSetting.layers.back().index = layer_index;
+        }
+
+        return mSetting.layers.back();
+    }
+public:
+    G2DHdrWriter() {
+#ifdef LIBACRYL_G2D_HDR_PLUGIN
+        mWriter.reset(IG2DHdr10CommandWriter::createInstance());
+#endif
+    }
+
+    explicit G2DHdrWriter(IG2DHdr10CommandWriter *writer) : mWriter(writer) { }
+
+    // Starts collecting the settings of a new task
+    void reset() {
+        mSetting = Setting();
+        mCmds = nullptr;
+    }
+
+    bool setLayerStaticMetadata(int layer_index, int dataspace, unsigned int min_luminance, unsigned int max_luminance) {
+        if (mWriter) {
+            LayerInfo &layer = layerInfo(layer_index);
+
+            layer.dataspace = dataspace;
+            layer.min_luminance = min_luminance;
+            layer.max_luminance = max_luminance;
+        }
+        return true;
+    }
+
+    bool setLayerImageInfo(int layer_index, unsigned int pixfmt, bool alpha_premult) {
+        if (mWriter) {
+            LayerInfo &layer = layerInfo(layer_index);
+
+            layer.pixfmt = pixfmt;
+            layer.alpha_premult = alpha_premult;
+        }
+        return true;
+    }
+
+    void setLayerOpaqueData(int layer_index, void *data, size_t len) {
+        if (mWriter) {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+            layerInfo(layer_index).data.assign(bytes, bytes + (data ? len : 0));
+        }
+    }
+
+    bool setTargetInfo(int dataspace, void *data, unsigned int serial) {
+        mSetting.target_dataspace = dataspace;
+        mSetting.target_data = data;
+        mSetting.target_info_serial = serial;
+        return true;
+    }
+
+    void setTargetDisplayLuminance(unsigned int min, unsigned int max) {
+        mSetting.target_min_luminance = min;
+        mSetting.target_max_luminance = max;
+    }
+
+    void getLayerHdrMode(g2d_task &task) {
+        if (!mCmds)
+            return;
+
+        for (g2d_reg &reg : mCmds->layer_hdr_mode) {
+            unsigned int idx;
+
+            if (mCmds->has_color_fill_layer)
+                idx = (reg.offset >> 8) - 3;
+            else
+                idx = (reg.offset >> 8) - 2;
+
+            // If premultiplied alpha values are de-premultied before HDR conversion,
+            // it should be multiplied again after the conversion. But some of the HDR processors
+            // does not have functionality of alpha multiplicaion after the conversion even though
+            // it has demultipier before the conversion.
+            // If the HDR process is lack of alpha multiplication, multiplication of alpha value
+            // should be performed by G2D.
+            if (reg.value & G2D_LAYER_HDRMODE_DEMULT_ALPHA)
+                task.commands.source[idx][G2DSFR_SRC_COMMAND] |= G2D_LAYERCMD_PREMULT_ALPHA;
+            task.commands.source[idx][G2DSFR_SRC_HDRMODE] = reg.value;
+        }
+    }
+
+    unsigned int getCommandCount() {
+        return mCmds ? mCmds->commands.size() : 0;
+    }
+
+    unsigned int write(g2d_reg *regs) {
+        if (mCmds) {
+            memcpy(regs, mCmds->commands.data(), sizeof(*regs) * mCmds->commands.size());
+            return mCmds->commands.size();
+        }
+
+        return 0;
+    }
+
+    void getCommands();
+
+    void putCommands() {
+        mCmds = nullptr;
+    }
+};
+
+#endif //__HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D_HDR_H__
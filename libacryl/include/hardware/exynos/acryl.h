@@ -1121,6 +1121,7 @@ public:
     inline void setTargetDisplayInfo(void *data)
     {
         mTargetDisplayInfo = data;
+        mTargetDisplayInfoSerial++;
     }
     /*
      * Run HW 2D. If @fence is not NULL and num_fences is not zero, execute()
@@ -1218,6 +1219,8 @@ protected:
     uint16_t getMaxTargetDisplayLuminance() { return mMaxTargetLuminance; }
     uint16_t getMinTargetDisplayLuminance() { return mMinTargetLuminance; }
     void *getTargetDisplayInfo() { return mTargetDisplayInfo; }
+    // Changes on every setTargetDisplayInfo() even if @data is at the same address
+    unsigned int getTargetDisplayInfoSerial() { return mTargetDisplayInfoSerial; }
 private:
     std::vector<AcrylicLayer *> mLayers;
     const HW2DCapability &mCapability;
@@ -1231,6 +1234,7 @@ private:
     uint16_t mMaxTargetLuminance;
     uint16_t mMinTargetLuminance;
     void *mTargetDisplayInfo;
+    unsigned int mTargetDisplayInfoSerial;
     AcrylicCanvas mCanvas;
 };
 
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "../acrylic_g2d_hdr.h"
+
+/*
+ * HDR plugin that generates one mode register for layer 1 and two commands
+ * from the last settings it was given, and counts the generations.
+ */
+class StubHdrWriter : public IG2DHdr10CommandWriter {
+public:
+    unsigned int generated = 0;
+    unsigned int returned = 0;
+
+    bool setLayerStaticMetadata(int /* layer_index */, int dataspace,
+                                unsigned int /* min_luminance */,
+                                unsigned int max_luminance) override {
+        mDataspace = dataspace;
+        mMaxLuminance = max_luminance;
+        return true;
+    }
+
+    bool setTargetInfo(int dataspace, void *data) override {
+        mTargetDataspace = dataspace;
+        mTargetData = data ? *static_cast<int *>(data) : -1;
+        return true;
+    }
+
+    void setTargetDisplayLuminance(unsigned int /* min */, unsigned int max) override {
+        mTargetMaxLuminance = max;
+    }
+
+    g2d_commandlist *getCommands() override {
+        generated++;
+
+        mLayerHdrMode[0] = {(2 + 1) << 8, static_cast<unsigned int>(mDataspace)};
+        mCommands[0] = {0x1000, mMaxLuminance};
+        mCommands[1] = {0x1004, mTargetMaxLuminance + static_cast<unsigned int>(mTargetData)};
+
+        mList = {mLayerHdrMode, mCommands, 1, 2};
+        return &mList;
+    }
+
+    void putCommands(g2d_commandlist * /* commands */) override { returned++; }
+
+private:
+    int mDataspace = 0;
+    unsigned int mMaxLuminance = 0;
+    int mTargetDataspace = 0;
+    int mTargetData = -1;
+    unsigned int mTargetMaxLuminance = 0;
+    g2d_reg mLayerHdrMode[1];
+    g2d_reg mCommands[2];
+    g2d_commandlist mList;
+};
+
+class G2DHdrWriterTest : public ::testing::Test {
+protected:
+    StubHdrWriter *plugin = new StubHdrWriter();
+    G2DHdrWriter writer{plugin};
+    int device = 0;
+    unsigned int serial = 0;
+
+    // Collects the settings of a task with one HDR layer and gets its commands
+    void prepare(unsigned int max_luminance, unsigned int target_max_luminance = 500) {
+        writer.reset();
+        writer.setLayerStaticMetadata(1, kLayerDataspace, 0, max_luminance);
+        writer.setLayerImageInfo(1, 0, true);
+        writer.setLayerOpaqueData(1, nullptr, 0);
+        writer.setTargetInfo(kTargetDataspace, &device, serial);
+        writer.setTargetDisplayLuminance(0, target_max_luminance);
+        writer.getCommands();
+    }
+
+    g2d_reg command(unsigned int index) {
+        g2d_reg regs[2] = {};
+
+        EXPECT_EQ(2u, writer.getCommandCount());
+        writer.write(regs);
+        writer.putCommands();
+        return regs[index];
+    }
+
+    static const int kLayerDataspace = 1;
+    static const int kTargetDataspace = 2;
+};
+
+TEST_F(G2DHdrWriterTest, Miss) {
+    prepare(1000);
+    EXPECT_EQ(1u, plugin->generated);
+    EXPECT_EQ(1u, plugin->returned);
+    EXPECT_EQ(1000u, command(0).value);
+
+    prepare(4000);
+    EXPECT_EQ(2u, plugin->generated);
+    EXPECT_EQ(4000u, command(0).value);
+
+    prepare(4000, 600);
+    EXPECT_EQ(3u, plugin->generated);
+    EXPECT_EQ(600u, command(1).value);
+}
+
+TEST_F(G2DHdrWriterTest, Hit) {
+    prepare(1000);
+    command(0);
+
+    for (int i = 0; i < 100; i++) {
+        prepare(1000);
+        EXPECT_EQ(1000u, command(0).value);
+    }
+    EXPECT_EQ(1u, plugin->generated);
+
+    // switching back to a cached setting does not regenerate it either
+    prepare(4000);
+    command(0);
+    prepare(1000);
+    EXPECT_EQ(1000u, command(0).value);
+    EXPECT_EQ(2u, plugin->generated);
+    EXPECT_EQ(plugin->generated, plugin->returned);
+}
+
+TEST_F(G2DHdrWriterTest, Eviction) {
+    // five settings on four entries push the first one out
+    for (unsigned int i = 0; i < 5; i++) {
+        prepare(1000 + i);
+        command(0);
+    }
+    EXPECT_EQ(5u, plugin->generated);
+
+    prepare(1004);
+    EXPECT_EQ(1004u, command(0).value);
+    EXPECT_EQ(5u, plugin->generated);
+
+    prepare(1000);
+    EXPECT_EQ(1000u, command(0).value);
+    EXPECT_EQ(6u, plugin->generated);
+
+    // the most recently used entries are kept
+    prepare(1004);
+    command(0);
+    EXPECT_EQ(6u, plugin->generated);
+}
+
+TEST_F(G2DHdrWriterTest, TargetInfoAtTheSameAddress) {
+    prepare(1000);
+    EXPECT_EQ(500u, command(1).value);
+
+    // the data behind the address changed, setTargetDisplayInfo() moved the serial
+    device = 2;
+    serial++;
+    prepare(1000);
+    EXPECT_EQ(2u, plugin->generated);
+    EXPECT_EQ(502u, command(1).value);
+}
+
+TEST_F(G2DHdrWriterTest, NoPlugin) {
+    G2DHdrWriter none{nullptr};
+
+    none.reset();
+    none.setLayerStaticMetadata(1, kLayerDataspace, 0, 1000);
+    none.getCommands();
+    EXPECT_EQ(0u, none.getCommandCount());
+}
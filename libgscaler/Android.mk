@@ -43,3 +43,26 @@ ifeq ($(BOARD_USES_VENDORIMAGE), true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+# m2m ioctl sequences against a fake GScaler node
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libexynosscaler libexynosutils
+LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers google_hal_headers
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include $(LOCAL_PATH)
+LOCAL_SRC_FILES := \
+	libgscaler_obj.cpp \
+	libgscaler.cpp \
+	exynos_subdev.c \
+	test/gscaler_m2m_test.cpp
+LOCAL_CFLAGS += -Wno-unused-function
+LOCAL_MODULE := libexynosgscaler_m2m_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+
+ifeq ($(BOARD_USES_VENDORIMAGE), true)
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+include $(BUILD_NATIVE_TEST)
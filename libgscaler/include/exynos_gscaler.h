@@ -65,6 +65,29 @@ extern "C" {
 
 typedef exynos_sc_img exynos_mpp_img;
 
+/*
+ * Counters of a m2m handle: the ioctls sent to the driver, the ones skipped
+ * because they would not change the state, and the time spent in run.
+ */
+typedef struct exynos_gsc_stats {
+    unsigned int runs;
+    unsigned int s_ctrl;
+    unsigned int s_ctrl_skipped;
+    unsigned int s_fmt;
+    unsigned int s_fmt_skipped;
+    unsigned int s_crop;
+    unsigned int s_crop_skipped;
+    unsigned int reqbufs;
+    unsigned int qbuf;
+    unsigned int dqbuf;
+    unsigned int streamon;
+    unsigned int streamoff;
+    unsigned int geometry_hit;
+    unsigned int geometry_miss;
+    unsigned long long run_time_ns;
+    unsigned long long max_run_time_ns;
+} exynos_gsc_stats;
+
 /*
  * Create libgscaler handle.
  * Gscaler dev_num is dynamically changed.
@@ -393,6 +416,35 @@ int exynos_gsc_stop_exclusive
 int exynos_gsc_free_and_close
 (void *handle);
 
+/*!
+ * Get the ioctl and run time counters of a m2m handle
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ *
+ * \param stats
+ *   counters[out]
+ *
+ * \return
+ *   error code
+ */
+int exynos_gsc_get_stats(
+    void *handle,
+    exynos_gsc_stats *stats);
+
+/*!
+ * Reset the counters of a m2m handle
+ *
+ * \ingroup exynos_gscaler
+ *
+ * \param handle
+ *   libgscaler handle[in]
+ */
+void exynos_gsc_reset_stats(
+    void *handle);
+
 enum {
     GSC_M2M_MODE = 0,
     GSC_OUTPUT_MODE,
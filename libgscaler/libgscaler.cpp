@@ -184,6 +184,27 @@ int exynos_gsc_set_src_format(
         ALOGE("%s::handle == NULL() fail", __func__);
         return -1;
     }
+
+    /* the same format is configured for every frame, only changes count */
+    if ((gsc->src_info.requested.width       == width) &&
+        (gsc->src_info.requested.height      == height) &&
+        (gsc->src_info.requested.crop_left   == crop_left) &&
+        (gsc->src_info.requested.crop_top    == crop_top) &&
+        (gsc->src_info.requested.crop_width  == crop_width) &&
+        (gsc->src_info.requested.crop_height == crop_height) &&
+        (gsc->src_info.v4l2_colorformat      == v4l2_colorformat) &&
+        (gsc->src_info.cacheable             == cacheable) &&
+        (gsc->src_info.mode_drm              == mode_drm)) {
+        Exynos_gsc_Out();
+        return 0;
+    }
+
+    gsc->src_info.requested.width       = width;
+    gsc->src_info.requested.height      = height;
+    gsc->src_info.requested.crop_left   = crop_left;
+    gsc->src_info.requested.crop_top    = crop_top;
+    gsc->src_info.requested.crop_width  = crop_width;
+    gsc->src_info.requested.crop_height = crop_height;
     gsc->src_info.width            = width;
     gsc->src_info.height           = height;
     gsc->src_info.crop_left        = crop_left;
@@ -220,6 +241,25 @@ int exynos_gsc_set_dst_format(
         return -1;
     }
 
+    if ((gsc->dst_info.requested.width       == width) &&
+        (gsc->dst_info.requested.height      == height) &&
+        (gsc->dst_info.requested.crop_left   == crop_left) &&
+        (gsc->dst_info.requested.crop_top    == crop_top) &&
+        (gsc->dst_info.requested.crop_width  == crop_width) &&
+        (gsc->dst_info.requested.crop_height == crop_height) &&
+        (gsc->dst_info.v4l2_colorformat      == v4l2_colorformat) &&
+        (gsc->dst_info.cacheable             == cacheable) &&
+        (gsc->dst_info.mode_drm              == mode_drm)) {
+        Exynos_gsc_Out();
+        return 0;
+    }
+
+    gsc->dst_info.requested.width       = width;
+    gsc->dst_info.requested.height      = height;
+    gsc->dst_info.requested.crop_left   = crop_left;
+    gsc->dst_info.requested.crop_top    = crop_top;
+    gsc->dst_info.requested.crop_width  = crop_width;
+    gsc->dst_info.requested.crop_height = crop_height;
     gsc->dst_info.width            = width;
     gsc->dst_info.height           = height;
     gsc->dst_info.crop_left        = crop_left;
@@ -259,6 +299,14 @@ int exynos_gsc_set_rotation(
     if(new_rotation < 0)
         new_rotation = -new_rotation;
 
+    if ((gsc->dst_info.rotation        != new_rotation) ||
+        (gsc->dst_info.flip_horizontal != flip_horizontal) ||
+        (gsc->dst_info.flip_vertical   != flip_vertical)) {
+        /* the size of the source is checked against the rotation too */
+        gsc->src_info.dirty = true;
+        gsc->dst_info.dirty = true;
+    }
+
     gsc->dst_info.rotation        = new_rotation;
     gsc->dst_info.flip_horizontal = flip_horizontal;
     gsc->dst_info.flip_vertical   = flip_vertical;
@@ -280,6 +328,10 @@ int exynos_gsc_set_src_addr(
         return -1;
     }
 
+    /* the buffers are requested for one memory type */
+    if (gsc->src_info.buf.mem_type != (enum v4l2_memory)mem_type)
+        gsc->src_info.dirty = true;
+
     gsc->src_info.buf.addr[0] = addr[0];
     gsc->src_info.buf.addr[1] = addr[1];
     gsc->src_info.buf.addr[2] = addr[2];
@@ -305,6 +357,9 @@ int exynos_gsc_set_dst_addr(
         return -1;
     }
 
+    if (gsc->dst_info.buf.mem_type != (enum v4l2_memory)mem_type)
+        gsc->dst_info.dirty = true;
+
     gsc->dst_info.buf.addr[0] = addr[0];
     gsc->dst_info.buf.addr[1] = addr[1];
     gsc->dst_info.buf.addr[2] = addr[2];
@@ -606,3 +661,27 @@ int exynos_gsc_free_and_close(void *handle)
 
     return 0;
 }
+
+int exynos_gsc_get_stats(void *handle, exynos_gsc_stats *stats)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if ((gsc == NULL) || (stats == NULL)) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return -1;
+    }
+
+    *stats = gsc->stats;
+
+    return 0;
+}
+
+void exynos_gsc_reset_stats(void *handle)
+{
+    CGscaler* gsc = GetGscaler(handle);
+    if (gsc == NULL) {
+        ALOGE("%s::handle == NULL() fail", __func__);
+        return;
+    }
+
+    memset(&gsc->stats, 0, sizeof(gsc->stats));
+}
@@ -345,6 +345,7 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
      * the other one off correctly.
      */
     if (gsc->src_info.stream_on == true) {
+        gsc->stats.streamoff++;
         if (ioctl(gsc->gsc_fd, VIDIOC_STREAMOFF, &gsc->src_info.buf.buf_type) < 0) {
             ALOGE("%s::exynos_v4l2_streamoff(src) fail", __func__);
             ret = -1;
@@ -353,6 +354,7 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
     }
 
     if (gsc->dst_info.stream_on == true) {
+        gsc->stats.streamoff++;
         if (ioctl(gsc->gsc_fd, VIDIOC_STREAMOFF, &gsc->dst_info.buf.buf_type) < 0) {
             ALOGE("%s::exynos_v4l2_streamoff(dst) fail", __func__);
             ret = -1;
@@ -360,12 +362,19 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
         gsc->dst_info.stream_on = false;
     }
 
+    /* streamoff returned all the queued buffers */
+    gsc->src_info.qbuf_cnt = 0;
+    gsc->src_info.buf.buf_idx = 0;
+    gsc->dst_info.qbuf_cnt = 0;
+    gsc->dst_info.buf.buf_idx = 0;
+
     /* Secure DRM support by GScaler is removed out */
 
     struct v4l2_control ctrl;
 
     ctrl.id = V4L2_CID_CONTENT_PROTECTION;
     ctrl.value = 0;
+    gsc->stats.s_ctrl++;
     if (ioctl(gsc->gsc_fd, VIDIOC_S_CTRL, &ctrl) < 0) {
         ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CONTENT_PROTECTION) fail",
               __func__);
@@ -376,6 +385,7 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
     req_buf.count  = 0;
     req_buf.type   = gsc->src_info.buf.buf_type;
     req_buf.memory = gsc->src_info.buf.mem_type;
+    gsc->stats.reqbufs++;
     if (ioctl(gsc->gsc_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
         ALOGE("%s::exynos_v4l2_reqbufs():src: fail", __func__);
         ret = -1;
@@ -385,11 +395,15 @@ int CGscaler::m_gsc_m2m_stop(void *handle)
     req_buf.count  = 0;
     req_buf.type   = gsc->dst_info.buf.buf_type;
     req_buf.memory = gsc->dst_info.buf.mem_type;;
+    gsc->stats.reqbufs++;
     if (ioctl(gsc->gsc_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
         ALOGE("%s::exynos_v4l2_reqbufs():dst: fail", __func__);
         ret = -1;
     }
 
+    gsc->src_info.buf.buf_cnt = 0;
+    gsc->dst_info.buf.buf_cnt = 0;
+
     Exynos_gsc_Out();
 
     return ret;
@@ -402,12 +416,23 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
     unsigned int rotate, hflip, vflip;
     bool is_dirty;
     bool is_drm;
+    bool csc_changed;
+    struct timespec start, end;
+    unsigned long long run_time;
     CGscaler* gsc = GetGscaler(handle);
     if (gsc == NULL) {
         ALOGE("%s::handle == NULL() fail", __func__);
         return -1;
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* the buffers were released by stop, they have to be requested again */
+    if (gsc->src_info.buf.buf_cnt == 0)
+        gsc->src_info.dirty = true;
+    if (gsc->dst_info.buf.buf_cnt == 0)
+        gsc->dst_info.dirty = true;
+
     is_dirty = gsc->src_info.dirty || gsc->dst_info.dirty;
     is_drm = gsc->src_info.mode_drm;
 
@@ -424,29 +449,61 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
 
     CGscaler::rotateValueHAL2GSC(gsc->dst_img.rot, &rotate, &hflip, &vflip);
 
-    if (CGscaler::m_gsc_check_src_size(&gsc->src_info.width,
-            &gsc->src_info.height, &gsc->src_info.crop_left,
-            &gsc->src_info.crop_top, &gsc->src_info.crop_width,
-            &gsc->src_info.crop_height, gsc->src_info.v4l2_colorformat,
-            (rotate == 90 || rotate == 270)) == false) {
+    if (gsc->src_info.dirty &&
+        (gsc->m_gsc_set_geometry(&gsc->src_info,
+            (rotate == 90 || rotate == 270), true) == false)) {
         ALOGE("%s::m_gsc_check_src_size() fail", __func__);
         return -1;
     }
 
-    if (CGscaler::m_gsc_check_dst_size(&gsc->dst_info.width,
-            &gsc->dst_info.height, &gsc->dst_info.crop_left,
-            &gsc->dst_info.crop_top, &gsc->dst_info.crop_width,
-            &gsc->dst_info.crop_height, gsc->dst_info.v4l2_colorformat,
-            gsc->dst_info.rotation) == false) {
+    if (gsc->dst_info.dirty &&
+        (gsc->m_gsc_set_geometry(&gsc->dst_info,
+            gsc->dst_info.rotation, false) == false)) {
         ALOGE("%s::m_gsc_check_dst_size() fail", __func__);
         return -1;
     }
 
-    /* dequeue buffers from previous work if necessary */
+    csc_changed = (gsc->ctrls.csc_eq_mode != (int)gsc->eq_auto) ||
+                  (gsc->ctrls.csc_eq != (int)gsc->v4l2_colorspace) ||
+                  (gsc->ctrls.csc_range != (int)gsc->range_full);
+
     if (gsc->src_info.stream_on == true) {
-        if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0) {
-            ALOGE("%s::exynos_gsc_m2m_wait_frame_done fail", __func__);
-            return -1;
+        if (is_dirty && (gsc->m_gsc_needs_realloc(&gsc->src_info) ||
+                         gsc->m_gsc_needs_realloc(&gsc->dst_info))) {
+            /*
+             * the format and the buffers can only be changed on idle queues,
+             * finish the jobs in flight before streaming off
+             */
+            if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0) {
+                ALOGE("%s::exynos_gsc_m2m_wait_frame_done fail", __func__);
+                gsc->m_gsc_m2m_stop(handle);
+                return -1;
+            }
+            if (gsc->m_gsc_m2m_stop(handle) < 0) {
+                ALOGE("%s::m_gsc_m2m_stop fail", __func__);
+                return -1;
+            }
+            /* stop released the buffers of both queues */
+            gsc->src_info.dirty = true;
+            gsc->dst_info.dirty = true;
+        } else if (is_dirty || csc_changed) {
+            /* the new controls and crop must not apply to the jobs in flight */
+            if (gsc->m_gsc_m2m_wait_frame_done(handle) < 0) {
+                ALOGE("%s::exynos_gsc_m2m_wait_frame_done fail", __func__);
+                goto done;
+            }
+        } else {
+            /* dequeue the oldest job only if its slot is needed now */
+            if ((gsc->src_info.qbuf_cnt >= gsc->src_info.buf.buf_cnt) &&
+                (gsc->m_gsc_dequeue_buf(&gsc->src_info) == false)) {
+                ALOGE("%s::m_gsc_dequeue_buf(src) fail", __func__);
+                goto done;
+            }
+            if ((gsc->dst_info.qbuf_cnt >= gsc->dst_info.buf.buf_cnt) &&
+                (gsc->m_gsc_dequeue_buf(&gsc->dst_info) == false)) {
+                ALOGE("%s::m_gsc_dequeue_buf(dst) fail", __func__);
+                goto done;
+            }
         }
     }
 
@@ -459,6 +516,7 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
 
         ctrl.id = V4L2_CID_CONTENT_PROTECTION;
         ctrl.value = is_drm;
+        gsc->stats.s_ctrl++;
         if (ioctl(gsc->gsc_fd,VIDIOC_S_CTRL, &ctrl) < 0) {
             ALOGE("%s::exynos_v4l2_s_ctrl() fail", __func__);
             return -1;
@@ -470,8 +528,29 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
      * whatever state we have set.
      */
 
+    /* the transform belongs to the context, only dst carries it */
+    if (is_dirty) {
+        if (gsc->m_gsc_set_ctrl(V4L2_CID_ROTATE, gsc->dst_info.rotation,
+                &gsc->ctrls.rotation) == false) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_ROTATE) fail", __func__);
+            goto done;
+        }
+
+        if (gsc->m_gsc_set_ctrl(V4L2_CID_VFLIP, gsc->dst_info.flip_horizontal,
+                &gsc->ctrls.vflip) == false) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_VFLIP) fail", __func__);
+            goto done;
+        }
+
+        if (gsc->m_gsc_set_ctrl(V4L2_CID_HFLIP, gsc->dst_info.flip_vertical,
+                &gsc->ctrls.hflip) == false) {
+            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_HFLIP) fail", __func__);
+            goto done;
+        }
+    }
+
     if (gsc->src_info.dirty) {
-        if (CGscaler::m_gsc_set_format(gsc->gsc_fd, &gsc->src_info) == false) {
+        if (gsc->m_gsc_set_format(&gsc->src_info) == false) {
             ALOGE("%s::m_gsc_set_format(src) fail", __func__);
             goto done;
         }
@@ -479,7 +558,7 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
     }
 
     if (gsc->dst_info.dirty) {
-        if (CGscaler::m_gsc_set_format(gsc->gsc_fd, &gsc->dst_info) == false) {
+        if (gsc->m_gsc_set_format(&gsc->dst_info) == false) {
             ALOGE("%s::m_gsc_set_format(dst) fail", __func__);
             goto done;
         }
@@ -489,29 +568,22 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
     /*
      * set up csc equation property
      */
-    if (is_dirty) {
-        struct v4l2_control ctrl;
-
-        ctrl.id = V4L2_CID_CSC_EQ_MODE;
-        ctrl.value = gsc->eq_auto;
-        if (ioctl(gsc->gsc_fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ_MODE) fail", __func__);
-            return -1;
-        }
+    if (gsc->m_gsc_set_ctrl(V4L2_CID_CSC_EQ_MODE, gsc->eq_auto,
+            &gsc->ctrls.csc_eq_mode) == false) {
+        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ_MODE) fail", __func__);
+        return -1;
+    }
 
-        ctrl.id = V4L2_CID_CSC_EQ;
-        ctrl.value = gsc->v4l2_colorspace;
-        if (ioctl(gsc->gsc_fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ) fail", __func__);
-            return -1;
-        }
+    if (gsc->m_gsc_set_ctrl(V4L2_CID_CSC_EQ, gsc->v4l2_colorspace,
+            &gsc->ctrls.csc_eq) == false) {
+        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_EQ) fail", __func__);
+        return -1;
+    }
 
-        ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = gsc->range_full;
-        if (ioctl(gsc->gsc_fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_RANGE) fail", __func__);
-            return -1;
-        }
+    if (gsc->m_gsc_set_ctrl(V4L2_CID_CSC_RANGE, gsc->range_full,
+            &gsc->ctrls.csc_range) == false) {
+        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_CSC_RANGE) fail", __func__);
+        return -1;
     }
 
     /* if we are enabling drm, make sure to enable hw protection.
@@ -520,17 +592,18 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
      */
     /* Secure DRM upport by GScaler is removed out */
 
-    if (gsc->m_gsc_set_addr(gsc->gsc_fd, &gsc->src_info) == false) {
+    if (gsc->m_gsc_set_addr(&gsc->src_info) == false) {
         ALOGE("%s::m_gsc_set_addr(src) fail", __func__);
         goto done;
     }
 
-    if (gsc->m_gsc_set_addr(gsc->gsc_fd, &gsc->dst_info) == false) {
+    if (gsc->m_gsc_set_addr(&gsc->dst_info) == false) {
         ALOGE("%s::m_gsc_set_addr(dst) fail", __func__);
         goto done;
     }
 
     if (gsc->src_info.stream_on == false) {
+        gsc->stats.streamon++;
         if (ioctl(gsc->gsc_fd, VIDIOC_STREAMON, &gsc->src_info.buf.buf_type) < 0) {
             ALOGE("%s::exynos_v4l2_streamon(src) fail", __func__);
             goto done;
@@ -539,6 +612,7 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
     }
 
     if (gsc->dst_info.stream_on == false) {
+        gsc->stats.streamon++;
         if (ioctl(gsc->gsc_fd, VIDIOC_STREAMON, &gsc->dst_info.buf.buf_type) < 0) {
             ALOGE("%s::exynos_v4l2_streamon(dst) fail", __func__);
             goto done;
@@ -546,6 +620,14 @@ int CGscaler::m_gsc_m2m_run_core(void *handle)
         gsc->dst_info.stream_on = true;
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    run_time = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+               end.tv_nsec - start.tv_nsec;
+    gsc->stats.runs++;
+    gsc->stats.run_time_ns += run_time;
+    if (run_time > gsc->stats.max_run_time_ns)
+        gsc->stats.max_run_time_ns = run_time;
+
     Exynos_gsc_Out();
 
     return 0;
@@ -647,20 +729,19 @@ int CGscaler::m_gsc_m2m_wait_frame_done(void *handle)
         return -1;
     }
 
-    if (gsc->src_info.buf.buffer_queued) {
-        if (ioctl(gsc->gsc_fd, VIDIOC_DQBUF, &gsc->src_info.buf.buffer) < 0) {
+    /* all the jobs in flight */
+    while (gsc->src_info.qbuf_cnt > 0) {
+        if (gsc->m_gsc_dequeue_buf(&gsc->src_info) == false) {
             ALOGE("%s::exynos_v4l2_dqbuf(src) fail", __func__);
             return -1;
         }
-        gsc->src_info.buf.buffer_queued = false;
     }
 
-    if (gsc->dst_info.buf.buffer_queued) {
-        if (ioctl(gsc->gsc_fd, VIDIOC_DQBUF, &gsc->dst_info.buf.buffer) < 0) {
+    while (gsc->dst_info.qbuf_cnt > 0) {
+        if (gsc->m_gsc_dequeue_buf(&gsc->dst_info) == false) {
             ALOGE("%s::exynos_v4l2_dqbuf(dst) fail", __func__);
             return -1;
         }
-        gsc->dst_info.buf.buffer_queued = false;
     }
 
     Exynos_gsc_Out();
@@ -668,80 +749,237 @@ int CGscaler::m_gsc_m2m_wait_frame_done(void *handle)
     return 0;
 }
 
-bool CGscaler::m_gsc_set_format(int fd, GscInfo *info)
+bool CGscaler::m_gsc_set_ctrl(unsigned int id, int value, int *applied)
 {
-    Exynos_gsc_In();
+    struct v4l2_control ctrl;
 
-    struct v4l2_requestbuffers req_buf;
-    int                        plane_count;
+    if (*applied == value) {
+        stats.s_ctrl_skipped++;
+        return true;
+    }
 
-    plane_count = m_gsc_get_plane_count(info->v4l2_colorformat);
-    if (plane_count < 0) {
-        ALOGE("%s::not supported v4l2_colorformat", __func__);
+    ctrl.id = id;
+    ctrl.value = value;
+    stats.s_ctrl++;
+    if (ioctl(gsc_fd, VIDIOC_S_CTRL, &ctrl) < 0) {
+        *applied = -1;
         return false;
     }
+    *applied = value;
 
-    struct v4l2_control ctrl;
+    return true;
+}
 
-    ctrl.id = V4L2_CID_ROTATE;
-    ctrl.value = info->rotation;
-    if (ioctl(fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_ROTATE) fail", __func__);
-        return false;
-    }
+bool CGscaler::m_gsc_needs_realloc(GscInfo *info)
+{
+    /* cacheable is applied to the buffers when they are requested */
+    return (info->buf.buf_cnt == 0) ||
+           (info->applied.format_valid == false) ||
+           (info->applied.width != info->width) ||
+           (info->applied.height != info->height) ||
+           (info->applied.v4l2_colorformat != info->v4l2_colorformat) ||
+           (info->applied.mem_type != info->buf.mem_type) ||
+           (info->applied.cacheable != info->cacheable);
+}
 
-    ctrl.id = V4L2_CID_VFLIP;
-    ctrl.value = info->flip_horizontal;
-    if (ioctl(fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_VFLIP) fail", __func__);
-        return false;
+bool CGscaler::m_gsc_set_geometry(GscInfo *info, int rotation, bool is_src)
+{
+    GscGeometry *geometry = NULL;
+    GscGeometry *victim = &info->geometry[0];
+    int i;
+
+    /* keyed on the size of the caller, the checks may align it */
+    for (i = 0; i < GSC_GEOMETRY_CACHE_SIZE; i++) {
+        GscGeometry *entry = &info->geometry[i];
+        if (entry->valid &&
+            (entry->width == info->requested.width) &&
+            (entry->height == info->requested.height) &&
+            (entry->crop_left == info->requested.crop_left) &&
+            (entry->crop_top == info->requested.crop_top) &&
+            (entry->crop_width == info->requested.crop_width) &&
+            (entry->crop_height == info->requested.crop_height) &&
+            (entry->v4l2_colorformat == info->v4l2_colorformat) &&
+            (entry->rotation == rotation)) {
+            geometry = entry;
+            break;
+        }
+        if (!entry->valid || (victim->valid && (entry->age < victim->age)))
+            victim = entry;
     }
 
-    ctrl.id = V4L2_CID_HFLIP;
-    ctrl.value = info->flip_vertical;
-    if (ioctl(fd, VIDIOC_S_CTRL, &ctrl) < 0) {
-        ALOGE("%s::exynos_v4l2_s_ctrl(V4L2_CID_HFLIP) fail", __func__);
-        return false;
-    }
+    if (geometry != NULL) {
+        stats.geometry_hit++;
+    } else {
+        stats.geometry_miss++;
+
+        info->width       = info->requested.width;
+        info->height      = info->requested.height;
+        info->crop_left   = info->requested.crop_left;
+        info->crop_top    = info->requested.crop_top;
+        info->crop_width  = info->requested.crop_width;
+        info->crop_height = info->requested.crop_height;
+
+        if (is_src) {
+            if (m_gsc_check_src_size(&info->width, &info->height,
+                    &info->crop_left, &info->crop_top, &info->crop_width,
+                    &info->crop_height, info->v4l2_colorformat,
+                    rotation) == false)
+                return false;
+        } else {
+            if (m_gsc_check_dst_size(&info->width, &info->height,
+                    &info->crop_left, &info->crop_top, &info->crop_width,
+                    &info->crop_height, info->v4l2_colorformat,
+                    rotation) == false)
+                return false;
+        }
 
-    info->format.type = info->buf.buf_type;
-    info->format.fmt.pix_mp.width       = info->width;
-    info->format.fmt.pix_mp.height      = info->height;
-    info->format.fmt.pix_mp.pixelformat = info->v4l2_colorformat;
-    info->format.fmt.pix_mp.field       = V4L2_FIELD_ANY;
-    info->format.fmt.pix_mp.num_planes  = plane_count;
+        int plane_count = m_gsc_get_plane_count(info->v4l2_colorformat);
+        if (plane_count < 0) {
+            ALOGE("%s::not supported v4l2_colorformat", __func__);
+            return false;
+        }
+
+        geometry = victim;
+        geometry->valid               = true;
+        geometry->width               = info->requested.width;
+        geometry->height              = info->requested.height;
+        geometry->crop_left           = info->requested.crop_left;
+        geometry->crop_top            = info->requested.crop_top;
+        geometry->crop_width          = info->requested.crop_width;
+        geometry->crop_height         = info->requested.crop_height;
+        geometry->v4l2_colorformat    = info->v4l2_colorformat;
+        geometry->rotation            = rotation;
+        geometry->aligned_width       = info->width;
+        geometry->aligned_height      = info->height;
+        geometry->aligned_crop_left   = info->crop_left;
+        geometry->aligned_crop_top    = info->crop_top;
+        geometry->aligned_crop_width  = info->crop_width;
+        geometry->aligned_crop_height = info->crop_height;
+        geometry->plane_count         = plane_count;
+        m_gsc_get_plane_size(geometry->plane_size, info->width,
+                             info->height, info->v4l2_colorformat);
+    }
+
+    info->width       = geometry->aligned_width;
+    info->height      = geometry->aligned_height;
+    info->crop_left   = geometry->aligned_crop_left;
+    info->crop_top    = geometry->aligned_crop_top;
+    info->crop_width  = geometry->aligned_crop_width;
+    info->crop_height = geometry->aligned_crop_height;
+
+    geometry->age = ++info->geometry_age;
+    info->cur_geometry = geometry - info->geometry;
+
+    return true;
+}
+
+bool CGscaler::m_gsc_set_format(GscInfo *info)
+{
+    Exynos_gsc_In();
+
+    struct v4l2_requestbuffers req_buf;
+    GscGeometry *geometry;
+    bool realloc = m_gsc_needs_realloc(info);
 
-    if (ioctl(fd, VIDIOC_S_FMT, &info->format) < 0) {
-        ALOGE("%s::exynos_v4l2_s_fmt() fail", __func__);
+    if (info->cur_geometry < 0) {
+        ALOGE("%s::geometry is not validated", __func__);
         return false;
     }
+    geometry = &info->geometry[info->cur_geometry];
+
+    if ((info->applied.format_valid == false) ||
+        (info->applied.width != info->width) ||
+        (info->applied.height != info->height) ||
+        (info->applied.v4l2_colorformat != info->v4l2_colorformat)) {
+        /* the format can't be changed while buffers are requested */
+        if (info->buf.buf_cnt > 0) {
+            req_buf.count  = 0;
+            req_buf.type   = info->buf.buf_type;
+            req_buf.memory = info->buf.mem_type;
+            stats.reqbufs++;
+            if (ioctl(gsc_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+                ALOGE("%s::exynos_v4l2_reqbufs() fail", __func__);
+                return false;
+            }
+            info->buf.buf_cnt = 0;
+        }
 
-    info->crop.type     = info->buf.buf_type;
-    info->crop.c.left   = info->crop_left;
-    info->crop.c.top    = info->crop_top;
-    info->crop.c.width  = info->crop_width;
-    info->crop.c.height = info->crop_height;
+        info->format.type = info->buf.buf_type;
+        info->format.fmt.pix_mp.width       = info->width;
+        info->format.fmt.pix_mp.height      = info->height;
+        info->format.fmt.pix_mp.pixelformat = info->v4l2_colorformat;
+        info->format.fmt.pix_mp.field       = V4L2_FIELD_ANY;
+        info->format.fmt.pix_mp.num_planes  = geometry->plane_count;
+
+        info->applied.format_valid = false;
+        stats.s_fmt++;
+        if (ioctl(gsc_fd, VIDIOC_S_FMT, &info->format) < 0) {
+            ALOGE("%s::exynos_v4l2_s_fmt() fail", __func__);
+            return false;
+        }
+        info->applied.format_valid     = true;
+        info->applied.width            = info->width;
+        info->applied.height           = info->height;
+        info->applied.v4l2_colorformat = info->v4l2_colorformat;
+    } else {
+        stats.s_fmt_skipped++;
+    }
+
+    if ((info->applied.crop_valid == false) ||
+        (info->applied.crop.left != (int)info->crop_left) ||
+        (info->applied.crop.top != (int)info->crop_top) ||
+        (info->applied.crop.width != info->crop_width) ||
+        (info->applied.crop.height != info->crop_height)) {
+        info->crop.type     = info->buf.buf_type;
+        info->crop.c.left   = info->crop_left;
+        info->crop.c.top    = info->crop_top;
+        info->crop.c.width  = info->crop_width;
+        info->crop.c.height = info->crop_height;
+
+        info->applied.crop_valid = false;
+        stats.s_crop++;
+        if (ioctl(gsc_fd, VIDIOC_S_CROP, &info->crop) < 0) {
+            ALOGE("%s::exynos_v4l2_s_crop() fail", __func__);
+            return false;
+        }
+        info->applied.crop_valid = true;
+        info->applied.crop = info->crop.c;
+    } else {
+        stats.s_crop_skipped++;
+    }
 
-    if (ioctl(fd, VIDIOC_S_CROP, &info->crop) < 0) {
-        ALOGE("%s::exynos_v4l2_s_crop() fail", __func__);
-        return false;
+    if (!realloc) {
+        Exynos_gsc_Out();
+        return true;
     }
 
-    ctrl.id = V4L2_CID_CACHEABLE;
-    ctrl.value = info->cacheable;
-    if (ioctl(fd, VIDIOC_S_CTRL, &ctrl) < 0) {
+    if (m_gsc_set_ctrl(V4L2_CID_CACHEABLE, info->cacheable,
+            &ctrls.cacheable) == false) {
         ALOGE("%s::exynos_v4l2_s_ctrl() fail", __func__);
         return false;
     }
 
-    req_buf.count  = 1;
+    req_buf.count  = NUM_OF_GSC_M2M_BUFFERS;
     req_buf.type   = info->buf.buf_type;
     req_buf.memory = info->buf.mem_type;
-    if (ioctl(fd, VIDIOC_REQBUFS, &req_buf) < 0) {
+    stats.reqbufs++;
+    if (ioctl(gsc_fd, VIDIOC_REQBUFS, &req_buf) < 0) {
         ALOGE("%s::exynos_v4l2_reqbufs() fail", __func__);
         return false;
     }
 
+    /* the driver may allocate less buffers than requested */
+    if (req_buf.count < 1) {
+        ALOGE("%s::exynos_v4l2_reqbufs() no buffers", __func__);
+        return false;
+    }
+    info->buf.buf_cnt = (req_buf.count < NUM_OF_GSC_M2M_BUFFERS) ?
+                         req_buf.count : NUM_OF_GSC_M2M_BUFFERS;
+    info->buf.buf_idx = 0;
+    info->qbuf_cnt = 0;
+    info->applied.mem_type = info->buf.mem_type;
+    info->applied.cacheable = info->cacheable;
+
     Exynos_gsc_Out();
 
     return true;
@@ -788,15 +1026,19 @@ unsigned int CGscaler::m_gsc_get_plane_count(int v4l_pixel_format)
     return plane_count;
 }
 
-bool CGscaler::m_gsc_set_addr(int fd, GscInfo *info)
+bool CGscaler::m_gsc_set_addr(GscInfo *info)
 {
     unsigned int i;
-    unsigned int plane_size[NUM_OF_GSC_PLANES];
+    unsigned int *plane_size;
 
-    CGscaler::m_gsc_get_plane_size(plane_size, info->width,
-                         info->height, info->v4l2_colorformat);
+    if ((info->buf.buf_cnt <= 0) || (info->cur_geometry < 0)) {
+        ALOGE("%s::no buffers requested", __func__);
+        return false;
+    }
+
+    plane_size = info->geometry[info->cur_geometry].plane_size;
 
-    info->buf.buffer.index    = 0;
+    info->buf.buffer.index    = info->buf.buf_idx;
     info->buf.buffer.flags    = V4L2_BUF_FLAG_USE_SYNC;
     info->buf.buffer.type     = info->buf.buf_type;
     info->buf.buffer.memory   = info->buf.mem_type;
@@ -814,17 +1056,46 @@ bool CGscaler::m_gsc_set_addr(int fd, GscInfo *info)
         info->buf.buffer.m.planes[i].bytesused = 0;
     }
 
-    if (ioctl(fd, VIDIOC_QBUF, &info->buf.buffer) < 0) {
-        ALOGE("%s::exynos_v4l2_qbuf() fail", __func__);
+    stats.qbuf++;
+    if (ioctl(gsc_fd, VIDIOC_QBUF, &info->buf.buffer) < 0) {
+        ALOGE("%s::exynos_v4l2_qbuf(index=%d) fail", __func__,
+              info->buf.buf_idx);
         return false;
     }
-    info->buf.buffer_queued = true;
+    info->qbuf_cnt++;
+    info->buf.buf_idx = (info->buf.buf_idx + 1) % info->buf.buf_cnt;
 
     info->releaseFenceFd = info->buf.buffer.reserved;
 
     return true;
 }
 
+bool CGscaler::m_gsc_dequeue_buf(GscInfo *info)
+{
+    struct v4l2_buffer buffer;
+    struct v4l2_plane planes[NUM_OF_GSC_PLANES];
+
+    if (info->qbuf_cnt <= 0)
+        return true;
+
+    memset(&buffer, 0, sizeof(buffer));
+    memset(planes, 0, sizeof(planes));
+    buffer.type     = info->buf.buf_type;
+    buffer.memory   = info->buf.mem_type;
+    buffer.m.planes = planes;
+    buffer.length   = info->format.fmt.pix_mp.num_planes;
+
+    /* jobs complete in order, this is the oldest one */
+    stats.dqbuf++;
+    if (ioctl(gsc_fd, VIDIOC_DQBUF, &buffer) < 0) {
+        ALOGE("%s::exynos_v4l2_dqbuf() fail", __func__);
+        return false;
+    }
+    info->qbuf_cnt--;
+
+    return true;
+}
+
 unsigned int CGscaler::m_gsc_get_plane_size(
     unsigned int *plane_size,
     unsigned int  width,
@@ -53,6 +53,13 @@ extern "C" {
 #define FIMD_SUBDEV_PAD_SINK        (0)
 #define DECON_TV_WB_PAD             (0)
 #define MAX_BUFFERS                 (6)
+/*
+ * m2m jobs in flight: the next job is queued while the previous ones are still
+ * processed, a slot is dequeued only when all of them are in use
+ */
+#define NUM_OF_GSC_M2M_BUFFERS      (3)
+/* validated geometries remembered per queue */
+#define GSC_GEOMETRY_CACHE_SIZE     (4)
 
 #define NUM_OF_GSC_HW               (4)
 #define NODE_NUM_GSC_0              (23)
@@ -90,6 +97,40 @@ extern "C" {
 #define MAX_GSC_WAITING_TIME_FOR_TRYLOCK (16000) // 16msec
 #define GSC_WAITING_TIME_FOR_TRYLOCK      (8000) //  8msec
 
+typedef struct GscalerGeometry {
+    bool valid;
+    unsigned int age;
+    /* key */
+    unsigned int width;
+    unsigned int height;
+    unsigned int crop_left;
+    unsigned int crop_top;
+    unsigned int crop_width;
+    unsigned int crop_height;
+    unsigned int v4l2_colorformat;
+    int rotation;
+    /* negotiated */
+    unsigned int aligned_width;
+    unsigned int aligned_height;
+    unsigned int aligned_crop_left;
+    unsigned int aligned_crop_top;
+    unsigned int aligned_crop_width;
+    unsigned int aligned_crop_height;
+    unsigned int plane_count;
+    unsigned int plane_size[NUM_OF_GSC_PLANES];
+}GscGeometry;
+
+/* last values sent to the driver, -1 when unknown */
+typedef struct GscalerCtrls {
+    int rotation;
+    int vflip;
+    int hflip;
+    int cacheable;
+    int csc_eq_mode;
+    int csc_eq;
+    int csc_range;
+}GscCtrls;
+
 typedef struct GscalerInfo {
     unsigned int width;
     unsigned int height;
@@ -108,6 +149,15 @@ typedef struct GscalerInfo {
     int releaseFenceFd;
     bool stream_on;
     bool dirty;
+    /* the size passed by the caller, the size checks may align the one above */
+    struct Requested_Info {
+        unsigned int width;
+        unsigned int height;
+        unsigned int crop_left;
+        unsigned int crop_top;
+        unsigned int crop_width;
+        unsigned int crop_height;
+    }requested;
     struct v4l2_format format;
     struct v4l2_crop crop;
     struct Buffer_Info {
@@ -115,10 +165,23 @@ typedef struct GscalerInfo {
         enum v4l2_buf_type buf_type;
         void *addr[NUM_OF_GSC_PLANES];
         struct v4l2_plane planes[NUM_OF_GSC_PLANES];
-        bool buffer_queued;
         struct v4l2_buffer buffer;
         int buf_idx;
+        int buf_cnt;
     }buf;
+    struct Applied_Info {
+        bool format_valid;
+        unsigned int width;
+        unsigned int height;
+        unsigned int v4l2_colorformat;
+        bool crop_valid;
+        struct v4l2_rect crop;
+        enum v4l2_memory mem_type;
+        unsigned int cacheable;
+    }applied;
+    GscGeometry geometry[GSC_GEOMETRY_CACHE_SIZE];
+    int cur_geometry;
+    unsigned int geometry_age;
 }GscInfo;
 
 struct MediaDevice {
@@ -145,11 +208,17 @@ public:
     unsigned int eq_auto;           /* 0: user, 1: auto */
     unsigned int range_full;        /* 0: narrow, 1: full */
     unsigned int v4l2_colorspace;   /* 1: 601, 3: 709, see csc.h or videodev2.h */
+    GscCtrls ctrls;
+    exynos_gsc_stats stats;
     void *scaler;
 
     void __InitMembers(int __mode, int __out_mode, int __gsc_id,int __allow_drm)
     {
         memset(&mdev, 0, sizeof(mdev));
+        memset(&ctrls, -1, sizeof(ctrls));
+        memset(&stats, 0, sizeof(stats));
+        src_info.cur_geometry = -1;
+        dst_info.cur_geometry = -1;
         scaler = NULL;
 
         mode = __mode;
@@ -229,9 +298,13 @@ public:
         exynos_mpp_img *src_img, exynos_mpp_img *dst_img);
     int m_gsc_out_run(void *handle, exynos_mpp_img *src_img);
     int m_gsc_cap_run(void *handle, exynos_mpp_img *dst_img);
-    static bool m_gsc_set_format(int fd, GscInfo *info);
+    bool m_gsc_set_format(GscInfo *info);
+    bool m_gsc_set_ctrl(unsigned int id, int value, int *applied);
+    bool m_gsc_needs_realloc(GscInfo *info);
+    bool m_gsc_set_geometry(GscInfo *info, int rotation, bool is_src);
     static unsigned int m_gsc_get_plane_count(int v4l_pixel_format);
-    static bool m_gsc_set_addr(int fd, GscInfo *info);
+    bool m_gsc_set_addr(GscInfo *info);
+    bool m_gsc_dequeue_buf(GscInfo *info);
     static unsigned int m_gsc_get_plane_size(
         unsigned int *plane_size, unsigned int width,
         unsigned int height, int v4l_pixel_format);
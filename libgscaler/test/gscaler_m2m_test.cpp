@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "libgscaler_obj.h"
+
+using namespace std;
+
+#define CID_EXYNOS_BASE         (V4L2_CTRL_CLASS_USER | 0x2000)
+#define CID_CSC_EQ_MODE         (CID_EXYNOS_BASE + 100)
+#define CID_CSC_EQ              (CID_EXYNOS_BASE + 101)
+#define CID_CSC_RANGE           (CID_EXYNOS_BASE + 102)
+#define CID_CONTENT_PROTECTION  (CID_EXYNOS_BASE + 201)
+#define CID_CACHEABLE           (CID_EXYNOS_BASE + 10)
+
+/*
+ * A stand-in of the m2m node of GScaler on a regular file. ioctl() on the file
+ * is served by FakeGscaler instead of the driver. Like videobuf2, it rejects
+ * S_FMT while buffers are allocated and REQBUFS while streaming, and it grants
+ * at most kMaxBuffers buffers. A job is done as soon as both of its buffers are
+ * queued. Each ioctl is logged as a string like "QBUF src 1".
+ */
+class FakeGscaler {
+    struct Queue {
+        bool streaming = false;
+        unsigned int count = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int num_planes = 0;
+        deque<unsigned int> queued;
+        deque<unsigned int> done;
+    };
+
+    string mPath;
+    dev_t mDev = 0;
+    ino_t mIno = 0;
+    Queue mQueue[2];
+
+    static int QueueOf(unsigned int type) {
+        return (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) ? 0 : 1;
+    }
+
+    static const char *Name(unsigned int type) {
+        return (QueueOf(type) == 0) ? "src" : "dst";
+    }
+
+    static string CtrlName(unsigned int id) {
+        switch (id) {
+            case V4L2_CID_ROTATE: return "ROTATE";
+            case V4L2_CID_VFLIP: return "VFLIP";
+            case V4L2_CID_HFLIP: return "HFLIP";
+            case CID_CSC_EQ_MODE: return "CSC_EQ_MODE";
+            case CID_CSC_EQ: return "CSC_EQ";
+            case CID_CSC_RANGE: return "CSC_RANGE";
+            case CID_CONTENT_PROTECTION: return "CONTENT_PROTECTION";
+            case CID_CACHEABLE: return "CACHEABLE";
+        }
+        return to_string(id);
+    }
+
+    int Fail(int err) {
+        errno = err;
+        return -1;
+    }
+
+    void Log(const string &call) { log.push_back(call); }
+
+    int SetFormat(v4l2_format *fmt) {
+        Queue &q = mQueue[QueueOf(fmt->type)];
+        Log(string("S_FMT ") + Name(fmt->type) + " " + to_string(fmt->fmt.pix_mp.width) + "x" +
+            to_string(fmt->fmt.pix_mp.height));
+        if (q.count > 0) return Fail(EBUSY);
+        q.width = fmt->fmt.pix_mp.width;
+        q.height = fmt->fmt.pix_mp.height;
+        q.num_planes = fmt->fmt.pix_mp.num_planes;
+        return 0;
+    }
+
+    int ReqBufs(v4l2_requestbuffers *req) {
+        Queue &q = mQueue[QueueOf(req->type)];
+        Log(string("REQBUFS ") + Name(req->type) + " " + to_string(req->count));
+        if (q.streaming) return Fail(EBUSY);
+        if ((req->count > 0) && (q.num_planes == 0)) return Fail(EINVAL);
+        q.count = min(req->count, kMaxBuffers);
+        q.queued.clear();
+        q.done.clear();
+        req->count = q.count;
+        return 0;
+    }
+
+    int Stream(unsigned int type, bool on) {
+        Queue &q = mQueue[QueueOf(type)];
+        Log(string(on ? "STREAMON " : "STREAMOFF ") + Name(type));
+        if (on && (q.count == 0)) return Fail(EINVAL);
+        q.streaming = on;
+        if (!on) {
+            q.queued.clear();
+            q.done.clear();
+        }
+        return 0;
+    }
+
+    int QBuf(v4l2_buffer *buf) {
+        Queue &q = mQueue[QueueOf(buf->type)];
+        Log(string("QBUF ") + Name(buf->type) + " " + to_string(buf->index));
+        bool busy = (find(q.queued.begin(), q.queued.end(), buf->index) != q.queued.end()) ||
+                    (find(q.done.begin(), q.done.end(), buf->index) != q.done.end());
+        if ((buf->index >= q.count) || busy || (buf->length != q.num_planes))
+            return Fail(EINVAL);
+        q.queued.push_back(buf->index);
+        buf->reserved = -1;
+
+        while (!mQueue[0].queued.empty() && !mQueue[1].queued.empty()) {
+            for (Queue &job : mQueue) {
+                job.done.push_back(job.queued.front());
+                job.queued.pop_front();
+            }
+        }
+        for (Queue &each : mQueue)
+            maxInFlight = max(maxInFlight, (unsigned int)(each.queued.size() + each.done.size()));
+        return 0;
+    }
+
+    int DQBuf(v4l2_buffer *buf) {
+        Queue &q = mQueue[QueueOf(buf->type)];
+        Log(string("DQBUF ") + Name(buf->type));
+        /* the driver would block forever */
+        if (q.done.empty()) return Fail(EAGAIN);
+        buf->index = q.done.front();
+        q.done.pop_front();
+        return 0;
+    }
+
+public:
+    static constexpr unsigned int kMaxBuffers = 3;
+
+    vector<string> log;
+    unsigned int maxInFlight = 0;
+
+    FakeGscaler() {
+        char tmpl[] = "/data/local/tmp/gscaler_fakeXXXXXX";
+        int fd = mkstemp(tmpl);
+        if (fd < 0) {
+            /* on the host */
+            char host_tmpl[] = "/tmp/gscaler_fakeXXXXXX";
+            fd = mkstemp(host_tmpl);
+            mPath = host_tmpl;
+        } else {
+            mPath = tmpl;
+        }
+
+        struct stat st;
+        if ((fd >= 0) && (fstat(fd, &st) == 0)) {
+            mDev = st.st_dev;
+            mIno = st.st_ino;
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    ~FakeGscaler() { unlink(mPath.c_str()); }
+
+    int Open() { return open(mPath.c_str(), O_RDWR); }
+
+    bool Owns(int fd) {
+        struct stat st;
+        return (fstat(fd, &st) == 0) && (st.st_dev == mDev) && (st.st_ino == mIno);
+    }
+
+    // The calls logged since the last call of TakeLog()
+    vector<string> TakeLog() {
+        vector<string> taken;
+        taken.swap(log);
+        return taken;
+    }
+
+    unsigned int Count(const string &request) {
+        return count_if(log.begin(), log.end(), [&](const string &call) {
+            return call.compare(0, request.size() + 1, request + " ") == 0;
+        });
+    }
+
+    int Ioctl(unsigned long request, void *arg) {
+        switch (request) {
+            case VIDIOC_S_FMT:
+                return SetFormat(static_cast<v4l2_format *>(arg));
+            case VIDIOC_S_CROP: {
+                v4l2_crop *crop = static_cast<v4l2_crop *>(arg);
+                Log(string("S_CROP ") + Name(crop->type) + " " + to_string(crop->c.left) + "," +
+                    to_string(crop->c.top) + " " + to_string(crop->c.width) + "x" +
+                    to_string(crop->c.height));
+                return 0;
+            }
+            case VIDIOC_S_CTRL: {
+                v4l2_control *ctrl = static_cast<v4l2_control *>(arg);
+                Log("S_CTRL " + CtrlName(ctrl->id) + " " + to_string(ctrl->value));
+                return 0;
+            }
+            case VIDIOC_REQBUFS:
+                return ReqBufs(static_cast<v4l2_requestbuffers *>(arg));
+            case VIDIOC_STREAMON:
+            case VIDIOC_STREAMOFF:
+                return Stream(*static_cast<unsigned int *>(arg), request == VIDIOC_STREAMON);
+            case VIDIOC_QBUF:
+                return QBuf(static_cast<v4l2_buffer *>(arg));
+            case VIDIOC_DQBUF:
+                return DQBuf(static_cast<v4l2_buffer *>(arg));
+        }
+
+        return Fail(ENOTTY);
+    }
+};
+
+static FakeGscaler *gFake;
+
+// The calls to ioctl() by libgscaler linked in this test come here
+#if defined(__BIONIC__)
+extern "C" int ioctl(int fd, int request, ...) {
+#else
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+#endif
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (gFake && gFake->Owns(fd))
+        return gFake->Ioctl(static_cast<unsigned long>(request), arg);
+
+    return static_cast<int>(syscall(SYS_ioctl, fd, request, arg));
+}
+
+static exynos_mpp_img Image(uint32_t fw, uint32_t fh, uint32_t w, uint32_t h,
+                            uint32_t format, uint32_t rot = 0) {
+    exynos_mpp_img img;
+    memset(&img, 0, sizeof(img));
+    img.fw = fw;
+    img.fh = fh;
+    img.w = w;
+    img.h = h;
+    img.format = format;
+    img.rot = rot;
+    img.yaddr = 100;
+    img.uaddr = 101;
+    img.vaddr = 102;
+    img.mem_type = V4L2_MEMORY_DMABUF;
+    img.acquireFenceFd = -1;
+    img.releaseFenceFd = -1;
+    return img;
+}
+
+class GscalerM2MTest : public ::testing::Test {
+protected:
+    FakeGscaler mFake;
+    CGscaler *mGsc = NULL;
+    exynos_mpp_img mSrc = Image(1920, 1080, 1920, 1080, HAL_PIXEL_FORMAT_YCrCb_420_SP);
+    exynos_mpp_img mDst = Image(1280, 720, 1280, 720, HAL_PIXEL_FORMAT_RGBA_8888);
+
+    void SetUp() override {
+        gFake = &mFake;
+        mGsc = new CGscaler(GSC_M2M_MODE, 0, 1, 0);
+        mGsc->gsc_fd = mFake.Open();
+        ASSERT_GE(mGsc->gsc_fd, 0);
+    }
+
+    void TearDown() override {
+        exynos_gsc_destroy(mGsc);
+        gFake = NULL;
+    }
+
+    // One frame the way a caller runs it: the configuration is set for every frame
+    bool Run() {
+        exynos_mpp_img src = mSrc;
+        exynos_mpp_img dst = mDst;
+        return (exynos_gsc_config_exclusive(mGsc, &src, &dst) == 0) &&
+               (exynos_gsc_run_exclusive(mGsc, &src, &dst) == 0);
+    }
+
+    // Runs until the queues are streaming and every slot holds a job
+    void WarmUp() {
+        for (unsigned int i = 0; i < FakeGscaler::kMaxBuffers; i++)
+            ASSERT_TRUE(Run());
+        mFake.TakeLog();
+        exynos_gsc_reset_stats(mGsc);
+    }
+
+    exynos_gsc_stats Stats() {
+        exynos_gsc_stats stats;
+        EXPECT_EQ(0, exynos_gsc_get_stats(mGsc, &stats));
+        return stats;
+    }
+
+    // The counters of the handle match the ioctls the device got
+    void ExpectStatsMatchDevice() {
+        exynos_gsc_stats stats = Stats();
+        EXPECT_EQ(mFake.Count("S_FMT"), stats.s_fmt);
+        EXPECT_EQ(mFake.Count("S_CROP"), stats.s_crop);
+        EXPECT_EQ(mFake.Count("S_CTRL"), stats.s_ctrl);
+        EXPECT_EQ(mFake.Count("REQBUFS"), stats.reqbufs);
+        EXPECT_EQ(mFake.Count("QBUF"), stats.qbuf);
+        EXPECT_EQ(mFake.Count("DQBUF"), stats.dqbuf);
+        EXPECT_EQ(mFake.Count("STREAMON"), stats.streamon);
+        EXPECT_EQ(mFake.Count("STREAMOFF"), stats.streamoff);
+    }
+};
+
+TEST_F(GscalerM2MTest, FirstRun) {
+    ASSERT_TRUE(Run());
+    const vector<string> expected = {
+            "S_CTRL ROTATE 0",
+            "S_CTRL VFLIP 0",
+            "S_CTRL HFLIP 0",
+            "S_FMT src 1920x1080",
+            "S_CROP src 0,0 1920x1080",
+            "S_CTRL CACHEABLE 0",
+            "REQBUFS src 3",
+            "S_FMT dst 1280x720",
+            "S_CROP dst 0,0 1280x720",
+            "REQBUFS dst 3",
+            "S_CTRL CSC_EQ_MODE 0",
+            "S_CTRL CSC_EQ 1",
+            "S_CTRL CSC_RANGE 0",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(expected, mFake.log);
+    ExpectStatsMatchDevice();
+}
+
+TEST_F(GscalerM2MTest, SteadyState) {
+    WarmUp();
+
+    const unsigned int kFrames = 10;
+    for (unsigned int i = 0; i < kFrames; i++)
+        ASSERT_TRUE(Run());
+
+    // the slots are used round-robin, the oldest job is dequeued only when its slot is needed
+    vector<string> expected;
+    for (unsigned int i = 0; i < kFrames; i++) {
+        string index = to_string(i % FakeGscaler::kMaxBuffers);
+        expected.insert(expected.end(), {"DQBUF src", "DQBUF dst", "QBUF src " + index,
+                                         "QBUF dst " + index});
+    }
+    EXPECT_EQ(expected, mFake.log);
+    EXPECT_EQ(FakeGscaler::kMaxBuffers, mFake.maxInFlight);
+
+    exynos_gsc_stats stats = Stats();
+    EXPECT_EQ(kFrames, stats.runs);
+    EXPECT_EQ(0u, stats.s_fmt);
+    EXPECT_EQ(0u, stats.s_crop);
+    EXPECT_EQ(0u, stats.s_ctrl);
+    EXPECT_EQ(0u, stats.reqbufs);
+    EXPECT_EQ(0u, stats.geometry_hit + stats.geometry_miss);
+    EXPECT_GT(stats.run_time_ns, 0u);
+    EXPECT_LE(stats.max_run_time_ns, stats.run_time_ns);
+    ExpectStatsMatchDevice();
+    RecordProperty("run_time_ns_avg", to_string(stats.run_time_ns / stats.runs));
+}
+
+TEST_F(GscalerM2MTest, GeometryChange) {
+    WarmUp();
+
+    // a new frame size needs new buffers, they can only be requested on idle queues
+    mDst = Image(720, 480, 720, 480, HAL_PIXEL_FORMAT_RGBA_8888);
+    ASSERT_TRUE(Run());
+    const vector<string> realloc = {
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF dst",
+            "DQBUF dst",
+            "DQBUF dst",
+            "STREAMOFF src",
+            "STREAMOFF dst",
+            "S_CTRL CONTENT_PROTECTION 0",
+            "REQBUFS src 0",
+            "REQBUFS dst 0",
+            "REQBUFS src 3",
+            "S_FMT dst 720x480",
+            "S_CROP dst 0,0 720x480",
+            "REQBUFS dst 3",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(realloc, mFake.TakeLog());
+
+    ASSERT_TRUE(Run());
+    EXPECT_EQ(vector<string>({"QBUF src 1", "QBUF dst 1"}), mFake.TakeLog());
+
+    // a crop inside the same frame only waits for the jobs in flight
+    mDst = Image(720, 480, 640, 480, HAL_PIXEL_FORMAT_RGBA_8888);
+    ASSERT_TRUE(Run());
+    const vector<string> crop = {
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF dst",
+            "DQBUF dst",
+            "S_CROP dst 0,0 640x480",
+            "QBUF src 2",
+            "QBUF dst 2",
+    };
+    EXPECT_EQ(crop, mFake.TakeLog());
+
+    // only dst changed, the geometry of src is kept across the reallocation
+    exynos_gsc_stats stats = Stats();
+    EXPECT_EQ(0u, stats.geometry_hit);
+    EXPECT_EQ(2u, stats.geometry_miss);
+    EXPECT_EQ(2u, stats.streamoff);
+    EXPECT_EQ(4u, stats.reqbufs);
+}
+
+TEST_F(GscalerM2MTest, AlternatingGeometries) {
+    WarmUp();
+
+    const exynos_mpp_img dsts[] = {
+            Image(1280, 720, 1280, 720, HAL_PIXEL_FORMAT_RGBA_8888),
+            Image(1280, 720, 960, 720, HAL_PIXEL_FORMAT_RGBA_8888),
+    };
+    for (unsigned int i = 0; i < 8; i++) {
+        mDst = dsts[(i + 1) % 2];
+        ASSERT_TRUE(Run());
+    }
+
+    // the validated geometries are remembered, only the crop is sent again
+    exynos_gsc_stats stats = Stats();
+    EXPECT_EQ(1u, stats.geometry_miss);
+    EXPECT_EQ(7u, stats.geometry_hit);
+    EXPECT_EQ(8u, stats.s_crop);
+    EXPECT_EQ(0u, stats.s_fmt);
+    EXPECT_EQ(0u, stats.reqbufs);
+    EXPECT_EQ(0u, mFake.Count("STREAMOFF"));
+    ExpectStatsMatchDevice();
+}
+
+TEST_F(GscalerM2MTest, RotationChange) {
+    WarmUp();
+
+    mDst.rot = HAL_TRANSFORM_ROT_90;
+    ASSERT_TRUE(Run());
+    // the transform is a control, the buffers and formats are kept
+    const vector<string> expected = {
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF dst",
+            "DQBUF dst",
+            "DQBUF dst",
+            "S_CTRL ROTATE 90",
+            "QBUF src 0",
+            "QBUF dst 0",
+    };
+    EXPECT_EQ(expected, mFake.TakeLog());
+
+    // both queues were checked again for the rotation
+    exynos_gsc_stats stats = Stats();
+    EXPECT_EQ(2u, stats.geometry_hit + stats.geometry_miss);
+    EXPECT_EQ(2u, stats.s_fmt_skipped);
+    EXPECT_EQ(2u, stats.s_crop_skipped);
+
+    mDst.rot = HAL_TRANSFORM_FLIP_H;
+    ASSERT_TRUE(Run());
+    const vector<string> flip = {
+            "DQBUF src",
+            "DQBUF dst",
+            "S_CTRL ROTATE 0",
+            "S_CTRL VFLIP 1",
+            "QBUF src 1",
+            "QBUF dst 1",
+    };
+    EXPECT_EQ(flip, mFake.TakeLog());
+}
+
+TEST_F(GscalerM2MTest, CscChange) {
+    WarmUp();
+
+    exynos_gsc_set_csc_property(mGsc, 0, 1, 1);
+    ASSERT_TRUE(Run());
+    const vector<string> expected = {
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF src",
+            "DQBUF dst",
+            "DQBUF dst",
+            "DQBUF dst",
+            "S_CTRL CSC_RANGE 1",
+            "QBUF src 0",
+            "QBUF dst 0",
+    };
+    EXPECT_EQ(expected, mFake.TakeLog());
+}
+
+TEST_F(GscalerM2MTest, StopRestart) {
+    WarmUp();
+
+    ASSERT_EQ(0, exynos_gsc_stop_exclusive(mGsc));
+    const vector<string> stop = {
+            "STREAMOFF src",
+            "STREAMOFF dst",
+            "S_CTRL CONTENT_PROTECTION 0",
+            "REQBUFS src 0",
+            "REQBUFS dst 0",
+    };
+    EXPECT_EQ(stop, mFake.TakeLog());
+
+    // the driver kept the formats and the crops, only the buffers are requested again
+    ASSERT_TRUE(Run());
+    const vector<string> restart = {
+            "REQBUFS src 3",
+            "REQBUFS dst 3",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(restart, mFake.TakeLog());
+
+    ASSERT_TRUE(Run());
+    EXPECT_EQ(vector<string>({"QBUF src 1", "QBUF dst 1"}), mFake.TakeLog());
+
+    exynos_gsc_stats stats = Stats();
+    EXPECT_EQ(0u, stats.s_fmt);
+    EXPECT_EQ(0u, stats.s_crop);
+    EXPECT_EQ(1u, stats.s_ctrl);
+    EXPECT_EQ(4u, stats.reqbufs);
+}
+
+TEST_F(GscalerM2MTest, WaitFrameDone) {
+    WarmUp();
+
+    ASSERT_EQ(0, exynos_gsc_wait_frame_done_exclusive(mGsc));
+    EXPECT_EQ(6u, mFake.Count("DQBUF"));
+    mFake.TakeLog();
+
+    // nothing is in flight, the next job takes the next slot without a dequeue
+    ASSERT_TRUE(Run());
+    EXPECT_EQ(vector<string>({"QBUF src 0", "QBUF dst 0"}), mFake.TakeLog());
+}
+
+TEST_F(GscalerM2MTest, ResetStats) {
+    ASSERT_TRUE(Run());
+    exynos_gsc_reset_stats(mGsc);
+
+    exynos_gsc_stats stats = Stats();
+    exynos_gsc_stats zero;
+    memset(&zero, 0, sizeof(zero));
+    EXPECT_EQ(0, memcmp(&zero, &stats, sizeof(stats)));
+}
@@ -70,6 +70,170 @@ LOCAL_MODULE_TAGS := optional
 include $(TOP)/hardware/google/graphics/common/BoardConfigCFlags.mk
 include $(BUILD_SHARED_LIBRARY)
 
+################################################################################
+# In-process fake of the Exynos KMS driver. It implements the libdrm API, so
+# binaries link it instead of libdrm, never together with it.
+fakekms_src_files := \
+	libdrmresource/fakekms/fakekmsdevice.cpp \
+	libdrmresource/fakekms/fakekmslibdrm.cpp
+
+fakekms_c_includes := \
+	$(TOP)/external/libdrm \
+	$(TOP)/external/libdrm/include/drm \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libdrmresource/include
+
+include $(CLEAR_VARS)
+
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SRC_FILES := $(fakekms_src_files)
+LOCAL_C_INCLUDES := $(fakekms_c_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/libdrmresource/fakekms $(fakekms_c_includes)
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_CFLAGS := -Wall -Werror -Wthread-safety
+
+LOCAL_MODULE := libdrm_fakekms
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(fakekms_src_files)
+LOCAL_C_INCLUDES := $(fakekms_c_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/libdrmresource/fakekms $(fakekms_c_includes)
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_CFLAGS := -Wall -Werror -Wthread-safety
+
+LOCAL_MODULE := libdrm_fakekms
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# Smoke test of libdrmresource on the fake, run on the host. The sources need
+# the vendor DRM uapi, which is plain C and taken from the board kernel headers.
+include $(CLEAR_VARS)
+
+fakekms_drmresource_src_files := \
+	libdrmresource/utils/worker.cpp \
+	libdrmresource/drm/drmdevice.cpp \
+	libdrmresource/drm/drmconnector.cpp \
+	libdrmresource/drm/drmcrtc.cpp \
+	libdrmresource/drm/drmencoder.cpp \
+	libdrmresource/drm/drmmode.cpp \
+	libdrmresource/drm/drmplane.cpp \
+	libdrmresource/drm/drmproperty.cpp \
+	libdrmresource/drm/drmeventlistener.cpp
+
+LOCAL_SRC_FILES := \
+	libdrmresource/fakekms/test/fakekms_smoke_test.cpp \
+	$(fakekms_drmresource_src_files)
+LOCAL_C_INCLUDES := $(fakekms_c_includes) $(TARGET_BOARD_KERNEL_HEADERS)
+LOCAL_HEADER_LIBRARIES := libhardware_headers libbase_headers
+LOCAL_STATIC_LIBRARIES := libdrm_fakekms
+LOCAL_SHARED_LIBRARIES := libcutils liblog libutils
+LOCAL_CFLAGS := -DHLOG_CODE=0 -Wno-unused-parameter -Wthread-safety
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_MODULE := libdrm_fakekms_smoke_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+# Fuzzer of the atomic commits the display interface builds, on the fake.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	libdrmresource/fakekms/test/fakekms_commit_fuzzer.cpp \
+	$(fakekms_drmresource_src_files)
+LOCAL_C_INCLUDES := $(fakekms_c_includes) $(TARGET_BOARD_KERNEL_HEADERS)
+LOCAL_HEADER_LIBRARIES := libhardware_headers libbase_headers libsystem_headers
+LOCAL_STATIC_LIBRARIES := libdrm_fakekms
+LOCAL_SHARED_LIBRARIES := libcutils liblog libutils
+LOCAL_CFLAGS := -DHLOG_CODE=0 -Wno-unused-parameter -Wthread-safety
+LOCAL_IS_HOST_MODULE := true
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_MODULE := libdrm_fakekms_commit_fuzzer
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_FUZZ_TEST)
+
+# Round trip of composition traces through the recorder and the reader.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	libdevice/test/composition_trace_test.cpp \
+	libdevice/CompositionTrace.cpp
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_MODULE := libhwc_composition_trace_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+# Ring, decimation and release paths of the readback recorder with a stub display and
+# pipes as writeback fences.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+	libdevice/test/readback_recorder_test.cpp \
+	libdevice/ReadbackRecorder.cpp \
+	libdrmresource/utils/worker.cpp
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/libdrmresource/include
+LOCAL_HEADER_LIBRARIES := libsystem_headers libbase_headers
+LOCAL_SHARED_LIBRARIES := libcutils liblog libutils
+LOCAL_CFLAGS := -Wno-unused-parameter -Wthread-safety
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_MODULE := libhwc_readback_recorder_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+# Dirty tracking of the color settings in DisplaySceneInfo. The scene info
+# needs the vendor headers of libexynosdisplay, so it runs on the device, but
+# does not touch the display.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := test/display_scene_info_test.cpp
+LOCAL_C_INCLUDES := \
+	$(TOP)/hardware/google/graphics/common/include \
+	$(TOP)/hardware/google/graphics/common/libhwc2.1/libhwchelper \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/include \
+	$(TOP)/hardware/google/graphics/$(soc_ver)/libhwc2.1
+LOCAL_HEADER_LIBRARIES := google_hal_headers libgralloc_headers \
+	android.hardware.graphics.common-V3-ndk_headers
+LOCAL_SHARED_LIBRARIES := libexynosdisplay libdrm libutils liblog libvendorgraphicbuffer \
+	android.hardware.graphics.composer3-V4-ndk
+LOCAL_STATIC_LIBRARIES := libVendorVideoApi
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_MODULE := libhwc_display_scene_info_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_NATIVE_TEST)
+
 ################################################################################
 include $(CLEAR_VARS)
 
@@ -78,7 +242,7 @@ LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware \
 	android.hardware.graphics.allocator@2.0 \
 	android.hardware.graphics.mapper@2.0 \
 	libhardware_legacy libutils \
-	libsync libacryl libui libion_google libdrmresource libdrm \
+	libsync libacryl libui libion_google libdrmresource libdrm liblz4 \
 	libvendorgraphicbuffer libbinder_ndk \
 	android.hardware.power-V2-ndk pixel-power-ext-V1-ndk \
 	pixel_stateresidency_provider_aidl_interface-ndk
@@ -132,16 +296,23 @@ LOCAL_SRC_FILES := \
 	DisplaySceneInfo.cpp \
 	ExynosHWCDebug.cpp \
 	libdevice/BrightnessController.cpp \
+	libdevice/CompositionTrace.cpp \
 	libdevice/ExynosDisplay.cpp \
 	libdevice/ExynosDevice.cpp \
 	libdevice/ExynosLayer.cpp \
 	libdevice/HistogramDevice.cpp \
 	libdevice/DisplayTe2Manager.cpp \
+	libdevice/PresentDurationModel.cpp \
+	libdevice/LayerFrameRateEstimator.cpp \
+	libdevice/BufferDumpWorker.cpp \
+	libdevice/ReadbackRecorder.cpp \
+	libdevice/ReadbackRecorderBackend.cpp \
 	libmaindisplay/ExynosPrimaryDisplay.cpp \
 	libresource/ExynosMPP.cpp \
 	libresource/ExynosResourceManager.cpp \
 	libexternaldisplay/ExynosExternalDisplay.cpp \
 	libvirtualdisplay/ExynosVirtualDisplay.cpp \
+	libvirtualdisplay/VirtualDisplayCompositor.cpp \
 	libdisplayinterface/ExynosDeviceInterface.cpp \
 	libdisplayinterface/ExynosDisplayInterface.cpp \
 	libdisplayinterface/ExynosDeviceDrmInterface.cpp \
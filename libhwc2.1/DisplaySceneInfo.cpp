@@ -137,7 +137,7 @@ void DisplaySceneInfo::setLayerHdrDynamicMetadata(
 int32_t DisplaySceneInfo::setClientCompositionColorData(
         const ExynosCompositionInfo& clientCompositionInfo, LayerColorData& layerData,
         float dimSdrRatio) {
-    layerData.dim_ratio = 1.0f;
+    updateInfoSingleVal(layerData.dim_ratio, 1.0f);
     setLayerDataspace(layerData, static_cast<hwc::Dataspace>(clientCompositionInfo.mDataSpace));
     disableLayerHdrStaticMetadata(layerData);
     disableLayerHdrDynamicMetadata(layerData);
@@ -165,12 +165,12 @@ int32_t DisplaySceneInfo::setClientCompositionColorData(
 
 int32_t DisplaySceneInfo::setLayerColorData(LayerColorData& layerData, ExynosLayer* layer,
                                             float dimSdrRatio) {
-    layerData.is_solid_color_layer = layer->isDimLayer();
-    layerData.solid_color.r = layer->mColor.r;
-    layerData.solid_color.g = layer->mColor.g;
-    layerData.solid_color.b = layer->mColor.b;
-    layerData.solid_color.a = layer->mColor.a;
-    layerData.dim_ratio = layer->mPreprocessedInfo.sdrDimRatio;
+    updateInfoSingleVal(layerData.is_solid_color_layer, layer->isDimLayer());
+    updateInfoSingleVal(layerData.solid_color.r, layer->mColor.r);
+    updateInfoSingleVal(layerData.solid_color.g, layer->mColor.g);
+    updateInfoSingleVal(layerData.solid_color.b, layer->mColor.b);
+    updateInfoSingleVal(layerData.solid_color.a, layer->mColor.a);
+    updateInfoSingleVal(layerData.dim_ratio, layer->mPreprocessedInfo.sdrDimRatio);
     setLayerDataspace(layerData, static_cast<hwc::Dataspace>(layer->mDataSpace));
     if (layer->mIsHdrLayer && layer->getMetaParcel() != nullptr) {
         if (layer->getMetaParcel()->eType & VIDEO_INFO_TYPE_HDR_STATIC)
@@ -235,15 +235,25 @@ int32_t DisplaySceneInfo::setLayerColorData(LayerColorData& layerData, ExynosLay
     return NO_ERROR;
 }
 
-bool DisplaySceneInfo::needDisplayColorSetting() {
-    /* TODO: Check if we can skip color setting */
-    /* For now, propage setting every frame */
-    return true;
-
-    if (colorSettingChanged) return true;
-    if (prev_layerDataMappingInfo != layerDataMappingInfo) return true;
+bool DisplaySceneInfo::needDisplayColorSetting() const {
+    /*
+     * The layer color data setters flag their changes in colorSettingChanged,
+     * the DPP channel of the layers is compared by the mapping and the rest of
+     * the display level settings by the scene of the last delivery.
+     * DisplayScene's comparison leaves out ltm_params and lux, both reached the
+     * color library on every frame before, so they are compared here as well.
+     */
+    return colorSettingChanged || !lastDisplaySceneValid ||
+            (prev_layerDataMappingInfo != layerDataMappingInfo) ||
+            (displayScene != lastDisplayScene) ||
+            !(displayScene.ltm_params == lastDisplayScene.ltm_params) ||
+            (displayScene.lux != lastDisplayScene.lux);
+}
 
-    return false;
+void DisplaySceneInfo::onDisplaySettingDelivered() {
+    displaySettingDelivered = true;
+    lastDisplayScene = displayScene;
+    lastDisplaySceneValid = true;
 }
 
 void DisplaySceneInfo::printDisplayScene() {
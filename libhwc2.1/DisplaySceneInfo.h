@@ -43,6 +43,13 @@ public:
     bool displaySettingDelivered = false;
     DisplayScene displayScene;
 
+    /*
+     * displayScene of the last delivered color setting, to catch the display
+     * level settings (brightness, lhbm, refresh rate, ...) that are assigned directly
+     */
+    DisplayScene lastDisplayScene;
+    bool lastDisplaySceneValid = false;
+
     /*
      * Index of LayerColorData in DisplayScene::layer_data
      * and assigned plane id in last color setting update.
@@ -59,14 +66,16 @@ public:
         layerDataMappingInfo.clear();
     };
 
+    /* Also forces the next color setting update, e.g. when the last one was not applied */
     void clear() {
         colorSettingChanged = false;
+        lastDisplaySceneValid = false;
         layerDataMappingInfo.clear();
         prev_layerDataMappingInfo.clear();
     }
 
     template <typename T, typename M>
-    void updateInfoSingleVal(T& dst, M& src) {
+    void updateInfoSingleVal(T& dst, const M& src) {
         if (src != dst) {
             colorSettingChanged = true;
             dst = src;
@@ -113,7 +122,13 @@ public:
     int32_t setLayerColorData(LayerColorData& layerData, ExynosLayer* layer, float dimSdrRatio);
     int32_t setClientCompositionColorData(const ExynosCompositionInfo& clientCompositionInfo,
                                           LayerColorData& layerData, float dimSdrRatio);
-    bool needDisplayColorSetting();
+    /* Whether displayScene differs from the one of the last delivered color setting */
+    bool needDisplayColorSetting() const;
+    /*
+     * Called once the commit carrying the color setting of displayScene succeeded.
+     * A scene that was never delivered keeps being reported as changed.
+     */
+    void onDisplaySettingDelivered();
     void printDisplayScene();
     void printLayerColorData(const LayerColorData& layerData);
 };
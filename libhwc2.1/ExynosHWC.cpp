@@ -582,14 +582,14 @@ int32_t exynos_setActiveConfig(hwc2_device_t *dev, hwc2_display_t display,
 
 int32_t exynos_setClientTarget(hwc2_device_t *dev, hwc2_display_t display,
         buffer_handle_t target, int32_t acquireFence,
-        int32_t /*android_dataspace_t*/ dataspace, hwc_region_t __unused damage)
+        int32_t /*android_dataspace_t*/ dataspace, hwc_region_t damage)
 {
     ExynosDevice *exynosDevice = checkDevice(dev);
 
     if (exynosDevice) {
         ExynosDisplay *exynosDisplay = checkDisplay(exynosDevice, display);
         if (exynosDisplay)
-            return exynosDisplay->setClientTarget(target, acquireFence, dataspace);
+            return exynosDisplay->setClientTarget(target, acquireFence, dataspace, damage);
     }
 
     return HWC2_ERROR_BAD_DISPLAY;
@@ -48,6 +48,7 @@ enum {
     eDebugTDM                     =   0x00800000,
     eDebugLoadBalancing           =   0x01000000,
     eDebugOperationRate           =   0x02000000,
+    eDebugCompositionTrace        =   0x04000000,
 };
 
 class ExynosDisplay;
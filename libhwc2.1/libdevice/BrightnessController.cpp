@@ -244,11 +244,18 @@ void BrightnessController::initDimmingUsage() {
     }
 }
 
+bool BrightnessController::SysfsFile::open(const char* path) {
+    auto fileNode = ::android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(path, name);
+    if (fileNode->getFileHandler(name) < 0) return false;
+    node = fileNode;
+    return true;
+}
+
 void BrightnessController::initBrightnessSysfs() {
     String8 nodeName;
     nodeName.appendFormat(BRIGHTNESS_SYSFS_NODE, mPanelIndex);
-    mBrightnessOfs.open(nodeName.c_str(), std::ofstream::out);
-    if (mBrightnessOfs.fail()) {
+    if (!mBrightnessFile.open(nodeName.c_str())) {
         ALOGE("%s %s fail to open", __func__, nodeName.c_str());
         return;
     }
@@ -267,8 +274,7 @@ void BrightnessController::initBrightnessSysfs() {
 
     nodeName.clear();
     nodeName.appendFormat(kGlobalAclModeFileNode, mPanelIndex);
-    mAclModeOfs.open(nodeName.c_str(), std::ofstream::out);
-    if (mAclModeOfs.fail()) {
+    if (!mAclModeFile.open(nodeName.c_str())) {
         ALOGI("%s %s not supported", __func__, nodeName.c_str());
     } else {
         String8 propName;
@@ -286,8 +292,7 @@ void BrightnessController::initCabcSysfs() {
     String8 nodeName;
     nodeName.appendFormat(kLocalCabcModeFileNode, mPanelIndex);
 
-    mCabcModeOfs.open(nodeName.c_str(), std::ofstream::out);
-    if (mCabcModeOfs.fail()) {
+    if (!mCabcModeFile.open(nodeName.c_str())) {
         ALOGE("%s %s fail to open", __func__, nodeName.c_str());
         return;
     }
@@ -352,7 +357,7 @@ void BrightnessController::processDimmingOff() {
 }
 
 int BrightnessController::updateAclMode() {
-    if (!mAclModeOfs.is_open()) return HWC2_ERROR_UNSUPPORTED;
+    if (!mAclModeFile.isOpen()) return HWC2_ERROR_UNSUPPORTED;
 
     if (mColorRenderIntent.get() == ColorRenderIntent::COLORIMETRIC) {
         mAclMode.store(AclMode::ACL_ENHANCED);
@@ -367,15 +372,13 @@ int BrightnessController::updateAclMode() {
 }
 
 int BrightnessController::applyAclViaSysfs() {
-    if (!mAclModeOfs.is_open()) return NO_ERROR;
+    if (!mAclModeFile.isOpen()) return NO_ERROR;
     if (!mAclMode.is_dirty()) return NO_ERROR;
 
-    mAclModeOfs.seekp(std::ios_base::beg);
-    mAclModeOfs << std::to_string(static_cast<uint8_t>(mAclMode.get()));
-    mAclModeOfs.flush();
-    if (mAclModeOfs.fail()) {
+    // Written synchronously so that a failed write stays dirty and is retried
+    if (!mAclModeFile.node->writeValue(mAclModeFile.name,
+                                       static_cast<uint8_t>(mAclMode.get()))) {
         ALOGW("%s write acl_mode to %d error = %s", __func__, mAclMode.get(), strerror(errno));
-        mAclModeOfs.clear();
         return HWC2_ERROR_NO_RESOURCES;
     }
 
@@ -668,7 +671,11 @@ void BrightnessController::onClearDisplay(bool needModeClear) {
     resetLhbmState();
     mInstantHbmReq.reset(false);
 
-    if (mBrightnessLevel.is_dirty()) applyBrightnessViaSysfs(mBrightnessLevel.get());
+    if (mBrightnessLevel.is_dirty()) {
+        applyBrightnessViaSysfs(mBrightnessLevel.get());
+        // the panel may be powered off right after
+        if (mBrightnessFile.isOpen()) mBrightnessFile.node->flush(mBrightnessFile.name);
+    }
 
     if (!needModeClear) return;
 
@@ -705,6 +712,12 @@ int BrightnessController::prepareFrameCommit(ExynosDisplay& display, const DrmCo
     ATRACE_CALL();
     std::lock_guard<std::recursive_mutex> lock(mBrightnessMutex);
 
+    // A brightness queued for the sysfs path must land before the one of this commit
+    if (mBrightnessFile.isOpen() &&
+        (mBrightnessLevel.is_dirty() || mLhbm.is_dirty() || mGhbm.is_dirty())) {
+        mBrightnessFile.node->flush(mBrightnessFile.name);
+    }
+
     bool sync = false;
     if (mixedComposition && mPrevDisplayWhitePointNits > 0 && mDisplayWhitePointNits > 0) {
         float diff = std::abs(mPrevDisplayWhitePointNits - mDisplayWhitePointNits);
@@ -998,6 +1011,24 @@ int BrightnessController::checkSysfsStatus(const std::string& file,
       return -EINVAL;
     }
 
+    // Check the current state on the persistent fd of the file
+    std::string nodeName;
+    auto fileNode = ::android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(file, nodeName);
+    auto content = fileNode->readString(nodeName);
+    if (!content) {
+        ALOGE("%s failed to read from %s", __func__, file.c_str());
+        return -ENOENT;
+    }
+    if (!content->empty() && content->back() == '\n') content->pop_back();
+    if (std::find(expectedValue.begin(), expectedValue.end(), *content) != expectedValue.end()) {
+        return OK;
+    } else if (timeoutNs == 0) {
+        // not get the expected value and no intention to wait
+        return -EINVAL;
+    }
+
+    // Poll on an fd of its own, reads on a shared one would consume the notification
     char buf[16];
     UniqueFd fd = open(file.c_str(), O_RDONLY);
     if (fd.get() < 0) {
@@ -1015,9 +1046,6 @@ int BrightnessController::checkSysfsStatus(const std::string& file,
     std::string val = std::string(buf, size - 1);
     if (std::find(expectedValue.begin(), expectedValue.end(), val) != expectedValue.end()) {
         return OK;
-    } else if (timeoutNs == 0) {
-        // not get the expected value and no intention to wait
-        return -EINVAL;
     }
 
     struct pollfd pfd;
@@ -1096,7 +1124,7 @@ void BrightnessController::setOutdoorVisibility(LbeState state) {
 }
 
 int BrightnessController::updateCabcMode() {
-    if (!mCabcSupport || mCabcModeOfs.fail()) return HWC2_ERROR_UNSUPPORTED;
+    if (!mCabcSupport || !mCabcModeFile.isOpen()) return HWC2_ERROR_UNSUPPORTED;
 
     std::lock_guard<std::recursive_mutex> lock(mCabcModeMutex);
     CabcMode mode;
@@ -1116,14 +1144,12 @@ int BrightnessController::updateCabcMode() {
 }
 
 int BrightnessController::applyBrightnessViaSysfs(uint32_t level) {
-    if (mBrightnessOfs.is_open()) {
+    if (mBrightnessFile.isOpen()) {
         ATRACE_NAME("write_bl_sysfs");
-        mBrightnessOfs.seekp(std::ios_base::beg);
-        mBrightnessOfs << std::to_string(level);
-        mBrightnessOfs.flush();
-        if (mBrightnessOfs.fail()) {
+        // Off the calling thread so that brightness ramps do not delay presents. prepareFrameCommit
+        // waits for it before brightness goes through drm again.
+        if (!mBrightnessFile.node->writeValueAsync(mBrightnessFile.name, level)) {
             ALOGE("%s fail to write brightness %d", __func__, level);
-            mBrightnessOfs.clear();
             return HWC2_ERROR_NO_RESOURCES;
         }
 
@@ -1141,15 +1167,12 @@ int BrightnessController::applyBrightnessViaSysfs(uint32_t level) {
 }
 
 int BrightnessController::applyCabcModeViaSysfs(uint8_t mode) {
-    if (!mCabcModeOfs.is_open()) return HWC2_ERROR_UNSUPPORTED;
+    if (!mCabcModeFile.isOpen()) return HWC2_ERROR_UNSUPPORTED;
 
     ATRACE_NAME("write_cabc_mode_sysfs");
-    mCabcModeOfs.seekp(std::ios_base::beg);
-    mCabcModeOfs << std::to_string(mode);
-    mCabcModeOfs.flush();
-    if (mCabcModeOfs.fail()) {
+    // Called from present, nothing else depends on when the mode lands
+    if (!mCabcModeFile.node->writeValueAsync(mCabcModeFile.name, mode)) {
         ALOGE("%s fail to write CabcMode %d", __func__, mode);
-        mCabcModeOfs.clear();
         return HWC2_ERROR_NO_RESOURCES;
     }
     ALOGI("%s Cabc_Mode=%d", __func__, mode);
@@ -1203,7 +1226,7 @@ void BrightnessController::dump(String8& result) {
 
     result.appendFormat("BrightnessController:\n");
     result.appendFormat("\tsysfs support %d, max %d, valid brightness table %d, "
-                        "lhbm supported %d, ghbm supported %d\n", mBrightnessOfs.is_open(),
+                        "lhbm supported %d, ghbm supported %d\n", mBrightnessFile.isOpen(),
                         mMaxBrightness, mBrightnessIntfSupported, mLhbmSupported, mGhbmSupported);
     result.appendFormat("\trequests: enhance hbm %d, lhbm %d, "
                         "brightness %f, instant hbm %d, DimBrightness %d\n",
@@ -1220,10 +1243,10 @@ void BrightnessController::dump(String8& result) {
                         mHbmDimming, mHbmDimmingTimeUs);
     result.appendFormat("\twhite point nits current %f, previous %f\n", mDisplayWhitePointNits,
                         mPrevDisplayWhitePointNits);
-    result.appendFormat("\tcabc supported %d, cabcMode %d\n", mCabcModeOfs.is_open(),
+    result.appendFormat("\tcabc supported %d, cabcMode %d\n", mCabcModeFile.isOpen(),
                         mCabcMode.get());
     result.appendFormat("\tignore brightness update request %d\n", mIgnoreBrightnessUpdateRequests);
-    result.appendFormat("\tacl mode supported %d, acl mode %d\n", mAclModeOfs.is_open(),
+    result.appendFormat("\tacl mode supported %d, acl mode %d\n", mAclModeFile.isOpen(),
                         mAclMode.get());
     result.appendFormat("\toperation rate %d\n", mOperationRate.get());
 
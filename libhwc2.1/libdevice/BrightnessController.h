@@ -25,6 +25,7 @@
 #include <thread>
 
 #include "ExynosDisplayDrmInterface.h"
+#include "../libvrr/FileNode.h"
 
 /**
  * Brightness change requests come from binder calls or HWC itself.
@@ -463,10 +464,19 @@ private:
     ::android::sp<::android::Looper> mDimmingLooper;
     ::android::sp<DimmingMsgHandler> mDimmingHandler;
 
+    // A sysfs file written through the FileNode of its directory
+    struct SysfsFile {
+        std::shared_ptr<::android::hardware::graphics::composer::FileNode> node;
+        std::string name;
+
+        bool open(const char* path);
+        bool isOpen() const { return node != nullptr; }
+    };
+
     // sysfs path
-    std::ofstream mBrightnessOfs;
+    SysfsFile mBrightnessFile;
     uint32_t mMaxBrightness = 0; // read from sysfs
-    std::ofstream mCabcModeOfs;
+    SysfsFile mCabcModeFile;
     bool mCabcSupport = false;
     uint32_t mDimBrightness = 0;
 
@@ -483,7 +493,7 @@ private:
         ACL_ENHANCED,
     };
 
-    std::ofstream mAclModeOfs;
+    SysfsFile mAclModeFile;
     CtrlValue<AclMode> mAclMode;
     AclMode mAclModeDefault = AclMode::ACL_OFF;
 
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "BufferDumpWorker.h"
+
+#include <cutils/properties.h>
+#include <inttypes.h>
+#include <log/log.h>
+#include <lz4frame.h>
+#include <sync/sync.h>
+#include <sys/mman.h>
+#include <system/thread_defs.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+BufferDumpWorker::BufferDumpWorker(const String8& displayName)
+      : Worker("BufferDump", ANDROID_PRIORITY_BACKGROUND),
+        mDisplayName(displayName),
+        mCompress(property_get_bool("vendor.display.buffer_dump.compress", true)) {
+    InitWorker();
+}
+
+BufferDumpWorker::~BufferDumpWorker() {
+    Exit();
+
+    for (auto& frame : mPendingFrames) closeFds(frame);
+}
+
+void BufferDumpWorker::closeFds(Frame& frame) {
+    for (auto& buffer : frame.buffers) {
+        for (int fd : buffer.planeFds)
+            if (fd >= 0) close(fd);
+        buffer.planeFds.clear();
+        if (buffer.acquireFence >= 0) close(buffer.acquireFence);
+        if (buffer.releaseFence >= 0) close(buffer.releaseFence);
+        buffer.acquireFence = -1;
+        buffer.releaseFence = -1;
+    }
+}
+
+bool BufferDumpWorker::isBusy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mPendingFrames.size() >= kMaxPendingFrames;
+}
+
+bool BufferDumpWorker::queueFrame(Frame&& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (mPendingFrames.size() < kMaxPendingFrames) {
+            mPendingFrames.push_back(std::move(frame));
+            mQueuedFrames++;
+            Signal();
+            return true;
+        }
+        mDroppedFrames++;
+    }
+
+    ALOGW("%s: %s: dump of frame %d dropped, %zu frames pending", __func__, mDisplayName.c_str(),
+          frame.number, kMaxPendingFrames);
+    closeFds(frame);
+    return false;
+}
+
+void BufferDumpWorker::Routine() {
+    Lock();
+    if (mPendingFrames.empty() && (WaitForSignalOrExitLocked() == -EINTR)) {
+        Unlock();
+        return;
+    }
+    if (mPendingFrames.empty()) {
+        Unlock();
+        return;
+    }
+    /* Stays queued while written, so isBusy() accounts for it */
+    Frame& frame = mPendingFrames.front();
+    Unlock();
+
+    writeFrame(frame);
+
+    Lock();
+    mPendingFrames.pop_front();
+    Unlock();
+}
+
+void BufferDumpWorker::writeFrame(Frame& frame) {
+    ATRACE_CALL();
+    std::vector<std::string> files;
+
+    for (const auto& [path, content] : frame.textFiles) {
+        std::ofstream file(path);
+        if (!file) {
+            ALOGE("%s: failed to open file %s", __func__, path.c_str());
+            continue;
+        }
+        file << content << std::endl;
+        files.push_back(path);
+    }
+
+    for (auto& buffer : frame.buffers) {
+        writeBuffer(buffer, files);
+    }
+    closeFds(frame);
+
+    /* A new capture restarts the numbering, its files replaced the ones of the older frames */
+    std::set<std::string> written(files.begin(), files.end());
+    for (auto& stored : mStoredFrames) {
+        stored.erase(std::remove_if(stored.begin(), stored.end(),
+                                    [&](const std::string& path) { return written.count(path); }),
+                     stored.end());
+    }
+    mStoredFrames.push_back(std::move(files));
+    removeOldFrames();
+
+    Lock();
+    mWrittenFrames++;
+    Unlock();
+}
+
+bool BufferDumpWorker::writeBuffer(Buffer& buffer, std::vector<std::string>& files) {
+    ATRACE_NAME(buffer.rawPath.c_str());
+
+    // TODO(b/261232489): Fix fence sync errors
+    // We currently ignore the fence errors and just dump the buffers
+    if (buffer.acquireFence >= 0 && sync_wait(buffer.acquireFence, kFenceTimeoutMs) < 0) {
+        buffer.info.appendFormat("Failed to sync acquire fence\n");
+        ALOGE("%s: Failed to wait acquire fence for %s, errno=(%d, %s)", __func__,
+              buffer.rawPath.c_str(), errno, strerror(errno));
+    }
+    if (buffer.releaseFence >= 0 && sync_wait(buffer.releaseFence, kFenceTimeoutMs) < 0) {
+        buffer.info.appendFormat("Failed to sync release fence\n");
+        ALOGE("%s: Failed to wait release fence for %s, errno=(%d, %s)", __func__,
+              buffer.rawPath.c_str(), errno, strerror(errno));
+    }
+
+    std::ofstream infoFile(buffer.infoPath);
+    if (!infoFile) {
+        ALOGE("%s: failed to open file %s", __func__, buffer.infoPath.c_str());
+        return false;
+    }
+    infoFile << buffer.info << std::endl;
+    files.push_back(buffer.infoPath);
+
+    std::string bufferPath = buffer.rawPath + (mCompress ? ".lz4" : "");
+    if (!writePlanes(buffer, bufferPath)) return false;
+    files.push_back(bufferPath);
+
+    return true;
+}
+
+bool BufferDumpWorker::writePlanes(Buffer& buffer, const std::string& path) {
+    std::ofstream bufferFile(path, std::ios::binary);
+    if (!bufferFile) {
+        ALOGE("%s: failed to open file %s", __func__, path.c_str());
+        return false;
+    }
+
+    LZ4F_cctx* cctx = nullptr;
+    std::vector<char> out;
+    if (mCompress) {
+        if (LZ4F_isError(LZ4F_createCompressionContext(&cctx, LZ4F_VERSION))) {
+            ALOGE("%s: failed to create LZ4 context", __func__);
+            return false;
+        }
+        out.resize(LZ4F_compressBound(kCompressChunkSize, nullptr));
+        size_t size = LZ4F_compressBegin(cctx, out.data(), out.size(), nullptr);
+        if (!LZ4F_isError(size)) bufferFile.write(out.data(), size);
+    }
+
+    uint64_t rawBytes = 0;
+    for (size_t i = 0; i < buffer.planeFds.size(); ++i) {
+        uint32_t planeSize = buffer.planeSizes[i];
+        auto addr = mmap(0, planeSize, PROT_READ, MAP_SHARED, buffer.planeFds[i], 0);
+        if (addr == MAP_FAILED || addr == NULL) {
+            ALOGE("%s: failed to mmap plane %zu of %s", __func__, i, path.c_str());
+            continue;
+        }
+
+        const char* data = static_cast<const char*>(addr);
+        if (!mCompress) {
+            bufferFile.write(data, planeSize);
+        } else {
+            for (size_t offset = 0; offset < planeSize; offset += kCompressChunkSize) {
+                size_t chunk = std::min<size_t>(kCompressChunkSize, planeSize - offset);
+                size_t size = LZ4F_compressUpdate(cctx, out.data(), out.size(), data + offset,
+                                                  chunk, nullptr);
+                if (LZ4F_isError(size)) {
+                    ALOGE("%s: failed to compress %s: %s", __func__, path.c_str(),
+                          LZ4F_getErrorName(size));
+                    break;
+                }
+                bufferFile.write(out.data(), size);
+            }
+        }
+        munmap(addr, planeSize);
+        rawBytes += planeSize;
+    }
+
+    if (mCompress) {
+        size_t size = LZ4F_compressEnd(cctx, out.data(), out.size(), nullptr);
+        if (!LZ4F_isError(size)) bufferFile.write(out.data(), size);
+        LZ4F_freeCompressionContext(cctx);
+    }
+    uint64_t writtenBytes = std::max<std::streamoff>(bufferFile.tellp(), 0);
+
+    Lock();
+    mRawBytes += rawBytes;
+    mWrittenBytes += writtenBytes;
+    Unlock();
+
+    return true;
+}
+
+void BufferDumpWorker::removeOldFrames() {
+    while (mStoredFrames.size() > kMaxStoredFrames) {
+        for (const auto& path : mStoredFrames.front()) {
+            if (unlink(path.c_str()) < 0 && errno != ENOENT)
+                ALOGW("%s: failed to remove %s, errno=(%d, %s)", __func__, path.c_str(), errno,
+                      strerror(errno));
+        }
+        mStoredFrames.pop_front();
+    }
+}
+
+void BufferDumpWorker::dump(String8& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result.appendFormat("Buffer dump: queued %u, dropped %u, written %u, pending %zu, "
+                        "%" PRIu64 " bytes -> %" PRIu64 " bytes%s\n",
+                        mQueuedFrames, mDroppedFrames, mWrittenFrames, mPendingFrames.size(),
+                        mRawBytes, mWrittenBytes, mCompress ? " (lz4)" : "");
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BUFFER_DUMP_WORKER_H_
+#define _BUFFER_DUMP_WORKER_H_
+
+#include <utils/String8.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ExynosHWCHelper.h"
+#include "worker.h"
+
+/*
+ * Writes the buffers captured by ExynosDisplay::dumpAllBuffers() off the present path.
+ *
+ * The present path only duplicates the plane fds and the fences of the buffers and queues the
+ * frame. The worker waits for the fences, maps the planes read-only and writes them LZ4 frame
+ * compressed (decompress with "lz4 -d") next to the info files and the hwc-tester config.
+ * The files of the last kMaxStoredFrames frames are kept, older ones are removed. Frames queued
+ * while kMaxPendingFrames frames are still being written are dropped.
+ */
+class BufferDumpWorker : public Worker {
+public:
+    struct Buffer {
+        /* Buffer and gralloc metadata description */
+        std::string infoPath;
+        String8 info;
+        /* Path of the uncompressed planes, ".lz4" is appended when compressed */
+        std::string rawPath;
+        std::vector<int> planeFds;
+        std::vector<uint32_t> planeSizes;
+        int32_t acquireFence = -1;
+        int32_t releaseFence = -1;
+    };
+
+    struct Frame {
+        int32_t number = 0;
+        /* Files written as they are */
+        std::vector<std::pair<std::string, std::string>> textFiles;
+        std::vector<Buffer> buffers;
+    };
+
+    BufferDumpWorker(const String8& displayName);
+    ~BufferDumpWorker();
+
+    /* Whether queueFrame() would drop a frame now */
+    bool isBusy();
+
+    /* Takes the fds of the frame, also when the frame is dropped */
+    bool queueFrame(Frame&& frame);
+
+    void dump(String8& result);
+
+protected:
+    void Routine() override;
+
+private:
+    static constexpr size_t kMaxPendingFrames = 2;
+    static constexpr size_t kMaxStoredFrames = 16;
+    static constexpr int kFenceTimeoutMs = 1000;
+    static constexpr size_t kCompressChunkSize = 1024 * 1024;
+
+    void writeFrame(Frame& frame);
+    bool writeBuffer(Buffer& buffer, std::vector<std::string>& files);
+    bool writePlanes(Buffer& buffer, const std::string& path);
+    void removeOldFrames();
+    static void closeFds(Frame& frame);
+
+    const String8 mDisplayName;
+    const bool mCompress;
+
+    std::deque<Frame> mPendingFrames GUARDED_BY(mutex_);
+    /* Files of the frames written, oldest first. Only used by the worker thread. */
+    std::deque<std::vector<std::string>> mStoredFrames;
+
+    uint32_t mQueuedFrames GUARDED_BY(mutex_) = 0;
+    uint32_t mDroppedFrames GUARDED_BY(mutex_) = 0;
+    uint32_t mWrittenFrames GUARDED_BY(mutex_) = 0;
+    uint64_t mRawBytes GUARDED_BY(mutex_) = 0;
+    uint64_t mWrittenBytes GUARDED_BY(mutex_) = 0;
+};
+
+#endif // _BUFFER_DUMP_WORKER_H_
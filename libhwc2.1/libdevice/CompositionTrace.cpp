@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompositionTrace.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+const char* getCompositionTraceStageName(CompositionTraceStage stage) {
+    switch (stage) {
+        case COMPOSITION_TRACE_VALIDATE:
+            return "validate";
+        case COMPOSITION_TRACE_ASSIGN_RESOURCE:
+            return "assignResource";
+        case COMPOSITION_TRACE_PRESENT:
+            return "present";
+        default:
+            return "unknown";
+    }
+}
+
+void CompositionTraceRecorder::setEnabled(bool enabled) {
+    if (mEnabled == enabled) return;
+    mEnabled = enabled;
+    mStageStart.fill(0);
+    for (size_t i = 0; i < COMPOSITION_TRACE_STAGE_MAX; i++) mFrame.stageDuration[i] = -1;
+    mLatency = {};
+}
+
+void CompositionTraceRecorder::beginStage(CompositionTraceStage stage, int64_t now) {
+    if (!mEnabled) return;
+    mStageStart[stage] = now;
+}
+
+void CompositionTraceRecorder::endStage(CompositionTraceStage stage, int64_t now) {
+    if (!mEnabled || mStageStart[stage] == 0) return;
+    mFrame.stageDuration[stage] = now - mStageStart[stage];
+    mStageStart[stage] = 0;
+}
+
+CompositionTraceStageScope::~CompositionTraceStageScope() {
+    if (!mRecorder.isEnabled()) return;
+    /* The same clock as systemTime(SYSTEM_TIME_MONOTONIC) */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    mRecorder.endStage(mStage, static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec);
+}
+
+CompositionTraceFrame& CompositionTraceRecorder::beginFrame(uint32_t displayId, int64_t timestamp) {
+    mLayers.clear();
+    mFrame.magic = kCompositionTraceMagic;
+    mFrame.version = kCompositionTraceVersion;
+    mFrame.headerSize = sizeof(CompositionTraceFrame);
+    mFrame.layerSize = sizeof(CompositionTraceLayer);
+    mFrame.displayId = displayId;
+    mFrame.frameNumber = mFrameNumber++;
+    mFrame.timestamp = timestamp;
+    return mFrame;
+}
+
+const std::vector<uint8_t>& CompositionTraceRecorder::endFrame() {
+    mFrame.layerCount = static_cast<uint16_t>(std::min<size_t>(mLayers.size(), UINT16_MAX));
+
+    const size_t layersSize = mFrame.layerCount * sizeof(CompositionTraceLayer);
+    mRecord.resize(sizeof(CompositionTraceFrame) + layersSize);
+    memcpy(mRecord.data(), &mFrame, sizeof(CompositionTraceFrame));
+    if (layersSize)
+        memcpy(mRecord.data() + sizeof(CompositionTraceFrame), mLayers.data(), layersSize);
+
+    for (size_t i = 0; i < COMPOSITION_TRACE_STAGE_MAX; i++) {
+        if (mFrame.stageDuration[i] >= 0) mLatency[i].insert(mFrame.stageDuration[i]);
+        mFrame.stageDuration[i] = -1;
+    }
+    mFrame.geometryChanged = 0;
+    return mRecord;
+}
+
+void CompositionTraceRecorder::dump(std::string& result) const {
+    char line[256];
+    snprintf(line, sizeof(line), "Composition trace: %s, frames %" PRIu64 "\n",
+             mEnabled ? "enabled" : "disabled", mFrameNumber);
+    result.append(line);
+    for (size_t i = 0; i < COMPOSITION_TRACE_STAGE_MAX; i++) {
+        const LatencyWindow& window = mLatency[i];
+        if (window.count == 0) continue;
+
+        std::vector<int64_t> sorted(window.samples.begin(),
+                                    window.samples.begin() + window.count);
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](size_t p) {
+            return sorted[(sorted.size() - 1) * p / 100] / 1000;
+        };
+        snprintf(line, sizeof(line),
+                 "\t%-16s(us) p50 %" PRId64 ", p90 %" PRId64 ", p99 %" PRId64 ", max %" PRId64
+                 " over %zu frames\n",
+                 getCompositionTraceStageName(static_cast<CompositionTraceStage>(i)),
+                 percentile(50), percentile(90), percentile(99), sorted.back() / 1000,
+                 sorted.size());
+        result.append(line);
+    }
+}
+
+bool readCompositionTrace(const std::string& path, std::vector<CompositionTraceRecord>* frames) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    bool valid = true;
+    std::vector<uint8_t> buf;
+    while (true) {
+        /* The fields of version 1 are common to every version */
+        CompositionTraceRecord record{};
+        if (fread(&record.frame, sizeof(record.frame), 1, file) != 1) break;
+        if (record.frame.magic != kCompositionTraceMagic ||
+            record.frame.headerSize < sizeof(CompositionTraceFrame) ||
+            record.frame.layerSize == 0) {
+            valid = frames->size() > 0;
+            break;
+        }
+        if (fseek(file, record.frame.headerSize - sizeof(CompositionTraceFrame), SEEK_CUR)) break;
+
+        buf.resize(static_cast<size_t>(record.frame.layerSize) * record.frame.layerCount);
+        if (buf.size() && fread(buf.data(), buf.size(), 1, file) != 1) break;
+
+        const size_t copySize =
+                std::min<size_t>(record.frame.layerSize, sizeof(CompositionTraceLayer));
+        record.layers.resize(record.frame.layerCount);
+        for (size_t i = 0; i < record.layers.size(); i++) {
+            memcpy(&record.layers[i], buf.data() + i * record.frame.layerSize, copySize);
+        }
+        frames->push_back(std::move(record));
+    }
+
+    fclose(file);
+    return valid;
+}
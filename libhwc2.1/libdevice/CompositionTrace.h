@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _COMPOSITION_TRACE_H_
+#define _COMPOSITION_TRACE_H_
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+/*
+ * Binary trace of the layer stack and the CPU cost of every frame.
+ *
+ * A trace is a sequence of frames. Each frame is a CompositionTraceFrame
+ * followed by layerCount records of layerSize bytes. Records are little
+ * endian and packed. New fields are only appended to the records, so readers
+ * skip what they do not know using headerSize and layerSize.
+ *
+ * Traces are recorded with the eDebugCompositionTrace debug flag into
+ * <display>_hwc_trace<N>.bin next to the error logs of the display.
+ */
+constexpr uint32_t kCompositionTraceMagic = 0x54435748; /* "HWCT" */
+constexpr uint16_t kCompositionTraceVersion = 1;
+
+enum CompositionTraceStage {
+    COMPOSITION_TRACE_VALIDATE = 0,
+    COMPOSITION_TRACE_ASSIGN_RESOURCE,
+    COMPOSITION_TRACE_PRESENT,
+    COMPOSITION_TRACE_STAGE_MAX,
+};
+
+struct CompositionTraceFrame {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint16_t layerSize;
+    uint16_t layerCount;
+    uint32_t displayId;
+    uint64_t frameNumber;
+    /* CLOCK_MONOTONIC time at the start of presentDisplay() */
+    int64_t timestamp;
+    /* Duration of each CompositionTraceStage, -1 if the stage did not run */
+    int64_t stageDuration[COMPOSITION_TRACE_STAGE_MAX];
+    uint64_t geometryChanged;
+    int32_t vsyncPeriod;
+    int32_t colorMode;
+    int32_t clientFirstIndex;
+    int32_t clientLastIndex;
+    int32_t exynosFirstIndex;
+    int32_t exynosLastIndex;
+} __attribute__((packed));
+
+struct CompositionTraceLayer {
+    uint64_t bufferId;
+    uint64_t usage;
+    int32_t requestedCompositionType;
+    int32_t validateCompositionType;
+    int32_t exynosCompositionType;
+    uint32_t overlayInfo;
+    int32_t format;
+    uint32_t compressionType;
+    uint32_t bufferWidth;
+    uint32_t bufferHeight;
+    uint32_t bufferStride;
+    float sourceCrop[4];   /* left, top, right, bottom */
+    int32_t displayFrame[4];
+    int32_t transform;
+    int32_t blending;
+    int32_t dataSpace;
+    float planeAlpha;
+    float fps;
+    uint32_t zOrder;
+    /* mLogicalType of the assigned MPPs, -1 if none */
+    int32_t otfMppType;
+    int32_t m2mMppType;
+    uint8_t isHdr;
+    uint8_t hasBuffer;
+    uint8_t reserved[2];
+} __attribute__((packed));
+
+struct CompositionTraceRecord {
+    CompositionTraceFrame frame;
+    std::vector<CompositionTraceLayer> layers;
+};
+
+/*
+ * Builds the records of the frames of a display and keeps the distribution
+ * of the latency of each stage over the last frames.
+ */
+class CompositionTraceRecorder {
+public:
+    static constexpr size_t kLatencyWindow = 256;
+
+    bool isEnabled() const { return mEnabled; }
+    void setEnabled(bool enabled);
+
+    void beginStage(CompositionTraceStage stage, int64_t now);
+    void endStage(CompositionTraceStage stage, int64_t now);
+    /* Geometry changes of the frame known at validation */
+    void setGeometryChanged(uint64_t geometryChanged) { mFrame.geometryChanged = geometryChanged; }
+
+    /* Starts the record of the frame being presented */
+    CompositionTraceFrame& beginFrame(uint32_t displayId, int64_t timestamp);
+    void addLayer(const CompositionTraceLayer& layer) { mLayers.push_back(layer); }
+    /*
+     * Completes the frame and returns its serialized record which stays
+     * valid until the next frame.
+     */
+    const std::vector<uint8_t>& endFrame();
+
+    /* Appends percentiles of the stage latencies */
+    void dump(std::string& result) const;
+
+private:
+    struct LatencyWindow {
+        std::array<int64_t, kLatencyWindow> samples{};
+        size_t count = 0;
+        size_t index = 0;
+        void insert(int64_t sample) {
+            samples[index] = sample;
+            index = (index + 1) % kLatencyWindow;
+            if (count < kLatencyWindow) count++;
+        }
+    };
+
+    bool mEnabled = false;
+    uint64_t mFrameNumber = 0;
+    std::array<int64_t, COMPOSITION_TRACE_STAGE_MAX> mStageStart{};
+    CompositionTraceFrame mFrame{};
+    std::vector<CompositionTraceLayer> mLayers;
+    std::vector<uint8_t> mRecord;
+    std::array<LatencyWindow, COMPOSITION_TRACE_STAGE_MAX> mLatency;
+};
+
+/* Ends a stage on every return path of the scope that began it */
+class CompositionTraceStageScope {
+public:
+    CompositionTraceStageScope(CompositionTraceRecorder& recorder, CompositionTraceStage stage,
+                               int64_t now)
+          : mRecorder(recorder), mStage(stage) {
+        mRecorder.beginStage(mStage, now);
+    }
+    ~CompositionTraceStageScope();
+
+private:
+    CompositionTraceRecorder& mRecorder;
+    const CompositionTraceStage mStage;
+};
+
+/*
+ * Reads all the frames of a trace file. Returns false if the file can not be
+ * read or is not a composition trace. A truncated last frame is dropped.
+ */
+bool readCompositionTrace(const std::string& path, std::vector<CompositionTraceRecord>* frames);
+
+const char* getCompositionTraceStageName(CompositionTraceStage stage);
+
+#endif // _COMPOSITION_TRACE_H_
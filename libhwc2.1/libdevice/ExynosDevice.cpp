@@ -34,6 +34,7 @@
 #include "ExynosResourceManagerModule.h"
 #include "ExynosVirtualDisplayModule.h"
 #include "VendorGraphicBuffer.h"
+#include "../libvrr/FileNode.h"
 
 using namespace vendor::graphics;
 using namespace SOC_VERSION;
@@ -171,6 +172,7 @@ ExynosDevice::ExynosDevice(bool vrrApiSupported)
         it->mErrLogFileWriter.setPrefixName(displayName + "_hwc_error_log");
         it->mDebugDumpFileWriter.setPrefixName(displayName + "_hwc_debug");
         it->mFenceFileWriter.setPrefixName(displayName + "_hwc_fence_state");
+        it->mCompositionTraceFileWriter.setPrefixName(displayName + "_hwc_trace");
         String8 saveString;
         saveString.appendFormat("ExynosDisplay %s is initialized", it->mDisplayName.c_str());
         saveErrorLog(saveString, it);
@@ -455,6 +457,13 @@ void ExynosDevice::dump(String8& result, const std::vector<std::string>& args) {
     }
     result.append("\n");
 
+    mReadbackRecorder.dump(result);
+    result.append("\n");
+
+    result.append(
+            android::hardware::graphics::composer::FileNodeManager::getInstance().dump().c_str());
+    result.append("\n");
+
     for (size_t i = 0; i < mDisplays.size(); i++) {
         ExynosDisplay* display = mDisplays[i];
         if (display->mPlugState == true) display->miniDump(result);
@@ -840,6 +849,13 @@ void ExynosDevice::setHWCControl(uint32_t displayId, uint32_t ctrl, int32_t val)
         case HWC_CTL_CAPTURE_READBACK:
             captureScreenWithReadback(displayId);
             break;
+        case HWC_CTL_CAPTURE_READBACK_CONTINUOUS:
+            ALOGI("%s::HWC_CTL_CAPTURE_READBACK_CONTINUOUS decimation=%d", __func__, val);
+            if (val > 0)
+                startReadbackRecording(displayId, static_cast<uint32_t>(val));
+            else
+                stopReadbackRecording();
+            break;
         case HWC_CTL_DISPLAY_MODE:
             ALOGI("%s::HWC_CTL_DISPLAY_MODE mode=%d", __func__, val);
             setDisplayMode((uint32_t)val);
@@ -1126,13 +1142,19 @@ int32_t ExynosDevice::captureReadbackClass::allocBuffer(
 
 void  ExynosDevice::captureReadbackClass::saveToFile(const String8 &fileName)
 {
-    if (mBuffer == nullptr) {
+    saveToFile(mBuffer, fileName);
+}
+
+void ExynosDevice::captureReadbackClass::saveToFile(buffer_handle_t buffer,
+        const String8 &fileName)
+{
+    if (buffer == nullptr) {
         ALOGE("%s:: buffer is null", __func__);
         return;
     }
 
     char filePath[MAX_DEV_NAME] = {0};
-    VendorGraphicBufferMeta gmeta(mBuffer);
+    VendorGraphicBufferMeta gmeta(buffer);
 
     snprintf(filePath, MAX_DEV_NAME,
             "%s/%s", WRITEBACK_CAPTURE_PATH, fileName.c_str());
@@ -1155,8 +1177,11 @@ void  ExynosDevice::captureReadbackClass::saveToFile(const String8 &fileName)
     }
 }
 
-void ExynosDevice::signalReadbackDone()
+void ExynosDevice::signalReadbackDone(ExynosDisplay *display)
 {
+    if (mReadbackRecorder.onPresented(display))
+        return;
+
     if (mIsWaitingReadbackReqDone) {
         Mutex::Autolock lock(mCaptureMutex);
         mCaptureCondition.signal();
@@ -1232,6 +1257,28 @@ void ExynosDevice::captureScreenWithReadback(uint32_t displayId) {
     captureClass.saveToFile(fileName);
 }
 
+int32_t ExynosDevice::startReadbackRecording(uint32_t displayId, uint32_t decimation,
+        ReadbackRecorder::Callback callback)
+{
+    ExynosDisplay *display = getDisplay(displayId);
+    if (display == nullptr) {
+        ALOGE("There is no display(%d)", displayId);
+        return HWC2_ERROR_BAD_DISPLAY;
+    }
+
+    int32_t ret = mReadbackRecorder.start(display, decimation, std::move(callback));
+    if (ret == NO_ERROR) {
+        /* Capture the current frame as the first one */
+        onRefresh(displayId);
+    }
+    return ret;
+}
+
+void ExynosDevice::stopReadbackRecording()
+{
+    mReadbackRecorder.stop();
+}
+
 int32_t ExynosDevice::setDisplayDeviceMode(int32_t display_id, int32_t mode)
 {
     int32_t ret = HWC2_ERROR_NONE;
@@ -1286,7 +1333,11 @@ void ExynosDevice::getLayerGenericMetadataKey(uint32_t __unused keyIndex,
 void ExynosDevice::setVBlankOffDelay(const int vblankOffDelay) {
     static constexpr const char *kVblankOffDelayPath = "/sys/module/drm/parameters/vblankoffdelay";
 
-    writeIntToFile(kVblankOffDelayPath, vblankOffDelay);
+    // Only HWC changes the parameter, skip the write when a mode switch leaves it unchanged
+    std::string nodeName;
+    auto fileNode = android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(kVblankOffDelayPath, nodeName);
+    fileNode->writeValue(nodeName, vblankOffDelay, true);
 }
 
 uint32_t ExynosDevice::getWindowPlaneNum()
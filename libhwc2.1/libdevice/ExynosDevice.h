@@ -41,12 +41,14 @@
 #include "ExynosHWC.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCModule.h"
+#include "ReadbackRecorder.h"
 
 #define MAX_DEV_NAME 128
 #define ERROR_LOG_PATH0 "/data/vendor/log/hwc"
 #define ERROR_LOG_PATH1 "/data/log"
 #define ERR_LOG_SIZE    (1024*1024)     // 1MB
 #define FENCE_ERR_LOG_SIZE    (1024*1024)     // 1MB
+#define COMPOSITION_TRACE_SIZE    (4*1024*1024)     // 4MB
 
 #ifndef DOZE_VSYNC_PERIOD
 #define DOZE_VSYNC_PERIOD 33333333 // 30fps
@@ -324,13 +326,21 @@ class ExynosDevice {
                 int32_t allocBuffer(uint32_t format, uint32_t w, uint32_t h);
                 buffer_handle_t& getBuffer() { return mBuffer; };
                 void saveToFile(const String8 &fileName);
+                static void saveToFile(buffer_handle_t buffer, const String8 &fileName);
             private:
                 buffer_handle_t mBuffer = nullptr;
                 ExynosDevice* mDevice = nullptr;
         };
         void captureScreenWithReadback(uint32_t displayType);
         void cleanupCaptureScreen(void *buffer);
-        void signalReadbackDone();
+        void signalReadbackDone(ExynosDisplay *display);
+        /* Continuous readback of every decimation-th present, see ReadbackRecorder */
+        int32_t startReadbackRecording(uint32_t displayId, uint32_t decimation,
+                ReadbackRecorder::Callback callback = nullptr);
+        void stopReadbackRecording();
+        void attachReadbackBuffer(ExynosDisplay *display) {
+            mReadbackRecorder.attachBuffer(display);
+        };
         void clearWaitingReadbackReqDone() {
             mIsWaitingReadbackReqDone = false;
         };
@@ -371,6 +381,7 @@ class ExynosDevice {
         Mutex mCaptureMutex;
         Condition mCaptureCondition;
         std::atomic<bool> mIsWaitingReadbackReqDone = false;
+        ReadbackRecorder mReadbackRecorder;
         bool isCallbackRegisteredLocked(int32_t descriptor);
 
     public:
@@ -34,10 +34,12 @@
 #include <utils/CallStack.h>
 
 #include <charconv>
+#include <cmath>
 #include <future>
 #include <map>
 
 #include "BrightnessController.h"
+#include "BufferDumpWorker.h"
 #include "DisplayTe2Manager.h"
 #include "ExynosExternalDisplay.h"
 #include "ExynosLayer.h"
@@ -930,6 +932,15 @@ void ExynosCompositionInfo::setTargetBuffer(ExynosDisplay *display, buffer_handl
     mDataSpace = dataspace;
 }
 
+void ExynosCompositionInfo::setTargetDamage(hwc_region_t damage)
+{
+    mDamageNum = damage.numRects;
+    mDamageRects.clear();
+
+    for (size_t i = 0; i < mDamageNum; i++)
+        mDamageRects.push_back(damage.rects[i]);
+}
+
 void ExynosCompositionInfo::setCompressionType(uint32_t compressionType) {
     mCompressionInfo.type = compressionType;
 }
@@ -1047,10 +1058,14 @@ ExynosDisplay::ExynosDisplay(uint32_t type, uint32_t index, ExynosDevice* device
         mVsyncPeriodChangeConstraints{systemTime(SYSTEM_TIME_MONOTONIC), 0},
         mVsyncAppliedTimeLine{false, 0, systemTime(SYSTEM_TIME_MONOTONIC)},
         mConfigRequestState(hwc_request_state_t::SET_CONFIG_STATE_DONE),
+        mDurationPredictor(PresentDurationModel::parseType(
+                base::GetProperty("vendor.display.power_hint.duration_model", ""),
+                PresentDurationModel::Type::kDecisionTable)),
         mPowerHalHint(mDisplayId, mDisplayTraceName),
         mErrLogFileWriter(2, ERR_LOG_SIZE),
         mDebugDumpFileWriter(10, 1, ".dump"),
         mFenceFileWriter(2, FENCE_ERR_LOG_SIZE),
+        mCompositionTraceFileWriter(4, COMPOSITION_TRACE_SIZE, ".bin"),
         mOperationRateManager(nullptr) {
     mDisplayControl.enableCompositionCrop = true;
     mDisplayControl.enableExynosCompositionOptimization = true;
@@ -1293,7 +1308,6 @@ void ExynosDisplay::doPreProcessing() {
 
     for (size_t i=0; i < mLayers.size(); i++) {
         buffer_handle_t handle = mLayers[i]->mLayerBuffer;
-        VendorGraphicBufferMeta gmeta(handle);
         if (mLayers[i]->mCompositionType == HWC2_COMPOSITION_CLIENT) {
             hasClientLayer = true;
         }
@@ -1349,14 +1363,22 @@ void ExynosDisplay::doPreProcessing() {
 int ExynosDisplay::checkLayerFps() {
     mLowFpsLayerInfo.initializeInfos();
 
+    Mutex::Autolock lock(mDRMutex);
+
+    int videoFrameRate = -1;
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        int cadence = mLayers[i]->getFrameRateCadence();
+        if (mLayers[i]->isLayerFormatYuv() && (cadence > 0))
+            videoFrameRate = std::max(videoFrameRate, cadence);
+    }
+    mVideoLayerFrameRate = videoFrameRate;
+
     if (mDisplayControl.handleLowFpsLayers == false)
         return NO_ERROR;
 
-    Mutex::Autolock lock(mDRMutex);
-
     for (size_t i=0; i < mLayers.size(); i++) {
         if ((mLayers[i]->mOverlayPriority < ePriorityHigh) &&
-            (mLayers[i]->getFps() < LOW_FPS_THRESHOLD)) {
+            (mLayers[i]->isLowFps())) {
             mLowFpsLayerInfo.addLowFpsLayer(i);
         } else if (mLowFpsLayerInfo.mHasLowFpsLayer == true) {
             break;
@@ -1848,8 +1870,9 @@ int ExynosDisplay::doExynosComposition() {
             return -EINVAL;
         }
 
-        if ((ret = mExynosCompositionInfo.mM2mMPP->doPostProcessing(
-                     mExynosCompositionInfo.mDstImg)) != NO_ERROR) {
+        if (((ret = mExynosCompositionInfo.mM2mMPP->doPostProcessing(
+                      mExynosCompositionInfo.mDstImg)) != NO_ERROR) ||
+            ((ret = mExynosCompositionInfo.mM2mMPP->waitPostProcessing()) != NO_ERROR)) {
             DISPLAY_LOGE("exynosComposition doPostProcessing fail ret(%d)", ret);
             return ret;
         }
@@ -2004,7 +2027,8 @@ int32_t ExynosDisplay::configureHandle(ExynosLayer &layer, int fence_fd, exynos_
         return ret;
     }
 
-    VendorGraphicBufferMeta gmeta(handle);
+    const BufferMetaInfo gmeta =
+            (m2mMPP != NULL) ? mBufferMetaCache.get(handle) : layer.mLayerBufferMeta;
 
     if (!layer.mPreprocessedInfo.mUsePrivateFormat)
         cfg.format = gmeta.format;
@@ -2063,7 +2087,7 @@ int32_t ExynosDisplay::configureHandle(ExynosLayer &layer, int fence_fd, exynos_
                 return -EINVAL;
             }
             if (layer.mBufferHasMetaParcel) {
-                VendorGraphicBufferMeta layer_buffer_gmeta(layer.mLayerBuffer);
+                const BufferMetaInfo &layer_buffer_gmeta = layer.mLayerBufferMeta;
                 if (layer_buffer_gmeta.flags & VendorGraphicBufferMeta::PRIV_FLAGS_USES_2PRIVATE_DATA)
                     cfg.fd_idma[parcelFdIndex] = layer_buffer_gmeta.fd1;
                 else if (layer_buffer_gmeta.flags & VendorGraphicBufferMeta::PRIV_FLAGS_USES_3PRIVATE_DATA)
@@ -2216,7 +2240,7 @@ int32_t ExynosDisplay::configureOverlay(ExynosCompositionInfo &compositionInfo)
 {
     int32_t windowIndex = compositionInfo.mWindowIndex;
     buffer_handle_t handle = compositionInfo.mTargetBuffer;
-    VendorGraphicBufferMeta gmeta(compositionInfo.mTargetBuffer);
+    const BufferMetaInfo gmeta = mBufferMetaCache.get(handle);
 
     if ((windowIndex < 0) || (windowIndex >= (int32_t)mDpuData.configs.size()))
     {
@@ -3443,7 +3467,8 @@ bool ExynosDisplay::isFullScreenComposition() {
     return true;
 }
 
-void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream& configFile) {
+void dumpBuffer(const String8& prefix, const exynos_image& image, std::ostream& configFile,
+                std::vector<BufferDumpWorker::Buffer>& buffers) {
     ATRACE_NAME(prefix.c_str());
     if (image.bufferHandle == nullptr) {
         ALOGE("%s: Buffer handle for %s is NULL", __func__, prefix.c_str());
@@ -3451,34 +3476,15 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
     }
     ALOGI("%s: dumping buffer for %s", __func__, prefix.c_str());
 
-    bool failFenceSync = false;
-    String8 infoDump;
-    if (image.acquireFenceFd > 0 && sync_wait(image.acquireFenceFd, 1000) < 0) {
-        infoDump.appendFormat("Failed to sync acquire fence\n");
-        ALOGE("%s: Failed to wait acquire fence %d, errno=(%d, %s)", __func__, image.acquireFenceFd,
-              errno, strerror(errno));
-        failFenceSync = true;
-    }
-    if (image.releaseFenceFd > 0 && sync_wait(image.releaseFenceFd, 1000) < 0) {
-        infoDump.appendFormat("Failed to sync release fence\n");
-
-        ALOGE("%s: Failed to wait release fence %d, errno=(%d, %s)", __func__, image.releaseFenceFd,
-              errno, strerror(errno));
-        failFenceSync = true;
-    }
-
     VendorGraphicBufferMeta gmeta(image.bufferHandle);
-    String8 infoPath = String8::format("%s/%s-info.txt", kBufferDumpPath, prefix.c_str());
-    std::ofstream infoFile(infoPath.c_str());
-    if (!infoFile) {
-        ALOGE("%s: failed to open file %s", __func__, infoPath.c_str());
-        return;
-    }
-
-    // TODO(b/261232489): Fix fence sync errors
-    // We currently ignore the fence errors and just dump the buffers
+    BufferDumpWorker::Buffer buffer;
+    buffer.infoPath = String8::format("%s/%s-info.txt", kBufferDumpPath, prefix.c_str()).c_str();
+    buffer.rawPath = String8::format("%s/%s-%s.raw", kBufferDumpPath, prefix.c_str(),
+                                     getFormatStr(image.format, image.compressionInfo.type).c_str())
+                             .c_str();
 
     // dump buffer info
+    String8& infoDump = buffer.info;
     dumpExynosImage(infoDump, image);
     infoDump.appendFormat("\nfd[%d, %d, %d] size[%d, %d, %d]\n", gmeta.fd, gmeta.fd1, gmeta.fd2,
                           gmeta.size, gmeta.size1, gmeta.size2);
@@ -3488,16 +3494,6 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
                           gmeta.stride, gmeta.vstride);
     infoDump.appendFormat(" producer: 0x%" PRIx64 " consumer: 0x%" PRIx64 " flags: 0x%" PRIx32 "\n",
                           gmeta.producer_usage, gmeta.consumer_usage, gmeta.flags);
-    infoFile << infoDump << std::endl;
-
-    String8 bufferPath =
-            String8::format("%s/%s-%s.raw", kBufferDumpPath, prefix.c_str(),
-                            getFormatStr(image.format, image.compressionInfo.type).c_str());
-    std::ofstream bufferFile(bufferPath.c_str(), std::ios::binary);
-    if (!bufferFile) {
-        ALOGE("%s: failed to open file %s", __func__, bufferPath.c_str());
-        return;
-    }
 
     // dump info that can be loaded by hwc-tester
     configFile << "buffers {\n";
@@ -3507,9 +3503,11 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
     configFile << "    height: " << gmeta.height << "\n";
     auto usage = gmeta.producer_usage | gmeta.consumer_usage;
     configFile << "    usage: 0x" << std::hex << usage << std::dec << "\n";
-    configFile << "    filepath: \"" << bufferPath << "\"\n";
+    // A compressed dump is restored to this path by "lz4 -d"
+    configFile << "    filepath: \"" << buffer.rawPath << "\"\n";
     configFile << "}\n" << std::endl;
 
+    // The worker reads the planes later, duplicated fds keep them alive until then
     int bufferNumber = getBufferNumOfFormat(image.format, image.compressionInfo.type);
     for (int i = 0; i < bufferNumber; ++i) {
         if (gmeta.fds[i] <= 0) {
@@ -3520,48 +3518,56 @@ void dumpBuffer(const String8& prefix, const exynos_image& image, std::ofstream&
             ALOGE("%s: gmeta.sizes[%d]=%d is invalid", __func__, i, gmeta.sizes[i]);
             continue;
         }
-        auto addr = mmap(0, gmeta.sizes[i], PROT_READ | PROT_WRITE, MAP_SHARED, gmeta.fds[i], 0);
-        if (addr != MAP_FAILED && addr != NULL) {
-            bufferFile.write(static_cast<char*>(addr), gmeta.sizes[i]);
-            munmap(addr, gmeta.sizes[i]);
-        } else {
-            ALOGE("%s: failed to mmap fds[%d]:%d for %s", __func__, i, gmeta.fds[i]);
+        int fd = dup(gmeta.fds[i]);
+        if (fd < 0) {
+            ALOGE("%s: failed to dup fds[%d]:%d for %s", __func__, i, gmeta.fds[i],
+                  prefix.c_str());
+            continue;
         }
+        buffer.planeFds.push_back(fd);
+        buffer.planeSizes.push_back(gmeta.sizes[i]);
     }
+    if (image.acquireFenceFd > 0) buffer.acquireFence = dup(image.acquireFenceFd);
+    if (image.releaseFenceFd > 0) buffer.releaseFence = dup(image.releaseFenceFd);
+
+    buffers.push_back(std::move(buffer));
 }
 
 void ExynosDisplay::dumpAllBuffers() {
     ATRACE_CALL();
+    if (mBufferDumpWorker == nullptr)
+        mBufferDumpWorker = std::make_unique<BufferDumpWorker>(mDisplayName);
+    /* Retried on the next frame rather than duplicating fds of a frame that would be dropped */
+    if (mBufferDumpWorker->isBusy()) return;
+
+    BufferDumpWorker::Frame frame;
+    frame.number = mBufferDumpNum;
+
     // dump layers info
-    String8 infoPath = String8::format("%s/%03d-display-info.txt", kBufferDumpPath, mBufferDumpNum);
-    std::ofstream infoFile(infoPath.c_str());
-    if (!infoFile) {
-        DISPLAY_LOGE("%s: failed to open file %s", __func__, infoPath.c_str());
-        ++mBufferDumpNum;
-        return;
-    }
     String8 displayDump;
     dumpLocked(displayDump);
-    infoFile << displayDump << std::endl;
+    frame.textFiles.emplace_back(String8::format("%s/%03d-display-info.txt", kBufferDumpPath,
+                                                 mBufferDumpNum)
+                                         .c_str(),
+                                 displayDump.c_str());
 
     // dump buffer contents & infos
     std::vector<String8> allLayerKeys;
-    String8 testerConfigPath =
-            String8::format("%s/%03d-hwc-tester-config.textproto", kBufferDumpPath, mBufferDumpNum);
-    std::ofstream configFile(testerConfigPath.c_str());
+    std::ostringstream configFile;
     configFile << std::string(15, '#')
                << " You can load this config file using hwc-tester to reproduce this frame "
                << std::string(15, '#') << std::endl;
+    configFile << "# Restore the *.raw.lz4 buffers with \"lz4 -d\" before loading" << std::endl;
     {
         std::scoped_lock lock(mDRMutex);
         for (int i = 0; i < mLayers.size(); ++i) {
             String8 prefix = String8::format("%03d-%d-src", mBufferDumpNum, i);
-            dumpBuffer(prefix, mLayers[i]->mSrcImg, configFile);
+            dumpBuffer(prefix, mLayers[i]->mSrcImg, configFile, frame.buffers);
             if (mLayers[i]->mM2mMPP != nullptr) {
                 String8 midPrefix = String8::format("%03d-%d-mid", mBufferDumpNum, i);
                 exynos_image image = mLayers[i]->mMidImg;
                 mLayers[i]->mM2mMPP->getDstImageInfo(&image);
-                dumpBuffer(midPrefix, image, configFile);
+                dumpBuffer(midPrefix, image, configFile, frame.buffers);
             }
             configFile << "layers {\n";
             configFile << "    key: \"" << prefix << "\"\n";
@@ -3619,7 +3625,7 @@ void ExynosDisplay::dumpAllBuffers() {
         String8 prefix = String8::format("%03d-client-target", mBufferDumpNum);
         exynos_image src, dst;
         setCompositionTargetExynosImage(COMPOSITION_CLIENT, &src, &dst);
-        dumpBuffer(prefix, src, configFile);
+        dumpBuffer(prefix, src, configFile, frame.buffers);
     }
 
     configFile << "timelines {\n";
@@ -3636,7 +3642,12 @@ void ExynosDisplay::dumpAllBuffers() {
         configFile << "    }\n";
     }
     configFile << "}" << std::endl;
+    frame.textFiles.emplace_back(String8::format("%s/%03d-hwc-tester-config.textproto",
+                                                 kBufferDumpPath, mBufferDumpNum)
+                                         .c_str(),
+                                 configFile.str());
 
+    mBufferDumpWorker->queueFrame(std::move(frame));
     ++mBufferDumpNum;
 }
 
@@ -3645,6 +3656,9 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
     gettimeofday(&updateTimeInfo.lastPresentTime, NULL);
 
     const bool mixedComposition = isMixedComposition();
+    mCompositionTrace.setEnabled(hwcCheckDebugMessages(eDebugCompositionTrace));
+    const nsecs_t presentStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mCompositionTrace.beginStage(COMPOSITION_TRACE_PRESENT, presentStartTime);
     // store this once here for the whole frame so it's consistent
     mUsePowerHints = usePowerHintSession();
     if (mUsePowerHints) {
@@ -3652,6 +3666,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
         mPowerHalHint.trackThisThread();
         mPresentStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
         if (!mValidateStartTime.has_value()) {
+            mPresentFrameFeatures = getPresentFrameFeatures(false);
             mValidationDuration = std::nullopt;
             // load target time here if validation was skipped
             mExpectedPresentTime = getExpectedPresentTime(mPresentStartTime);
@@ -3659,7 +3674,7 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
                               static_cast<nsecs_t>(mVsyncPeriod));
             mPowerHalHint.signalTargetWorkDuration(target);
             // if we did not validate (have not sent hint yet) and have data for this case
-            std::optional<nsecs_t> predictedDuration = getPredictedDuration(false);
+            std::optional<nsecs_t> predictedDuration = getPredictedDuration();
             if (predictedDuration.has_value()) {
                 mPowerHalHint.signalActualWorkDuration(*predictedDuration);
             }
@@ -3681,6 +3696,9 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     Mutex::Autolock lock(mDisplayMutex);
 
+    /* M2M jobs queued by validateDisplay() still own the layer images updated below */
+    int32_t m2mRet = waitM2mPostProcessing();
+
     if (!mHpdStatus) {
         ALOGD("presentDisplay: drop frame: mHpdStatus == false");
     }
@@ -3776,8 +3794,13 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
                 DISPLAY_LOGE("deliverPerformanceInfo() error (%d) in validateSkip case", ret);
             }
             startPostProcessing();
+            m2mRet = waitM2mPostProcessing();
         }
     }
+    if (m2mRet != NO_ERROR) {
+        errString.appendFormat("M2M post processing fail (%d)\n", m2mRet);
+        goto err;
+    }
     mRetireFenceAcquireTime = std::nullopt;
     mDpuData.reset();
 
@@ -3860,6 +3883,11 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
         }
     }
 
+    if ((ret = waitM2mPostProcessing()) != NO_ERROR) {
+        errString.appendFormat("M2M post processing fail (%d)\n", ret);
+        goto err;
+    }
+
     if ((ret = setWinConfigData()) != NO_ERROR) {
         errString.appendFormat("setWinConfigData fail (%d)\n", ret);
         goto err;
@@ -3885,6 +3913,8 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
 
     setDisplayWinConfigData();
 
+    mDevice->attachReadbackBuffer(this);
+
     if ((ret = deliverWinConfigData()) != NO_ERROR) {
         HWC_LOGE(this, "%s:: fail to deliver win_config (%d)", __func__, ret);
         if (mDpuData.retire_fence > 0)
@@ -3982,6 +4012,11 @@ int32_t ExynosDisplay::presentDisplay(int32_t* outRetireFence) {
         mPowerHalHint.signalActualWorkDuration(duration + mValidationDuration.value_or(0));
     }
 
+    if (mCompositionTrace.isEnabled()) {
+        mCompositionTrace.endStage(COMPOSITION_TRACE_PRESENT, systemTime(SYSTEM_TIME_MONOTONIC));
+        recordCompositionTrace(presentStartTime);
+    }
+
     mPriorFrameMixedComposition = mixedComposition;
 
     tryUpdateBtsFromOperationRate(false);
@@ -4007,6 +4042,12 @@ err:
     }
     mDisplayInterface->setForcePanic();
 
+    /* Failed frames are recorded too, their stages do not leak into the next frame */
+    if (mCompositionTrace.isEnabled()) {
+        mCompositionTrace.endStage(COMPOSITION_TRACE_PRESENT, systemTime(SYSTEM_TIME_MONOTONIC));
+        recordCompositionTrace(presentStartTime);
+    }
+
     ret = -EINVAL;
     return ret;
 
@@ -4021,7 +4062,7 @@ int32_t ExynosDisplay::presentPostProcessing()
 {
     setReadbackBufferInternal(NULL, -1, false);
     if (mDpuData.enable_readback)
-        mDevice->signalReadbackDone();
+        mDevice->signalReadbackDone(this);
     mDpuData.enable_readback = false;
 
     for (auto it : mIgnoreLayers) {
@@ -4075,7 +4116,8 @@ int32_t ExynosDisplay::setActiveConfigInternal(hwc2_config_t config, bool force)
 
 int32_t ExynosDisplay::setClientTarget(
         buffer_handle_t target,
-        int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace) {
+        int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace,
+        hwc_region_t damage) {
     buffer_handle_t handle = NULL;
     if (target != NULL)
         handle = target;
@@ -4094,7 +4136,7 @@ int32_t ExynosDisplay::setClientTarget(
             DISPLAY_LOGE("\t%s:: mRenderingState(%d)",__func__, mRenderingState);
         }
     } else {
-        VendorGraphicBufferMeta gmeta(handle);
+        const BufferMetaInfo gmeta = mBufferMetaCache.get(handle);
 
         DISPLAY_LOGD(eDebugOverlaySupported, "ClientTarget handle: %p [fd: %d, %d, %d]",
                 handle, gmeta.fd, gmeta.fd1, gmeta.fd2);
@@ -4121,11 +4163,13 @@ int32_t ExynosDisplay::setClientTarget(
         }
     }
     mClientCompositionInfo.setTargetBuffer(this, handle, acquireFence, (android_dataspace)dataspace);
+    mClientCompositionInfo.setTargetDamage(damage);
     setFenceInfo(acquireFence, this, FENCE_TYPE_SRC_RELEASE, FENCE_IP_FB, HwcFenceDirection::FROM);
 
     if (handle) {
-        mClientCompositionInfo.mCompressionInfo = getCompressionInfo(handle);
-        mExynosCompositionInfo.mCompressionInfo = getCompressionInfo(handle);
+        const CompressionInfo compressionInfo = mBufferMetaCache.get(handle).compressionInfo;
+        mClientCompositionInfo.mCompressionInfo = compressionInfo;
+        mExynosCompositionInfo.mCompressionInfo = compressionInfo;
     }
 
     return 0;
@@ -4910,13 +4954,21 @@ int32_t ExynosDisplay::validateDisplay(
     mUpdateCallCnt++;
     mLastUpdateTimeStamp = systemTime(SYSTEM_TIME_MONOTONIC);
 
+    mCompositionTrace.setEnabled(hwcCheckDebugMessages(eDebugCompositionTrace));
+    CompositionTraceStageScope validateStage(mCompositionTrace, COMPOSITION_TRACE_VALIDATE,
+                                             mLastUpdateTimeStamp);
+    mCompositionTrace.setGeometryChanged(mGeometryChanged);
+
     if (usePowerHintSession()) {
         mValidateStartTime = mLastUpdateTimeStamp;
         mExpectedPresentTime = getExpectedPresentTime(*mValidateStartTime);
         auto target =
                 min(mExpectedPresentTime - *mValidateStartTime, static_cast<nsecs_t>(mVsyncPeriod));
         mPowerHalHint.signalTargetWorkDuration(target);
-        std::optional<nsecs_t> predictedDuration = getPredictedDuration(true);
+        // The composition of the frame is not decided yet. The model is trained with the
+        // features taken here, so it learns from the same state it predicts from.
+        mPresentFrameFeatures = getPresentFrameFeatures(true);
+        std::optional<nsecs_t> predictedDuration = getPredictedDuration();
         if (predictedDuration.has_value()) {
             mPowerHalHint.signalActualWorkDuration(*predictedDuration);
         }
@@ -4940,7 +4992,14 @@ int32_t ExynosDisplay::validateDisplay(
             mDevice->dynamicRecompositionThreadCreate();
     }
 
-    if ((ret = mResourceManager->assignResource(this)) != NO_ERROR) {
+    if (mCompositionTrace.isEnabled())
+        mCompositionTrace.beginStage(COMPOSITION_TRACE_ASSIGN_RESOURCE,
+                                     systemTime(SYSTEM_TIME_MONOTONIC));
+    ret = mResourceManager->assignResource(this);
+    if (mCompositionTrace.isEnabled())
+        mCompositionTrace.endStage(COMPOSITION_TRACE_ASSIGN_RESOURCE,
+                                   systemTime(SYSTEM_TIME_MONOTONIC));
+    if (ret != NO_ERROR) {
         validateError = true;
         HWC_LOGE(this, "%s:: assignResource() fail, display(%d), ret(%d)", __func__, mDisplayId, ret);
         String8 errString;
@@ -5024,6 +5083,21 @@ int32_t ExynosDisplay::validateDisplay(
     return HWC2_ERROR_HAS_CHANGES;
 }
 
+int32_t ExynosDisplay::waitM2mPostProcessing()
+{
+    int32_t ret = NO_ERROR;
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosMPP* m2mMpp = mLayers[i]->mM2mMPP;
+        if ((m2mMpp == NULL) || (m2mMpp->mAssignedDisplay != this))
+            continue;
+        int32_t mppRet = m2mMpp->waitPostProcessing();
+        if ((mppRet != NO_ERROR) && (ret == NO_ERROR))
+            ret = mppRet;
+    }
+    return ret;
+}
+
 int32_t ExynosDisplay::startPostProcessing()
 {
     ATRACE_CALL();
@@ -5038,12 +5112,7 @@ int32_t ExynosDisplay::startPostProcessing()
         goto err;
     }
 
-    if ((ret = doExynosComposition()) != NO_ERROR) {
-        errString.appendFormat("exynosComposition fail (%d)\n", ret);
-        goto err;
-    }
-
-    // loop for all layer
+    // loop for all layer, the jobs run while the exynos composition is set up
     for (size_t i=0; i < mLayers.size(); i++) {
         if ((mLayers[i]->getValidateCompositionType() == HWC2_COMPOSITION_DEVICE) &&
             (mLayers[i]->mM2mMPP != NULL)) {
@@ -5067,6 +5136,11 @@ int32_t ExynosDisplay::startPostProcessing()
             }
         }
     }
+
+    if ((ret = doExynosComposition()) != NO_ERROR) {
+        errString.appendFormat("exynosComposition fail (%d)\n", ret);
+        goto err;
+    }
     return ret;
 err:
     printDebugInfos(errString);
@@ -5165,6 +5239,18 @@ void ExynosDisplay::dumpLocked(String8& result) {
     if (mDisplayTe2Manager) {
         mDisplayTe2Manager->dump(result);
     }
+    if (mBufferDumpWorker) {
+        mBufferDumpWorker->dump(result);
+    }
+    if (mUsePowerHintSession.value_or(false)) {
+        mDurationPredictor.dump(result);
+        result.appendFormat("\n");
+    }
+    if (mCompositionTrace.isEnabled()) {
+        std::string trace;
+        mCompositionTrace.dump(trace);
+        result.appendFormat("%s\n", trace.c_str());
+    }
 }
 
 void ExynosDisplay::dumpConfig(String8 &result, const exynos_win_config_data &c)
@@ -5238,7 +5324,7 @@ int32_t ExynosDisplay::setCompositionTargetExynosImage(uint32_t targetType, exyn
     if (compositionInfo.mTargetBuffer != NULL) {
         src_img->bufferHandle = compositionInfo.mTargetBuffer;
 
-        VendorGraphicBufferMeta gmeta(compositionInfo.mTargetBuffer);
+        const BufferMetaInfo gmeta = mBufferMetaCache.get(compositionInfo.mTargetBuffer);
         src_img->format = gmeta.format;
         src_img->usageFlags = gmeta.producer_usage;
     } else {
@@ -5726,33 +5812,79 @@ bool ExynosDisplay::isSecureContentPresenting() const {
 
 bool ExynosDisplay::windowUpdateExceptions()
 {
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        if (mLayers[i]->mLayerBuffer == NULL) return true;
+    }
 
-    if (mExynosCompositionInfo.mHasCompositionLayer) {
-        DISPLAY_LOGD(eDebugWindowUpdate, "has exynos composition");
+    /*
+     * The target buffers of GLES and G2D are accounted for by
+     * handleWindowUpdate(), but the composition window itself should be
+     * where it was.
+     */
+    auto compositionMoved = [&](ExynosCompositionInfo &compositionInfo) {
+        if (!compositionInfo.mHasCompositionLayer) return false;
+
+        int32_t windowIndex = compositionInfo.mWindowIndex;
+        if ((windowIndex < 0) || (windowIndex >= (int32_t)mDpuData.configs.size()) ||
+            (windowIndex >= (int32_t)mLastDpuData.configs.size()))
+            return true;
+
+        exynos_win_config_data &config = mDpuData.configs[windowIndex];
+        exynos_win_config_data &lastConfig = mLastDpuData.configs[windowIndex];
+        return (config.state != lastConfig.state) ||
+                (config.dst.x != lastConfig.dst.x) || (config.dst.y != lastConfig.dst.y) ||
+                (config.dst.w != lastConfig.dst.w) || (config.dst.h != lastConfig.dst.h) ||
+                (config.src.x != lastConfig.src.x) || (config.src.y != lastConfig.src.y) ||
+                (config.src.w != lastConfig.src.w) || (config.src.h != lastConfig.src.h);
+    };
+
+    if (compositionMoved(mExynosCompositionInfo)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "exynos composition window changed");
         return true;
     }
-    if (mClientCompositionInfo.mHasCompositionLayer) {
-        DISPLAY_LOGD(eDebugWindowUpdate, "has client composition");
+    if (compositionMoved(mClientCompositionInfo)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "client composition window changed");
         return true;
     }
 
-    for (size_t i = 0; i < mLayers.size(); i++) {
-        if (mLayers[i]->mM2mMPP != NULL) return true;
-        if (mLayers[i]->mLayerBuffer == NULL) return true;
-        if (mLayers[i]->mTransform != 0) return true;
-    }
+    return false;
+}
 
-    for (size_t i = 0; i < mDpuData.configs.size(); i++) {
-        exynos_win_config_data &config = mDpuData.configs[i];
-        if (config.state == config.WIN_STATE_BUFFER) {
-            if (config.src.w/config.dst.w != 1 || config.src.h/config.dst.h != 1) {
-                DISPLAY_LOGD(eDebugWindowUpdate, "Skip reason : scaled");
-                return true;
+/*
+ * DPP can't crop the source of a scaled or rotated window to the update
+ * region without artifacts at the edges. Such windows are either out of the
+ * region or entirely in it.
+ */
+void ExynosDisplay::expandWindowUpdateRegion(hwc_rect &region)
+{
+    bool expanded;
+
+    do {
+        expanded = false;
+        for (size_t i = 0; i < mDpuData.configs.size(); i++) {
+            exynos_win_config_data &config = mDpuData.configs[i];
+            if (config.state != config.WIN_STATE_BUFFER) continue;
+
+            bool rotated = (config.transform & HAL_TRANSFORM_ROT_90) != 0;
+            uint32_t srcW = rotated ? config.src.h : config.src.w;
+            uint32_t srcH = rotated ? config.src.w : config.src.h;
+            if ((config.transform == 0) && (srcW == config.dst.w) && (srcH == config.dst.h))
+                continue;
+
+            hwc_rect dst = {config.dst.x, config.dst.y,
+                            config.dst.x + (int)config.dst.w, config.dst.y + (int)config.dst.h};
+            bool intersects = (dst.left < region.right) && (region.left < dst.right) &&
+                    (dst.top < region.bottom) && (region.top < dst.bottom);
+            bool contained = (region.left <= dst.left) && (dst.right <= region.right) &&
+                    (region.top <= dst.top) && (dst.bottom <= region.bottom);
+            if (intersects && !contained) {
+                DISPLAY_LOGD(eDebugWindowUpdate, "window(%zu) is scaled or rotated : %d, %d, %d, %d",
+                        i, dst.left, dst.top, dst.right, dst.bottom);
+                region = expand(region, dst);
+                expanded = true;
             }
         }
-    }
-
-    return false;
+    } while (expanded);
 }
 
 int ExynosDisplay::handleWindowUpdate()
@@ -5788,11 +5920,74 @@ int ExynosDisplay::handleWindowUpdate()
     if (windowUpdateExceptions())
         return 0;
 
+    /*
+     * Layers composed by GLES or G2D reach the display only through the target
+     * buffer. The client target is updated in the damage SurfaceFlinger gives
+     * to setClientTarget(), G2D composes its whole target again.
+     */
+    auto getCompositionRegion = [&](ExynosCompositionInfo &compositionInfo, hwc_rect *rect) {
+        if (!compositionInfo.mHasCompositionLayer || compositionInfo.mSkipFlag)
+            return eDamageRegionSkip;
+
+        /* the window index was checked by windowUpdateExceptions() */
+        exynos_win_config_data &config = mDpuData.configs[compositionInfo.mWindowIndex];
+        hwc_rect window = {config.dst.x, config.dst.y,
+                           config.dst.x + (int)config.dst.w, config.dst.y + (int)config.dst.h};
+        *rect = window;
+
+        const android::Vector<hwc_rect_t> &hwcRects = compositionInfo.mDamageRects;
+        if ((compositionInfo.mType != COMPOSITION_CLIENT) || (compositionInfo.mDamageNum == 0) ||
+            (hwcRects.size() == 0) || (config.src.w == 0) || (config.src.h == 0))
+            return eDamageRegionFull;
+
+        if ((hwcRects.size() == 1) && (hwcRects[0].left == 0) && (hwcRects[0].top == 0) &&
+            (hwcRects[0].right == 0) && (hwcRects[0].bottom == 0))
+            return eDamageRegionSkip;
+
+        /* the target is only cropped and scaled to its window */
+        float scaleX = (float)config.dst.w / config.src.w;
+        float scaleY = (float)config.dst.h / config.src.h;
+        *rect = {INT_MAX, INT_MAX, 0, 0};
+        for (size_t j = 0; j < hwcRects.size(); j++) {
+            const hwc_rect_t &damage = hwcRects[j];
+            if ((damage.left < config.src.x) || (damage.top < config.src.y) ||
+                (damage.left >= damage.right) || (damage.top >= damage.bottom) ||
+                (damage.right > config.src.x + (int)config.src.w) ||
+                (damage.bottom > config.src.y + (int)config.src.h)) {
+                *rect = window;
+                return eDamageRegionFull;
+            }
+            hwc_rect mapped;
+            mapped.left = window.left + (int)floorf((damage.left - config.src.x) * scaleX);
+            mapped.top = window.top + (int)floorf((damage.top - config.src.y) * scaleY);
+            mapped.right = window.left + (int)ceilf((damage.right - config.src.x) * scaleX);
+            mapped.bottom = window.top + (int)ceilf((damage.bottom - config.src.y) * scaleY);
+            *rect = expand(*rect, mapped);
+        }
+        return eDamageRegionPartial;
+    };
+
     hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
     hwc_rect damageRect = {(int)mXres, (int)mYres, 0, 0};
 
+    for (auto compositionInfo : {&mClientCompositionInfo, &mExynosCompositionInfo}) {
+        excp = getCompositionRegion(*compositionInfo, &damageRect);
+        if (excp == eDamageRegionSkip) {
+            DISPLAY_LOGD(eDebugWindowUpdate, "%s composition skip",
+                    compositionInfo->getTypeStr().c_str());
+            continue;
+        }
+        DISPLAY_LOGD(eDebugWindowUpdate, "%s composition %s : %d, %d, %d, %d",
+                compositionInfo->getTypeStr().c_str(),
+                (excp == eDamageRegionPartial) ? "partial" : "full",
+                damageRect.left, damageRect.top, damageRect.right, damageRect.bottom);
+        mergedRect = expand(mergedRect, damageRect);
+    }
+
     for (size_t i = 0; i < mLayers.size(); i++) {
-        if (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_DISPLAY_DECORATION) {
+        if ((mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_DISPLAY_DECORATION) ||
+            (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_CLIENT) ||
+            (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_EXYNOS)) {
             continue;
         }
         excp = getLayerRegion(mLayers[i], &damageRect, eDamageRegionByDamage);
@@ -5803,6 +5998,8 @@ int ExynosDisplay::handleWindowUpdate()
         }
         else if (excp == eDamageRegionSkip) {
             int32_t windowIndex = mLayers[i]->mWindowIndex;
+            if ((windowIndex < 0) || (windowIndex >= (int32_t)mLastDpuData.configs.size()))
+                return 0;
             if ((ret = checkConfigDstChanged(mDpuData, mLastDpuData, windowIndex)) < 0) {
                 return 0;
             } else if (ret > 0) {
@@ -5813,9 +6010,10 @@ int ExynosDisplay::handleWindowUpdate()
                 DISPLAY_LOGD(eDebugWindowUpdate, "Skip layer (origin) : %d, %d, %d, %d",
                         damageRect.left, damageRect.top, damageRect.right, damageRect.bottom);
                 mergedRect = expand(mergedRect, damageRect);
-                hwc_rect prevDst = {mLastDpuData.configs[i].dst.x, mLastDpuData.configs[i].dst.y,
-                    mLastDpuData.configs[i].dst.x + (int)mLastDpuData.configs[i].dst.w,
-                    mLastDpuData.configs[i].dst.y + (int)mLastDpuData.configs[i].dst.h};
+                exynos_win_config_data &lastConfig = mLastDpuData.configs[windowIndex];
+                hwc_rect prevDst = {lastConfig.dst.x, lastConfig.dst.y,
+                    lastConfig.dst.x + (int)lastConfig.dst.w,
+                    lastConfig.dst.y + (int)lastConfig.dst.h};
                 mergedRect = expand(mergedRect, prevDst);
             } else {
                 DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) skip", i);
@@ -5846,6 +6044,8 @@ int ExynosDisplay::handleWindowUpdate()
     DISPLAY_LOGD(eDebugWindowUpdate, "Partial(origin) : %d, %d, %d, %d",
             mergedRect.left, mergedRect.top, mergedRect.right, mergedRect.bottom);
 
+    expandWindowUpdateRegion(mergedRect);
+
     if (mergedRect.left < 0) mergedRect.left = 0;
     if (mergedRect.right > (int32_t)mXres) mergedRect.right = mXres;
     if (mergedRect.top < 0) mergedRect.top = 0;
@@ -5873,6 +6073,54 @@ int ExynosDisplay::handleWindowUpdate()
     return 0;
 }
 
+/*
+ * Maps a damage rect in the buffer of the layer to the display through the
+ * source crop, the transform and the scaling to the display frame.
+ */
+static hwc_rect_t mapDamageToDisplay(const ExynosLayer *layer, const hwc_rect_t &damage)
+{
+    const hwc_frect_t &crop = layer->mSourceCrop;
+    const hwc_rect_t &frame = layer->mDisplayFrame;
+    float w = crop.right - crop.left;
+    float h = crop.bottom - crop.top;
+
+    /* relative to the source crop */
+    float l = std::max(damage.left - crop.left, 0.0f);
+    float t = std::max(damage.top - crop.top, 0.0f);
+    float r = std::min(damage.right - crop.left, w);
+    float b = std::min(damage.bottom - crop.top, h);
+
+    if (layer->mTransform & HAL_TRANSFORM_FLIP_H) {
+        float tmp = l;
+        l = w - r;
+        r = w - tmp;
+    }
+    if (layer->mTransform & HAL_TRANSFORM_FLIP_V) {
+        float tmp = t;
+        t = h - b;
+        b = h - tmp;
+    }
+    if (layer->mTransform & HAL_TRANSFORM_ROT_90) {
+        /* clockwise: (x, y) -> (h - y, x) */
+        float nl = h - b, nr = h - t;
+        t = l;
+        b = r;
+        l = nl;
+        r = nr;
+        std::swap(w, h);
+    }
+
+    float scaleX = (w > 0) ? (WIDTH(frame) / w) : 1.0f;
+    float scaleY = (h > 0) ? (HEIGHT(frame) / h) : 1.0f;
+
+    hwc_rect_t rect;
+    rect.left = frame.left + (int)floorf(l * scaleX);
+    rect.top = frame.top + (int)floorf(t * scaleY);
+    rect.right = frame.left + (int)ceilf(r * scaleX);
+    rect.bottom = frame.top + (int)ceilf(b * scaleY);
+    return rect;
+}
+
 unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_area, uint32_t regionType) {
 
     android::Vector <hwc_rect_t> hwcRects;
@@ -5908,10 +6156,7 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect *rect_ar
                 return eDamageRegionFull;
             }
 
-            rect.left = layer->mDisplayFrame.left + hwcRects[j].left - layer->mSourceCrop.left;
-            rect.top = layer->mDisplayFrame.top + hwcRects[j].top - layer->mSourceCrop.top;
-            rect.right = layer->mDisplayFrame.left + hwcRects[j].right - layer->mSourceCrop.left;
-            rect.bottom = layer->mDisplayFrame.top + hwcRects[j].bottom - layer->mSourceCrop.top;
+            rect = mapDamageToDisplay(layer, hwcRects[j]);
             DISPLAY_LOGD(eDebugWindowUpdate, "Display frame : %d, %d, %d, %d", layer->mDisplayFrame.left,
                     layer->mDisplayFrame.top, layer->mDisplayFrame.right, layer->mDisplayFrame.bottom);
             DISPLAY_LOGD(eDebugWindowUpdate, "hwcRects : %d, %d, %d, %d", hwcRects[j].left,
@@ -6302,13 +6547,17 @@ int32_t ExynosDisplay::uncacheLayerBuffers(ExynosLayer* layer,
         for (auto buffer : buffers) {
             if (layer->mLayerBuffer == buffer) {
                 layer->mLayerBuffer = nullptr;
+                layer->mLayerBufferMeta = BufferMetaInfo();
             }
             if (layer->mLastLayerBuffer == buffer) {
                 layer->mLastLayerBuffer = nullptr;
             }
         }
         outClearableBuffers = buffers;
-        return mDisplayInterface->uncacheLayerBuffers(layer, outClearableBuffers);
+        int32_t ret = mDisplayInterface->uncacheLayerBuffers(layer, outClearableBuffers);
+        for (auto buffer : buffers)
+            mBufferMetaCache.erase(buffer);
+        return ret;
     }
     return NO_ERROR;
 }
@@ -6466,15 +6715,48 @@ nsecs_t ExynosDisplay::getPredictedPresentTime(nsecs_t startTime) {
     return expectedPresentTime;
 }
 
-std::optional<nsecs_t> ExynosDisplay::getPredictedDuration(bool duringValidation) {
-    AveragesKey beforeFenceKey(mLayers.size(), duringValidation, true);
-    AveragesKey afterFenceKey(mLayers.size(), duringValidation, false);
-    if (mRollingAverages.count(beforeFenceKey) == 0 || mRollingAverages.count(afterFenceKey) == 0) {
-        return std::nullopt;
+PresentFrameFeatures ExynosDisplay::getPresentFrameFeatures(bool validated) {
+    PresentFrameFeatures features;
+    features.layers = mLayers.size();
+    features.vsyncPeriod = mVsyncPeriod;
+    features.modeSet = (mConfigRequestState != hwc_request_state_t::SET_CONFIG_STATE_DONE);
+    features.validated = validated;
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        switch (layer->getValidateCompositionType()) {
+            case HWC2_COMPOSITION_CLIENT:
+                features.clientLayers++;
+                break;
+            case HWC2_COMPOSITION_EXYNOS:
+                features.exynosLayers++;
+                break;
+            case HWC2_COMPOSITION_INVALID:
+                break;
+            default:
+                features.deviceLayers++;
+                break;
+        }
+        if (layer->mM2mMPP != NULL) features.m2mMpps++;
+        if (layer->mIsHdrLayer) features.hasHdr = true;
+
+        const bool isPerpendicular = !!(layer->mTransform & HAL_TRANSFORM_ROT_90);
+        if (isPerpendicular) features.rotatedLayers++;
+        uint32_t srcWidth = static_cast<uint32_t>(WIDTH(layer->mSourceCrop));
+        uint32_t srcHeight = static_cast<uint32_t>(HEIGHT(layer->mSourceCrop));
+        if (isPerpendicular) std::swap(srcWidth, srcHeight);
+        if ((srcWidth != static_cast<uint32_t>(WIDTH(layer->mDisplayFrame))) ||
+            (srcHeight != static_cast<uint32_t>(HEIGHT(layer->mDisplayFrame))))
+            features.scaledLayers++;
     }
-    nsecs_t beforeReleaseFence = mRollingAverages[beforeFenceKey].average;
-    nsecs_t afterReleaseFence = mRollingAverages[afterFenceKey].average;
-    return std::make_optional(afterReleaseFence + beforeReleaseFence);
+    if (mExynosCompositionInfo.mHasCompositionLayer && (mExynosCompositionInfo.mM2mMPP != NULL))
+        features.m2mMpps++;
+
+    return features;
+}
+
+std::optional<nsecs_t> ExynosDisplay::getPredictedDuration() {
+    return mDurationPredictor.predict(mPresentFrameFeatures);
 }
 
 void ExynosDisplay::updateAverages(nsecs_t endTime) {
@@ -6484,10 +6766,59 @@ void ExynosDisplay::updateAverages(nsecs_t endTime) {
     nsecs_t beforeFenceTime =
             mValidationDuration.value_or(0) + (*mRetireFenceWaitTime - mPresentStartTime);
     nsecs_t afterFenceTime = endTime - *mRetireFenceAcquireTime;
-    mRollingAverages[AveragesKey(mLayers.size(), mValidationDuration.has_value(), true)].insert(
-            beforeFenceTime);
-    mRollingAverages[AveragesKey(mLayers.size(), mValidationDuration.has_value(), false)].insert(
-            afterFenceTime);
+    mDurationPredictor.update(mPresentFrameFeatures, beforeFenceTime, afterFenceTime);
+}
+
+void ExynosDisplay::recordCompositionTrace(nsecs_t presentStartTime) {
+    CompositionTraceFrame &frame = mCompositionTrace.beginFrame(mDisplayId, presentStartTime);
+    frame.vsyncPeriod = mVsyncPeriod;
+    frame.colorMode = mColorMode;
+    frame.clientFirstIndex = mClientCompositionInfo.mFirstIndex;
+    frame.clientLastIndex = mClientCompositionInfo.mLastIndex;
+    frame.exynosFirstIndex = mExynosCompositionInfo.mFirstIndex;
+    frame.exynosLastIndex = mExynosCompositionInfo.mLastIndex;
+
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        const BufferMetaInfo &meta = layer->mLayerBufferMeta;
+        CompositionTraceLayer record = {};
+        record.bufferId = meta.unique_id;
+        record.usage = meta.producer_usage;
+        record.requestedCompositionType = layer->mRequestedCompositionType;
+        record.validateCompositionType = layer->getValidateCompositionType();
+        record.exynosCompositionType = layer->mExynosCompositionType;
+        record.overlayInfo = layer->mOverlayInfo;
+        record.format = meta.format;
+        record.compressionType = meta.compressionInfo.type;
+        record.bufferWidth = meta.width;
+        record.bufferHeight = meta.height;
+        record.bufferStride = meta.stride;
+        record.sourceCrop[0] = layer->mSourceCrop.left;
+        record.sourceCrop[1] = layer->mSourceCrop.top;
+        record.sourceCrop[2] = layer->mSourceCrop.right;
+        record.sourceCrop[3] = layer->mSourceCrop.bottom;
+        record.displayFrame[0] = layer->mDisplayFrame.left;
+        record.displayFrame[1] = layer->mDisplayFrame.top;
+        record.displayFrame[2] = layer->mDisplayFrame.right;
+        record.displayFrame[3] = layer->mDisplayFrame.bottom;
+        record.transform = layer->mTransform;
+        record.blending = layer->mBlending;
+        record.dataSpace = layer->mDataSpace;
+        record.planeAlpha = layer->mPlaneAlpha;
+        record.fps = layer->mFps;
+        record.zOrder = layer->mZOrder;
+        record.otfMppType = layer->mOtfMPP ? (int32_t)layer->mOtfMPP->mLogicalType : -1;
+        record.m2mMppType = layer->mM2mMPP ? (int32_t)layer->mM2mMPP->mLogicalType : -1;
+        record.isHdr = layer->mIsHdrLayer;
+        record.hasBuffer = (layer->mLayerBuffer != NULL);
+        mCompositionTrace.addLayer(record);
+    }
+
+    const std::vector<uint8_t> &data = mCompositionTrace.endFrame();
+    if (mCompositionTraceFileWriter.chooseOpenedFile()) {
+        mCompositionTraceFileWriter.write(data.data(), data.size());
+        mCompositionTraceFileWriter.flush();
+    }
 }
 
 int32_t ExynosDisplay::getRCDLayerSupport(bool &outSupport) const {
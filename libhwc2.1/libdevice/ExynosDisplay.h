@@ -28,6 +28,7 @@
 #include <chrono>
 #include <set>
 
+#include "CompositionTrace.h"
 #include "DeconHeader.h"
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWC.h"
@@ -36,6 +37,7 @@
 #include "ExynosHwc3Types.h"
 #include "ExynosMPP.h"
 #include "ExynosResourceManager.h"
+#include "PresentDurationModel.h"
 #include "drmeventlistener.h"
 #include "worker.h"
 
@@ -58,6 +60,7 @@ using namespace std::chrono_literals;
 typedef hwc2_composition_t exynos_composition;
 
 class BrightnessController;
+class BufferDumpWorker;
 class ExynosLayer;
 class ExynosDevice;
 class ExynosMPP;
@@ -257,6 +260,8 @@ struct exynos_dpu_data
 
     bool enable_win_update = false;
     std::atomic<bool> enable_readback = false;
+    /* A ReadbackRecorder keeps the writeback connector attached between its captures */
+    std::atomic<bool> readback_recording = false;
     struct decon_frame win_update_region = {0, 0, 0, 0, 0, 0};
     struct exynos_readback_info readback_info;
 
@@ -349,10 +354,15 @@ class ExynosCompositionInfo : public ExynosMPPSource {
         int32_t mWindowIndex;
         CompressionInfo mCompressionInfo;
 
+        /* Damage of the target buffer set by setClientTarget() */
+        size_t mDamageNum = 0;
+        android::Vector <hwc_rect_t> mDamageRects;
+
         void initializeInfos(ExynosDisplay *display);
         void initializeInfosComplete(ExynosDisplay *display);
         void setTargetBuffer(ExynosDisplay *display, buffer_handle_t handle,
                 int32_t acquireFence, android_dataspace dataspace);
+        void setTargetDamage(hwc_region_t damage);
         void setCompressionType(uint32_t compressionType);
         void dump(String8& result) const;
         String8 getTypeStr();
@@ -529,6 +539,12 @@ class ExynosDisplay {
          */
         uint32_t mBufferUpdates;
 
+        /**
+         * Decoded gralloc metadata of the buffers seen by this display.
+         * Entries are dropped by uncacheLayerBuffers().
+         */
+        BufferMetaCache mBufferMetaCache;
+
         /**
          * Rendering step information that is seperated by
          * VALIDATED, ACCEPTED_CHANGE, PRESENTED.
@@ -599,6 +615,10 @@ class ExynosDisplay {
 
         ExynosLowFpsLayerInfo mLowFpsLayerInfo;
 
+        // Highest content frame rate of the video layers, -1 if none follows one.
+        // Updated by checkLayerFps(), read by the VRR controller.
+        std::atomic<int> mVideoLayerFrameRate{-1};
+
         // HDR capabilities
         std::vector<int32_t> mHdrTypes;
         float mMaxLuminance;
@@ -620,6 +640,7 @@ class ExynosDisplay {
         hwc_display_contents_1_t *mHWC1LayerList;
         int mBufferDumpCount = 0;
         int mBufferDumpNum = 0;
+        std::unique_ptr<BufferDumpWorker> mBufferDumpWorker;
 
         /* Support Multi-resolution scheme */
         int mOldScalerMode;
@@ -683,6 +704,8 @@ class ExynosDisplay {
 
         int checkLayerFps();
 
+        int getVideoLayerFrameRate() const { return mVideoLayerFrameRate; }
+
         int switchDynamicReCompMode(dynamic_recomp_mode mode);
 
         int checkDynamicReCompMode();
@@ -845,13 +868,14 @@ class ExynosDisplay {
          */
         virtual int32_t setActiveConfig(hwc2_config_t config);
 
-        /* setClientTarget(..., target, acquireFence, dataspace)
+        /* setClientTarget(..., target, acquireFence, dataspace, damage)
          * Descriptor: HWC2_FUNCTION_SET_CLIENT_TARGET
          * HWC2_PFN_SET_CLIENT_TARGET
          */
         virtual int32_t setClientTarget(
                 buffer_handle_t target,
-                int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace);
+                int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace,
+                hwc_region_t damage);
 
         /* setColorTransform(..., matrix, hint)
          * Descriptor: HWC2_FUNCTION_SET_COLOR_TRANSFORM
@@ -1276,6 +1300,8 @@ class ExynosDisplay {
         void dumpAllBuffers() REQUIRES(mDisplayMutex);
 
         virtual int32_t startPostProcessing();
+        /* Collects the M2M jobs queued by doPostProcessing() of this display's MPPs */
+        int32_t waitM2mPostProcessing();
 
         void dumpConfig(const exynos_win_config_data &c);
         void dumpConfig(String8 &result, const exynos_win_config_data &c);
@@ -1286,6 +1312,7 @@ class ExynosDisplay {
 
         int handleWindowUpdate();
         bool windowUpdateExceptions();
+        void expandWindowUpdateRegion(hwc_rect &region);
 
         /* For debugging */
         void setHWC1LayerList(hwc_display_contents_1_t *contents) {mHWC1LayerList = contents;};
@@ -1632,23 +1659,10 @@ class ExynosDisplay {
             static constexpr const std::chrono::nanoseconds kTargetSafetyMargin = 2ms;
         };
 
-        // union here permits use as a key in the unordered_map without a custom hash
-        union AveragesKey {
-            struct {
-                uint16_t layers;
-                bool validated;
-                bool beforeReleaseFence;
-            };
-            uint32_t value;
-            AveragesKey(size_t layers, bool validated, bool beforeReleaseFence)
-                  : layers(static_cast<uint16_t>(layers)),
-                    validated(validated),
-                    beforeReleaseFence(beforeReleaseFence) {}
-            operator uint32_t() const { return value; }
-        };
-
-        static const constexpr int kAveragesBufferSize = 3;
-        std::unordered_map<uint32_t, RollingAverage<kAveragesBufferSize>> mRollingAverages;
+        PresentDurationPredictor mDurationPredictor;
+        // features of the frame being presented, taken before validation if the frame is
+        // validated. Its duration is predicted and mDurationPredictor is trained with them.
+        PresentFrameFeatures mPresentFrameFeatures;
         // mPowerHalHint should be declared only after mDisplayId and mDisplayTraceName have been
         // declared since mDisplayId and mDisplayTraceName are needed as the parameter of
         // PowerHalHintWorker's constructor
@@ -1673,8 +1687,9 @@ class ExynosDisplay {
         bool mUsePowerHints = false;
         nsecs_t getExpectedPresentTime(nsecs_t startTime);
         nsecs_t getPredictedPresentTime(nsecs_t startTime);
+        PresentFrameFeatures getPresentFrameFeatures(bool validated);
         void updateAverages(nsecs_t endTime);
-        std::optional<nsecs_t> getPredictedDuration(bool duringValidation);
+        std::optional<nsecs_t> getPredictedDuration();
         atomic_bool mDebugRCDLayerEnabled = true;
 
     protected:
@@ -1717,9 +1732,10 @@ class ExynosDisplay {
             }
 
             bool chooseOpenedFile();
-            void write(const String8& content) {
+            void write(const String8& content) { write(content.c_str(), content.size()); }
+            void write(const void* data, size_t size) {
                 if (mFile) {
-                    fwrite(content.c_str(), 1, content.size(), mFile);
+                    fwrite(data, 1, size, mFile);
                 }
             }
             void flush() {
@@ -1743,6 +1759,9 @@ class ExynosDisplay {
         mutable RotatingLogFileWriter mErrLogFileWriter;
         RotatingLogFileWriter mDebugDumpFileWriter;
         RotatingLogFileWriter mFenceFileWriter;
+        RotatingLogFileWriter mCompositionTraceFileWriter;
+        CompositionTraceRecorder mCompositionTrace;
+        void recordCompositionTrace(nsecs_t presentStartTime);
 
     protected:
         class OperationRateManager {
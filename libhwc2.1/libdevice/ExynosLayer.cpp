@@ -55,11 +55,7 @@ ExynosLayer::ExynosLayer(ExynosDisplay* display)
         mAcquireFence(-1),
         mPrevAcquireFence(-1),
         mReleaseFence(-1),
-        mFrameCount(0),
-        mLastFrameCount(0),
-        mLastFpsTime(0),
-        mNextLastFrameCount(0),
-        mNextLastFpsTime(0),
+        mFrameRateEstimator(LOW_FPS_THRESHOLD),
         mLastLayerBuffer(NULL),
         mLayerBuffer(NULL),
         mLastUpdateTime(0),
@@ -110,43 +106,13 @@ ExynosLayer::~ExynosLayer() {
  * @return float
  */
 float ExynosLayer::checkFps(bool increaseCount) {
-    uint32_t frameDiff;
-    mFrameCount += increaseCount ? 1 : 0;
-
     nsecs_t now = systemTime();
-    if (mLastFpsTime == 0) { // Initialize values
-        mLastFpsTime = now;
-        mNextLastFpsTime = now;
-        // TODO(b/268474771): set the initial FPS to the correct peak refresh rate
-        mFps = 120;
-        return mFps;
-    }
+    if (increaseCount) mFrameRateEstimator.onBufferUpdate(now);
 
-    nsecs_t diff = now - mNextLastFpsTime;
-    // Update mLastFrameCount for every 5s, to ensure that FPS calculation is only based on
-    // frames in the past at most 10s.
-    if (diff >= kLayerFpsStableTimeNs) {
-        mLastFrameCount = mNextLastFrameCount;
-        mNextLastFrameCount = mFrameCount;
-
-        mLastFpsTime = mNextLastFpsTime;
-        mNextLastFpsTime = now;
-    }
-
-    bool wasLowFps = (mFps < LOW_FPS_THRESHOLD) ? true : false;
-
-    if (mFrameCount >= mLastFrameCount)
-        frameDiff = (mFrameCount - mLastFrameCount);
-    else
-        frameDiff = (mFrameCount + (UINT_MAX - mLastFrameCount));
+    bool lowFpsChanged = mFrameRateEstimator.update(now);
+    mFps = mFrameRateEstimator.getFps();
 
-    diff = now - mLastFpsTime;
-    mFps = (frameDiff * float(s2ns(1))) / diff;
-
-    bool nowLowFps = (mFps < LOW_FPS_THRESHOLD) ? true : false;
-
-    if ((mDisplay->mDisplayControl.handleLowFpsLayers) &&
-        (wasLowFps != nowLowFps))
+    if ((mDisplay->mDisplayControl.handleLowFpsLayers) && lowFpsChanged)
         setGeometryChanged(GEOMETRY_LAYER_FPS_CHANGED);
 
     return mFps;
@@ -159,6 +125,14 @@ float ExynosLayer::getFps() {
     return mFps;
 }
 
+bool ExynosLayer::isLowFps() {
+    return mFrameRateEstimator.isLowFps();
+}
+
+int ExynosLayer::getFrameRateCadence() {
+    return mFrameRateEstimator.getCadence();
+}
+
 int32_t ExynosLayer::doPreProcess()
 {
     overlay_priority priority = ePriorityLow;
@@ -186,7 +160,7 @@ int32_t ExynosLayer::doPreProcess()
         return NO_ERROR;
     }
 
-    VendorGraphicBufferMeta gmeta(mLayerBuffer);
+    const BufferMetaInfo &gmeta = mLayerBufferMeta;
 
     mPreprocessedInfo.mUsePrivateFormat = false;
     mPreprocessedInfo.mPrivateFormat = gmeta.format;
@@ -293,7 +267,7 @@ int32_t ExynosLayer::doPreProcess()
         mPreprocessedInfo.preProcessed = true;
     }
 
-    if (exynosMPPVG && ((getDrmMode(mLayerBuffer) != NO_DRM) ||
+    if (exynosMPPVG && ((gmeta.drmMode != NO_DRM) ||
         (mIsHdrLayer == true)))
     {
         if ((mDisplay->mDisplayControl.adjustDisplayFrame == true) &&
@@ -355,10 +329,9 @@ int32_t ExynosLayer::doPreProcess()
         mPreprocessedInfo.preProcessed = true;
     }
 
-    if (VendorGraphicBufferMeta::get_usage(mLayerBuffer) &
-               toUnderlying(AidlBufferUsage::FRONT_BUFFER)) {
+    if (gmeta.usage & toUnderlying(AidlBufferUsage::FRONT_BUFFER)) {
         priority = ePriorityMax;
-    } else if (getDrmMode(mLayerBuffer) != NO_DRM) {
+    } else if (gmeta.drmMode != NO_DRM) {
         priority = ePriorityMax;
     } else if (mIsHdrLayer) {
         if (isFormatRgb(gmeta.format))
@@ -397,31 +370,31 @@ int32_t ExynosLayer::setLayerBuffer(buffer_handle_t buffer, int32_t acquireFence
     if (mDisplay->mPlugState == false)
         buffer = NULL;
 
+    BufferMetaInfo gmeta;
     if (buffer != NULL) {
-        if (VendorGraphicBufferMeta::get_fd(buffer,0) < 0)
+        gmeta = mDisplay->mBufferMetaCache.get(buffer);
+        if (gmeta.fd < 0)
             return HWC2_ERROR_BAD_LAYER;
     }
 
-    VendorGraphicBufferMeta gmeta(buffer);
     internal_format = gmeta.format;
 
     if ((mLayerBuffer == NULL) || (buffer == NULL))
         setGeometryChanged(GEOMETRY_LAYER_UNKNOWN_CHANGED);
     else {
-        if (getDrmMode(VendorGraphicBufferMeta::get_producer_usage(mLayerBuffer)) != getDrmMode(gmeta.producer_usage))
+        if (getDrmMode(mLayerBufferMeta.producer_usage) != getDrmMode(gmeta.producer_usage))
             setGeometryChanged(GEOMETRY_LAYER_DRM_CHANGED);
-        if (VendorGraphicBufferMeta::get_format(mLayerBuffer) != gmeta.format)
+        if (mLayerBufferMeta.format != gmeta.format)
             setGeometryChanged(GEOMETRY_LAYER_FORMAT_CHANGED);
-        if ((VendorGraphicBufferMeta::get_usage(mLayerBuffer) &
-                    toUnderlying(AidlBufferUsage::FRONT_BUFFER)) !=
-                (VendorGraphicBufferMeta::get_usage(buffer) &
-                    toUnderlying(AidlBufferUsage::FRONT_BUFFER)))
+        if ((mLayerBufferMeta.usage & toUnderlying(AidlBufferUsage::FRONT_BUFFER)) !=
+                (gmeta.usage & toUnderlying(AidlBufferUsage::FRONT_BUFFER)))
             setGeometryChanged(GEOMETRY_LAYER_FRONT_BUFFER_USAGE_CHANGED);
     }
 
     {
         Mutex::Autolock lock(mDisplay->mDRMutex);
         mLayerBuffer = buffer;
+        mLayerBufferMeta = gmeta;
         checkFps(mLastLayerBuffer != mLayerBuffer);
         if (mLayerBuffer != mLastLayerBuffer) {
             mLastUpdateTime = systemTime(CLOCK_MONOTONIC);
@@ -448,7 +421,7 @@ int32_t ExynosLayer::setLayerBuffer(buffer_handle_t buffer, int32_t acquireFence
 
     /* Set Compression Information from GraphicBuffer */
     uint32_t prevCompressionType = mCompressionInfo.type;
-    mCompressionInfo = getCompressionInfo(mLayerBuffer);
+    mCompressionInfo = gmeta.compressionInfo;
     if (mCompressionInfo.type != prevCompressionType)
         setGeometryChanged(GEOMETRY_LAYER_COMPRESSED_CHANGED);
 
@@ -529,7 +502,7 @@ int32_t ExynosLayer::setLayerCompositionType(int32_t /*hwc2_composition_t*/ type
 
 int32_t ExynosLayer::setLayerDataspace(int32_t /*android_dataspace_t*/ dataspace) {
     android_dataspace currentDataSpace = (android_dataspace_t)dataspace;
-    if ((mLayerBuffer != NULL) && (VendorGraphicBufferMeta::get_format(mLayerBuffer) == HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL))
+    if ((mLayerBuffer != NULL) && (mLayerBufferMeta.format == HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL))
         currentDataSpace = HAL_DATASPACE_V0_JFIF;
     else {
         /* Change legacy dataspace */
@@ -843,7 +816,7 @@ int32_t ExynosLayer::setSrcExynosImage(exynos_image *src_img)
         src_img->usageFlags = 0x0;
         src_img->bufferHandle = handle;
     } else {
-        VendorGraphicBufferMeta gmeta(handle);
+        const BufferMetaInfo &gmeta = mLayerBufferMeta;
 
         if ((mPreprocessedInfo.interlacedType == V4L2_FIELD_INTERLACED_TB) ||
             (mPreprocessedInfo.interlacedType == V4L2_FIELD_INTERLACED_BT))
@@ -915,7 +888,7 @@ int32_t ExynosLayer::setDstExynosImage(exynos_image *dst_img)
     if (handle == NULL) {
         dst_img->usageFlags = 0x0;
     } else {
-        dst_img->usageFlags = VendorGraphicBufferMeta::get_producer_usage(handle);
+        dst_img->usageFlags = mLayerBufferMeta.producer_usage;
     }
 
     if (isDimLayer()) {
@@ -1032,7 +1005,7 @@ void ExynosLayer::dump(String8& result)
     uint64_t unique_id;
     if (mLayerBuffer != NULL)
     {
-        VendorGraphicBufferMeta gmeta(mLayerBuffer);
+        const BufferMetaInfo &gmeta = mLayerBufferMeta;
         format = gmeta.format;
         fd = gmeta.fd;
         fd1 = gmeta.fd1;
@@ -1062,7 +1035,8 @@ void ExynosLayer::dump(String8& result)
                 .add("colorTr", mLayerColorTransform.enable)
                 .add("blend", mBlending, true)
                 .add("planeAlpha", mPlaneAlpha)
-                .add("fps", mFps);
+                .add("fps", mFps)
+                .add("cadence", mFrameRateEstimator.getCadence());
         result.append(tb.build().c_str());
     }
 
@@ -1127,7 +1101,7 @@ void ExynosLayer::miniDump(TableBuilder& tb) {
     int format = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
     int32_t fd, fd1, fd2;
     if (mLayerBuffer != NULL) {
-        VendorGraphicBufferMeta gmeta(mLayerBuffer);
+        const BufferMetaInfo &gmeta = mLayerBufferMeta;
         format = gmeta.format;
         fd = gmeta.fd;
         fd1 = gmeta.fd1;
@@ -1186,7 +1160,7 @@ void ExynosLayer::printLayer()
     String8 result;
     if (mLayerBuffer != NULL)
     {
-        VendorGraphicBufferMeta gmeta(mLayerBuffer);
+        const BufferMetaInfo &gmeta = mLayerBufferMeta;
         format = gmeta.format;
         fd = gmeta.fd;
         fd1 = gmeta.fd1;
@@ -1204,8 +1178,8 @@ void ExynosLayer::printLayer()
                         getFormatStr(format, mCompressionInfo.type).c_str());
     result.appendFormat("\tblend: 0x%4x, planeAlpha: %3.1f, zOrder: %d, color[0x%2x, 0x%2x, 0x%2x, 0x%2x]\n",
             mBlending, mPlaneAlpha, mZOrder, mColor.r, mColor.g, mColor.b, mColor.a);
-    result.appendFormat("\tfps: %.2f, priority: %d, windowIndex: %d\n", mFps, mOverlayPriority,
-                        mWindowIndex);
+    mFrameRateEstimator.dump(result);
+    result.appendFormat("\tpriority: %d, windowIndex: %d\n", mOverlayPriority, mWindowIndex);
     result.appendFormat("\tsourceCrop[%7.1f,%7.1f,%7.1f,%7.1f], dispFrame[%5d,%5d,%5d,%5d]\n",
             mSourceCrop.left, mSourceCrop.top, mSourceCrop.right, mSourceCrop.bottom,
             mDisplayFrame.left, mDisplayFrame.top, mDisplayFrame.right, mDisplayFrame.bottom);
@@ -29,6 +29,7 @@
 #include "ExynosDisplay.h"
 #include "ExynosHWC.h"
 #include "ExynosHWCHelper.h"
+#include "LayerFrameRateEstimator.h"
 #include "VendorGraphicBuffer.h"
 #include "VendorVideoAPI.h"
 
@@ -179,11 +180,10 @@ class ExynosLayer : public ExynosMPPSource {
          */
         int32_t mReleaseFence;
 
-        uint32_t mFrameCount;
-        uint32_t mLastFrameCount;
-        nsecs_t mLastFpsTime;
-        uint32_t mNextLastFrameCount;
-        nsecs_t mNextLastFpsTime;
+        /**
+         * Update rate estimation from the buffer update timestamps
+         */
+        LayerFrameRateEstimator mFrameRateEstimator;
 
         /**
          * Previous buffer's handle
@@ -195,6 +195,11 @@ class ExynosLayer : public ExynosMPPSource {
          */
         buffer_handle_t mLayerBuffer;
 
+        /**
+         * Gralloc metadata of mLayerBuffer from the display's cache
+         */
+        BufferMetaInfo mLayerBufferMeta;
+
         nsecs_t mLastUpdateTime;
 
         /**
@@ -288,6 +293,12 @@ class ExynosLayer : public ExynosMPPSource {
 
         float getFps();
 
+        /* Low fps state with hysteresis, see LayerFrameRateEstimator */
+        bool isLowFps();
+
+        /* Content frame rate the buffer updates follow, 0 if none */
+        int getFrameRateCadence();
+
         int32_t doPreProcess();
 
         /* setCursorPosition(..., x, y)
@@ -486,19 +497,16 @@ class ExynosLayer : public ExynosMPPSource {
 
         void setSrcAcquireFence();
 
-        bool isDrm() {return ((mLayerBuffer != NULL) && (getDrmMode(mLayerBuffer) != NO_DRM));};
+        bool isDrm() {return ((mLayerBuffer != NULL) && (mLayerBufferMeta.drmMode != NO_DRM));};
         bool isLayerFormatRgb() {
-            return ((mLayerBuffer != NULL) &&
-                    isFormatRgb(VendorGraphicBufferMeta::get_internal_format(mLayerBuffer)));
+            return ((mLayerBuffer != NULL) && isFormatRgb(mLayerBufferMeta.internal_format));
         }
         bool isLayerFormatYuv() {
-            return ((mLayerBuffer != NULL) &&
-                    isFormatYUV(VendorGraphicBufferMeta::get_internal_format(mLayerBuffer)));
+            return ((mLayerBuffer != NULL) && isFormatYUV(mLayerBufferMeta.internal_format));
         }
         bool isLayerHasAlphaChannel() {
             return ((mLayerBuffer != NULL) &&
-                    formatHasAlphaChannel(
-                            VendorGraphicBufferMeta::get_internal_format(mLayerBuffer)));
+                    formatHasAlphaChannel(mLayerBufferMeta.internal_format));
         }
         bool isLayerOpaque() {
             return (!isLayerHasAlphaChannel() &&
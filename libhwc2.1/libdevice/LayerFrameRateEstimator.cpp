@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LayerFrameRateEstimator.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr int kContentFrameRates[] = {24, 25, 30, 48, 50, 60, 90, 120};
+
+void LayerFrameRateEstimator::onBufferUpdate(nsecs_t now) {
+    mHead = (mHead + 1) % kMaxTimestamps;
+    mTimestamps[mHead] = now;
+    if (mCount < kMaxTimestamps) mCount++;
+
+    evaluateIntervals();
+}
+
+void LayerFrameRateEstimator::evaluateIntervals() {
+    if (mCount <= kMinIntervals) return;
+
+    std::array<nsecs_t, kMaxTimestamps - 1> intervals;
+    const size_t numIntervals = mCount - 1;
+    for (size_t i = 0; i < numIntervals; i++) {
+        size_t index = (mHead + kMaxTimestamps - i) % kMaxTimestamps;
+        size_t prevIndex = (index + kMaxTimestamps - 1) % kMaxTimestamps;
+        intervals[i] = mTimestamps[index] - mTimestamps[prevIndex];
+    }
+
+    auto begin = intervals.begin();
+    auto end = begin + numIntervals;
+    std::nth_element(begin, begin + numIntervals / 2, end);
+    mMedianIntervalNs = std::max<nsecs_t>(intervals[numIntervals / 2], 1);
+
+    /* Median absolute deviation, and the mean without the intervals of stalls */
+    std::array<nsecs_t, kMaxTimestamps - 1> deviations;
+    nsecs_t sum = 0;
+    size_t sumCount = 0;
+    for (size_t i = 0; i < numIntervals; i++) {
+        deviations[i] = std::abs(intervals[i] - mMedianIntervalNs);
+        if (intervals[i] <= 3 * mMedianIntervalNs) {
+            sum += intervals[i];
+            sumCount++;
+        }
+    }
+    std::nth_element(deviations.begin(), deviations.begin() + numIntervals / 2,
+                     deviations.begin() + numIntervals);
+    mJitterNs = deviations[numIntervals / 2];
+    mIntervalFps = float(s2ns(1)) / mMedianIntervalNs;
+
+    int cadence = 0;
+    if ((sum > 0) && (mJitterNs <= kCadenceMaxJitter * mMedianIntervalNs))
+        cadence = matchCadence(float(s2ns(1)) * sumCount / sum);
+
+    if (cadence == mCadence) {
+        mCandidateCadenceRuns = 0;
+    } else if (cadence == mCandidateCadence) {
+        if (++mCandidateCadenceRuns >= kCadenceStableRuns) {
+            mCadence = cadence;
+            mCandidateCadenceRuns = 0;
+        }
+    } else {
+        mCandidateCadence = cadence;
+        mCandidateCadenceRuns = 1;
+    }
+}
+
+int LayerFrameRateEstimator::matchCadence(float fps) const {
+    for (int rate : kContentFrameRates) {
+        if (std::abs(fps - rate) <= rate * kCadenceTolerance) return rate;
+    }
+    return 0;
+}
+
+bool LayerFrameRateEstimator::update(nsecs_t now) {
+    if (mCount == 0) return false;
+
+    mFps = (mCount > kMinIntervals) ? mIntervalFps : kInitialFps;
+    if (mCadence != 0) mFps = mCadence;
+
+    /* The layer stopped updating, the cadence is gone as soon as an update is missed */
+    nsecs_t sinceLastUpdate = now - mTimestamps[mHead];
+    if ((mMedianIntervalNs > 0) && (sinceLastUpdate > 2 * mMedianIntervalNs)) {
+        mCadence = 0;
+        mCandidateCadence = 0;
+        mCandidateCadenceRuns = 0;
+    }
+    /* but the rate only decays after a while, pauses of animations are not low fps */
+    if (sinceLastUpdate > std::max(2 * mMedianIntervalNs, kIdleDecayNs))
+        mFps = std::min(mFps, float(s2ns(1)) / sinceLastUpdate);
+
+    bool wasLowFps = mLowFps;
+    if (mLowFps)
+        mLowFps = (mFps < mLowFpsThreshold * kLowFpsExitRatio);
+    else
+        mLowFps = (mFps < mLowFpsThreshold);
+
+    return wasLowFps != mLowFps;
+}
+
+void LayerFrameRateEstimator::dump(String8& result) const {
+    result.appendFormat("\tfps: %.2f (interval %.2f ms, jitter %.2f ms, cadence %d%s)\n", mFps,
+                        mMedianIntervalNs / 1000000.0f, mJitterNs / 1000000.0f, mCadence,
+                        mLowFps ? ", low fps" : "");
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LAYER_FRAME_RATE_ESTIMATOR_H_
+#define _LAYER_FRAME_RATE_ESTIMATOR_H_
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <array>
+
+#include "ExynosHWCHelper.h"
+
+/*
+ * Estimates the update rate of a layer from the timestamps of its last buffer updates.
+ *
+ * The rate is the inverse of the median interval, so single late or dropped frames do not move
+ * it. When the updates lock to a content rate (24, 25, 30, 48, 50, 60, 90 or 120 fps, 3:2
+ * pulldown included) for a few updates in a row, that rate is reported as the cadence. The
+ * cadence is dropped once the layer misses an update, and after kIdleDecayNs without update the
+ * rate decays with the time since the last update.
+ *
+ * The low fps state has hysteresis: it is entered below lowFpsThreshold and only left at
+ * kLowFpsExitRatio times that rate.
+ */
+class LayerFrameRateEstimator {
+public:
+    /* Rate reported until the layer has a few updates */
+    static constexpr float kInitialFps = 120;
+    static constexpr float kLowFpsExitRatio = 1.5f;
+
+    LayerFrameRateEstimator(float lowFpsThreshold) : mLowFpsThreshold(lowFpsThreshold) {}
+
+    void onBufferUpdate(nsecs_t now);
+
+    /* Re-evaluates the estimate at now. Returns true if isLowFps() changed. */
+    bool update(nsecs_t now);
+
+    float getFps() const { return mFps; }
+    /* 0 if the updates do not follow a content rate */
+    int getCadence() const { return mCadence; }
+    bool isLowFps() const { return mLowFps; }
+
+    void dump(String8& result) const;
+
+private:
+    /* Timestamps kept, the estimate uses the intervals between them */
+    static constexpr size_t kMaxTimestamps = 16;
+    static constexpr size_t kMinIntervals = 3;
+    /* Updates in a row a new cadence has to match before it is reported */
+    static constexpr int kCadenceStableRuns = 3;
+    /* Relative error between the mean rate and a content rate */
+    static constexpr float kCadenceTolerance = 0.02f;
+    /* Relative jitter above which the updates do not follow a cadence, 3:2 pulldown is ~0.2 */
+    static constexpr float kCadenceMaxJitter = 0.3f;
+    /* Time without update before the rate decays */
+    static constexpr nsecs_t kIdleDecayNs = ms2ns(500);
+
+    void evaluateIntervals();
+    int matchCadence(float fps) const;
+
+    const float mLowFpsThreshold;
+
+    std::array<nsecs_t, kMaxTimestamps> mTimestamps;
+    size_t mHead = 0;
+    size_t mCount = 0;
+
+    float mFps = kInitialFps;
+    /* Estimate from the intervals, before the idle decay */
+    float mIntervalFps = kInitialFps;
+    nsecs_t mMedianIntervalNs = 0;
+    nsecs_t mJitterNs = 0;
+    int mCadence = 0;
+    int mCandidateCadence = 0;
+    int mCandidateCadenceRuns = 0;
+    bool mLowFps = false;
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PresentDurationModel.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <cmath>
+
+std::string PresentFrameFeatures::toString() const {
+    return std::string("layers ") + std::to_string(layers) + " (client " +
+            std::to_string(clientLayers) + ", device " + std::to_string(deviceLayers) +
+            ", exynos " + std::to_string(exynosLayers) + "), m2m " + std::to_string(m2mMpps) +
+            ", scaled " + std::to_string(scaledLayers) + ", rotated " +
+            std::to_string(rotatedLayers) + ", " + std::to_string(nanoSec2Hz(vsyncPeriod)) +
+            "Hz" + (hasHdr ? ", hdr" : "") + (modeSet ? ", modeset" : "") +
+            (validated ? ", validated" : "");
+}
+
+std::unique_ptr<PresentDurationModel> PresentDurationModel::create(Type type) {
+    switch (type) {
+        case Type::kLayerCount:
+            return std::make_unique<LayerCountDurationModel>();
+        case Type::kLeastSquares:
+            return std::make_unique<LeastSquaresDurationModel>();
+        case Type::kDecisionTable:
+        default:
+            return std::make_unique<DecisionTableDurationModel>();
+    }
+}
+
+PresentDurationModel::Type PresentDurationModel::parseType(const std::string& str, Type fallback) {
+    if (str == "layer-count") return Type::kLayerCount;
+    if (str == "decision-table") return Type::kDecisionTable;
+    if (str == "least-squares") return Type::kLeastSquares;
+    return fallback;
+}
+
+std::optional<nsecs_t> LayerCountDurationModel::predict(const PresentFrameFeatures& features) {
+    AveragesKey beforeFenceKey(features.layers, features.validated, true);
+    AveragesKey afterFenceKey(features.layers, features.validated, false);
+    auto before = mRollingAverages.find(beforeFenceKey);
+    auto after = mRollingAverages.find(afterFenceKey);
+    if (before == mRollingAverages.end() || after == mRollingAverages.end()) {
+        return std::nullopt;
+    }
+    return std::make_optional(before->second.average + after->second.average);
+}
+
+void LayerCountDurationModel::update(const PresentFrameFeatures& features,
+                                     nsecs_t beforeReleaseFence, nsecs_t afterReleaseFence) {
+    mRollingAverages[AveragesKey(features.layers, features.validated, true)].insert(
+            beforeReleaseFence);
+    mRollingAverages[AveragesKey(features.layers, features.validated, false)].insert(
+            afterReleaseFence);
+}
+
+void LayerCountDurationModel::dump(String8& result) const {
+    result.appendFormat("\tlayer count averages: %zu\n", mRollingAverages.size());
+}
+
+uint64_t DecisionTableDurationModel::sceneKey(const PresentFrameFeatures& f) {
+    auto field = [](uint64_t value, uint32_t bits) {
+        return std::min<uint64_t>(value, (1ULL << bits) - 1);
+    };
+    uint64_t key = field(f.layers, 8);
+    key = (key << 5) | field(f.clientLayers, 5);
+    key = (key << 5) | field(f.deviceLayers, 5);
+    key = (key << 5) | field(f.exynosLayers, 5);
+    key = (key << 3) | field(f.m2mMpps, 3);
+    key = (key << 4) | field(f.scaledLayers, 4);
+    key = (key << 4) | field(f.rotatedLayers, 4);
+    key = (key << 9) | field(nanoSec2Hz(f.vsyncPeriod), 9);
+    key = (key << 1) | f.hasHdr;
+    key = (key << 1) | f.modeSet;
+    key = (key << 1) | f.validated;
+    return key;
+}
+
+std::optional<nsecs_t> DecisionTableDurationModel::predict(const PresentFrameFeatures& features) {
+    auto it = mIndex.find(sceneKey(features));
+    if (it == mIndex.end()) {
+        return mFallback.predict(features);
+    }
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return std::make_optional(it->second->second.duration.average);
+}
+
+void DecisionTableDurationModel::update(const PresentFrameFeatures& features,
+                                        nsecs_t beforeReleaseFence, nsecs_t afterReleaseFence) {
+    mFallback.update(features, beforeReleaseFence, afterReleaseFence);
+
+    uint64_t key = sceneKey(features);
+    auto it = mIndex.find(key);
+    if (it != mIndex.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, it->second);
+    } else {
+        if (mEntries.size() >= kMaxEntries) {
+            mIndex.erase(mEntries.back().first);
+            mEntries.pop_back();
+            mEvictions++;
+        }
+        mEntries.emplace_front(key, Entry{{}, features});
+        mIndex[key] = mEntries.begin();
+    }
+    mEntries.front().second.duration.insert(beforeReleaseFence + afterReleaseFence);
+}
+
+void DecisionTableDurationModel::reset() {
+    mEntries.clear();
+    mIndex.clear();
+    mFallback.reset();
+    mEvictions = 0;
+}
+
+void DecisionTableDurationModel::dump(String8& result) const {
+    result.appendFormat("\tscenes: %zu/%zu, evictions: %" PRIu64 "\n", mEntries.size(),
+                        kMaxEntries, mEvictions);
+    for (const auto& [key, entry] : mEntries) {
+        result.appendFormat("\t\t%" PRId64 " us: %s\n", ns2us(entry.duration.average),
+                            entry.features.toString().c_str());
+    }
+    mFallback.dump(result);
+}
+
+LeastSquaresDurationModel::Vector LeastSquaresDurationModel::toVector(
+        const PresentFrameFeatures& f) {
+    return {1.0,
+            static_cast<double>(f.layers),
+            static_cast<double>(f.clientLayers),
+            static_cast<double>(f.deviceLayers),
+            static_cast<double>(f.exynosLayers),
+            static_cast<double>(f.m2mMpps),
+            static_cast<double>(f.scaledLayers),
+            static_cast<double>(f.rotatedLayers),
+            static_cast<double>(ns2ms(f.vsyncPeriod)),
+            f.hasHdr ? 1.0 : 0.0,
+            f.modeSet ? 1.0 : 0.0,
+            f.validated ? 1.0 : 0.0};
+}
+
+void LeastSquaresDurationModel::reset() {
+    mWeights.fill(0.0);
+    for (size_t i = 0; i < kNumFeatures; i++) {
+        mCovariance[i].fill(0.0);
+        mCovariance[i][i] = kInitialCovariance;
+    }
+    mSamples = 0;
+}
+
+std::optional<nsecs_t> LeastSquaresDurationModel::predict(const PresentFrameFeatures& features) {
+    // not enough samples to determine all the weights yet
+    if (mSamples < kNumFeatures) {
+        return std::nullopt;
+    }
+    const Vector x = toVector(features);
+    double us = 0;
+    for (size_t i = 0; i < kNumFeatures; i++) {
+        us += mWeights[i] * x[i];
+    }
+    return std::make_optional(static_cast<nsecs_t>(std::max(us, 0.0) * 1000));
+}
+
+void LeastSquaresDurationModel::update(const PresentFrameFeatures& features,
+                                       nsecs_t beforeReleaseFence, nsecs_t afterReleaseFence) {
+    const Vector x = toVector(features);
+    const double y = ns2us(beforeReleaseFence + afterReleaseFence);
+
+    Vector px{};
+    double xpx = 0;
+    double prediction = 0;
+    for (size_t i = 0; i < kNumFeatures; i++) {
+        for (size_t j = 0; j < kNumFeatures; j++) {
+            px[i] += mCovariance[i][j] * x[j];
+        }
+        xpx += x[i] * px[i];
+        prediction += mWeights[i] * x[i];
+    }
+
+    const double denom = kForgettingFactor + xpx;
+    const double error = y - prediction;
+    double trace = 0;
+    for (size_t i = 0; i < kNumFeatures; i++) {
+        mWeights[i] += px[i] / denom * error;
+        for (size_t j = 0; j < kNumFeatures; j++) {
+            mCovariance[i][j] -= px[i] * px[j] / denom;
+        }
+        trace += mCovariance[i][i];
+    }
+
+    // Features which never change (no HDR layers ever, for example) make the
+    // covariance grow without bound when it keeps being divided by the
+    // forgetting factor. Stop forgetting when it has grown large enough.
+    if (trace * (1.0 / kForgettingFactor) < kMaxCovarianceTrace) {
+        for (auto& row : mCovariance) {
+            for (auto& value : row) {
+                value /= kForgettingFactor;
+            }
+        }
+    }
+    mSamples++;
+}
+
+void LeastSquaresDurationModel::dump(String8& result) const {
+    result.appendFormat("\tsamples: %" PRIu64 ", weights (us):", mSamples);
+    for (double weight : mWeights) {
+        result.appendFormat(" %.1f", weight);
+    }
+    result.appendFormat("\n");
+}
+
+std::optional<nsecs_t> PresentDurationPredictor::predict(const PresentFrameFeatures& features) {
+    mPendingPrediction = mModel->predict(features);
+    return mPendingPrediction;
+}
+
+void PresentDurationPredictor::update(const PresentFrameFeatures& features,
+                                      nsecs_t beforeReleaseFence, nsecs_t afterReleaseFence) {
+    mFrames++;
+    if (mPendingPrediction.has_value()) {
+        nsecs_t error = *mPendingPrediction - (beforeReleaseFence + afterReleaseFence);
+        mPredictedFrames++;
+        if (error < 0) mUnderPredictedFrames++;
+        mTotalError += error;
+        mTotalAbsError += std::abs(error);
+        mMaxAbsError = std::max(mMaxAbsError, std::abs(error));
+        mLastError = error;
+        mPendingPrediction = std::nullopt;
+    }
+    mModel->update(features, beforeReleaseFence, afterReleaseFence);
+}
+
+void PresentDurationPredictor::reset() {
+    mModel->reset();
+    mPendingPrediction = std::nullopt;
+    mFrames = 0;
+    mPredictedFrames = 0;
+    mUnderPredictedFrames = 0;
+    mTotalAbsError = 0;
+    mTotalError = 0;
+    mMaxAbsError = 0;
+    mLastError = 0;
+}
+
+void PresentDurationPredictor::dump(String8& result) const {
+    result.appendFormat("Present duration model: %s\n", mModel->getName());
+    result.appendFormat("\tframes: %" PRIu64 ", predicted: %" PRIu64 ", under-predicted: %" PRIu64
+                        "\n",
+                        mFrames, mPredictedFrames, mUnderPredictedFrames);
+    if (mPredictedFrames) {
+        result.appendFormat("\terror (us): mean abs %" PRId64 ", mean %" PRId64 ", max abs %" PRId64
+                            ", last %" PRId64 "\n",
+                            ns2us(mTotalAbsError / static_cast<int64_t>(mPredictedFrames)),
+                            ns2us(mTotalError / static_cast<int64_t>(mPredictedFrames)),
+                            ns2us(mMaxAbsError), ns2us(mLastError));
+    }
+    mModel->dump(result);
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PRESENT_DURATION_MODEL_H_
+#define _PRESENT_DURATION_MODEL_H_
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "ExynosHWCHelper.h"
+
+/*
+ * Description of the work of a frame which determines how long
+ * validateDisplay() and presentDisplay() take on the CPU.
+ */
+struct PresentFrameFeatures {
+    uint32_t layers = 0;
+    uint32_t clientLayers = 0;
+    uint32_t deviceLayers = 0;
+    uint32_t exynosLayers = 0;
+    /* M2M MPPs used by layers and by the exynos composition */
+    uint32_t m2mMpps = 0;
+    uint32_t scaledLayers = 0;
+    uint32_t rotatedLayers = 0;
+    nsecs_t vsyncPeriod = 0;
+    bool hasHdr = false;
+    /* A change of the display config is in flight */
+    bool modeSet = false;
+    bool validated = false;
+
+    std::string toString() const;
+};
+
+/*
+ * Predicts the duration of validateDisplay() and presentDisplay() of a frame
+ * from its features. The prediction is sent to the PowerHAL as the actual work
+ * duration before the work is done, and the measured duration is fed back by
+ * update() when the frame is presented.
+ */
+class PresentDurationModel {
+public:
+    enum class Type : int {
+        kLayerCount = 0,
+        kDecisionTable,
+        kLeastSquares,
+    };
+
+    virtual ~PresentDurationModel() = default;
+
+    virtual const char* getName() const = 0;
+    virtual std::optional<nsecs_t> predict(const PresentFrameFeatures& features) = 0;
+    virtual void update(const PresentFrameFeatures& features, nsecs_t beforeReleaseFence,
+                        nsecs_t afterReleaseFence) = 0;
+    virtual void reset() = 0;
+    virtual void dump(String8& __unused result) const {}
+
+    static std::unique_ptr<PresentDurationModel> create(Type type);
+    /* Returns the type named by str or fallback if str is not a valid name */
+    static Type parseType(const std::string& str, Type fallback);
+};
+
+/*
+ * Rolling averages keyed by the number of layers only.
+ */
+class LayerCountDurationModel : public PresentDurationModel {
+public:
+    const char* getName() const override { return "layer-count"; }
+    std::optional<nsecs_t> predict(const PresentFrameFeatures& features) override;
+    void update(const PresentFrameFeatures& features, nsecs_t beforeReleaseFence,
+                nsecs_t afterReleaseFence) override;
+    void reset() override { mRollingAverages.clear(); }
+    void dump(String8& result) const override;
+
+private:
+    // union here permits use as a key in the unordered_map without a custom hash
+    union AveragesKey {
+        struct {
+            uint16_t layers;
+            bool validated;
+            bool beforeReleaseFence;
+        };
+        uint32_t value;
+        AveragesKey(size_t layers, bool validated, bool beforeReleaseFence)
+              : layers(static_cast<uint16_t>(layers)),
+                validated(validated),
+                beforeReleaseFence(beforeReleaseFence) {}
+        operator uint32_t() const { return value; }
+    };
+
+    static const constexpr int kAveragesBufferSize = 3;
+    std::unordered_map<uint32_t, RollingAverage<kAveragesBufferSize>> mRollingAverages;
+};
+
+/*
+ * Rolling averages keyed by the quantized features of the frame. The table is
+ * bounded and the least recently used scene is evicted first. Scenes which
+ * have not been seen yet fall back to the average of their layer count.
+ */
+class DecisionTableDurationModel : public PresentDurationModel {
+public:
+    const char* getName() const override { return "decision-table"; }
+    std::optional<nsecs_t> predict(const PresentFrameFeatures& features) override;
+    void update(const PresentFrameFeatures& features, nsecs_t beforeReleaseFence,
+                nsecs_t afterReleaseFence) override;
+    void reset() override;
+    void dump(String8& result) const override;
+
+    static constexpr size_t kMaxEntries = 64;
+
+private:
+    static uint64_t sceneKey(const PresentFrameFeatures& features);
+
+    static const constexpr int kAveragesBufferSize = 4;
+    struct Entry {
+        RollingAverage<kAveragesBufferSize> duration;
+        PresentFrameFeatures features;
+    };
+    // most recently used scene first
+    std::list<std::pair<uint64_t, Entry>> mEntries;
+    std::unordered_map<uint64_t, decltype(mEntries)::iterator> mIndex;
+    LayerCountDurationModel mFallback;
+    uint64_t mEvictions = 0;
+};
+
+/*
+ * Linear model of the features fitted by recursive least squares with
+ * exponential forgetting. The memory used does not depend on the number of
+ * scenes, and unseen combinations of features are extrapolated.
+ */
+class LeastSquaresDurationModel : public PresentDurationModel {
+public:
+    LeastSquaresDurationModel() { reset(); }
+
+    const char* getName() const override { return "least-squares"; }
+    std::optional<nsecs_t> predict(const PresentFrameFeatures& features) override;
+    void update(const PresentFrameFeatures& features, nsecs_t beforeReleaseFence,
+                nsecs_t afterReleaseFence) override;
+    void reset() override;
+    void dump(String8& result) const override;
+
+    static constexpr size_t kNumFeatures = 12;
+    // weight of the previous samples is divided by this at every update
+    static constexpr double kForgettingFactor = 0.98;
+    static constexpr double kInitialCovariance = 1e4;
+    // forgetting stops while the trace of the covariance is over this
+    static constexpr double kMaxCovarianceTrace = 1e6;
+
+private:
+    using Vector = std::array<double, kNumFeatures>;
+    static Vector toVector(const PresentFrameFeatures& features);
+
+    Vector mWeights;
+    std::array<Vector, kNumFeatures> mCovariance;
+    uint64_t mSamples;
+};
+
+/*
+ * Owns the model of a display and measures the accuracy of its predictions.
+ */
+class PresentDurationPredictor {
+public:
+    explicit PresentDurationPredictor(PresentDurationModel::Type type)
+          : mModel(PresentDurationModel::create(type)) {}
+
+    std::optional<nsecs_t> predict(const PresentFrameFeatures& features);
+    // Called once per presented frame with the measured durations
+    void update(const PresentFrameFeatures& features, nsecs_t beforeReleaseFence,
+                nsecs_t afterReleaseFence);
+    void reset();
+    void dump(String8& result) const;
+
+private:
+    std::unique_ptr<PresentDurationModel> mModel;
+    // latest prediction made for the frame being composed
+    std::optional<nsecs_t> mPendingPrediction;
+
+    uint64_t mFrames = 0;
+    uint64_t mPredictedFrames = 0;
+    // frames which took longer than predicted
+    uint64_t mUnderPredictedFrames = 0;
+    int64_t mTotalAbsError = 0;
+    int64_t mTotalError = 0;
+    nsecs_t mMaxAbsError = 0;
+    nsecs_t mLastError = 0;
+};
+
+#endif // _PRESENT_DURATION_MODEL_H_
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#include "ReadbackRecorder.h"
+
+#include <log/log.h>
+#include <system/thread_defs.h>
+#include <utils/Errors.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cerrno>
+
+using android::NO_ERROR;
+using android::String8;
+
+/* The thread is only started by the first recording */
+ReadbackRecorder::ReadbackRecorder(std::unique_ptr<Backend> backend)
+      : Worker("ReadbackRecorder", ANDROID_PRIORITY_BACKGROUND), mBackend(std::move(backend)) {}
+
+ReadbackRecorder::~ReadbackRecorder() {
+    Exit();
+
+    /* The displays are gone by now, none of the buffers is used any more */
+    for (auto& slot : mSlots) {
+        if (slot.fence >= 0) mBackend->closeFence(slot.fence);
+        freeBuffer(slot.buffer);
+    }
+}
+
+void ReadbackRecorder::freeBuffer(buffer_handle_t buffer) {
+    if (buffer != nullptr) mBackend->freeBuffer(buffer);
+}
+
+int32_t ReadbackRecorder::start(ExynosDisplay* display, uint32_t decimation, Callback callback) {
+    int32_t format;
+    int32_t dataspace;
+    uint32_t width;
+    uint32_t height;
+    int32_t ret;
+
+    if ((ret = mBackend->getAttributes(display, &format, &dataspace, &width, &height)) !=
+        NO_ERROR) {
+        ALOGE("%s: getReadbackBufferAttributes fail, ret(%d)", __func__, ret);
+        return ret;
+    }
+
+    InitWorker();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (mActive) {
+        if (display != mDisplay) {
+            ALOGE("%s: already recording %s", __func__, mBackend->getName(mDisplay));
+            return -EBUSY;
+        }
+        mDecimation = std::max(decimation, 1U);
+        mCallback = std::move(callback);
+        return NO_ERROR;
+    }
+
+    for (auto& slot : mSlots) {
+        if (slot.state != SlotState::FREE) {
+            ALOGE("%s: the previous recording is still being delivered", __func__);
+            return -EBUSY;
+        }
+    }
+
+    if ((format != mFormat) || (width != mWidth) || (height != mHeight)) {
+        for (auto& slot : mSlots) freeBuffer(slot.buffer);
+        mSlots.clear();
+    }
+
+    while (mSlots.size() < kRingSize) {
+        Slot slot;
+        int32_t error = mBackend->allocateBuffer(width, height, format, &slot.buffer);
+        if ((error != NO_ERROR) || (slot.buffer == nullptr)) {
+            ALOGE("%s: failed to allocate readback buffer(%dx%d): %d", __func__, width, height,
+                  error);
+            for (auto& allocated : mSlots) freeBuffer(allocated.buffer);
+            mSlots.clear();
+            return (error != NO_ERROR) ? error : -ENOMEM;
+        }
+        mSlots.push_back(slot);
+    }
+
+    mActive = true;
+    mDisplay = display;
+    mDecimation = std::max(decimation, 1U);
+    mCallback = std::move(callback);
+    mFormat = format;
+    mDataspace = dataspace;
+    mWidth = width;
+    mHeight = height;
+    mPresents = 0;
+    mBackend->setRecording(display, true);
+
+    ALOGI("%s: recording %s every %u presents, format(%d) %dx%d", __func__,
+          mBackend->getName(display), mDecimation, format, width, height);
+    return NO_ERROR;
+}
+
+void ReadbackRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!mActive) return;
+    mActive = false;
+    /* The next present detaches the writeback connector */
+    mBackend->setRecording(mDisplay, false);
+
+    /* Buffers still attached or pending are freed once they come back */
+    for (auto& slot : mSlots) {
+        if (slot.state == SlotState::FREE) releaseSlotLocked(slot);
+    }
+
+    ALOGI("%s: %u frames captured, %u skipped, %u failed", __func__, mCapturedFrames,
+          mSkippedFrames, mFailedFrames);
+}
+
+void ReadbackRecorder::releaseSlotLocked(Slot& slot) {
+    if (slot.fence >= 0) mBackend->closeFence(slot.fence);
+    slot.fence = -1;
+    slot.state = SlotState::FREE;
+
+    if (!mActive) {
+        freeBuffer(slot.buffer);
+        slot.buffer = nullptr;
+    }
+
+    if (!mActive && std::all_of(mSlots.begin(), mSlots.end(),
+                                [](const Slot& s) { return s.buffer == nullptr; })) {
+        mSlots.clear();
+        mDisplay = nullptr;
+    }
+}
+
+void ReadbackRecorder::attachBuffer(ExynosDisplay* display) {
+    Slot* target = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!mActive || (display != mDisplay) || (mAttachedSlot != nullptr)) return;
+        /* A capture of HWCService or of the framework is using the writeback this time */
+        if (mBackend->hasReadbackBuffer(display)) return;
+        if ((mPresents++ % mDecimation) != 0) return;
+
+        for (auto& slot : mSlots) {
+            if (slot.state == SlotState::FREE) {
+                target = &slot;
+                break;
+            }
+        }
+        if (target == nullptr) {
+            mSkippedFrames++;
+            return;
+        }
+
+        target->state = SlotState::ATTACHED;
+        mAttachedSlot = target;
+    }
+
+    mBackend->setReadbackBuffer(display, target->buffer);
+}
+
+bool ReadbackRecorder::onPresented(ExynosDisplay* display) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if ((mAttachedSlot == nullptr) || (display != mDisplay)) return false;
+
+    Slot& slot = *mAttachedSlot;
+    mAttachedSlot = nullptr;
+
+    int32_t fence = mBackend->getReadbackFence(display, slot.buffer);
+    if (fence < 0) {
+        /* The present did not reach the display */
+        mFailedFrames++;
+        releaseSlotLocked(slot);
+        return true;
+    }
+
+    slot.fence = fence;
+    slot.state = SlotState::PENDING;
+    slot.number = mCapturedFrames++;
+    slot.presentTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mPendingSlots.push_back(&slot - mSlots.data());
+    Signal();
+
+    return true;
+}
+
+void ReadbackRecorder::Routine() {
+    Lock();
+    if (mPendingSlots.empty() && (WaitForSignalOrExitLocked() == -EINTR)) {
+        Unlock();
+        return;
+    }
+    if (mPendingSlots.empty()) {
+        Unlock();
+        return;
+    }
+
+    size_t index = mPendingSlots.front();
+    mPendingSlots.pop_front();
+
+    Slot& slot = mSlots[index];
+    int32_t fence = slot.fence;
+    slot.fence = -1;
+    Frame frame = {slot.buffer, slot.number, slot.presentTime, mFormat, mDataspace, mWidth,
+                   mHeight};
+    Callback callback = mCallback;
+    Unlock();
+
+    ATRACE_NAME("ReadbackRecorder::deliver");
+    bool ready = mBackend->waitFence(fence, kFenceTimeoutMs);
+    if (!ready) ALOGE("%s: sync wait error, fence(%d)", __func__, fence);
+    mBackend->closeFence(fence);
+
+    if (ready) {
+        if (callback)
+            callback(frame);
+        else
+            mBackend->writeFrame(frame);
+    }
+
+    Lock();
+    if (ready)
+        mDeliveredFrames++;
+    else
+        mFailedFrames++;
+    releaseSlotLocked(mSlots[index]);
+    Unlock();
+}
+
+void ReadbackRecorder::dump(String8& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    result.appendFormat("Readback recorder: %s", mActive ? "recording" : "stopped");
+    if (mActive)
+        result.appendFormat(" %s every %u presents", mBackend->getName(mDisplay), mDecimation);
+    result.appendFormat("\n\tcaptured(%u) skipped(%u) failed(%u) delivered(%u) pending(%zu)\n",
+                        mCapturedFrames, mSkippedFrames, mFailedFrames, mDeliveredFrames,
+                        mPendingSlots.size());
+}
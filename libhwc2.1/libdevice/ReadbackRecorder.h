@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _READBACK_RECORDER_H_
+#define _READBACK_RECORDER_H_
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <cutils/native_handle.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "worker.h"
+
+class ExynosDisplay;
+
+/*
+ * Continuous writeback capture of the frames presented on a display.
+ *
+ * A ring of kRingSize readback buffers is allocated when the recording starts. Every
+ * decimation-th present takes a free buffer of the ring as its readback buffer. Once presented,
+ * the buffer and its writeback fence are queued to the worker thread, which waits for the fence
+ * and hands the buffer to the callback, or writes it to WRITEBACK_CAPTURE_PATH without a callback.
+ * The buffer returns to the ring afterwards. Presents that find no free buffer are not captured,
+ * so a slow consumer never stalls the composer.
+ *
+ * The writeback connector stays attached to the crtc while recording, only the first capture and
+ * the first present after stop() are modesets.
+ */
+class ReadbackRecorder : public android::Worker {
+public:
+    struct Frame {
+        buffer_handle_t buffer;
+        uint32_t number;
+        nsecs_t presentTime;
+        int32_t format;
+        int32_t dataspace;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /* Called on the worker thread, the buffer is only valid during the call */
+    using Callback = std::function<void(const Frame& frame)>;
+
+    static constexpr size_t kRingSize = 4;
+    static constexpr int kFenceTimeoutMs = 1000;
+
+    /* The display, the buffers and the fences, ExynosDisplay is only used through it */
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+        virtual int32_t getAttributes(ExynosDisplay* display, int32_t* format,
+                                      int32_t* dataspace, uint32_t* width, uint32_t* height) = 0;
+        virtual const char* getName(ExynosDisplay* display) = 0;
+        /* True if the next present already has a readback buffer */
+        virtual bool hasReadbackBuffer(ExynosDisplay* display) = 0;
+        virtual void setReadbackBuffer(ExynosDisplay* display, buffer_handle_t buffer) = 0;
+        /* The writeback fence of the buffer, -1 if the present did not write it */
+        virtual int32_t getReadbackFence(ExynosDisplay* display, buffer_handle_t buffer) = 0;
+        virtual void setRecording(ExynosDisplay* display, bool recording) = 0;
+        virtual int32_t allocateBuffer(uint32_t width, uint32_t height, int32_t format,
+                                       buffer_handle_t* outBuffer) = 0;
+        virtual void freeBuffer(buffer_handle_t buffer) = 0;
+        virtual bool waitFence(int32_t fence, int timeoutMs) = 0;
+        virtual void closeFence(int32_t fence) = 0;
+        virtual void writeFrame(const Frame& frame) = 0;
+    };
+
+    /* With the backend of the composer, see ReadbackRecorderBackend.cpp */
+    ReadbackRecorder();
+    explicit ReadbackRecorder(std::unique_ptr<Backend> backend);
+    ~ReadbackRecorder();
+
+    int32_t start(ExynosDisplay* display, uint32_t decimation, Callback callback);
+    void stop();
+
+    /* Present path of the display, with its display mutex held */
+    void attachBuffer(ExynosDisplay* display);
+    /* Returns true if the readback of the present was the recorder's */
+    bool onPresented(ExynosDisplay* display);
+
+    void dump(android::String8& result);
+
+protected:
+    void Routine() override;
+
+private:
+    enum class SlotState {
+        FREE,
+        ATTACHED,
+        PENDING,
+    };
+
+    struct Slot {
+        buffer_handle_t buffer = nullptr;
+        SlotState state = SlotState::FREE;
+        int32_t fence = -1;
+        uint32_t number = 0;
+        nsecs_t presentTime = 0;
+    };
+
+    void releaseSlotLocked(Slot& slot) REQUIRES(mutex_);
+    void freeBuffer(buffer_handle_t buffer);
+
+    const std::unique_ptr<Backend> mBackend;
+
+    std::vector<Slot> mSlots GUARDED_BY(mutex_);
+    std::deque<size_t> mPendingSlots GUARDED_BY(mutex_);
+    Slot* mAttachedSlot GUARDED_BY(mutex_) = nullptr;
+
+    bool mActive GUARDED_BY(mutex_) = false;
+    ExynosDisplay* mDisplay GUARDED_BY(mutex_) = nullptr;
+    uint32_t mDecimation GUARDED_BY(mutex_) = 1;
+    Callback mCallback GUARDED_BY(mutex_);
+    int32_t mFormat GUARDED_BY(mutex_) = 0;
+    int32_t mDataspace GUARDED_BY(mutex_) = 0;
+    uint32_t mWidth GUARDED_BY(mutex_) = 0;
+    uint32_t mHeight GUARDED_BY(mutex_) = 0;
+
+    uint32_t mPresents GUARDED_BY(mutex_) = 0;
+    uint32_t mCapturedFrames GUARDED_BY(mutex_) = 0;
+    uint32_t mSkippedFrames GUARDED_BY(mutex_) = 0;
+    uint32_t mFailedFrames GUARDED_BY(mutex_) = 0;
+    uint32_t mDeliveredFrames GUARDED_BY(mutex_) = 0;
+};
+
+#endif // _READBACK_RECORDER_H_
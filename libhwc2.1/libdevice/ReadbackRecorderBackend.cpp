@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sync/sync.h>
+
+#include <cinttypes>
+
+#include "ExynosDevice.h"
+#include "ExynosDisplay.h"
+#include "ReadbackRecorder.h"
+#include "VendorGraphicBuffer.h"
+
+using namespace vendor::graphics;
+
+namespace {
+
+/* The readback path of ExynosDisplay and the gralloc buffers of the composer */
+class ComposerBackend : public ReadbackRecorder::Backend {
+public:
+    int32_t getAttributes(ExynosDisplay* display, int32_t* format, int32_t* dataspace,
+                          uint32_t* width, uint32_t* height) override {
+        int32_t ret = display->getReadbackBufferAttributes(format, dataspace);
+        *width = display->mXres;
+        *height = display->mYres;
+        return ret;
+    }
+
+    const char* getName(ExynosDisplay* display) override {
+        return display->mDisplayName.c_str();
+    }
+
+    bool hasReadbackBuffer(ExynosDisplay* display) override {
+        return display->mDpuData.enable_readback;
+    }
+
+    void setReadbackBuffer(ExynosDisplay* display, buffer_handle_t buffer) override {
+        display->setReadbackBufferInternal(buffer, -1, true);
+        display->mDpuData.enable_readback = true;
+    }
+
+    int32_t getReadbackFence(ExynosDisplay* display, buffer_handle_t buffer) override {
+        int32_t fence = -1;
+        if ((display->mDpuData.readback_info.handle != buffer) ||
+            (display->getReadbackBufferFence(&fence) != NO_ERROR))
+            return -1;
+        return fence;
+    }
+
+    void setRecording(ExynosDisplay* display, bool recording) override {
+        display->mDpuData.readback_recording = recording;
+    }
+
+    int32_t allocateBuffer(uint32_t width, uint32_t height, int32_t format,
+                           buffer_handle_t* outBuffer) override {
+        uint64_t usage = static_cast<uint64_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
+                                               GRALLOC1_CONSUMER_USAGE_CPU_READ_OFTEN);
+        uint32_t stride = 0;
+        return static_cast<int32_t>(
+                VendorGraphicBufferAllocator::get().allocate(width, height, format, 1, usage,
+                                                             outBuffer, &stride, "HWC"));
+    }
+
+    void freeBuffer(buffer_handle_t buffer) override {
+        VendorGraphicBufferMapper::get().freeBuffer(buffer);
+    }
+
+    bool waitFence(int32_t fence, int timeoutMs) override {
+        return sync_wait(fence, timeoutMs) >= 0;
+    }
+
+    void closeFence(int32_t fence) override { hwcFdClose(fence); }
+
+    void writeFrame(const ReadbackRecorder::Frame& frame) override {
+        String8 fileName;
+        fileName.appendFormat("readback_%05u_%" PRId64 "_format%d_%dx%d.raw", frame.number,
+                              ns2ms(frame.presentTime), frame.format, frame.width, frame.height);
+        ExynosDevice::captureReadbackClass::saveToFile(frame.buffer, fileName);
+    }
+};
+
+} // namespace
+
+ReadbackRecorder::ReadbackRecorder() : ReadbackRecorder(std::make_unique<ComposerBackend>()) {}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../CompositionTrace.h"
+
+class CompositionTraceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/composition_traceXXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        mPath = path;
+    }
+
+    void TearDown() override { unlink(mPath.c_str()); }
+
+    void write(const void* data, size_t size) {
+        FILE* file = fopen(mPath.c_str(), "ab");
+        ASSERT_NE(nullptr, file);
+        EXPECT_EQ(size, fwrite(data, 1, size, file));
+        fclose(file);
+    }
+
+    void write(const std::vector<uint8_t>& record) { write(record.data(), record.size()); }
+
+    // Records a presented frame of layerCount layers, validated if validateDuration >= 0
+    const std::vector<uint8_t>& recordFrame(size_t layerCount, int64_t start,
+                                            int64_t validateDuration, int64_t presentDuration) {
+        if (validateDuration >= 0) {
+            mRecorder.beginStage(COMPOSITION_TRACE_VALIDATE, start);
+            mRecorder.endStage(COMPOSITION_TRACE_VALIDATE, start + validateDuration);
+            mRecorder.setGeometryChanged(0x10);
+            start += validateDuration;
+        }
+        mRecorder.beginStage(COMPOSITION_TRACE_PRESENT, start);
+        mRecorder.endStage(COMPOSITION_TRACE_PRESENT, start + presentDuration);
+
+        CompositionTraceFrame& frame = mRecorder.beginFrame(kDisplayId, start);
+        frame.vsyncPeriod = 16666666;
+        frame.clientFirstIndex = -1;
+        frame.clientLastIndex = -1;
+        for (size_t i = 0; i < layerCount; i++) mRecorder.addLayer(layer(i));
+        return mRecorder.endFrame();
+    }
+
+    static CompositionTraceLayer layer(size_t index) {
+        CompositionTraceLayer layer = {};
+        layer.bufferId = 100 + index;
+        layer.validateCompositionType = 2;
+        layer.bufferWidth = 1080;
+        layer.bufferHeight = 2400;
+        layer.sourceCrop[2] = 1080.0f;
+        layer.sourceCrop[3] = 2400.0f;
+        layer.zOrder = index;
+        layer.otfMppType = -1;
+        layer.m2mMppType = -1;
+        layer.hasBuffer = 1;
+        return layer;
+    }
+
+    static constexpr uint32_t kDisplayId = 3;
+
+    std::string mPath;
+    CompositionTraceRecorder mRecorder;
+};
+
+TEST_F(CompositionTraceTest, RoundTrip) {
+    mRecorder.setEnabled(true);
+    write(recordFrame(2, 1000000, 300000, 500000));
+    write(recordFrame(0, 2000000, -1, 200000));
+    write(recordFrame(3, 3000000, 400000, 600000));
+
+    std::vector<CompositionTraceRecord> frames;
+    ASSERT_TRUE(readCompositionTrace(mPath, &frames));
+    ASSERT_EQ(3u, frames.size());
+
+    const CompositionTraceFrame& first = frames[0].frame;
+    EXPECT_EQ(kCompositionTraceMagic, first.magic);
+    EXPECT_EQ(kCompositionTraceVersion, first.version);
+    EXPECT_EQ(kDisplayId, first.displayId);
+    EXPECT_EQ(0u, first.frameNumber);
+    EXPECT_EQ(1300000, first.timestamp);
+    EXPECT_EQ(300000, first.stageDuration[COMPOSITION_TRACE_VALIDATE]);
+    EXPECT_EQ(-1, first.stageDuration[COMPOSITION_TRACE_ASSIGN_RESOURCE]);
+    EXPECT_EQ(500000, first.stageDuration[COMPOSITION_TRACE_PRESENT]);
+    EXPECT_EQ(0x10u, first.geometryChanged);
+    EXPECT_EQ(16666666, first.vsyncPeriod);
+    ASSERT_EQ(2u, frames[0].layers.size());
+    for (size_t i = 0; i < frames[0].layers.size(); i++) {
+        CompositionTraceLayer expected = layer(i);
+        EXPECT_EQ(0, memcmp(&frames[0].layers[i], &expected, sizeof(expected)));
+    }
+
+    // A frame presented without validation
+    EXPECT_EQ(1u, frames[1].frame.frameNumber);
+    EXPECT_EQ(-1, frames[1].frame.stageDuration[COMPOSITION_TRACE_VALIDATE]);
+    EXPECT_EQ(200000, frames[1].frame.stageDuration[COMPOSITION_TRACE_PRESENT]);
+    EXPECT_EQ(0u, frames[1].frame.geometryChanged);
+    EXPECT_TRUE(frames[1].layers.empty());
+
+    EXPECT_EQ(3u, frames[2].layers.size());
+    EXPECT_EQ(102u, frames[2].layers[2].bufferId);
+
+    std::string dump;
+    mRecorder.dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("frames 3"));
+}
+
+TEST_F(CompositionTraceTest, SkipsFieldsOfNewerVersions) {
+    const size_t kExtraHeader = 8;
+    const size_t kExtraLayer = 4;
+    CompositionTraceFrame frame = {};
+    frame.magic = kCompositionTraceMagic;
+    frame.version = kCompositionTraceVersion + 1;
+    frame.headerSize = sizeof(CompositionTraceFrame) + kExtraHeader;
+    frame.layerSize = sizeof(CompositionTraceLayer) + kExtraLayer;
+    frame.layerCount = 2;
+    frame.frameNumber = 7;
+
+    std::vector<uint8_t> record(frame.headerSize + frame.layerSize * frame.layerCount, 0xff);
+    memcpy(record.data(), &frame, sizeof(frame));
+    for (size_t i = 0; i < frame.layerCount; i++) {
+        CompositionTraceLayer known = layer(i);
+        memcpy(record.data() + frame.headerSize + i * frame.layerSize, &known, sizeof(known));
+    }
+    write(record);
+    mRecorder.setEnabled(true);
+    write(recordFrame(1, 1000000, -1, 100000));
+
+    std::vector<CompositionTraceRecord> frames;
+    ASSERT_TRUE(readCompositionTrace(mPath, &frames));
+    ASSERT_EQ(2u, frames.size());
+    EXPECT_EQ(7u, frames[0].frame.frameNumber);
+    ASSERT_EQ(2u, frames[0].layers.size());
+    EXPECT_EQ(101u, frames[0].layers[1].bufferId);
+    EXPECT_EQ(1u, frames[0].layers[1].zOrder);
+    EXPECT_EQ(100000, frames[1].frame.stageDuration[COMPOSITION_TRACE_PRESENT]);
+}
+
+TEST_F(CompositionTraceTest, DropsTruncatedFrame) {
+    mRecorder.setEnabled(true);
+    write(recordFrame(1, 1000000, -1, 100000));
+    const std::vector<uint8_t>& last = recordFrame(2, 2000000, -1, 100000);
+    write(last.data(), last.size() - 1);
+
+    std::vector<CompositionTraceRecord> frames;
+    ASSERT_TRUE(readCompositionTrace(mPath, &frames));
+    EXPECT_EQ(1u, frames.size());
+}
+
+TEST_F(CompositionTraceTest, RejectsOtherFiles) {
+    std::vector<CompositionTraceRecord> frames;
+    EXPECT_FALSE(readCompositionTrace(mPath + ".missing", &frames));
+
+    std::vector<uint8_t> garbage(sizeof(CompositionTraceFrame) * 2, 0x5a);
+    write(garbage);
+    EXPECT_FALSE(readCompositionTrace(mPath, &frames));
+    EXPECT_TRUE(frames.empty());
+}
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../ReadbackRecorder.h"
+
+using namespace std::chrono_literals;
+
+/*
+ * The recorder only passes the display to its backend, the one of the test is this stub. Its
+ * readback is what the present path of ExynosDisplay leaves for signalReadbackDone().
+ */
+class ExynosDisplay {
+public:
+    explicit ExynosDisplay(const char* name) : mName(name) {}
+
+    std::string mName;
+    bool mEnableReadback = false;
+    buffer_handle_t mReadbackBuffer = nullptr;
+    int32_t mReadbackFence = -1;
+    bool mRecording = false;
+};
+
+namespace {
+
+// The buffers and fences not released yet, they outlive the recorder and its backend
+struct Resources {
+    std::mutex mutex;
+    std::set<buffer_handle_t> buffers;
+    std::set<int32_t> fences;
+};
+
+/*
+ * Buffers are empty native handles. A writeback fence is the read end of a pipe, it is
+ * signalled by a write to the other end, which the test keeps.
+ */
+class FakeBackend : public ReadbackRecorder::Backend {
+public:
+    explicit FakeBackend(Resources& resources) : mResources(resources) {}
+
+    int32_t getAttributes(ExynosDisplay*, int32_t* format, int32_t* dataspace, uint32_t* width,
+                          uint32_t* height) override {
+        *format = 1;
+        *dataspace = 0;
+        *width = 64;
+        *height = 32;
+        return mAttributesError;
+    }
+
+    const char* getName(ExynosDisplay* display) override { return display->mName.c_str(); }
+
+    bool hasReadbackBuffer(ExynosDisplay* display) override { return display->mEnableReadback; }
+
+    void setReadbackBuffer(ExynosDisplay* display, buffer_handle_t buffer) override {
+        display->mReadbackBuffer = buffer;
+        display->mEnableReadback = true;
+    }
+
+    int32_t getReadbackFence(ExynosDisplay* display, buffer_handle_t buffer) override {
+        if (display->mReadbackBuffer != buffer) return -1;
+        int32_t fence = display->mReadbackFence;
+        display->mReadbackFence = -1;
+        return fence;
+    }
+
+    void setRecording(ExynosDisplay* display, bool recording) override {
+        display->mRecording = recording;
+    }
+
+    int32_t allocateBuffer(uint32_t, uint32_t, int32_t, buffer_handle_t* outBuffer) override {
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        if (mResources.buffers.size() >= mMaxBuffers) return -ENOMEM;
+        *outBuffer = native_handle_create(0, 0);
+        mResources.buffers.insert(*outBuffer);
+        mAllocations++;
+        return 0;
+    }
+
+    void freeBuffer(buffer_handle_t buffer) override {
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        EXPECT_EQ(1u, mResources.buffers.erase(buffer));
+        native_handle_delete(const_cast<native_handle_t*>(buffer));
+    }
+
+    bool waitFence(int32_t fence, int timeoutMs) override {
+        struct pollfd pfd = {fence, POLLIN, 0};
+        return (poll(&pfd, 1, timeoutMs) == 1) && (pfd.revents & POLLIN);
+    }
+
+    void closeFence(int32_t fence) override {
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        EXPECT_EQ(1u, mResources.fences.erase(fence));
+        close(fence);
+    }
+
+    void writeFrame(const ReadbackRecorder::Frame&) override {
+        mWrittenFrames++;
+    }
+
+    // Returns the end of the fence that signals it
+    int newFence(int32_t* fence) {
+        int fds[2];
+        if (pipe(fds) != 0) return -1;
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        mResources.fences.insert(fds[0]);
+        *fence = fds[0];
+        return fds[1];
+    }
+
+    int32_t mAttributesError = 0;
+    size_t mMaxBuffers = SIZE_MAX;
+    size_t mAllocations = 0;
+    std::atomic<size_t> mWrittenFrames = 0;
+
+private:
+    Resources& mResources;
+};
+
+class ReadbackRecorderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // A fence that is never signalled is closed at its write end
+        signal(SIGPIPE, SIG_IGN);
+        auto backend = std::make_unique<FakeBackend>(mResources);
+        mBackend = backend.get();
+        mRecorder = std::make_unique<ReadbackRecorder>(std::move(backend));
+    }
+
+    void TearDown() override {
+        mRecorder.reset();
+        for (int fd : mSignals) close(fd);
+    }
+
+    /*
+     * One present of the display: the readback buffer is taken before the commit, the commit
+     * writes it unless failed, and the post processing hands it back.
+     */
+    bool present(ExynosDisplay& display, bool fail = false) {
+        mRecorder->attachBuffer(&display);
+        if (!display.mEnableReadback) return false;
+
+        if (!fail) mSignals.push_back(mBackend->newFence(&display.mReadbackFence));
+        bool recorders = mRecorder->onPresented(&display);
+        display.mEnableReadback = false;
+        return recorders;
+    }
+
+    // Signals the fences of the captured presents in order
+    void signalFences(size_t count = SIZE_MAX) {
+        for (size_t i = 0; (i < count) && (mSignaled < mSignals.size()); i++)
+            EXPECT_EQ(1, write(mSignals[mSignaled++], "s", 1));
+    }
+
+    ReadbackRecorder::Callback callback() {
+        return [this](const ReadbackRecorder::Frame& frame) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            EXPECT_NE(nullptr, frame.buffer);
+            EXPECT_EQ(64u, frame.width);
+            EXPECT_EQ(32u, frame.height);
+            mFrames.push_back(frame.number);
+            mFrameBuffers.push_back(frame.buffer);
+        };
+    }
+
+    std::vector<uint32_t> frames() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFrames;
+    }
+
+    size_t buffers() {
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        return mResources.buffers.size();
+    }
+
+    size_t fences() {
+        std::lock_guard<std::mutex> lock(mResources.mutex);
+        return mResources.fences.size();
+    }
+
+    std::string dump() {
+        android::String8 result;
+        mRecorder->dump(result);
+        return result.c_str();
+    }
+
+    template <typename Predicate>
+    static bool waitUntil(Predicate predicate) {
+        for (auto end = std::chrono::steady_clock::now() + 5s;
+             std::chrono::steady_clock::now() < end; std::this_thread::sleep_for(1ms)) {
+            if (predicate()) return true;
+        }
+        return predicate();
+    }
+
+    // The delivered and failed frames are counted after the callback
+    bool waitForStats(const std::string& stats) {
+        return waitUntil([&] { return dump().find(stats) != std::string::npos; });
+    }
+
+    ExynosDisplay mDisplay{"primary"};
+    Resources mResources;
+    FakeBackend* mBackend;
+    std::unique_ptr<ReadbackRecorder> mRecorder;
+    std::vector<int> mSignals;
+    size_t mSignaled = 0;
+
+    std::mutex mMutex;
+    std::vector<uint32_t> mFrames;
+    std::vector<buffer_handle_t> mFrameBuffers;
+};
+
+TEST_F(ReadbackRecorderTest, Decimation) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 3, callback()));
+    EXPECT_TRUE(mDisplay.mRecording);
+    EXPECT_EQ(ReadbackRecorder::kRingSize, buffers());
+
+    std::vector<bool> captured;
+    for (int i = 0; i < 9; i++) captured.push_back(present(mDisplay));
+    EXPECT_EQ(std::vector<bool>({true, false, false, true, false, false, true, false, false}),
+              captured);
+
+    signalFences();
+    ASSERT_TRUE(waitForStats("captured(3) skipped(0) failed(0) delivered(3) pending(0)"))
+            << dump();
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2}), frames());
+    EXPECT_EQ(0u, fences());
+
+    // A running recording only takes the new decimation and callback
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 0, nullptr));
+    EXPECT_EQ(ReadbackRecorder::kRingSize, mBackend->mAllocations);
+    EXPECT_TRUE(present(mDisplay));
+    EXPECT_TRUE(present(mDisplay));
+    signalFences();
+    ASSERT_TRUE(waitForStats("delivered(5)")) << dump();
+    EXPECT_EQ(2u, mBackend->mWrittenFrames);
+    EXPECT_EQ(3u, frames().size());
+
+    mRecorder->stop();
+    EXPECT_FALSE(mDisplay.mRecording);
+    EXPECT_EQ(0u, buffers());
+}
+
+TEST_F(ReadbackRecorderTest, RingOfBuffers) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+
+    // The fences are not signalled, the whole ring is waiting for the writeback
+    for (size_t i = 0; i < ReadbackRecorder::kRingSize; i++) EXPECT_TRUE(present(mDisplay));
+    EXPECT_FALSE(present(mDisplay));
+    EXPECT_FALSE(present(mDisplay));
+    EXPECT_NE(std::string::npos, dump().find("captured(4) skipped(2)")) << dump();
+
+    // The first buffer back in the ring is taken by the next present
+    signalFences(1);
+    ASSERT_TRUE(waitForStats("delivered(1)")) << dump();
+    EXPECT_TRUE(present(mDisplay));
+    EXPECT_FALSE(present(mDisplay));
+
+    signalFences();
+    ASSERT_TRUE(waitForStats("captured(5) skipped(3) failed(0) delivered(5) pending(0)"))
+            << dump();
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 3, 4}), frames());
+    std::set<buffer_handle_t> buffers(mFrameBuffers.begin(), mFrameBuffers.end());
+    EXPECT_EQ(ReadbackRecorder::kRingSize, buffers.size());
+    EXPECT_EQ(mFrameBuffers[0], mFrameBuffers[4]);
+    EXPECT_EQ(ReadbackRecorder::kRingSize, mBackend->mAllocations);
+}
+
+TEST_F(ReadbackRecorderTest, FailedPresentReleasesTheBuffer) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+
+    // The commit did not write the buffer, it is back in the ring at once
+    for (size_t i = 0; i < ReadbackRecorder::kRingSize + 1; i++)
+        EXPECT_TRUE(present(mDisplay, true));
+    EXPECT_NE(std::string::npos, dump().find("captured(0) skipped(0) failed(5) delivered(0)"))
+            << dump();
+
+    EXPECT_TRUE(present(mDisplay));
+    signalFences();
+    ASSERT_TRUE(waitForStats("captured(1) skipped(0) failed(5) delivered(1) pending(0)"))
+            << dump();
+    EXPECT_EQ(std::vector<uint32_t>({0}), frames());
+}
+
+TEST_F(ReadbackRecorderTest, FenceTimeout) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_TRUE(present(mDisplay));
+    EXPECT_TRUE(present(mDisplay));
+
+    // Only the second writeback completes, the first buffer is dropped after the timeout
+    EXPECT_EQ(1, write(mSignals[1], "s", 1));
+    ASSERT_TRUE(waitForStats("captured(2) skipped(0) failed(1) delivered(1) pending(0)"))
+            << dump();
+    EXPECT_EQ(std::vector<uint32_t>({1}), frames());
+    EXPECT_EQ(0u, fences());
+}
+
+TEST_F(ReadbackRecorderTest, StopWhilePending) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_TRUE(present(mDisplay));
+    EXPECT_TRUE(present(mDisplay));
+
+    // A present in flight when the recording stops
+    mRecorder->attachBuffer(&mDisplay);
+    ASSERT_TRUE(mDisplay.mEnableReadback);
+    mRecorder->stop();
+    EXPECT_FALSE(mDisplay.mRecording);
+
+    // Only the free buffer is gone, a new recording waits for the others
+    EXPECT_EQ(3u, buffers());
+    EXPECT_EQ(-EBUSY, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_FALSE(mDisplay.mRecording);
+
+    mSignals.push_back(mBackend->newFence(&mDisplay.mReadbackFence));
+    EXPECT_TRUE(mRecorder->onPresented(&mDisplay));
+    mDisplay.mEnableReadback = false;
+    EXPECT_FALSE(present(mDisplay));
+
+    // The frames captured before stop are still delivered
+    signalFences();
+    ASSERT_TRUE(waitForStats("stopped\n\tcaptured(3) skipped(0) failed(0) delivered(3)"))
+            << dump();
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2}), frames());
+    ASSERT_TRUE(waitUntil([&] { return buffers() == 0; }));
+    EXPECT_EQ(0u, fences());
+
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_TRUE(mDisplay.mRecording);
+    EXPECT_EQ(2 * ReadbackRecorder::kRingSize, mBackend->mAllocations);
+}
+
+TEST_F(ReadbackRecorderTest, DestroyedWhilePending) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_TRUE(present(mDisplay));
+    EXPECT_TRUE(present(mDisplay));
+
+    // The worker waits for the first fence until the recorder is gone
+    mRecorder.reset();
+    EXPECT_EQ(0u, buffers());
+    EXPECT_EQ(0u, fences());
+}
+
+TEST_F(ReadbackRecorderTest, OtherReadbackOfThePresent) {
+    ASSERT_EQ(0, mRecorder->start(&mDisplay, 1, callback()));
+
+    // A capture of HWCService set its own buffer, the present is not the recorder's
+    buffer_handle_t serviceBuffer = reinterpret_cast<buffer_handle_t>(0x1);
+    mDisplay.mEnableReadback = true;
+    mDisplay.mReadbackBuffer = serviceBuffer;
+    mRecorder->attachBuffer(&mDisplay);
+    EXPECT_EQ(serviceBuffer, mDisplay.mReadbackBuffer);
+    EXPECT_FALSE(mRecorder->onPresented(&mDisplay));
+    mDisplay.mEnableReadback = false;
+
+    // Nor are presents of other displays
+    ExynosDisplay external("external");
+    EXPECT_FALSE(present(external));
+    EXPECT_FALSE(mRecorder->onPresented(&external));
+    EXPECT_EQ(-EBUSY, mRecorder->start(&external, 1, callback()));
+    EXPECT_FALSE(external.mRecording);
+
+    EXPECT_TRUE(present(mDisplay));
+    signalFences();
+    ASSERT_TRUE(waitForStats("captured(1) skipped(0) failed(0) delivered(1)")) << dump();
+}
+
+TEST_F(ReadbackRecorderTest, StartFailures) {
+    mBackend->mAttributesError = -EINVAL;
+    EXPECT_EQ(-EINVAL, mRecorder->start(&mDisplay, 1, callback()));
+
+    // A ring that cannot be allocated in full is not kept
+    mBackend->mAttributesError = 0;
+    mBackend->mMaxBuffers = ReadbackRecorder::kRingSize - 1;
+    EXPECT_EQ(-ENOMEM, mRecorder->start(&mDisplay, 1, callback()));
+    EXPECT_EQ(0u, buffers());
+    EXPECT_FALSE(mDisplay.mRecording);
+    EXPECT_FALSE(present(mDisplay));
+}
+
+} // namespace
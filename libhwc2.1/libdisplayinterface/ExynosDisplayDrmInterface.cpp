@@ -1999,31 +1999,39 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData()
     funcReturnCallback retCallback([&]() {
         if ((ret == NO_ERROR) && !drmReq.getError()) {
             mFBManager.flip(hasSecureBuffer);
-        } else if (ret == -ENOMEM) {
-            ALOGW("OOM, release all cached buffers by FBManager");
-            mFBManager.releaseAll();
+        } else {
+            /* The next readback sets the crtc of the writeback connector again */
+            mReadbackInfo.mCrtcAttached = false;
+            if (ret == -ENOMEM) {
+                ALOGW("OOM, release all cached buffers by FBManager");
+                mFBManager.releaseAll();
+            }
         }
     });
 
     mFBManager.checkShrink();
 
+    /*
+     * Attaching the writeback connector to the crtc and detaching it are modesets. While a
+     * recording is running the connector stays attached between its captures, the frames in
+     * between have no writeback job and are not written.
+     */
     bool needModesetForReadback = false;
     if (mExynosDisplay->mDpuData.enable_readback) {
+        needModesetForReadback = !mReadbackInfo.mCrtcAttached;
         if ((ret = setupWritebackCommit(drmReq)) < 0) {
             HWC_LOGE(mExynosDisplay, "%s:: Failed to setup writeback commit ret(%d)",
                     __func__, ret);
             return ret;
         }
-        needModesetForReadback = true;
-    } else {
-        if (mReadbackInfo.mNeedClearReadbackCommit) {
-            if ((ret = clearWritebackCommit(drmReq)) < 0) {
-                HWC_LOGE(mExynosDisplay, "%s: Failed to clear writeback commit ret(%d)",
-                         __func__, ret);
-                return ret;
-            }
-            needModesetForReadback = true;
+    } else if (mReadbackInfo.mNeedClearReadbackCommit &&
+               !mExynosDisplay->mDpuData.readback_recording) {
+        if ((ret = clearWritebackCommit(drmReq)) < 0) {
+            HWC_LOGE(mExynosDisplay, "%s: Failed to clear writeback commit ret(%d)",
+                     __func__, ret);
+            return ret;
         }
+        needModesetForReadback = true;
     }
 
     uint64_t mipi_sync_type = 0;
@@ -2708,10 +2716,13 @@ int32_t ExynosDisplayDrmInterface::setupWritebackCommit(DrmModeAtomicReq &drmReq
             (uint64_t)& mExynosDisplay->mDpuData.readback_info.acq_fence)) < 0)
         return ret;
 
-    if ((ret = drmReq.atomicAddProperty(writeback_conn->id(),
-            writeback_conn->crtc_id_property(),
-            mDrmCrtc->id())) < 0)
-        return ret;
+    if (!mReadbackInfo.mCrtcAttached) {
+        if ((ret = drmReq.atomicAddProperty(writeback_conn->id(),
+                writeback_conn->crtc_id_property(),
+                mDrmCrtc->id())) < 0)
+            return ret;
+        mReadbackInfo.mCrtcAttached = true;
+    }
 
     mReadbackInfo.setFbId(writeback_fb_id);
     mReadbackInfo.mNeedClearReadbackCommit = true;
@@ -2741,6 +2752,7 @@ int32_t ExynosDisplayDrmInterface::clearWritebackCommit(DrmModeAtomicReq &drmReq
         return ret;
 
     mReadbackInfo.mNeedClearReadbackCommit = false;
+    mReadbackInfo.mCrtcAttached = false;
     return NO_ERROR;
 }
 
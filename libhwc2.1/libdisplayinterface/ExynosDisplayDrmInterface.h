@@ -606,6 +606,8 @@ class ExynosDisplayDrmInterface :
                     HAL_PIXEL_FORMAT_RGBA_8888;
                 uint32_t mReadbackFormat = HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED;
                 bool mNeedClearReadbackCommit = false;
+                /* CRTC_ID of the writeback connector is set by a commit not cleared since */
+                bool mCrtcAttached = false;
             private:
                 DrmDevice *mDrmDevice = NULL;
                 DrmConnector *mWritebackConnector = NULL;
@@ -29,6 +29,8 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <cinttypes>
+#include <cstring>
+#include <string_view>
 
 #include <cutils/properties.h>
 #include <log/log.h>
@@ -423,7 +425,29 @@ int DrmDevice::AttachWriteback(DrmConnector *display_conn) {
   return -EINVAL;
 }
 
+size_t DrmDevice::HashBlob(const void *data, size_t length) {
+  return std::hash<std::string_view>{}(
+      std::string_view(static_cast<const char *>(data), length));
+}
+
 int DrmDevice::CreatePropertyBlob(const void *data, size_t length, uint32_t *blob_id) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  size_t hash = blob_hash_(data, length);
+
+  std::lock_guard<std::mutex> lock(blobs_lock_);
+
+  auto range = blob_ids_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    PropertyBlob &blob = blobs_.at(it->second);
+    if ((blob.data.size() != length) || memcmp(blob.data.data(), data, length))
+      continue;
+
+    if (blob.refs++ == 0)
+      unused_blobs_.erase(blob.unused);
+    *blob_id = it->second;
+    return 0;
+  }
+
   struct drm_mode_create_blob create_blob;
   memset(&create_blob, 0, sizeof(create_blob));
   create_blob.length = length;
@@ -435,6 +459,9 @@ int DrmDevice::CreatePropertyBlob(const void *data, size_t length, uint32_t *blo
     return ret;
   }
   *blob_id = create_blob.blob_id;
+
+  blobs_[create_blob.blob_id] = {std::vector<uint8_t>(bytes, bytes + length), hash, 1, {}};
+  blob_ids_.emplace(hash, create_blob.blob_id);
   return 0;
 }
 
@@ -442,6 +469,45 @@ int DrmDevice::DestroyPropertyBlob(uint32_t blob_id) {
   if (!blob_id)
     return 0;
 
+  std::lock_guard<std::mutex> lock(blobs_lock_);
+
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end())
+    return DestroyKernelBlob(blob_id);
+
+  PropertyBlob &blob = it->second;
+  if (blob.refs == 0) {
+    ALOGE("Property blob %" PRIu32 " is destroyed more than created", blob_id);
+    return -EINVAL;
+  }
+
+  // the kernel blob is kept for a while, the same payload tends to come back
+  if (--blob.refs == 0) {
+    blob.unused = unused_blobs_.insert(unused_blobs_.end(), blob_id);
+    EvictUnusedBlobs(kMaxUnusedBlobs);
+  }
+  return 0;
+}
+
+void DrmDevice::EvictUnusedBlobs(size_t max_unused) {
+  while (unused_blobs_.size() > max_unused) {
+    uint32_t blob_id = unused_blobs_.front();
+    unused_blobs_.pop_front();
+
+    auto range = blob_ids_.equal_range(blobs_.at(blob_id).hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == blob_id) {
+        blob_ids_.erase(it);
+        break;
+      }
+    }
+    blobs_.erase(blob_id);
+
+    DestroyKernelBlob(blob_id);
+  }
+}
+
+int DrmDevice::DestroyKernelBlob(uint32_t blob_id) {
   struct drm_mode_destroy_blob destroy_blob;
   memset(&destroy_blob, 0, sizeof(destroy_blob));
   destroy_blob.blob_id = (__u32)blob_id;
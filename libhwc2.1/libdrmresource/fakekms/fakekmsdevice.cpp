@@ -0,0 +1,1482 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "fakekms"
+
+#include "fakekmsdevice.h"
+
+#include <drm_fourcc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace android {
+
+namespace {
+
+/* ABI of the sw_sync debugfs interface */
+struct sw_sync_create_fence_data {
+  __u32 value;
+  char name[32];
+  __s32 fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE \
+  _IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, __u32)
+
+const char *const kSwSyncPaths[] = {"/sys/kernel/debug/sync/sw_sync",
+                                    "/dev/sw_sync"};
+
+/*
+ * DrmEventListener reads the device with a buffer of this size. Events are
+ * written in batches which fit in it, and only once the previous batch has
+ * been read, so that no event is split between two reads.
+ */
+constexpr size_t kEventReadSize = 1024;
+
+constexpr int64_t kNsPerSec = 1000000000LL;
+constexpr auto kVblankTimeout = std::chrono::seconds(3);
+
+const std::vector<uint32_t> kPlaneFormats = {
+    DRM_FORMAT_ARGB8888,    DRM_FORMAT_ABGR8888,    DRM_FORMAT_XRGB8888,
+    DRM_FORMAT_XBGR8888,    DRM_FORMAT_RGB565,      DRM_FORMAT_ARGB2101010,
+    DRM_FORMAT_ABGR2101010, DRM_FORMAT_NV12,        DRM_FORMAT_NV21,
+    DRM_FORMAT_P010,
+};
+
+const std::vector<uint32_t> kWritebackFormats = {
+    DRM_FORMAT_ABGR8888, DRM_FORMAT_ARGB8888, DRM_FORMAT_XBGR8888,
+    DRM_FORMAT_XRGB8888,
+};
+
+/* Properties the driver resets after every commit */
+bool IsTransient(const std::string &name) {
+  return name == "OUT_FENCE_PTR" || name == "IN_FENCE_FD" ||
+         name == "WRITEBACK_OUT_FENCE_PTR" || name == "WRITEBACK_FB_ID";
+}
+
+int64_t Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * kNsPerSec + ts.tv_nsec;
+}
+
+drmModeModeInfo MakeMode(uint32_t width, uint32_t height, uint32_t refresh) {
+  drmModeModeInfo mode;
+  memset(&mode, 0, sizeof(mode));
+  mode.hdisplay = width;
+  mode.hsync_start = width + 32;
+  mode.hsync_end = width + 44;
+  mode.htotal = width + 80;
+  mode.vdisplay = height;
+  mode.vsync_start = height + 8;
+  mode.vsync_end = height + 12;
+  mode.vtotal = height + 32;
+  mode.vrefresh = refresh;
+  mode.clock = static_cast<uint32_t>(static_cast<uint64_t>(mode.htotal) *
+                                     mode.vtotal * refresh / 1000);
+  mode.type = DRM_MODE_TYPE_DRIVER;
+  snprintf(mode.name, sizeof(mode.name), "%ux%u@%u", width, height, refresh);
+  return mode;
+}
+
+template <typename T>
+T *AllocArray(size_t count) {
+  return count ? static_cast<T *>(calloc(count, sizeof(T))) : nullptr;
+}
+
+std::mutex gRegistryLock;
+std::map<std::pair<dev_t, ino_t>, std::weak_ptr<FakeKmsDevice>> gRegistry;
+
+}  // namespace
+
+std::shared_ptr<FakeKmsDevice> FakeKmsDevice::Create(const Config &config) {
+  std::shared_ptr<FakeKmsDevice> device(new FakeKmsDevice(config));
+  if (device->Init())
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(gRegistryLock);
+  gRegistry[device->key_] = device;
+  return device;
+}
+
+std::shared_ptr<FakeKmsDevice> FakeKmsDevice::FromFd(int fd) {
+  struct stat st;
+  if (fstat(fd, &st))
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(gRegistryLock);
+  auto it = gRegistry.find(std::make_pair(st.st_dev, st.st_ino));
+  if (it == gRegistry.end())
+    return nullptr;
+  return it->second.lock();
+}
+
+FakeKmsDevice::FakeKmsDevice(const Config &config) : config_(config) {
+}
+
+FakeKmsDevice::~FakeKmsDevice() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+    timer_cv_.notify_all();
+  }
+  if (timer_.joinable())
+    timer_.join();
+
+  {
+    std::lock_guard<std::mutex> lock(gRegistryLock);
+    auto it = gRegistry.find(key_);
+    if (it != gRegistry.end() && it->second.expired())
+      gRegistry.erase(it);
+  }
+
+  if (!path_.empty())
+    unlink(path_.c_str());
+  if (!dir_.empty())
+    rmdir(dir_.c_str());
+}
+
+int FakeKmsDevice::Init() {
+  if (config_.num_displays == 0 || config_.refresh_rates.empty()) {
+    ALOGE("%s: at least one display and one mode are needed", __func__);
+    return -EINVAL;
+  }
+
+  const char *tmp = getenv("TMPDIR");
+#ifdef __ANDROID__
+  std::string dir = std::string(tmp ? tmp : "/data/local/tmp") + "/fakekms.XXXXXX";
+#else
+  std::string dir = std::string(tmp ? tmp : "/tmp") + "/fakekms.XXXXXX";
+#endif
+  if (!mkdtemp(&dir[0])) {
+    ALOGE("%s: failed to create %s: %s", __func__, dir.c_str(), strerror(errno));
+    return -errno;
+  }
+  dir_ = dir;
+
+  /*
+   * The device node is a FIFO: clients open it like a DRM node, poll it and
+   * read the events the device writes into it.
+   */
+  std::string path = dir_ + "/card0";
+  if (mkfifo(path.c_str(), 0600)) {
+    ALOGE("%s: failed to create %s: %s", __func__, path.c_str(), strerror(errno));
+    return -errno;
+  }
+  path_ = path;
+
+  event_fd_.Set(open(path_.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC));
+  struct stat st;
+  if (event_fd_.get() < 0 || fstat(event_fd_.get(), &st)) {
+    ALOGE("%s: failed to open %s: %s", __func__, path_.c_str(), strerror(errno));
+    return -errno;
+  }
+  key_ = std::make_pair(st.st_dev, st.st_ino);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = 0; i < config_.num_displays; i++)
+    BuildCrtc(i);
+  for (uint32_t i = 0; i < config_.num_planes; i++)
+    BuildPlane(i);
+  for (uint32_t i = 0; i < config_.num_displays; i++)
+    BuildPanel(i);
+  if (config_.writeback)
+    BuildWriteback();
+
+  const int64_t now = Now();
+  for (auto &[id, crtc] : crtc_state_)
+    UpdateVblankTimerLocked(crtc, now);
+  if (config_.vsync_timer)
+    timer_ = std::thread(&FakeKmsDevice::TimerRoutine, this);
+  return 0;
+}
+
+uint32_t FakeKmsDevice::NewId() {
+  return next_id_++;
+}
+
+uint32_t FakeKmsDevice::AddProperty(uint32_t object_type,
+                                    const std::string &name, uint32_t flags,
+                                    std::vector<uint64_t> values,
+                                    std::vector<std::string> enum_names) {
+  auto key = std::make_pair(object_type, name);
+  auto it = property_ids_.find(key);
+  if (it != property_ids_.end())
+    return it->second;
+
+  Property property;
+  property.id = NewId();
+  property.object_type = object_type;
+  property.name = name;
+  property.flags = flags;
+  property.values = std::move(values);
+  property.enum_names = std::move(enum_names);
+  property_ids_[key] = property.id;
+  properties_[property.id] = property;
+  return property.id;
+}
+
+uint32_t FakeKmsDevice::AddRange(uint32_t object_type, const std::string &name,
+                                 uint64_t min, uint64_t max, uint32_t flags) {
+  return AddProperty(object_type, name, DRM_MODE_PROP_RANGE | flags, {min, max});
+}
+
+uint32_t FakeKmsDevice::AddSignedRange(uint32_t object_type,
+                                       const std::string &name, int64_t min,
+                                       int64_t max) {
+  return AddProperty(object_type, name,
+                     DRM_MODE_PROP_SIGNED_RANGE | DRM_MODE_PROP_ATOMIC,
+                     {static_cast<uint64_t>(min), static_cast<uint64_t>(max)});
+}
+
+/*
+ * DrmProperty::value() uses the value of an enum property as an index into
+ * its enums, so the values of enums are their indices as in the driver.
+ */
+uint32_t FakeKmsDevice::AddEnum(uint32_t object_type, const std::string &name,
+                                std::vector<std::string> enum_names,
+                                uint32_t flags) {
+  std::vector<uint64_t> values(enum_names.size());
+  for (size_t i = 0; i < values.size(); i++)
+    values[i] = i;
+  return AddProperty(object_type, name, DRM_MODE_PROP_ENUM | flags,
+                     std::move(values), std::move(enum_names));
+}
+
+uint32_t FakeKmsDevice::AddBitmask(uint32_t object_type,
+                                   const std::string &name,
+                                   std::vector<std::string> bit_names,
+                                   uint32_t flags) {
+  std::vector<uint64_t> bits(bit_names.size());
+  for (size_t i = 0; i < bits.size(); i++)
+    bits[i] = i;
+  return AddProperty(object_type, name, DRM_MODE_PROP_BITMASK | flags,
+                     std::move(bits), std::move(bit_names));
+}
+
+uint32_t FakeKmsDevice::AddBlob(uint32_t object_type, const std::string &name,
+                                uint32_t flags) {
+  return AddProperty(object_type, name, DRM_MODE_PROP_BLOB | flags);
+}
+
+uint32_t FakeKmsDevice::AddObjectProperty(uint32_t object_type,
+                                          const std::string &name,
+                                          uint32_t target_type) {
+  return AddProperty(object_type, name,
+                     DRM_MODE_PROP_OBJECT | DRM_MODE_PROP_ATOMIC,
+                     {target_type});
+}
+
+void FakeKmsDevice::Attach(uint32_t object_id, uint32_t property_id,
+                           uint64_t value) {
+  objects_[object_id].properties.emplace_back(property_id, value);
+  if (properties_[property_id].flags & DRM_MODE_PROP_BLOB)
+    RefBlobLocked(value);
+}
+
+uint32_t FakeKmsDevice::CreateBlobLocked(const void *data, size_t length,
+                                         bool user_owned) {
+  uint32_t id = NewId();
+  Blob &blob = blobs_[id];
+  blob.data.assign(static_cast<const uint8_t *>(data),
+                   static_cast<const uint8_t *>(data) + length);
+  blob.user_owned = user_owned;
+  blob.refs = 0;
+  return id;
+}
+
+void FakeKmsDevice::BuildCrtc(uint32_t pipe) {
+  const uint32_t t = DRM_MODE_OBJECT_CRTC;
+  const uint32_t id = NewId();
+  objects_[id].type = t;
+  crtc_ids_.push_back(id);
+
+  Crtc &crtc = crtc_state_[id];
+  crtc.id = id;
+  crtc.pipe = pipe;
+  for (const char *sw_sync : kSwSyncPaths) {
+    crtc.timeline.Set(open(sw_sync, O_RDWR | O_CLOEXEC));
+    if (crtc.timeline.get() >= 0)
+      break;
+  }
+
+  drmModeModeInfo mode = MakeMode(config_.width, config_.height,
+                                  config_.refresh_rates[0]);
+  mode.type |= DRM_MODE_TYPE_PREFERRED;
+  const uint32_t mode_blob = CreateBlobLocked(&mode, sizeof(mode), false);
+
+  Attach(id, AddRange(t, "ACTIVE", 0, 1, DRM_MODE_PROP_ATOMIC), 1);
+  Attach(id, AddBlob(t, "MODE_ID", DRM_MODE_PROP_ATOMIC), mode_blob);
+  Attach(id, AddRange(t, "OUT_FENCE_PTR", 0, UINT64_MAX, DRM_MODE_PROP_ATOMIC),
+         0);
+  Attach(id, AddBlob(t, "partial_region"), 0);
+  Attach(id, AddBlob(t, "cgc_lut"), 0);
+  Attach(id, AddSignedRange(t, "cgc_lut_fd", -1, INT32_MAX), -1);
+  Attach(id, AddBlob(t, "DEGAMMA_LUT"), 0);
+  Attach(id, AddRange(t, "DEGAMMA_LUT_SIZE", 0, UINT32_MAX,
+                      DRM_MODE_PROP_IMMUTABLE), 65);
+  Attach(id, AddBlob(t, "GAMMA_LUT"), 0);
+  Attach(id, AddRange(t, "GAMMA_LUT_SIZE", 0, UINT32_MAX,
+                      DRM_MODE_PROP_IMMUTABLE), 65);
+  Attach(id, AddBlob(t, "linear_matrix"), 0);
+  Attach(id, AddBlob(t, "gamma_matrix"), 0);
+  Attach(id, AddEnum(t, "force_bpc", {"Unspecified", "8bpc", "10bpc"}), 0);
+  Attach(id, AddBlob(t, "disp_dither"), 0);
+  Attach(id, AddBlob(t, "cgc_dither"), 0);
+  Attach(id, AddRange(t, "adjusted_vblank", 0, UINT64_MAX), 0);
+  Attach(id, AddRange(t, "ppc", 0, UINT32_MAX, DRM_MODE_PROP_IMMUTABLE), 2);
+  Attach(id, AddRange(t, "max_disp_freq", 0, UINT32_MAX,
+                      DRM_MODE_PROP_IMMUTABLE), 664000);
+  Attach(id, AddRange(t, "dqe_enabled", 0, 1), 1);
+  Attach(id, AddEnum(t, "color mode", {"Native", "DCI-P3", "sRGB"}), 0);
+  Attach(id, AddRange(t, "expected_present_time", 0, UINT64_MAX), 0);
+  Attach(id, AddBlob(t, "histogram_roi"), 0);
+  Attach(id, AddBlob(t, "histogram_weights"), 0);
+  Attach(id, AddRange(t, "histogram_threshold", 0, UINT32_MAX), 0);
+  Attach(id, AddEnum(t, "histogram_pos", {"post", "pre"}), 0);
+  for (uint32_t i = 0; i < config_.histogram_channels; i++)
+    Attach(id, AddBlob(t, "histogram_" + std::to_string(i)), 0);
+}
+
+void FakeKmsDevice::BuildPlane(uint32_t index) {
+  const uint32_t t = DRM_MODE_OBJECT_PLANE;
+  const uint32_t id = NewId();
+  objects_[id].type = t;
+  plane_ids_.push_back(id);
+
+  Plane &plane = plane_state_[id];
+  plane.id = id;
+  plane.possible_crtcs = (1u << crtc_ids_.size()) - 1;
+
+  Attach(id, AddEnum(t, "type", {"Overlay", "Primary", "Cursor"},
+                     DRM_MODE_PROP_IMMUTABLE),
+         index < crtc_ids_.size() ? 1 : 0);
+  Attach(id, AddObjectProperty(t, "CRTC_ID", DRM_MODE_OBJECT_CRTC), 0);
+  Attach(id, AddObjectProperty(t, "FB_ID", DRM_MODE_OBJECT_FB), 0);
+  Attach(id, AddSignedRange(t, "CRTC_X", INT32_MIN, INT32_MAX), 0);
+  Attach(id, AddSignedRange(t, "CRTC_Y", INT32_MIN, INT32_MAX), 0);
+  Attach(id, AddRange(t, "CRTC_W", 0, INT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "CRTC_H", 0, INT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "SRC_X", 0, UINT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "SRC_Y", 0, UINT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "SRC_W", 0, UINT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "SRC_H", 0, UINT32_MAX, DRM_MODE_PROP_ATOMIC), 0);
+  Attach(id, AddRange(t, "zpos", 0, config_.num_planes - 1), index);
+  Attach(id, AddBitmask(t, "rotation", {"rotate-0", "rotate-90", "rotate-180",
+                                        "rotate-270", "reflect-x", "reflect-y"}),
+         DRM_MODE_ROTATE_0);
+  Attach(id, AddRange(t, "alpha", 0, 0xffff), 0xffff);
+  Attach(id, AddEnum(t, "pixel blend mode", {"None", "Pre-multiplied", "Coverage"}),
+         1);
+  Attach(id, AddSignedRange(t, "IN_FENCE_FD", -1, INT32_MAX),
+         static_cast<uint64_t>(-1));
+  Attach(id, AddEnum(t, "standard",
+                     {"Unspecified", "BT709", "BT601_625", "BT601_625_UNADJUSTED",
+                      "BT601_525", "BT601_525_UNADJUSTED", "BT2020",
+                      "BT2020_CONSTANT_LUMINANCE", "BT470M", "FILM", "DCI-P3",
+                      "Adobe RGB"}),
+         0);
+  Attach(id, AddEnum(t, "transfer",
+                     {"Unspecified", "Linear", "sRGB", "SMPTE 170M", "Gamma 2.2",
+                      "Gamma 2.6", "Gamma 2.8", "ST2084", "HLG"}),
+         0);
+  Attach(id, AddEnum(t, "range", {"Unspecified", "Full", "Limited", "Extended"}),
+         0);
+  Attach(id, AddRange(t, "max_luminance", 0, UINT32_MAX), 0);
+  Attach(id, AddRange(t, "min_luminance", 0, UINT32_MAX), 0);
+  if (!config_.plane_restrictions.empty()) {
+    const uint32_t blob = CreateBlobLocked(config_.plane_restrictions.data(),
+                                           config_.plane_restrictions.size(),
+                                           false);
+    Attach(id, AddBlob(t, "hw restrictions", DRM_MODE_PROP_IMMUTABLE), blob);
+  }
+  Attach(id, AddBlob(t, "eotf_lut"), 0);
+  Attach(id, AddBlob(t, "oetf_lut"), 0);
+  Attach(id, AddBlob(t, "gammut_matrix"), 0);
+  Attach(id, AddBlob(t, "tone_mapping"), 0);
+  Attach(id, AddRange(t, "colormap", 0, UINT32_MAX), 0);
+  Attach(id, AddBlob(t, "block"), 0);
+}
+
+void FakeKmsDevice::BuildPanel(uint32_t index) {
+  const uint32_t encoder_id = NewId();
+  objects_[encoder_id].type = DRM_MODE_OBJECT_ENCODER;
+  encoder_ids_.push_back(encoder_id);
+  Encoder &encoder = encoder_state_[encoder_id];
+  encoder.id = encoder_id;
+  encoder.type = DRM_MODE_ENCODER_DSI;
+  encoder.possible_crtcs = 1u << index;
+  /* The writeback encoder follows the panel ones */
+  encoder.possible_clones =
+      (1u << index) | (config_.writeback ? 1u << config_.num_displays : 0);
+
+  const uint32_t t = DRM_MODE_OBJECT_CONNECTOR;
+  const uint32_t id = NewId();
+  objects_[id].type = t;
+  connector_ids_.push_back(id);
+  Connector &connector = connector_state_[id];
+  connector.id = id;
+  connector.type = DRM_MODE_CONNECTOR_DSI;
+  connector.type_id = index + 1;
+  connector.encoder_id = encoder_id;
+  for (size_t i = 0; i < config_.refresh_rates.size(); i++) {
+    drmModeModeInfo mode = MakeMode(config_.width, config_.height,
+                                    config_.refresh_rates[i]);
+    if (i == 0)
+      mode.type |= DRM_MODE_TYPE_PREFERRED;
+    connector.modes.push_back(mode);
+  }
+
+  const drmModeModeInfo lp_mode = MakeMode(config_.width, config_.height, 30);
+  const uint32_t lp_blob = CreateBlobLocked(&lp_mode, sizeof(lp_mode), false);
+  uint32_t brightness_blob = 0;
+  if (!config_.brightness_capability.empty())
+    brightness_blob = CreateBlobLocked(config_.brightness_capability.data(),
+                                       config_.brightness_capability.size(),
+                                       false);
+
+  Attach(id, AddEnum(t, "DPMS", {"On", "Standby", "Suspend", "Off"}), 0);
+  Attach(id, AddObjectProperty(t, "CRTC_ID", DRM_MODE_OBJECT_CRTC),
+         crtc_ids_[index]);
+  Attach(id, AddBlob(t, "EDID", DRM_MODE_PROP_IMMUTABLE), 0);
+  /* Luminances are in units of 1/10000 nit */
+  Attach(id, AddRange(t, "max_luminance", 0, UINT32_MAX, DRM_MODE_PROP_IMMUTABLE),
+         10000000);
+  Attach(id, AddRange(t, "max_avg_luminance", 0, UINT32_MAX,
+                      DRM_MODE_PROP_IMMUTABLE), 5000000);
+  Attach(id, AddRange(t, "min_luminance", 0, UINT32_MAX, DRM_MODE_PROP_IMMUTABLE),
+         5);
+  Attach(id, AddBitmask(t, "hdr_formats", {"Dolby Vision", "HDR10", "HLG", "HDR10+"},
+                        DRM_MODE_PROP_IMMUTABLE),
+         (1 << 1) | (1 << 2));
+  Attach(id, AddRange(t, "frame_interval", 0, UINT64_MAX), 0);
+  Attach(id, AddEnum(t, "panel orientation",
+                     {"Normal", "Left Side Up", "Upside Down", "Right Side Up"},
+                     DRM_MODE_PROP_IMMUTABLE),
+         0);
+  Attach(id, AddBlob(t, "lp_mode", DRM_MODE_PROP_IMMUTABLE), lp_blob);
+  Attach(id, AddBlob(t, "brightness_capability", DRM_MODE_PROP_IMMUTABLE),
+         brightness_blob);
+  Attach(id, AddRange(t, "brightness_level", 0, UINT32_MAX), 0);
+  Attach(id, AddEnum(t, "hbm_mode", {"Off", "On IRC On", "On IRC Off"}), 0);
+  Attach(id, AddRange(t, "dimming_on", 0, 1), 0);
+  Attach(id, AddRange(t, "local_hbm_mode", 0, 1), 0);
+  Attach(id, AddBitmask(t, "mipi_sync", {"sync_refresh_rate", "sync_lhbm",
+                                         "sync_ghbm", "sync_bl", "sync_op_rate"}),
+         0);
+  Attach(id, AddRange(t, "panel_idle_support", 0, 1, DRM_MODE_PROP_IMMUTABLE), 1);
+  Attach(id, AddRange(t, "rr_switch_duration", 0, UINT32_MAX,
+                      DRM_MODE_PROP_IMMUTABLE), 0);
+  Attach(id, AddRange(t, "operation_rate", 0, UINT32_MAX), 0);
+  Attach(id, AddRange(t, "refresh_on_lp", 0, 1), 0);
+  Attach(id, AddEnum(t, "Content Protection", {"Undesired", "Desired", "Enabled"}),
+         0);
+}
+
+void FakeKmsDevice::BuildWriteback() {
+  const uint32_t encoder_id = NewId();
+  objects_[encoder_id].type = DRM_MODE_OBJECT_ENCODER;
+  encoder_ids_.push_back(encoder_id);
+  Encoder &encoder = encoder_state_[encoder_id];
+  encoder.id = encoder_id;
+  encoder.type = DRM_MODE_ENCODER_VIRTUAL;
+  encoder.possible_crtcs = (1u << crtc_ids_.size()) - 1;
+  encoder.possible_clones = (1u << encoder_ids_.size()) - 1;
+
+  const uint32_t t = DRM_MODE_OBJECT_CONNECTOR;
+  const uint32_t id = NewId();
+  objects_[id].type = t;
+  connector_ids_.push_back(id);
+  Connector &connector = connector_state_[id];
+  connector.id = id;
+  connector.type = DRM_MODE_CONNECTOR_WRITEBACK;
+  connector.type_id = 1;
+  connector.encoder_id = encoder_id;
+
+  const uint32_t formats =
+      CreateBlobLocked(kWritebackFormats.data(),
+                       kWritebackFormats.size() * sizeof(kWritebackFormats[0]),
+                       false);
+
+  Attach(id, AddEnum(t, "DPMS", {"On", "Standby", "Suspend", "Off"}), 0);
+  Attach(id, AddObjectProperty(t, "CRTC_ID", DRM_MODE_OBJECT_CRTC), 0);
+  Attach(id, AddBlob(t, "WRITEBACK_PIXEL_FORMATS", DRM_MODE_PROP_IMMUTABLE),
+         formats);
+  Attach(id, AddObjectProperty(t, "WRITEBACK_FB_ID", DRM_MODE_OBJECT_FB), 0);
+  Attach(id, AddRange(t, "WRITEBACK_OUT_FENCE_PTR", 0, UINT64_MAX,
+                      DRM_MODE_PROP_ATOMIC), 0);
+}
+
+const FakeKmsDevice::Property *FakeKmsDevice::FindPropertyLocked(
+    uint32_t object_id, const std::string &name) const {
+  auto object = objects_.find(object_id);
+  if (object == objects_.end())
+    return nullptr;
+  for (auto &[property_id, value] : object->second.properties) {
+    const Property &property = properties_.at(property_id);
+    if (property.name == name)
+      return &property;
+  }
+  return nullptr;
+}
+
+bool FakeKmsDevice::GetValueLocked(uint32_t object_id, uint32_t property_id,
+                                   uint64_t *value) const {
+  auto object = objects_.find(object_id);
+  if (object == objects_.end())
+    return false;
+  for (auto &[id, current] : object->second.properties) {
+    if (id == property_id) {
+      *value = current;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FakeKmsDevice::SetValueLocked(uint32_t object_id, uint32_t property_id,
+                                   uint64_t value) {
+  const bool blob = properties_[property_id].flags & DRM_MODE_PROP_BLOB;
+  for (auto &[id, current] : objects_[object_id].properties) {
+    if (id != property_id)
+      continue;
+    if (blob) {
+      RefBlobLocked(value);
+      UnrefBlobLocked(current);
+    }
+    current = value;
+    return;
+  }
+}
+
+void FakeKmsDevice::RefBlobLocked(uint64_t blob_id) {
+  auto blob = blobs_.find(blob_id);
+  if (blob != blobs_.end())
+    blob->second.refs++;
+}
+
+void FakeKmsDevice::UnrefBlobLocked(uint64_t blob_id) {
+  auto blob = blobs_.find(blob_id);
+  if (blob == blobs_.end() || blob->second.refs == 0)
+    return;
+  if (--blob->second.refs == 0 && !blob->second.user_owned)
+    blobs_.erase(blob);
+}
+
+int FakeKmsDevice::CheckValueLocked(const Property &property,
+                                    uint64_t value) const {
+  const uint32_t type = property.flags & DRM_MODE_PROP_EXTENDED_TYPE;
+  if (property.flags & DRM_MODE_PROP_IMMUTABLE)
+    return -EINVAL;
+
+  if (property.flags & DRM_MODE_PROP_RANGE) {
+    if (value < property.values[0] || value > property.values[1])
+      return -EINVAL;
+  } else if (type == DRM_MODE_PROP_SIGNED_RANGE) {
+    const int64_t svalue = static_cast<int64_t>(value);
+    if (svalue < static_cast<int64_t>(property.values[0]) ||
+        svalue > static_cast<int64_t>(property.values[1]))
+      return -EINVAL;
+  } else if (property.flags & DRM_MODE_PROP_ENUM) {
+    if (value >= property.values.size())
+      return -EINVAL;
+  } else if (property.flags & DRM_MODE_PROP_BITMASK) {
+    if (value >> property.values.size())
+      return -EINVAL;
+  } else if (property.flags & DRM_MODE_PROP_BLOB) {
+    if (value && blobs_.find(value) == blobs_.end())
+      return -EINVAL;
+  } else if (type == DRM_MODE_PROP_OBJECT) {
+    if (value == 0)
+      return 0;
+    auto object = objects_.find(value);
+    if (object == objects_.end() || object->second.type != property.values[0])
+      return -ENOENT;
+  }
+  return 0;
+}
+
+const drmModeModeInfo *FakeKmsDevice::ActiveModeLocked(const Crtc &crtc) const {
+  uint64_t active = 0;
+  uint64_t mode_id = 0;
+  const Property *active_property = FindPropertyLocked(crtc.id, "ACTIVE");
+  const Property *mode_property = FindPropertyLocked(crtc.id, "MODE_ID");
+  GetValueLocked(crtc.id, active_property->id, &active);
+  GetValueLocked(crtc.id, mode_property->id, &mode_id);
+  if (!active)
+    return nullptr;
+
+  auto blob = blobs_.find(mode_id);
+  if (blob == blobs_.end() || blob->second.data.size() != sizeof(drmModeModeInfo))
+    return nullptr;
+  return reinterpret_cast<const drmModeModeInfo *>(blob->second.data.data());
+}
+
+FakeKmsDevice::Crtc *FakeKmsDevice::FindCrtcLocked(uint32_t crtc_id) {
+  auto crtc = crtc_state_.find(crtc_id);
+  return crtc == crtc_state_.end() ? nullptr : &crtc->second;
+}
+
+uint32_t FakeKmsDevice::FindProperty(uint32_t object_id,
+                                     const std::string &name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Property *property = FindPropertyLocked(object_id, name);
+  return property ? property->id : 0;
+}
+
+int FakeKmsDevice::GetPropertyValue(uint32_t object_id, const std::string &name,
+                                    uint64_t *value) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Property *property = FindPropertyLocked(object_id, name);
+  if (!property || !GetValueLocked(object_id, property->id, value))
+    return -ENOENT;
+  return 0;
+}
+
+int FakeKmsDevice::SetPropertyValue(uint32_t object_id, const std::string &name,
+                                    uint64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Property *property = FindPropertyLocked(object_id, name);
+  if (!property)
+    return -ENOENT;
+  SetValueLocked(object_id, property->id, value);
+  return 0;
+}
+
+std::vector<uint8_t> FakeKmsDevice::GetBlob(uint32_t blob_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto blob = blobs_.find(blob_id);
+  return blob == blobs_.end() ? std::vector<uint8_t>() : blob->second.data;
+}
+
+std::vector<FakeKmsDevice::Commit> FakeKmsDevice::TakeCommits() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Commit> commits(std::make_move_iterator(commits_.begin()),
+                              std::make_move_iterator(commits_.end()));
+  commits_.clear();
+  return commits;
+}
+
+uint64_t FakeKmsDevice::commit_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return commit_count_;
+}
+
+void FakeKmsDevice::FailCommits(uint32_t count, int error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  failing_commits_ = count;
+  commit_error_ = error;
+}
+
+uint64_t FakeKmsDevice::vblank_count(uint32_t crtc_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto crtc = crtc_state_.find(crtc_id);
+  return crtc == crtc_state_.end() ? 0 : crtc->second.sequence;
+}
+
+void FakeKmsDevice::Vblank(uint32_t crtc_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t now = Now();
+  for (auto &[id, crtc] : crtc_state_) {
+    if ((crtc_id == 0 || crtc_id == id) && ActiveModeLocked(crtc))
+      VblankLocked(crtc, now);
+  }
+  FlushEventsLocked();
+}
+
+void FakeKmsDevice::QueueEvent(const void *event, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  events_.emplace_back(static_cast<const uint8_t *>(event),
+                       static_cast<const uint8_t *>(event) + size);
+  FlushEventsLocked();
+}
+
+int FakeKmsDevice::CreateOutFenceLocked(Crtc &crtc) {
+  if (crtc.timeline.get() >= 0) {
+    struct sw_sync_create_fence_data data;
+    memset(&data, 0, sizeof(data));
+    data.value = static_cast<__u32>(crtc.sequence + 1);
+    snprintf(data.name, sizeof(data.name), "fakekms-crtc%d", crtc.pipe);
+    if (ioctl(crtc.timeline.get(), SW_SYNC_IOC_CREATE_FENCE, &data) < 0)
+      return -errno;
+    return data.fence;
+  }
+
+  /* The client owns the fence, a duplicate is kept to signal it */
+  int fd = eventfd(0, EFD_CLOEXEC);
+  if (fd < 0)
+    return -errno;
+  int signal_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (signal_fd < 0) {
+    int ret = -errno;
+    close(fd);
+    return ret;
+  }
+  crtc.fences.push_back({crtc.sequence + 1, UniqueFd(signal_fd)});
+  return fd;
+}
+
+void FakeKmsDevice::VblankLocked(Crtc &crtc, int64_t now_ns) {
+  crtc.sequence++;
+  crtc.last_vblank_ns = now_ns;
+  crtc.pending = false;
+
+  if (crtc.timeline.get() >= 0) {
+    __u32 inc = 1;
+    if (ioctl(crtc.timeline.get(), SW_SYNC_IOC_INC, &inc) < 0)
+      ALOGE("%s: failed to signal fences of crtc %u: %s", __func__, crtc.id,
+            strerror(errno));
+  }
+  auto signaled = std::partition(crtc.fences.begin(), crtc.fences.end(),
+                                 [&crtc](const PendingFence &fence) {
+                                   return fence.sequence > crtc.sequence;
+                                 });
+  for (auto it = signaled; it != crtc.fences.end(); ++it) {
+    uint64_t count = 1;
+    if (write(it->fd.get(), &count, sizeof(count)) != sizeof(count))
+      ALOGE("%s: failed to signal fence: %s", __func__, strerror(errno));
+  }
+  crtc.fences.erase(signaled, crtc.fences.end());
+
+  for (uint64_t user_data : crtc.flip_events) {
+    struct drm_event_vblank event;
+    memset(&event, 0, sizeof(event));
+    event.base.type = DRM_EVENT_FLIP_COMPLETE;
+    event.base.length = sizeof(event);
+    event.user_data = user_data;
+    event.tv_sec = static_cast<__u32>(now_ns / kNsPerSec);
+    event.tv_usec = static_cast<__u32>((now_ns % kNsPerSec) / 1000);
+    event.sequence = static_cast<__u32>(crtc.sequence);
+    event.crtc_id = crtc.id;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(&event);
+    events_.emplace_back(data, data + sizeof(event));
+  }
+  crtc.flip_events.clear();
+  vblank_cv_.notify_all();
+}
+
+void FakeKmsDevice::UpdateVblankTimerLocked(Crtc &crtc, int64_t now_ns) {
+  const drmModeModeInfo *mode = ActiveModeLocked(crtc);
+  if (!config_.vsync_timer || !mode || !mode->vrefresh) {
+    crtc.next_vblank_ns = INT64_MAX;
+    crtc.period_ns = 0;
+    return;
+  }
+
+  const int64_t period_ns = kNsPerSec / mode->vrefresh;
+  if (crtc.period_ns != period_ns || crtc.next_vblank_ns == INT64_MAX) {
+    crtc.period_ns = period_ns;
+    crtc.next_vblank_ns = now_ns + period_ns;
+    timer_cv_.notify_all();
+  }
+}
+
+void FakeKmsDevice::FlushEventsLocked() {
+  if (events_.empty())
+    return;
+
+  int unread = 0;
+  if (ioctl(event_fd_.get(), FIONREAD, &unread) || unread > 0)
+    return;
+
+  std::vector<uint8_t> batch;
+  while (!events_.empty() &&
+         (batch.empty() ||
+          batch.size() + events_.front().size() <= kEventReadSize)) {
+    batch.insert(batch.end(), events_.front().begin(), events_.front().end());
+    events_.pop_front();
+  }
+  if (write(event_fd_.get(), batch.data(), batch.size()) !=
+      static_cast<ssize_t>(batch.size()))
+    ALOGE("%s: failed to write %zu bytes of events: %s", __func__, batch.size(),
+          strerror(errno));
+}
+
+void FakeKmsDevice::TimerRoutine() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!exit_) {
+    const int64_t now = Now();
+    int64_t next = INT64_MAX;
+    bool signaled = false;
+    for (auto &[id, crtc] : crtc_state_) {
+      if (crtc.next_vblank_ns <= now) {
+        VblankLocked(crtc, crtc.next_vblank_ns);
+        crtc.next_vblank_ns += crtc.period_ns;
+        /* Skip the vblanks the thread missed instead of catching up */
+        if (crtc.next_vblank_ns <= now)
+          crtc.next_vblank_ns = now + crtc.period_ns;
+        signaled = true;
+      }
+      next = std::min(next, crtc.next_vblank_ns);
+    }
+    if (signaled)
+      FlushEventsLocked();
+
+    if (next == INT64_MAX)
+      timer_cv_.wait(lock);
+    else
+      timer_cv_.wait_for(lock, std::chrono::nanoseconds(next - now));
+  }
+}
+
+int FakeKmsDevice::SetClientCap(uint64_t capability, uint64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  switch (capability) {
+    case DRM_CLIENT_CAP_STEREO_3D:
+    case DRM_CLIENT_CAP_UNIVERSAL_PLANES:
+    case DRM_CLIENT_CAP_ATOMIC:
+    case DRM_CLIENT_CAP_ASPECT_RATIO:
+      return value > 1 ? -EINVAL : 0;
+    case DRM_CLIENT_CAP_WRITEBACK_CONNECTORS:
+      if (value > 1)
+        return -EINVAL;
+      writeback_cap_ = value;
+      return 0;
+    default:
+      return -EINVAL;
+  }
+}
+
+drmModeResPtr FakeKmsDevice::GetResources() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint32_t> connectors;
+  for (uint32_t id : connector_ids_) {
+    if (writeback_cap_ ||
+        connector_state_[id].type != DRM_MODE_CONNECTOR_WRITEBACK)
+      connectors.push_back(id);
+  }
+
+  drmModeResPtr res = AllocArray<drmModeRes>(1);
+  res->count_fbs = framebuffers_.size();
+  res->fbs = AllocArray<uint32_t>(framebuffers_.size());
+  int i = 0;
+  for (auto &[id, fb] : framebuffers_)
+    res->fbs[i++] = id;
+  res->count_crtcs = crtc_ids_.size();
+  res->crtcs = AllocArray<uint32_t>(crtc_ids_.size());
+  std::copy(crtc_ids_.begin(), crtc_ids_.end(), res->crtcs);
+  res->count_connectors = connectors.size();
+  res->connectors = AllocArray<uint32_t>(connectors.size());
+  std::copy(connectors.begin(), connectors.end(), res->connectors);
+  res->count_encoders = encoder_ids_.size();
+  res->encoders = AllocArray<uint32_t>(encoder_ids_.size());
+  std::copy(encoder_ids_.begin(), encoder_ids_.end(), res->encoders);
+  res->min_width = 16;
+  res->min_height = 16;
+  res->max_width = 8192;
+  res->max_height = 8192;
+  return res;
+}
+
+drmModeCrtcPtr FakeKmsDevice::GetCrtc(uint32_t crtc_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Crtc *crtc = FindCrtcLocked(crtc_id);
+  if (!crtc) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModeCrtcPtr c = AllocArray<drmModeCrtc>(1);
+  c->crtc_id = crtc_id;
+  const drmModeModeInfo *mode = ActiveModeLocked(*crtc);
+  if (mode) {
+    c->mode_valid = 1;
+    c->mode = *mode;
+    c->width = mode->hdisplay;
+    c->height = mode->vdisplay;
+  }
+  uint64_t gamma_size = 0;
+  GetValueLocked(crtc_id, FindPropertyLocked(crtc_id, "GAMMA_LUT_SIZE")->id,
+                 &gamma_size);
+  c->gamma_size = gamma_size;
+  return c;
+}
+
+drmModeEncoderPtr FakeKmsDevice::GetEncoder(uint32_t encoder_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto encoder = encoder_state_.find(encoder_id);
+  if (encoder == encoder_state_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModeEncoderPtr e = AllocArray<drmModeEncoder>(1);
+  e->encoder_id = encoder_id;
+  e->encoder_type = encoder->second.type;
+  e->possible_crtcs = encoder->second.possible_crtcs;
+  e->possible_clones = encoder->second.possible_clones;
+  for (auto &[id, connector] : connector_state_) {
+    uint64_t crtc_id = 0;
+    if (connector.encoder_id == encoder_id &&
+        GetValueLocked(id, FindPropertyLocked(id, "CRTC_ID")->id, &crtc_id))
+      e->crtc_id = crtc_id;
+  }
+  return e;
+}
+
+drmModeConnectorPtr FakeKmsDevice::GetConnector(uint32_t connector_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = connector_state_.find(connector_id);
+  if (it == connector_state_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+  const Connector &connector = it->second;
+  const Object &object = objects_[connector_id];
+
+  drmModeConnectorPtr c = AllocArray<drmModeConnector>(1);
+  c->connector_id = connector_id;
+  c->encoder_id = connector.encoder_id;
+  c->connector_type = connector.type;
+  c->connector_type_id = connector.type_id;
+  if (connector.type == DRM_MODE_CONNECTOR_WRITEBACK) {
+    c->connection = DRM_MODE_UNKNOWNCONNECTION;
+  } else {
+    c->connection = DRM_MODE_CONNECTED;
+    /* About 400 dpi */
+    c->mmWidth = config_.width * 254 / 4000;
+    c->mmHeight = config_.height * 254 / 4000;
+  }
+  c->subpixel = DRM_MODE_SUBPIXEL_UNKNOWN;
+  c->count_modes = connector.modes.size();
+  c->modes = AllocArray<drmModeModeInfo>(connector.modes.size());
+  std::copy(connector.modes.begin(), connector.modes.end(), c->modes);
+  c->count_props = object.properties.size();
+  c->props = AllocArray<uint32_t>(object.properties.size());
+  c->prop_values = AllocArray<uint64_t>(object.properties.size());
+  for (size_t i = 0; i < object.properties.size(); i++) {
+    c->props[i] = object.properties[i].first;
+    c->prop_values[i] = object.properties[i].second;
+  }
+  c->count_encoders = 1;
+  c->encoders = AllocArray<uint32_t>(1);
+  c->encoders[0] = connector.encoder_id;
+  return c;
+}
+
+drmModePlaneResPtr FakeKmsDevice::GetPlaneResources() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drmModePlaneResPtr res = AllocArray<drmModePlaneRes>(1);
+  res->count_planes = plane_ids_.size();
+  res->planes = AllocArray<uint32_t>(plane_ids_.size());
+  std::copy(plane_ids_.begin(), plane_ids_.end(), res->planes);
+  return res;
+}
+
+drmModePlanePtr FakeKmsDevice::GetPlane(uint32_t plane_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto plane = plane_state_.find(plane_id);
+  if (plane == plane_state_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  auto value = [this, plane_id](const char *name) {
+    uint64_t v = 0;
+    GetValueLocked(plane_id, FindPropertyLocked(plane_id, name)->id, &v);
+    return static_cast<uint32_t>(v);
+  };
+  drmModePlanePtr p = AllocArray<drmModePlane>(1);
+  p->plane_id = plane_id;
+  p->crtc_id = value("CRTC_ID");
+  p->fb_id = value("FB_ID");
+  p->crtc_x = value("CRTC_X");
+  p->crtc_y = value("CRTC_Y");
+  p->x = value("SRC_X") >> 16;
+  p->y = value("SRC_Y") >> 16;
+  p->possible_crtcs = plane->second.possible_crtcs;
+  p->count_formats = kPlaneFormats.size();
+  p->formats = AllocArray<uint32_t>(kPlaneFormats.size());
+  std::copy(kPlaneFormats.begin(), kPlaneFormats.end(), p->formats);
+  return p;
+}
+
+drmModeObjectPropertiesPtr FakeKmsDevice::GetObjectProperties(
+    uint32_t object_id, uint32_t object_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = objects_.find(object_id);
+  if (it == objects_.end() ||
+      (object_type != DRM_MODE_OBJECT_ANY && object_type != it->second.type)) {
+    errno = ENOENT;
+    return nullptr;
+  }
+  const Object &object = it->second;
+
+  drmModeObjectPropertiesPtr props = AllocArray<drmModeObjectProperties>(1);
+  props->count_props = object.properties.size();
+  props->props = AllocArray<uint32_t>(object.properties.size());
+  props->prop_values = AllocArray<uint64_t>(object.properties.size());
+  for (size_t i = 0; i < object.properties.size(); i++) {
+    props->props[i] = object.properties[i].first;
+    props->prop_values[i] = object.properties[i].second;
+  }
+  return props;
+}
+
+drmModePropertyPtr FakeKmsDevice::GetProperty(uint32_t property_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = properties_.find(property_id);
+  if (it == properties_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+  const Property &property = it->second;
+
+  drmModePropertyPtr p = AllocArray<drmModePropertyRes>(1);
+  p->prop_id = property_id;
+  /* The atomic flag is only used to hide properties from legacy clients */
+  p->flags = property.flags & ~DRM_MODE_PROP_ATOMIC;
+  strncpy(p->name, property.name.c_str(), DRM_PROP_NAME_LEN - 1);
+  p->count_values = property.values.size();
+  p->values = AllocArray<uint64_t>(property.values.size());
+  std::copy(property.values.begin(), property.values.end(), p->values);
+  p->count_enums = property.enum_names.size();
+  p->enums = AllocArray<struct drm_mode_property_enum>(property.enum_names.size());
+  for (size_t i = 0; i < property.enum_names.size(); i++) {
+    p->enums[i].value = property.values[i];
+    strncpy(p->enums[i].name, property.enum_names[i].c_str(),
+            DRM_PROP_NAME_LEN - 1);
+  }
+  return p;
+}
+
+drmModePropertyBlobPtr FakeKmsDevice::GetPropertyBlob(uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto blob = blobs_.find(blob_id);
+  if (blob == blobs_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+
+  drmModePropertyBlobPtr b = AllocArray<drmModePropertyBlobRes>(1);
+  b->id = blob_id;
+  b->length = blob->second.data.size();
+  b->data = malloc(b->length);
+  memcpy(b->data, blob->second.data.data(), b->length);
+  return b;
+}
+
+int FakeKmsDevice::CreateBlob(const void *data, size_t length,
+                              uint32_t *blob_id) {
+  if (!data || length == 0)
+    return -EINVAL;
+  std::lock_guard<std::mutex> lock(mutex_);
+  *blob_id = CreateBlobLocked(data, length, true);
+  return 0;
+}
+
+int FakeKmsDevice::DestroyBlob(uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto blob = blobs_.find(blob_id);
+  if (blob == blobs_.end() || !blob->second.user_owned)
+    return -EINVAL;
+  blob->second.user_owned = false;
+  if (blob->second.refs == 0)
+    blobs_.erase(blob);
+  return 0;
+}
+
+int FakeKmsDevice::AddFb(uint32_t width, uint32_t height, uint32_t format,
+                         const uint32_t handles[4],
+                         const uint64_t /*modifier*/[4], uint32_t *fb_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (width == 0 || height == 0 || width > 8192 || height > 8192)
+    return -EINVAL;
+  bool imported = false;
+  for (auto &[buffer, handle] : gem_handles_)
+    imported |= handle == handles[0];
+  if (!imported)
+    return -ENOENT;
+
+  const uint32_t id = NewId();
+  objects_[id].type = DRM_MODE_OBJECT_FB;
+  framebuffers_[id] = {width, height, format};
+  *fb_id = id;
+  return 0;
+}
+
+int FakeKmsDevice::RemoveFb(uint32_t fb_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (framebuffers_.erase(fb_id) == 0)
+    return -ENOENT;
+  objects_.erase(fb_id);
+
+  /* Planes still scanning out the framebuffer are disabled */
+  for (uint32_t plane_id : plane_ids_) {
+    const uint32_t fb_property = FindPropertyLocked(plane_id, "FB_ID")->id;
+    uint64_t current = 0;
+    if (GetValueLocked(plane_id, fb_property, &current) && current == fb_id) {
+      SetValueLocked(plane_id, fb_property, 0);
+      SetValueLocked(plane_id, FindPropertyLocked(plane_id, "CRTC_ID")->id, 0);
+    }
+  }
+  return 0;
+}
+
+int FakeKmsDevice::PrimeFdToHandle(int prime_fd, uint32_t *handle) {
+  struct stat st;
+  if (fstat(prime_fd, &st))
+    return -errno;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto key = std::make_pair(st.st_dev, st.st_ino);
+  auto it = gem_handles_.find(key);
+  if (it == gem_handles_.end())
+    it = gem_handles_.emplace(key, next_gem_handle_++).first;
+  *handle = it->second;
+  return 0;
+}
+
+int FakeKmsDevice::CloseHandle(uint32_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = gem_handles_.begin(); it != gem_handles_.end(); ++it) {
+    if (it->second == handle) {
+      gem_handles_.erase(it);
+      return 0;
+    }
+  }
+  return -EINVAL;
+}
+
+int FakeKmsDevice::CheckPlaneLocked(
+    uint32_t plane_id,
+    const std::map<uint32_t, std::map<uint32_t, uint64_t>> &changes) const {
+  auto value = [&](uint32_t object_id, const char *name) -> uint64_t {
+    uint64_t v = 0;
+    const Property *property = FindPropertyLocked(object_id, name);
+    if (!property)
+      return 0;
+    auto object = changes.find(object_id);
+    if (object != changes.end()) {
+      auto it = object->second.find(property->id);
+      if (it != object->second.end())
+        return it->second;
+    }
+    GetValueLocked(object_id, property->id, &v);
+    return v;
+  };
+
+  const uint64_t fb_id = value(plane_id, "FB_ID");
+  const uint64_t crtc_id = value(plane_id, "CRTC_ID");
+  if (!fb_id && !crtc_id)
+    return 0;
+  if (!fb_id || !crtc_id)
+    return -EINVAL;
+
+  auto crtc = crtc_state_.find(crtc_id);
+  if (!(plane_state_.at(plane_id).possible_crtcs & (1u << crtc->second.pipe)) ||
+      !value(crtc_id, "ACTIVE"))
+    return -EINVAL;
+  if (!value(plane_id, "CRTC_W") || !value(plane_id, "CRTC_H"))
+    return -EINVAL;
+
+  const Framebuffer &fb = framebuffers_.at(fb_id);
+  const uint64_t src_x = value(plane_id, "SRC_X");
+  const uint64_t src_y = value(plane_id, "SRC_Y");
+  const uint64_t src_w = value(plane_id, "SRC_W");
+  const uint64_t src_h = value(plane_id, "SRC_H");
+  if (src_w > (static_cast<uint64_t>(fb.width) << 16) ||
+      src_x > (static_cast<uint64_t>(fb.width) << 16) - src_w ||
+      src_h > (static_cast<uint64_t>(fb.height) << 16) ||
+      src_y > (static_cast<uint64_t>(fb.height) << 16) - src_h)
+    return -ENOSPC;
+  return 0;
+}
+
+int FakeKmsDevice::AtomicCommit(const std::vector<PropertyValue> &values,
+                                uint32_t flags, void *user_data) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  Commit commit;
+  commit.id = commit_count_++;
+  commit.flags = flags;
+  commit.timestamp_ns = Now();
+  commit.values = values;
+  std::stable_sort(commit.values.begin(), commit.values.end(),
+                   [](const PropertyValue &a, const PropertyValue &b) {
+                     return a.object_id != b.object_id
+                                ? a.object_id < b.object_id
+                                : a.property_id < b.property_id;
+                   });
+  /* Keep the last value of each property */
+  size_t count = 0;
+  for (size_t i = 0; i < commit.values.size(); i++) {
+    if (count && commit.values[count - 1].object_id == commit.values[i].object_id &&
+        commit.values[count - 1].property_id == commit.values[i].property_id)
+      count--;
+    commit.values[count++] = commit.values[i];
+  }
+  commit.values.resize(count);
+
+  auto record = [this, &commit](int result) {
+    commit.result = result;
+    commits_.push_back(std::move(commit));
+    while (commits_.size() > config_.max_recorded_commits)
+      commits_.pop_front();
+    return result;
+  };
+
+  if ((flags & ~DRM_MODE_ATOMIC_FLAGS) || (flags & DRM_MODE_PAGE_FLIP_ASYNC) ||
+      ((flags & DRM_MODE_ATOMIC_TEST_ONLY) && (flags & DRM_MODE_PAGE_FLIP_EVENT)))
+    return record(-EINVAL);
+
+  /* Values of the request by object and property */
+  std::map<uint32_t, std::map<uint32_t, uint64_t>> changes;
+  std::vector<uint32_t> crtcs;
+  auto add_crtc = [&crtcs](uint64_t crtc_id) {
+    if (crtc_id && std::find(crtcs.begin(), crtcs.end(), crtc_id) == crtcs.end())
+      crtcs.push_back(crtc_id);
+  };
+  for (const PropertyValue &v : commit.values) {
+    auto object = objects_.find(v.object_id);
+    if (object == objects_.end())
+      return record(-ENOENT);
+    uint64_t current = 0;
+    if (!GetValueLocked(v.object_id, v.property_id, &current))
+      return record(-ENOENT);
+    int ret = CheckValueLocked(properties_[v.property_id], v.value);
+    if (ret)
+      return record(ret);
+    changes[v.object_id][v.property_id] = v.value;
+
+    if (object->second.type == DRM_MODE_OBJECT_CRTC) {
+      add_crtc(v.object_id);
+    } else if (properties_[v.property_id].name == "CRTC_ID") {
+      add_crtc(current);
+      add_crtc(v.value);
+    } else if (object->second.type != DRM_MODE_OBJECT_FB) {
+      uint64_t crtc_id = 0;
+      GetValueLocked(v.object_id, FindPropertyLocked(v.object_id, "CRTC_ID")->id,
+                     &crtc_id);
+      add_crtc(crtc_id);
+    }
+  }
+  if ((flags & DRM_MODE_PAGE_FLIP_EVENT) && crtcs.empty())
+    return record(-EINVAL);
+
+  const bool test_only = flags & DRM_MODE_ATOMIC_TEST_ONLY;
+  if (!test_only && failing_commits_) {
+    failing_commits_--;
+    return record(commit_error_);
+  }
+
+  if (!test_only && config_.throttle) {
+    auto busy = [&]() {
+      for (uint32_t crtc_id : crtcs)
+        if (crtc_state_[crtc_id].pending)
+          return true;
+      return false;
+    };
+    if (busy()) {
+      if (flags & DRM_MODE_ATOMIC_NONBLOCK)
+        return record(-EBUSY);
+      if (config_.vsync_timer)
+        vblank_cv_.wait_for(lock, kVblankTimeout, [&busy]() { return !busy(); });
+    }
+  }
+
+  for (auto &[object_id, object_changes] : changes) {
+    const uint32_t type = objects_[object_id].type;
+    for (auto &[property_id, value] : object_changes) {
+      const Property &property = properties_[property_id];
+      uint64_t current = 0;
+      GetValueLocked(object_id, property_id, &current);
+      bool modeset = false;
+      if (type == DRM_MODE_OBJECT_CRTC)
+        modeset = property.name == "ACTIVE" || property.name == "MODE_ID";
+      /*
+       * Routing a writeback connector is not a modeset, readback requests do
+       * not set ALLOW_MODESET.
+       */
+      else if (type == DRM_MODE_OBJECT_CONNECTOR &&
+               connector_state_[object_id].type != DRM_MODE_CONNECTOR_WRITEBACK)
+        modeset = property.name == "CRTC_ID";
+      if (modeset && value != current && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET))
+        return record(-EINVAL);
+    }
+
+    if (type == DRM_MODE_OBJECT_PLANE) {
+      int ret = CheckPlaneLocked(object_id, changes);
+      if (ret)
+        return record(ret);
+    } else if (type == DRM_MODE_OBJECT_CRTC) {
+      const Property *active = FindPropertyLocked(object_id, "ACTIVE");
+      const Property *mode = FindPropertyLocked(object_id, "MODE_ID");
+      uint64_t active_value = 0;
+      uint64_t mode_value = 0;
+      GetValueLocked(object_id, active->id, &active_value);
+      GetValueLocked(object_id, mode->id, &mode_value);
+      if (object_changes.count(active->id))
+        active_value = object_changes[active->id];
+      if (object_changes.count(mode->id))
+        mode_value = object_changes[mode->id];
+      if (active_value && (!mode_value || blobs_[mode_value].data.size() !=
+                                              sizeof(drmModeModeInfo)))
+        return record(-EINVAL);
+    } else if (type == DRM_MODE_OBJECT_CONNECTOR &&
+               connector_state_[object_id].type == DRM_MODE_CONNECTOR_WRITEBACK) {
+      const Property *fb = FindPropertyLocked(object_id, "WRITEBACK_FB_ID");
+      const Property *fence =
+          FindPropertyLocked(object_id, "WRITEBACK_OUT_FENCE_PTR");
+      const Property *crtc = FindPropertyLocked(object_id, "CRTC_ID");
+      uint64_t crtc_value = 0;
+      GetValueLocked(object_id, crtc->id, &crtc_value);
+      if (object_changes.count(crtc->id))
+        crtc_value = object_changes[crtc->id];
+      const bool has_fb = object_changes.count(fb->id) && object_changes[fb->id];
+      if (object_changes.count(fence->id) && object_changes[fence->id] && !has_fb)
+        return record(-EINVAL);
+      if (has_fb && !crtc_value)
+        return record(-EINVAL);
+    }
+  }
+
+  if (test_only)
+    return record(0);
+
+  /* Out-fences are created before anything is applied */
+  std::vector<std::pair<int32_t *, int>> out_fences;
+  auto close_fences = [&out_fences]() {
+    for (auto &[ptr, fd] : out_fences)
+      close(fd);
+  };
+  for (auto &[object_id, object_changes] : changes) {
+    for (auto &[property_id, value] : object_changes) {
+      const std::string &name = properties_[property_id].name;
+      if (!value || (name != "OUT_FENCE_PTR" && name != "WRITEBACK_OUT_FENCE_PTR"))
+        continue;
+      uint64_t crtc_id = object_id;
+      if (name == "WRITEBACK_OUT_FENCE_PTR") {
+        const Property *crtc = FindPropertyLocked(object_id, "CRTC_ID");
+        GetValueLocked(object_id, crtc->id, &crtc_id);
+        if (object_changes.count(crtc->id))
+          crtc_id = object_changes[crtc->id];
+      }
+      int fd = CreateOutFenceLocked(crtc_state_[crtc_id]);
+      if (fd < 0) {
+        close_fences();
+        return record(fd);
+      }
+      out_fences.emplace_back(reinterpret_cast<int32_t *>(value), fd);
+    }
+  }
+  for (auto &[ptr, fd] : out_fences)
+    *ptr = fd;
+
+  for (auto &[object_id, object_changes] : changes) {
+    for (auto &[property_id, value] : object_changes) {
+      if (!IsTransient(properties_[property_id].name))
+        SetValueLocked(object_id, property_id, value);
+    }
+  }
+
+  const int64_t now = Now();
+  for (uint32_t crtc_id : crtcs) {
+    Crtc &crtc = crtc_state_[crtc_id];
+    if (flags & DRM_MODE_PAGE_FLIP_EVENT)
+      crtc.flip_events.push_back(reinterpret_cast<uint64_t>(user_data));
+    UpdateVblankTimerLocked(crtc, now);
+    /* A disabled CRTC completes the commit at once */
+    if (ActiveModeLocked(crtc))
+      crtc.pending = true;
+    else
+      VblankLocked(crtc, now);
+  }
+  FlushEventsLocked();
+
+  if (!(flags & DRM_MODE_ATOMIC_NONBLOCK) && config_.throttle &&
+      config_.vsync_timer) {
+    vblank_cv_.wait_for(lock, kVblankTimeout, [&]() {
+      for (uint32_t crtc_id : crtcs)
+        if (crtc_state_[crtc_id].pending)
+          return false;
+      return true;
+    });
+  }
+  return record(0);
+}
+
+int FakeKmsDevice::ConnectorSetProperty(uint32_t connector_id,
+                                        uint32_t property_id, uint64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (connector_state_.find(connector_id) == connector_state_.end())
+    return -ENOENT;
+  uint64_t current = 0;
+  if (!GetValueLocked(connector_id, property_id, &current))
+    return -ENOENT;
+
+  const Property &property = properties_[property_id];
+  if (property.flags & DRM_MODE_PROP_ATOMIC)
+    return -EINVAL;
+  int ret = CheckValueLocked(property, value);
+  if (ret)
+    return ret;
+  SetValueLocked(connector_id, property_id, value);
+  return 0;
+}
+
+int FakeKmsDevice::WaitVblank(drmVBlankPtr vbl) {
+  const uint32_t type = vbl->request.type;
+  if (type & (DRM_VBLANK_EVENT | DRM_VBLANK_SIGNAL))
+    return -EINVAL;
+  int pipe = (type & DRM_VBLANK_HIGH_CRTC_MASK) >> DRM_VBLANK_HIGH_CRTC_SHIFT;
+  if (type & DRM_VBLANK_SECONDARY)
+    pipe = 1;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  Crtc *crtc = nullptr;
+  for (auto &[id, c] : crtc_state_)
+    if (c.pipe == pipe)
+      crtc = &c;
+  if (!crtc || !ActiveModeLocked(*crtc))
+    return -EINVAL;
+
+  /* Sequences are compared with the 32 bits of the uapi */
+  uint32_t current = static_cast<uint32_t>(crtc->sequence);
+  uint32_t target = vbl->request.sequence;
+  if (type & DRM_VBLANK_RELATIVE)
+    target += current;
+  else if ((type & DRM_VBLANK_NEXTONMISS) &&
+           static_cast<int32_t>(current - target) >= 0)
+    target = current + 1;
+
+  if (!vblank_cv_.wait_for(lock, kVblankTimeout, [crtc, target]() {
+        return static_cast<int32_t>(static_cast<uint32_t>(crtc->sequence) -
+                                    target) >= 0;
+      }))
+    return -EBUSY;
+
+  vbl->reply.sequence = static_cast<uint32_t>(crtc->sequence);
+  vbl->reply.tval_sec = crtc->last_vblank_ns / kNsPerSec;
+  vbl->reply.tval_usec = (crtc->last_vblank_ns % kNsPerSec) / 1000;
+  return 0;
+}
+
+}  // namespace android
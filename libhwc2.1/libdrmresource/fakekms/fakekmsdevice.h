@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FAKE_KMS_DEVICE_H_
+#define ANDROID_FAKE_KMS_DEVICE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "autofd.h"
+
+namespace android {
+
+/*
+ * In-process stand-in for the Exynos DRM driver.
+ *
+ * FakeKmsDevice models the CRTCs, encoders, connectors and planes of an
+ * Exynos display subsystem with all the properties DrmCrtc, DrmPlane and
+ * DrmConnector look up, including the vendor ones (dqe_enabled, the color
+ * pipeline LUTs, histogram blobs, mipi_sync, ...). fakekmslibdrm.cpp
+ * implements the subset of libdrm used by libdrmresource and
+ * ExynosDisplayDrmInterface on top of it, so a host binary links
+ * libdrm_fakekms instead of libdrm and passes path() to DrmDevice::Init().
+ *
+ * Atomic commits are checked the way the driver checks them, applied to the
+ * object state and recorded. Out-fences and page flip events of a CRTC are
+ * signaled at its next vblank, which a timer thread generates at the refresh
+ * rate of the active mode.
+ *
+ * Out-fences are sw_sync fences when sw_sync is available. Otherwise they are
+ * eventfds, which sync_wait() can poll but the sync_file ioctls reject.
+ */
+class FakeKmsDevice {
+ public:
+  struct Config {
+    // Internal DSI panels, each driven by its own CRTC
+    uint32_t num_displays = 1;
+    // DPP channels, shared by all the CRTCs
+    uint32_t num_planes = 6;
+    // Adds a writeback connector which can clone any CRTC
+    bool writeback = true;
+    uint32_t width = 1080;
+    uint32_t height = 2400;
+    // Modes of each panel, the first one is active at creation
+    std::vector<uint32_t> refresh_rates = {60, 120};
+    // histogram_N channel properties of each CRTC
+    uint32_t histogram_channels = 4;
+    // Contents of the "hw restrictions" blob of the planes and of the
+    // brightness_capability blob of the panels. Their layout is defined by
+    // the vendor uapi header, planes have no hw restrictions if it is empty.
+    std::vector<uint8_t> plane_restrictions;
+    std::vector<uint8_t> brightness_capability;
+    // Without the timer vblanks only happen on Vblank()
+    bool vsync_timer = true;
+    // Non blocking commits fail with -EBUSY and blocking commits wait while
+    // the previous commit of a CRTC is not latched
+    bool throttle = true;
+    size_t max_recorded_commits = 1024;
+  };
+
+  struct PropertyValue {
+    uint32_t object_id;
+    uint32_t property_id;
+    uint64_t value;
+  };
+
+  struct Commit {
+    uint64_t id;
+    uint32_t flags;
+    int result;
+    int64_t timestamp_ns;
+    // Sorted by object and property, the last value set wins
+    std::vector<PropertyValue> values;
+  };
+
+  static std::shared_ptr<FakeKmsDevice> Create(const Config &config);
+  // Returns the device opened as fd, nullptr if fd is not a fake device
+  static std::shared_ptr<FakeKmsDevice> FromFd(int fd);
+
+  ~FakeKmsDevice();
+
+  const std::string &path() const {
+    return path_;
+  }
+  const std::vector<uint32_t> &crtcs() const {
+    return crtc_ids_;
+  }
+  const std::vector<uint32_t> &planes() const {
+    return plane_ids_;
+  }
+  const std::vector<uint32_t> &connectors() const {
+    return connector_ids_;
+  }
+
+  // Returns 0 if the object has no property of that name
+  uint32_t FindProperty(uint32_t object_id, const std::string &name) const;
+  int GetPropertyValue(uint32_t object_id, const std::string &name,
+                       uint64_t *value) const;
+  // Changes a property the way the driver does, immutable ones included
+  int SetPropertyValue(uint32_t object_id, const std::string &name,
+                       uint64_t value);
+  std::vector<uint8_t> GetBlob(uint32_t blob_id) const;
+
+  // Returns the recorded commits and forgets them
+  std::vector<Commit> TakeCommits();
+  uint64_t commit_count() const;
+  // The next count commits which are not TEST_ONLY fail with error
+  void FailCommits(uint32_t count, int error);
+
+  uint64_t vblank_count(uint32_t crtc_id) const;
+  // Signals a vblank on crtc_id, or on all active CRTCs if it is 0
+  void Vblank(uint32_t crtc_id = 0);
+  // Queues a driver event such as an exynos_drm_histogram_event
+  void QueueEvent(const void *event, size_t size);
+
+  // Backend of the libdrm API, errors are returned as -errno
+  int SetClientCap(uint64_t capability, uint64_t value);
+  drmModeResPtr GetResources();
+  drmModeCrtcPtr GetCrtc(uint32_t crtc_id);
+  drmModeEncoderPtr GetEncoder(uint32_t encoder_id);
+  drmModeConnectorPtr GetConnector(uint32_t connector_id);
+  drmModePlaneResPtr GetPlaneResources();
+  drmModePlanePtr GetPlane(uint32_t plane_id);
+  drmModeObjectPropertiesPtr GetObjectProperties(uint32_t object_id,
+                                                 uint32_t object_type);
+  drmModePropertyPtr GetProperty(uint32_t property_id);
+  drmModePropertyBlobPtr GetPropertyBlob(uint32_t blob_id);
+  int CreateBlob(const void *data, size_t length, uint32_t *blob_id);
+  int DestroyBlob(uint32_t blob_id);
+  int AddFb(uint32_t width, uint32_t height, uint32_t format,
+            const uint32_t handles[4], const uint64_t modifier[4],
+            uint32_t *fb_id);
+  int RemoveFb(uint32_t fb_id);
+  int PrimeFdToHandle(int prime_fd, uint32_t *handle);
+  int CloseHandle(uint32_t handle);
+  int AtomicCommit(const std::vector<PropertyValue> &values, uint32_t flags,
+                   void *user_data);
+  int ConnectorSetProperty(uint32_t connector_id, uint32_t property_id,
+                           uint64_t value);
+  int WaitVblank(drmVBlankPtr vbl);
+
+ private:
+  struct Property {
+    uint32_t id;
+    uint32_t object_type;
+    std::string name;
+    uint32_t flags;
+    // Range bounds, enum values, bitmask bits or the type of the object
+    std::vector<uint64_t> values;
+    std::vector<std::string> enum_names;
+  };
+
+  struct Object {
+    uint32_t type;
+    // In the order they are reported
+    std::vector<std::pair<uint32_t, uint64_t>> properties;
+  };
+
+  struct Blob {
+    std::vector<uint8_t> data;
+    // Destroyed blobs live on while a property refers to them
+    bool user_owned;
+    uint32_t refs;
+  };
+
+  struct Framebuffer {
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+  };
+
+  struct PendingFence {
+    uint64_t sequence;
+    UniqueFd fd;
+  };
+
+  struct Crtc {
+    uint32_t id;
+    int pipe;
+    uint64_t sequence = 0;
+    int64_t last_vblank_ns = 0;
+    int64_t next_vblank_ns = INT64_MAX;
+    int64_t period_ns = 0;
+    // A commit waits for the next vblank to be latched
+    bool pending = false;
+    // sw_sync timeline, its value is the vblank sequence
+    UniqueFd timeline;
+    // eventfds signaled without sw_sync
+    std::vector<PendingFence> fences;
+    std::vector<uint64_t> flip_events;
+  };
+
+  struct Connector {
+    uint32_t id;
+    uint32_t type;
+    uint32_t type_id;
+    uint32_t encoder_id;
+    std::vector<drmModeModeInfo> modes;
+  };
+
+  struct Encoder {
+    uint32_t id;
+    uint32_t type;
+    uint32_t possible_crtcs;
+    uint32_t possible_clones;
+  };
+
+  struct Plane {
+    uint32_t id;
+    uint32_t possible_crtcs;
+  };
+
+  explicit FakeKmsDevice(const Config &config);
+  int Init();
+  void BuildCrtc(uint32_t pipe);
+  void BuildPlane(uint32_t index);
+  void BuildPanel(uint32_t index);
+  void BuildWriteback();
+
+  uint32_t NewId();
+  uint32_t AddProperty(uint32_t object_type, const std::string &name,
+                       uint32_t flags, std::vector<uint64_t> values = {},
+                       std::vector<std::string> enum_names = {});
+  uint32_t AddRange(uint32_t object_type, const std::string &name,
+                    uint64_t min, uint64_t max, uint32_t flags = 0);
+  uint32_t AddSignedRange(uint32_t object_type, const std::string &name,
+                          int64_t min, int64_t max);
+  uint32_t AddEnum(uint32_t object_type, const std::string &name,
+                   std::vector<std::string> enum_names, uint32_t flags = 0);
+  uint32_t AddBitmask(uint32_t object_type, const std::string &name,
+                      std::vector<std::string> bit_names, uint32_t flags = 0);
+  uint32_t AddBlob(uint32_t object_type, const std::string &name,
+                   uint32_t flags = 0);
+  uint32_t AddObjectProperty(uint32_t object_type, const std::string &name,
+                             uint32_t target_type);
+  void Attach(uint32_t object_id, uint32_t property_id, uint64_t value);
+  uint32_t CreateBlobLocked(const void *data, size_t length, bool user_owned);
+
+  const Property *FindPropertyLocked(uint32_t object_id,
+                                     const std::string &name) const;
+  bool GetValueLocked(uint32_t object_id, uint32_t property_id,
+                      uint64_t *value) const;
+  void SetValueLocked(uint32_t object_id, uint32_t property_id,
+                      uint64_t value);
+  void RefBlobLocked(uint64_t blob_id);
+  void UnrefBlobLocked(uint64_t blob_id);
+  int CheckValueLocked(const Property &property, uint64_t value) const;
+  int CheckPlaneLocked(uint32_t plane_id,
+                       const std::map<uint32_t, std::map<uint32_t, uint64_t>>
+                           &changes) const;
+  const drmModeModeInfo *ActiveModeLocked(const Crtc &crtc) const;
+  Crtc *FindCrtcLocked(uint32_t crtc_id);
+
+  int CreateOutFenceLocked(Crtc &crtc);
+  void VblankLocked(Crtc &crtc, int64_t now_ns);
+  void UpdateVblankTimerLocked(Crtc &crtc, int64_t now_ns);
+  void FlushEventsLocked();
+  void TimerRoutine();
+
+  const Config config_;
+  std::string dir_;
+  std::string path_;
+  std::pair<dev_t, ino_t> key_;
+  // Write end of the event FIFO
+  UniqueFd event_fd_;
+
+  std::vector<uint32_t> crtc_ids_;
+  std::vector<uint32_t> encoder_ids_;
+  std::vector<uint32_t> connector_ids_;
+  std::vector<uint32_t> plane_ids_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable vblank_cv_;
+  std::condition_variable timer_cv_;
+  bool exit_ = false;
+  std::thread timer_;
+
+  uint32_t next_id_ = 1;
+  std::map<std::pair<uint32_t, std::string>, uint32_t> property_ids_;
+  std::map<uint32_t, Property> properties_;
+  std::map<uint32_t, Object> objects_;
+  std::map<uint32_t, Blob> blobs_;
+  std::map<uint32_t, Framebuffer> framebuffers_;
+  std::map<uint32_t, Crtc> crtc_state_;
+  std::map<uint32_t, Connector> connector_state_;
+  std::map<uint32_t, Encoder> encoder_state_;
+  std::map<uint32_t, Plane> plane_state_;
+  // GEM handles of imported buffers by inode
+  std::map<std::pair<dev_t, ino_t>, uint32_t> gem_handles_;
+  uint32_t next_gem_handle_ = 1;
+  bool writeback_cap_ = false;
+
+  std::deque<std::vector<uint8_t>> events_;
+  std::deque<Commit> commits_;
+  uint64_t commit_count_ = 0;
+  uint32_t failing_commits_ = 0;
+  int commit_error_ = 0;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_FAKE_KMS_DEVICE_H_
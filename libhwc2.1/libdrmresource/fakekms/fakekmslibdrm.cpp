@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The libdrm API used by libdrmresource and ExynosDisplayDrmInterface,
+ * implemented on top of FakeKmsDevice. Return values and errno follow libdrm:
+ * drmIoctl() style calls return -1 and set errno, drmMode calls wrapping an
+ * ioctl return -errno.
+ */
+
+#define LOG_TAG "fakekms"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fakekmsdevice.h"
+
+using android::FakeKmsDevice;
+
+/* Same layout as the one ExynosDisplayDrmInterface dumps commits with */
+typedef struct _drmModeAtomicReqItem drmModeAtomicReqItem, *drmModeAtomicReqItemPtr;
+
+struct _drmModeAtomicReqItem {
+  uint32_t object_id;
+  uint32_t property_id;
+  uint64_t value;
+};
+
+struct _drmModeAtomicReq {
+  uint32_t cursor;
+  uint32_t size_items;
+  drmModeAtomicReqItemPtr items;
+};
+
+namespace {
+
+std::shared_ptr<FakeKmsDevice> Device(int fd) {
+  std::shared_ptr<FakeKmsDevice> device = FakeKmsDevice::FromFd(fd);
+  if (!device)
+    errno = EBADF;
+  return device;
+}
+
+int ToIoctlResult(int ret) {
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+extern "C" {
+
+int drmIoctl(int fd, unsigned long request, void *arg) {
+  auto device = Device(fd);
+  if (!device)
+    return -1;
+
+  switch (request) {
+    case DRM_IOCTL_MODE_CREATEPROPBLOB: {
+      auto create = static_cast<struct drm_mode_create_blob *>(arg);
+      return ToIoctlResult(device->CreateBlob(
+          reinterpret_cast<const void *>(create->data), create->length,
+          &create->blob_id));
+    }
+    case DRM_IOCTL_MODE_DESTROYPROPBLOB: {
+      auto destroy = static_cast<struct drm_mode_destroy_blob *>(arg);
+      return ToIoctlResult(device->DestroyBlob(destroy->blob_id));
+    }
+    case DRM_IOCTL_GEM_CLOSE: {
+      auto close = static_cast<struct drm_gem_close *>(arg);
+      return ToIoctlResult(device->CloseHandle(close->handle));
+    }
+    default:
+      errno = ENOTTY;
+      return -1;
+  }
+}
+
+int drmSetClientCap(int fd, uint64_t capability, uint64_t value) {
+  auto device = Device(fd);
+  if (!device)
+    return -1;
+  return ToIoctlResult(device->SetClientCap(capability, value));
+}
+
+int drmWaitVBlank(int fd, drmVBlankPtr vbl) {
+  auto device = Device(fd);
+  if (!device)
+    return -1;
+  return ToIoctlResult(device->WaitVblank(vbl));
+}
+
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) {
+  auto device = Device(fd);
+  if (!device)
+    return -1;
+  return ToIoctlResult(device->PrimeFdToHandle(prime_fd, handle));
+}
+
+drmModeResPtr drmModeGetResources(int fd) {
+  auto device = Device(fd);
+  return device ? device->GetResources() : nullptr;
+}
+
+void drmModeFreeResources(drmModeResPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->fbs);
+  free(ptr->crtcs);
+  free(ptr->connectors);
+  free(ptr->encoders);
+  free(ptr);
+}
+
+drmModeCrtcPtr drmModeGetCrtc(int fd, uint32_t crtcId) {
+  auto device = Device(fd);
+  return device ? device->GetCrtc(crtcId) : nullptr;
+}
+
+void drmModeFreeCrtc(drmModeCrtcPtr ptr) {
+  free(ptr);
+}
+
+drmModeEncoderPtr drmModeGetEncoder(int fd, uint32_t encoder_id) {
+  auto device = Device(fd);
+  return device ? device->GetEncoder(encoder_id) : nullptr;
+}
+
+void drmModeFreeEncoder(drmModeEncoderPtr ptr) {
+  free(ptr);
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connectorId) {
+  auto device = Device(fd);
+  return device ? device->GetConnector(connectorId) : nullptr;
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->modes);
+  free(ptr->props);
+  free(ptr->prop_values);
+  free(ptr->encoders);
+  free(ptr);
+}
+
+void drmModeFreeModeInfo(drmModeModeInfoPtr ptr) {
+  free(ptr);
+}
+
+int drmModeConnectorSetProperty(int fd, uint32_t connector_id,
+                                uint32_t property_id, uint64_t value) {
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+  return device->ConnectorSetProperty(connector_id, property_id, value);
+}
+
+drmModePlaneResPtr drmModeGetPlaneResources(int fd) {
+  auto device = Device(fd);
+  return device ? device->GetPlaneResources() : nullptr;
+}
+
+void drmModeFreePlaneResources(drmModePlaneResPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->planes);
+  free(ptr);
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id) {
+  auto device = Device(fd);
+  return device ? device->GetPlane(plane_id) : nullptr;
+}
+
+void drmModeFreePlane(drmModePlanePtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->formats);
+  free(ptr);
+}
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd, uint32_t object_id,
+                                                      uint32_t object_type) {
+  auto device = Device(fd);
+  return device ? device->GetObjectProperties(object_id, object_type) : nullptr;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->props);
+  free(ptr->prop_values);
+  free(ptr);
+}
+
+drmModePropertyPtr drmModeGetProperty(int fd, uint32_t propertyId) {
+  auto device = Device(fd);
+  return device ? device->GetProperty(propertyId) : nullptr;
+}
+
+void drmModeFreeProperty(drmModePropertyPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->values);
+  free(ptr->enums);
+  free(ptr->blob_ids);
+  free(ptr);
+}
+
+drmModePropertyBlobPtr drmModeGetPropertyBlob(int fd, uint32_t blob_id) {
+  auto device = Device(fd);
+  return device ? device->GetPropertyBlob(blob_id) : nullptr;
+}
+
+void drmModeFreePropertyBlob(drmModePropertyBlobPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->data);
+  free(ptr);
+}
+
+int drmModeCreatePropertyBlob(int fd, const void *data, size_t size,
+                              uint32_t *id) {
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+  return device->CreateBlob(data, size, id);
+}
+
+int drmModeDestroyPropertyBlob(int fd, uint32_t id) {
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+  return device->DestroyBlob(id);
+}
+
+int drmModeAddFB2WithModifiers(int fd, uint32_t width, uint32_t height,
+                               uint32_t pixel_format,
+                               const uint32_t bo_handles[4],
+                               const uint32_t /*pitches*/[4],
+                               const uint32_t /*offsets*/[4],
+                               const uint64_t modifier[4], uint32_t *buf_id,
+                               uint32_t /*flags*/) {
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+  return device->AddFb(width, height, pixel_format, bo_handles, modifier,
+                       buf_id);
+}
+
+int drmModeRmFB(int fd, uint32_t bufferId) {
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+  return device->RemoveFb(bufferId);
+}
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void) {
+  return static_cast<drmModeAtomicReqPtr>(calloc(1, sizeof(drmModeAtomicReq)));
+}
+
+drmModeAtomicReqPtr drmModeAtomicDuplicate(drmModeAtomicReqPtr old) {
+  if (!old)
+    return nullptr;
+
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  if (!req)
+    return nullptr;
+  if (old->size_items) {
+    req->items = static_cast<drmModeAtomicReqItemPtr>(
+        malloc(old->size_items * sizeof(*req->items)));
+    if (!req->items) {
+      free(req);
+      return nullptr;
+    }
+    memcpy(req->items, old->items, old->cursor * sizeof(*req->items));
+  }
+  req->cursor = old->cursor;
+  req->size_items = old->size_items;
+  return req;
+}
+
+int drmModeAtomicMerge(drmModeAtomicReqPtr base, drmModeAtomicReqPtr augment) {
+  if (!base)
+    return -EINVAL;
+  if (!augment || augment->cursor == 0)
+    return 0;
+
+  if (base->cursor + augment->cursor >= base->size_items) {
+    const uint32_t size = base->cursor + augment->cursor;
+    auto items = static_cast<drmModeAtomicReqItemPtr>(
+        realloc(base->items, size * sizeof(*base->items)));
+    if (!items)
+      return -ENOMEM;
+    base->items = items;
+    base->size_items = size;
+  }
+  memcpy(&base->items[base->cursor], augment->items,
+         augment->cursor * sizeof(*augment->items));
+  base->cursor += augment->cursor;
+  return 0;
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req) {
+  if (!req)
+    return;
+  free(req->items);
+  free(req);
+}
+
+int drmModeAtomicGetCursor(drmModeAtomicReqPtr req) {
+  return req ? req->cursor : -EINVAL;
+}
+
+void drmModeAtomicSetCursor(drmModeAtomicReqPtr req, int cursor) {
+  if (req)
+    req->cursor = cursor;
+}
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id,
+                             uint32_t property_id, uint64_t value) {
+  if (!req)
+    return -EINVAL;
+
+  if (req->cursor >= req->size_items) {
+    const uint32_t size =
+        req->size_items + getpagesize() / sizeof(*req->items);
+    auto items = static_cast<drmModeAtomicReqItemPtr>(
+        realloc(req->items, size * sizeof(*req->items)));
+    if (!items)
+      return -ENOMEM;
+    req->items = items;
+    req->size_items = size;
+  }
+
+  req->items[req->cursor].object_id = object_id;
+  req->items[req->cursor].property_id = property_id;
+  req->items[req->cursor].value = value;
+  req->cursor++;
+  return req->cursor;
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+                        void *user_data) {
+  if (!req)
+    return -EINVAL;
+  if (req->cursor == 0)
+    return 0;
+
+  auto device = Device(fd);
+  if (!device)
+    return -EBADF;
+
+  std::vector<FakeKmsDevice::PropertyValue> values(req->cursor);
+  for (uint32_t i = 0; i < req->cursor; i++) {
+    values[i].object_id = req->items[i].object_id;
+    values[i].property_id = req->items[i].property_id;
+    values[i].value = req->items[i].value;
+  }
+  return device->AtomicCommit(values, flags, user_data);
+}
+
+}  // extern "C"
@@ -0,0 +1,534 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <drm_fourcc.h>
+#include <fuzzer/FuzzedDataProvider.h>
+#include <hardware/hwcomposer2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <system/graphics.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "drmdevice.h"
+#include "fakekmsdevice.h"
+
+/*
+ * Frames of window configs committed on the fake the way
+ * ExynosDisplayDrmInterface::deliverWinConfigData() builds them: the plane
+ * properties of setupCommitFromDisplayConfig(), the HAL to DRM enum mapping,
+ * the blobs of the mode, partial and blocking regions through the blob cache of
+ * DrmDevice, the writeback connector and the out-fence. ExynosDisplay does not
+ * build on the host, so the frames are built here on the same DrmDevice,
+ * DrmPlane and DrmProperty objects.
+ *
+ * Every frame is checked with TEST_ONLY first, the real commit must agree with
+ * it. A successful commit must leave the values of the request on the objects
+ * and hand out its fences, a failed one must change nothing.
+ */
+
+#define FUZZ_ASSERT(cond)                                                 \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+      abort();                                                            \
+    }                                                                     \
+  } while (0)
+
+namespace android {
+namespace {
+
+enum WindowState { kStateColor, kStateBuffer, kStateRcd };
+
+constexpr size_t kMaxFrames = 16;
+constexpr uint32_t kFormats[] = {DRM_FORMAT_ARGB8888, DRM_FORMAT_XRGB8888,
+                                 DRM_FORMAT_RGB565, DRM_FORMAT_NV12,
+                                 DRM_FORMAT_ABGR2101010};
+
+class CommitFuzzer {
+ public:
+  CommitFuzzer() {
+    FakeKmsDevice::Config config;
+    config.vsync_timer = false;
+    config.throttle = false;
+    fake_ = FakeKmsDevice::Create(config);
+    FUZZ_ASSERT(fake_ != nullptr);
+    auto [ret, displays] = drm_.Init(fake_->path().c_str(), 0);
+    FUZZ_ASSERT(ret == 0 && displays == 1);
+
+    crtc_ = drm_.GetCrtcForDisplay(0);
+    connector_ = drm_.GetConnectorForDisplay(0);
+    writeback_ = drm_.GetWritebackConnectorForDisplay(0);
+    FUZZ_ASSERT(crtc_ && connector_ && writeback_);
+    if (connector_->modes().empty())
+      connector_->UpdateModes();
+    FUZZ_ASSERT(!connector_->modes().empty());
+    for (const auto &plane : drm_.planes())
+      if (plane->GetCrtcSupported(*crtc_))
+        planes_.push_back(plane.get());
+
+    const DrmPlane &plane = *planes_[0];
+    DrmEnumParser::parseEnums(plane.blend_property(),
+                              {{HWC2_BLEND_MODE_NONE, "None"},
+                               {HWC2_BLEND_MODE_PREMULTIPLIED, "Pre-multiplied"},
+                               {HWC2_BLEND_MODE_COVERAGE, "Coverage"}},
+                              blend_enums_);
+    DrmEnumParser::parseEnums(plane.standard_property(),
+                              {{HAL_DATASPACE_STANDARD_UNSPECIFIED, "Unspecified"},
+                               {HAL_DATASPACE_STANDARD_BT709, "BT709"},
+                               {HAL_DATASPACE_STANDARD_BT601_625, "BT601_625"},
+                               {HAL_DATASPACE_STANDARD_BT601_525, "BT601_525"},
+                               {HAL_DATASPACE_STANDARD_BT2020, "BT2020"},
+                               {HAL_DATASPACE_STANDARD_DCI_P3, "DCI-P3"}},
+                              standard_enums_);
+    DrmEnumParser::parseEnums(plane.transfer_property(),
+                              {{HAL_DATASPACE_TRANSFER_UNSPECIFIED, "Unspecified"},
+                               {HAL_DATASPACE_TRANSFER_LINEAR, "Linear"},
+                               {HAL_DATASPACE_TRANSFER_SRGB, "sRGB"},
+                               {HAL_DATASPACE_TRANSFER_GAMMA2_2, "Gamma 2.2"},
+                               {HAL_DATASPACE_TRANSFER_ST2084, "ST2084"},
+                               {HAL_DATASPACE_TRANSFER_HLG, "HLG"}},
+                              transfer_enums_);
+    DrmEnumParser::parseEnums(plane.range_property(),
+                              {{HAL_DATASPACE_RANGE_UNSPECIFIED, "Unspecified"},
+                               {HAL_DATASPACE_RANGE_FULL, "Full"},
+                               {HAL_DATASPACE_RANGE_LIMITED, "Limited"},
+                               {HAL_DATASPACE_RANGE_EXTENDED, "Extended"}},
+                              range_enums_);
+
+    buffer_fd_ = memfd_create("fakekms_commit_fuzzer", MFD_CLOEXEC);
+    FUZZ_ASSERT(drmPrimeFDToHandle(drm_.fd(), buffer_fd_, &gem_handle_) == 0);
+    // An acquire fence which is already signaled
+    acquire_fence_ = eventfd(1, EFD_CLOEXEC);
+    FUZZ_ASSERT(acquire_fence_ >= 0);
+
+    drmModeCrtcPtr crtc = drmModeGetCrtc(drm_.fd(), crtc_->id());
+    FUZZ_ASSERT(crtc != nullptr);
+    initial_mode_ = crtc->mode;
+    drmModeFreeCrtc(crtc);
+  }
+
+  void Run(FuzzedDataProvider &fdp) {
+    for (size_t i = 0; i < kMaxFrames && fdp.remaining_bytes(); i++)
+      RunFrame(fdp);
+    Reset();
+  }
+
+ private:
+  struct Frame {
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    std::vector<FakeKmsDevice::PropertyValue> values;
+    std::vector<uint32_t> fbs;
+    std::vector<uint32_t> blobs;
+    std::vector<uint32_t> old_blobs;
+    ~Frame() {
+      drmModeAtomicFree(req);
+    }
+  };
+
+  // ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty()
+  static int Add(Frame &frame, uint32_t object_id, const DrmProperty &property,
+                 uint64_t value, bool optional = false) {
+    if (!optional && !property.id())
+      return -EINVAL;
+    if (property.id() && property.validateChange(value)) {
+      int ret = drmModeAtomicAddProperty(frame.req, object_id, property.id(),
+                                         value);
+      if (ret < 0)
+        return ret;
+      frame.values.push_back({object_id, property.id(), value});
+    }
+    return 0;
+  }
+
+  // FramebufferManager::getBuffer(), without its cache
+  int AddFb(Frame &frame, uint32_t width, uint32_t height, uint32_t format,
+            uint32_t *fb_id) {
+    uint32_t handles[4] = {gem_handle_};
+    uint32_t pitches[4] = {width * 4};
+    uint32_t offsets[4] = {};
+    uint64_t modifiers[4] = {};
+    int ret = drmModeAddFB2WithModifiers(drm_.fd(), width, height, format,
+                                         handles, pitches, offsets, modifiers,
+                                         fb_id, DRM_MODE_FB_MODIFIERS);
+    if (ret == 0)
+      frame.fbs.push_back(*fb_id);
+    return ret;
+  }
+
+  int CreateBlob(Frame &frame, const void *data, size_t length,
+                 uint32_t *blob_id) {
+    int ret = drm_.CreatePropertyBlob(data, length, blob_id);
+    if (ret == 0) {
+      // The blob cache hands out blobs with the payload asked for
+      std::vector<uint8_t> blob = fake_->GetBlob(*blob_id);
+      FUZZ_ASSERT(blob.size() == length && !memcmp(blob.data(), data, length));
+      frame.blobs.push_back(*blob_id);
+    }
+    return ret;
+  }
+
+  // Replaces the committed blob of a state once the frame is committed
+  static void SetBlob(Frame &frame, uint32_t &state, uint32_t blob_id) {
+    if (state)
+      frame.old_blobs.push_back(state);
+    state = blob_id;
+  }
+
+  // setupCommitFromDisplayConfig()
+  int AddWindow(Frame &frame, FuzzedDataProvider &fdp, const DrmPlane &plane,
+                uint32_t index, std::map<uint32_t, uint32_t> &blob_states) {
+    const WindowState state =
+        fdp.PickValueInArray({kStateColor, kStateBuffer, kStateRcd});
+    const uint32_t width = fdp.ConsumeIntegralInRange<uint32_t>(0, 4096);
+    const uint32_t height = fdp.ConsumeIntegralInRange<uint32_t>(0, 4096);
+    uint32_t fb_id = 0;
+    int ret = AddFb(frame, width, height, fdp.PickValueInArray(kFormats), &fb_id);
+    if (ret)
+      return ret;
+
+    const uint32_t id = plane.id();
+    if ((ret = Add(frame, id, plane.crtc_property(), crtc_->id())) ||
+        (ret = Add(frame, id, plane.fb_property(), fb_id)) ||
+        (ret = Add(frame, id, plane.crtc_x_property(), fdp.ConsumeIntegral<int16_t>())) ||
+        (ret = Add(frame, id, plane.crtc_y_property(), fdp.ConsumeIntegral<int16_t>())) ||
+        (ret = Add(frame, id, plane.crtc_w_property(), fdp.ConsumeIntegral<uint16_t>())) ||
+        (ret = Add(frame, id, plane.crtc_h_property(), fdp.ConsumeIntegral<uint16_t>())) ||
+        (ret = Add(frame, id, plane.src_x_property(),
+                   static_cast<uint64_t>(fdp.ConsumeIntegral<uint16_t>()) << 16)) ||
+        (ret = Add(frame, id, plane.src_y_property(),
+                   static_cast<uint64_t>(fdp.ConsumeIntegral<uint16_t>()) << 16)) ||
+        (ret = Add(frame, id, plane.src_w_property(),
+                   static_cast<uint64_t>(fdp.ConsumeIntegral<uint16_t>()) << 16)) ||
+        (ret = Add(frame, id, plane.src_h_property(),
+                   static_cast<uint64_t>(fdp.ConsumeIntegral<uint16_t>()) << 16)) ||
+        (ret = Add(frame, id, plane.rotation_property(),
+                   fdp.ConsumeIntegral<uint8_t>(), true)))
+      return ret;
+
+    uint64_t drm_enum = 0;
+    std::tie(drm_enum, ret) = DrmEnumParser::halToDrmEnum(
+        fdp.ConsumeIntegralInRange<uint32_t>(0, 4), blend_enums_);
+    if (ret || (ret = Add(frame, id, plane.blend_property(), drm_enum, true)))
+      return ret;
+
+    if (plane.zpos_property().id() && !plane.zpos_property().isImmutable()) {
+      uint64_t min_zpos = 0;
+      std::tie(std::ignore, min_zpos) = plane.zpos_property().rangeMin();
+      if ((ret = Add(frame, id, plane.zpos_property(), index + min_zpos)))
+        return ret;
+    }
+    if (plane.alpha_property().id()) {
+      uint64_t min_alpha = 0, max_alpha = 0;
+      std::tie(std::ignore, min_alpha) = plane.alpha_property().rangeMin();
+      std::tie(std::ignore, max_alpha) = plane.alpha_property().rangeMax();
+      const float alpha = fdp.ConsumeProbability<float>();
+      if ((ret = Add(frame, id, plane.alpha_property(),
+                     (uint64_t)(((max_alpha - min_alpha) * alpha) + 0.5) + min_alpha,
+                     true)))
+        return ret;
+    }
+    if (fdp.ConsumeBool() &&
+        (ret = Add(frame, id, plane.in_fence_fd_property(), acquire_fence_)))
+      return ret;
+    if (state == kStateColor && plane.colormap_property().id() &&
+        (ret = Add(frame, id, plane.colormap_property(), fdp.ConsumeIntegral<uint32_t>())))
+      return ret;
+
+    // Components of the dataspace unknown to the mapping fail the frame
+    const uint32_t standard = fdp.ConsumeIntegralInRange<uint32_t>(0, 12)
+                              << HAL_DATASPACE_STANDARD_SHIFT;
+    const uint32_t transfer = fdp.ConsumeIntegralInRange<uint32_t>(0, 10)
+                              << HAL_DATASPACE_TRANSFER_SHIFT;
+    const uint32_t range = fdp.ConsumeIntegralInRange<uint32_t>(0, 4)
+                           << HAL_DATASPACE_RANGE_SHIFT;
+    const std::pair<uint32_t, const DrmEnumParser::MapHal2DrmEnum *> components[] =
+        {{standard, &standard_enums_}, {transfer, &transfer_enums_},
+         {range, &range_enums_}};
+    const DrmProperty *properties[] = {&plane.standard_property(),
+                                       &plane.transfer_property(),
+                                       &plane.range_property()};
+    for (size_t i = 0; i < 3; i++) {
+      std::tie(drm_enum, ret) = DrmEnumParser::halToDrmEnum(
+          components[i].first, *components[i].second);
+      if (ret || (ret = Add(frame, id, *properties[i], drm_enum, true)))
+        return ret;
+    }
+    if (transfer == HAL_DATASPACE_TRANSFER_ST2084 ||
+        transfer == HAL_DATASPACE_TRANSFER_HLG) {
+      if ((ret = Add(frame, id, plane.min_luminance_property(),
+                     fdp.ConsumeIntegral<uint32_t>())) ||
+          (ret = Add(frame, id, plane.max_luminance_property(),
+                     fdp.ConsumeIntegral<uint32_t>())))
+        return ret;
+    }
+
+    if (state == kStateRcd && plane.block_property().id()) {
+      // A blocking region blob is only created when the region changes
+      const drm_clip_rect region = {fdp.ConsumeIntegral<uint16_t>(),
+                                    fdp.ConsumeIntegral<uint16_t>(),
+                                    fdp.ConsumeIntegral<uint16_t>(),
+                                    fdp.ConsumeIntegral<uint16_t>()};
+      uint32_t &block = blob_states[id];
+      if (!block || fake_->GetBlob(block).size() != sizeof(region) ||
+          memcmp(fake_->GetBlob(block).data(), &region, sizeof(region))) {
+        uint32_t blob_id = 0;
+        if ((ret = CreateBlob(frame, &region, sizeof(region), &blob_id)))
+          return ret;
+        SetBlob(frame, block, blob_id);
+      }
+      if ((ret = Add(frame, id, plane.block_property(), block)))
+        return ret;
+    }
+    return 0;
+  }
+
+  void RunFrame(FuzzedDataProvider &fdp) {
+    Frame frame;
+    uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK;
+    // The committed blobs of the next state, applied on success
+    uint32_t mode_blob = mode_blob_;
+    uint32_t partial_blob = partial_blob_;
+    std::map<uint32_t, uint32_t> block_blobs = block_blobs_;
+    bool writeback_attached = writeback_attached_;
+    int ret = 0;
+
+    if (fdp.ConsumeBool()) {
+      const auto &modes = connector_->modes();
+      drm_mode_modeinfo mode;
+      modes[fdp.ConsumeIntegralInRange<size_t>(0, modes.size() - 1)]
+          .ToDrmModeModeInfo(&mode);
+      uint32_t blob_id = 0;
+      if (CreateBlob(frame, &mode, sizeof(mode), &blob_id))
+        return Discard(frame);
+      SetBlob(frame, mode_blob, blob_id);
+      Add(frame, crtc_->id(), crtc_->mode_property(), blob_id);
+      Add(frame, crtc_->id(), crtc_->active_property(), 1);
+      flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+    }
+
+    if (fdp.ConsumeBool()) {
+      const drm_clip_rect rect = {fdp.ConsumeIntegral<uint16_t>(),
+                                  fdp.ConsumeIntegral<uint16_t>(),
+                                  fdp.ConsumeIntegral<uint16_t>(),
+                                  fdp.ConsumeIntegral<uint16_t>()};
+      uint32_t blob_id = 0;
+      if (CreateBlob(frame, &rect, sizeof(rect), &blob_id))
+        return Discard(frame);
+      SetBlob(frame, partial_blob, blob_id);
+      Add(frame, crtc_->id(), crtc_->partial_region_property(), blob_id);
+    }
+
+    int32_t out_fence = -1;
+    Add(frame, crtc_->id(), crtc_->out_fence_ptr_property(),
+        reinterpret_cast<uint64_t>(&out_fence), true);
+    Add(frame, crtc_->id(), crtc_->dqe_enabled_property(), fdp.ConsumeBool(),
+        true);
+
+    // Windows on distinct channels, the other planes of the CRTC are disabled
+    std::vector<DrmPlane *> free_planes = planes_;
+    const size_t windows =
+        fdp.ConsumeIntegralInRange<size_t>(0, free_planes.size());
+    for (size_t i = 0; i < windows; i++) {
+      const size_t channel =
+          fdp.ConsumeIntegralInRange<size_t>(0, free_planes.size() - 1);
+      if (AddWindow(frame, fdp, *free_planes[channel], i, block_blobs))
+        return Discard(frame);
+      free_planes.erase(free_planes.begin() + channel);
+    }
+    for (DrmPlane *plane : free_planes) {
+      Add(frame, plane->id(), plane->crtc_property(), 0);
+      Add(frame, plane->id(), plane->fb_property(), 0);
+    }
+
+    // The writeback connector stays attached while readback is requested
+    int32_t writeback_fence = -1;
+    const uint8_t readback = fdp.ConsumeIntegralInRange<uint8_t>(0, 2);
+    if (readback == 1) {
+      uint32_t fb_id = 0;
+      if (AddFb(frame, initial_mode_.hdisplay, initial_mode_.vdisplay,
+                DRM_FORMAT_ARGB8888, &fb_id))
+        return Discard(frame);
+      Add(frame, writeback_->id(), writeback_->writeback_fb_id(), fb_id);
+      Add(frame, writeback_->id(), writeback_->writeback_out_fence(),
+          reinterpret_cast<uint64_t>(&writeback_fence));
+      if (!writeback_attached)
+        Add(frame, writeback_->id(), writeback_->crtc_id_property(),
+            crtc_->id());
+      writeback_attached = true;
+    } else if (readback == 2 && writeback_attached) {
+      Add(frame, writeback_->id(), writeback_->writeback_fb_id(), 0);
+      Add(frame, writeback_->id(), writeback_->writeback_out_fence(), 0);
+      Add(frame, writeback_->id(), writeback_->crtc_id_property(), 0);
+      writeback_attached = false;
+      flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+    }
+
+    std::vector<uint64_t> before = Snapshot(frame);
+    const int test = drmModeAtomicCommit(drm_.fd(), frame.req,
+                                         flags | DRM_MODE_ATOMIC_TEST_ONLY,
+                                         nullptr);
+    FUZZ_ASSERT(out_fence == -1 && writeback_fence == -1);
+    FUZZ_ASSERT(Snapshot(frame) == before);
+
+    ret = drmModeAtomicCommit(drm_.fd(), frame.req, flags, nullptr);
+    std::vector<FakeKmsDevice::Commit> commits = fake_->TakeCommits();
+    FUZZ_ASSERT(commits.size() == 2 && commits.back().result == ret);
+    FUZZ_ASSERT(ret == test);
+    if (ret) {
+      FUZZ_ASSERT(out_fence == -1 && writeback_fence == -1);
+      FUZZ_ASSERT(Snapshot(frame) == before);
+      return Discard(frame);
+    }
+
+    FUZZ_ASSERT(out_fence >= 0);
+    close(out_fence);
+    FUZZ_ASSERT((readback == 1) == (writeback_fence >= 0));
+    if (writeback_fence >= 0)
+      close(writeback_fence);
+    for (const auto &value : frame.values) {
+      uint64_t current = 0;
+      if (!Persistent(value.property_id))
+        continue;
+      FUZZ_ASSERT(fake_->GetPropertyValue(value.object_id,
+                                          Name(value.property_id),
+                                          &current) == 0);
+      FUZZ_ASSERT(current == value.value);
+    }
+    fake_->Vblank(crtc_->id());
+
+    // The framebuffers of the previous frame are not scanned out any more
+    for (uint32_t fb_id : committed_fbs_)
+      drmModeRmFB(drm_.fd(), fb_id);
+    committed_fbs_ = frame.fbs;
+    for (uint32_t blob_id : frame.old_blobs)
+      FUZZ_ASSERT(drm_.DestroyPropertyBlob(blob_id) == 0);
+    mode_blob_ = mode_blob;
+    partial_blob_ = partial_blob;
+    block_blobs_ = block_blobs;
+    writeback_attached_ = writeback_attached;
+  }
+
+  // The frame did not make it to the display
+  void Discard(Frame &frame) {
+    for (uint32_t fb_id : frame.fbs)
+      drmModeRmFB(drm_.fd(), fb_id);
+    for (uint32_t blob_id : frame.blobs)
+      FUZZ_ASSERT(drm_.DestroyPropertyBlob(blob_id) == 0);
+  }
+
+  // Values of the persistent properties the frame sets, as committed so far
+  std::vector<uint64_t> Snapshot(const Frame &frame) {
+    std::vector<uint64_t> values;
+    for (const auto &value : frame.values) {
+      uint64_t current = 0;
+      if (Persistent(value.property_id))
+        fake_->GetPropertyValue(value.object_id, Name(value.property_id),
+                                &current);
+      values.push_back(current);
+    }
+    return values;
+  }
+
+  std::string Name(uint32_t property_id) {
+    drmModePropertyPtr property = drmModeGetProperty(drm_.fd(), property_id);
+    FUZZ_ASSERT(property != nullptr);
+    std::string name = property->name;
+    drmModeFreeProperty(property);
+    return name;
+  }
+
+  bool Persistent(uint32_t property_id) {
+    const std::string name = Name(property_id);
+    return name != "OUT_FENCE_PTR" && name != "IN_FENCE_FD" &&
+           name != "WRITEBACK_OUT_FENCE_PTR" && name != "WRITEBACK_FB_ID";
+  }
+
+  // Back to the state of the first input, each input runs on its own
+  void Reset() {
+    Frame frame;
+    uint32_t mode_blob = 0;
+    FUZZ_ASSERT(drm_.CreatePropertyBlob(&initial_mode_, sizeof(initial_mode_),
+                                        &mode_blob) == 0);
+    Add(frame, crtc_->id(), crtc_->mode_property(), mode_blob);
+    Add(frame, crtc_->id(), crtc_->active_property(), 1);
+    Add(frame, crtc_->id(), crtc_->partial_region_property(), 0);
+    for (DrmPlane *plane : planes_) {
+      Add(frame, plane->id(), plane->crtc_property(), 0);
+      Add(frame, plane->id(), plane->fb_property(), 0);
+      Add(frame, plane->id(), plane->block_property(), 0, true);
+    }
+    Add(frame, writeback_->id(), writeback_->crtc_id_property(), 0);
+    FUZZ_ASSERT(drmModeAtomicCommit(drm_.fd(), frame.req,
+                                    DRM_MODE_ATOMIC_ALLOW_MODESET, nullptr) == 0);
+    fake_->Vblank(crtc_->id());
+    fake_->TakeCommits();
+
+    for (uint32_t fb_id : committed_fbs_)
+      drmModeRmFB(drm_.fd(), fb_id);
+    committed_fbs_.clear();
+    for (uint32_t blob_id : {mode_blob_, partial_blob_, mode_blob})
+      if (blob_id)
+        FUZZ_ASSERT(drm_.DestroyPropertyBlob(blob_id) == 0);
+    for (auto &[plane_id, blob_id] : block_blobs_)
+      if (blob_id)
+        FUZZ_ASSERT(drm_.DestroyPropertyBlob(blob_id) == 0);
+    mode_blob_ = 0;
+    partial_blob_ = 0;
+    block_blobs_.clear();
+    writeback_attached_ = false;
+  }
+
+  std::shared_ptr<FakeKmsDevice> fake_;
+  DrmDevice drm_;
+  DrmCrtc *crtc_ = nullptr;
+  DrmConnector *connector_ = nullptr;
+  DrmConnector *writeback_ = nullptr;
+  std::vector<DrmPlane *> planes_;
+  DrmEnumParser::MapHal2DrmEnum blend_enums_;
+  DrmEnumParser::MapHal2DrmEnum standard_enums_;
+  DrmEnumParser::MapHal2DrmEnum transfer_enums_;
+  DrmEnumParser::MapHal2DrmEnum range_enums_;
+  int buffer_fd_ = -1;
+  uint32_t gem_handle_ = 0;
+  int acquire_fence_ = -1;
+  drmModeModeInfo initial_mode_;
+
+  // The state committed by the frames of the input
+  std::vector<uint32_t> committed_fbs_;
+  uint32_t mode_blob_ = 0;
+  uint32_t partial_blob_ = 0;
+  std::map<uint32_t, uint32_t> block_blobs_;
+  bool writeback_attached_ = false;
+};
+
+}  // namespace
+}  // namespace android
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static android::CommitFuzzer fuzzer;
+  FuzzedDataProvider fdp(data, size);
+  fuzzer.Run(fdp);
+  return 0;
+}
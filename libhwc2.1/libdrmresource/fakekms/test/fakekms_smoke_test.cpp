@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <drm_fourcc.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <algorithm>
+
+#include "drmdevice.h"
+#include "fakekmsdevice.h"
+
+namespace android {
+namespace {
+
+/*
+ * DrmDevice initialized on a fake with one panel. Vblanks only happen on
+ * FakeKmsDevice::Vblank(), and the event listener thread is not started, so
+ * the events of the fake stay on the fd for the test to read.
+ */
+class FakeKmsSmokeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FakeKmsDevice::Config config;
+    config.vsync_timer = false;
+    fake_ = FakeKmsDevice::Create(config);
+    ASSERT_NE(nullptr, fake_);
+
+    auto [ret, displays] = drm_.Init(fake_->path().c_str(), 0);
+    ASSERT_EQ(0, ret);
+    ASSERT_EQ(1, displays);
+
+    crtc_ = drm_.GetCrtcForDisplay(0);
+    ASSERT_NE(nullptr, crtc_);
+    for (const auto &plane : drm_.planes()) {
+      if (plane->GetCrtcSupported(*crtc_)) {
+        plane_ = plane.get();
+        break;
+      }
+    }
+    ASSERT_NE(nullptr, plane_);
+  }
+
+  void TearDown() override {
+    if (fb_id_)
+      drmModeRmFB(drm_.fd(), fb_id_);
+    if (buffer_fd_ >= 0)
+      close(buffer_fd_);
+  }
+
+  // A framebuffer of the size of the panel on an imported memfd
+  void AddFb() {
+    buffer_fd_ = memfd_create("fakekms_smoke_test", MFD_CLOEXEC);
+    ASSERT_GE(buffer_fd_, 0);
+    uint32_t handle = 0;
+    ASSERT_EQ(0, drmPrimeFDToHandle(drm_.fd(), buffer_fd_, &handle));
+
+    uint32_t handles[4] = {handle};
+    uint32_t pitches[4] = {kWidth * 4};
+    uint32_t offsets[4] = {};
+    uint64_t modifiers[4] = {};
+    ASSERT_EQ(0, drmModeAddFB2WithModifiers(drm_.fd(), kWidth, kHeight,
+                                            DRM_FORMAT_ARGB8888, handles,
+                                            pitches, offsets, modifiers,
+                                            &fb_id_, DRM_MODE_FB_MODIFIERS));
+  }
+
+  // Scans fb_id_ out on the whole panel
+  void AddPlane(drmModeAtomicReqPtr req) {
+    const uint32_t id = plane_->id();
+    drmModeAtomicAddProperty(req, id, plane_->crtc_property().id(), crtc_->id());
+    drmModeAtomicAddProperty(req, id, plane_->fb_property().id(), fb_id_);
+    drmModeAtomicAddProperty(req, id, plane_->crtc_x_property().id(), 0);
+    drmModeAtomicAddProperty(req, id, plane_->crtc_y_property().id(), 0);
+    drmModeAtomicAddProperty(req, id, plane_->crtc_w_property().id(), kWidth);
+    drmModeAtomicAddProperty(req, id, plane_->crtc_h_property().id(), kHeight);
+    drmModeAtomicAddProperty(req, id, plane_->src_x_property().id(), 0);
+    drmModeAtomicAddProperty(req, id, plane_->src_y_property().id(), 0);
+    drmModeAtomicAddProperty(req, id, plane_->src_w_property().id(),
+                             static_cast<uint64_t>(kWidth) << 16);
+    drmModeAtomicAddProperty(req, id, plane_->src_h_property().id(),
+                             static_cast<uint64_t>(kHeight) << 16);
+  }
+
+  static uint64_t CommittedValue(const FakeKmsDevice::Commit &commit,
+                                 uint32_t object_id, uint32_t property_id) {
+    auto it = std::find_if(commit.values.begin(), commit.values.end(),
+                           [=](const FakeKmsDevice::PropertyValue &v) {
+                             return v.object_id == object_id &&
+                                    v.property_id == property_id;
+                           });
+    return it == commit.values.end() ? UINT64_MAX : it->value;
+  }
+
+  static constexpr uint32_t kWidth = 1080;
+  static constexpr uint32_t kHeight = 2400;
+
+  std::shared_ptr<FakeKmsDevice> fake_;
+  DrmDevice drm_;
+  DrmCrtc *crtc_ = nullptr;
+  DrmPlane *plane_ = nullptr;
+  int buffer_fd_ = -1;
+  uint32_t fb_id_ = 0;
+};
+
+TEST_F(FakeKmsSmokeTest, Init) {
+  EXPECT_EQ(fake_->crtcs().size(), drm_.crtcs().size());
+  EXPECT_EQ(fake_->planes().size(), drm_.planes().size());
+  EXPECT_EQ(fake_->crtcs()[0], crtc_->id());
+
+  DrmConnector *connector = drm_.GetConnectorForDisplay(0);
+  ASSERT_NE(nullptr, connector);
+  EXPECT_TRUE(connector->internal());
+  EXPECT_NE(nullptr, drm_.GetWritebackConnectorForDisplay(0));
+
+  // The vendor properties DrmCrtc looks up are found on the fake
+  EXPECT_NE(0u, crtc_->dqe_enabled_property().id());
+}
+
+TEST_F(FakeKmsSmokeTest, AtomicCommitWithPlaneAndBlob) {
+  ASSERT_NO_FATAL_FAILURE(AddFb());
+
+  drmModeCrtcPtr crtc = drmModeGetCrtc(drm_.fd(), crtc_->id());
+  ASSERT_NE(nullptr, crtc);
+  ASSERT_TRUE(crtc->mode_valid);
+  drmModeModeInfo mode = crtc->mode;
+  drmModeFreeCrtc(crtc);
+
+  uint32_t mode_blob = 0;
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&mode, sizeof(mode), &mode_blob));
+
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  ASSERT_NE(nullptr, req);
+  AddPlane(req);
+  drmModeAtomicAddProperty(req, crtc_->id(), crtc_->mode_property().id(),
+                           mode_blob);
+  EXPECT_EQ(0, drmModeAtomicCommit(drm_.fd(), req,
+                                   DRM_MODE_ATOMIC_ALLOW_MODESET, nullptr));
+  drmModeAtomicFree(req);
+
+  std::vector<FakeKmsDevice::Commit> commits = fake_->TakeCommits();
+  ASSERT_EQ(1u, commits.size());
+  EXPECT_EQ(0, commits[0].result);
+  EXPECT_EQ(fb_id_, CommittedValue(commits[0], plane_->id(),
+                                   plane_->fb_property().id()));
+  EXPECT_EQ(mode_blob, CommittedValue(commits[0], crtc_->id(),
+                                      crtc_->mode_property().id()));
+
+  uint64_t value = 0;
+  EXPECT_EQ(0, fake_->GetPropertyValue(plane_->id(), "FB_ID", &value));
+  EXPECT_EQ(fb_id_, value);
+  EXPECT_EQ(0, fake_->GetPropertyValue(crtc_->id(), "MODE_ID", &value));
+  EXPECT_EQ(mode_blob, value);
+  std::vector<uint8_t> blob = fake_->GetBlob(mode_blob);
+  ASSERT_EQ(sizeof(mode), blob.size());
+  EXPECT_EQ(0, memcmp(&mode, blob.data(), sizeof(mode)));
+
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(mode_blob));
+}
+
+TEST_F(FakeKmsSmokeTest, VblankEvent) {
+  ASSERT_NO_FATAL_FAILURE(AddFb());
+
+  drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+  ASSERT_NE(nullptr, req);
+  AddPlane(req);
+  void *user_data = this;
+  EXPECT_EQ(0, drmModeAtomicCommit(drm_.fd(), req,
+                                   DRM_MODE_ATOMIC_NONBLOCK |
+                                       DRM_MODE_PAGE_FLIP_EVENT,
+                                   user_data));
+  drmModeAtomicFree(req);
+
+  // Nothing is latched before the vblank
+  struct pollfd fd = {drm_.fd(), POLLIN, 0};
+  EXPECT_EQ(0, poll(&fd, 1, 0));
+
+  const uint64_t sequence = fake_->vblank_count(crtc_->id());
+  fake_->Vblank(crtc_->id());
+  EXPECT_EQ(sequence + 1, fake_->vblank_count(crtc_->id()));
+
+  ASSERT_EQ(1, poll(&fd, 1, 1000));
+  struct drm_event_vblank event;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(event)),
+            read(drm_.fd(), &event, sizeof(event)));
+  EXPECT_EQ(static_cast<uint32_t>(DRM_EVENT_FLIP_COMPLETE), event.base.type);
+  EXPECT_EQ(reinterpret_cast<uint64_t>(user_data), event.user_data);
+  EXPECT_EQ(crtc_->id(), event.crtc_id);
+  EXPECT_EQ(static_cast<uint32_t>(sequence + 1), event.sequence);
+}
+
+TEST_F(FakeKmsSmokeTest, BlobReuse) {
+  const uint32_t a = 1, b = 2;
+  uint32_t blob_a = 0, blob_b = 0, again = 0;
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&a, sizeof(a), &blob_a));
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&b, sizeof(b), &blob_b));
+  EXPECT_NE(blob_a, blob_b);
+
+  // the same payload gets the blob already created for it
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&a, sizeof(a), &again));
+  EXPECT_EQ(blob_a, again);
+
+  // a payload of another length is another blob, even with the same bytes
+  const uint64_t a64 = 1;
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&a64, sizeof(a64), &again));
+  EXPECT_NE(blob_a, again);
+  EXPECT_EQ(sizeof(a64), fake_->GetBlob(again).size());
+
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(again));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob_a));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob_a));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob_b));
+  // more destroys than creates
+  EXPECT_EQ(-EINVAL, drm_.DestroyPropertyBlob(blob_a));
+}
+
+TEST_F(FakeKmsSmokeTest, BlobRefsAcrossOldBlobs) {
+  drmModeCrtcPtr crtc = drmModeGetCrtc(drm_.fd(), crtc_->id());
+  ASSERT_NE(nullptr, crtc);
+  drmModeModeInfo mode = crtc->mode;
+  drmModeFreeCrtc(crtc);
+
+  // Like the mode state of a display: every frame creates the blob of its
+  // mode and destroys the one of the previous frame once it is committed
+  uint32_t old_blob = 0;
+  for (int frame = 0; frame < 3; frame++) {
+    uint32_t blob = 0;
+    ASSERT_EQ(0, drm_.CreatePropertyBlob(&mode, sizeof(mode), &blob));
+    if (old_blob)
+      EXPECT_EQ(old_blob, blob);
+
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    ASSERT_NE(nullptr, req);
+    drmModeAtomicAddProperty(req, crtc_->id(), crtc_->mode_property().id(),
+                             blob);
+    EXPECT_EQ(0, drmModeAtomicCommit(drm_.fd(), req,
+                                     DRM_MODE_ATOMIC_ALLOW_MODESET, nullptr));
+    drmModeAtomicFree(req);
+
+    // the old blob of the frame before still holds the committed one
+    EXPECT_EQ(0, drm_.DestroyPropertyBlob(old_blob));
+    EXPECT_EQ(sizeof(mode), fake_->GetBlob(blob).size());
+    uint64_t value = 0;
+    EXPECT_EQ(0, fake_->GetPropertyValue(crtc_->id(), "MODE_ID", &value));
+    EXPECT_EQ(blob, value);
+    old_blob = blob;
+  }
+
+  // the last reference is dropped, the kernel blob is kept for the next user
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(old_blob));
+  EXPECT_EQ(sizeof(mode), fake_->GetBlob(old_blob).size());
+  uint32_t blob = 0;
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&mode, sizeof(mode), &blob));
+  EXPECT_EQ(old_blob, blob);
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob));
+}
+
+TEST_F(FakeKmsSmokeTest, BlobEviction) {
+  // kMaxUnusedBlobs unused blobs of the payloads 0, 1, ..., in that order
+  std::vector<uint32_t> blobs(DrmDevice::kMaxUnusedBlobs + 2);
+  auto create_and_destroy = [&](uint32_t payload) {
+    ASSERT_EQ(0, drm_.CreatePropertyBlob(&payload, sizeof(payload),
+                                         &blobs[payload]));
+    EXPECT_EQ(0, drm_.DestroyPropertyBlob(blobs[payload]));
+  };
+  for (uint32_t i = 0; i < DrmDevice::kMaxUnusedBlobs; i++)
+    create_and_destroy(i);
+  for (uint32_t i = 0; i < DrmDevice::kMaxUnusedBlobs; i++)
+    EXPECT_FALSE(fake_->GetBlob(blobs[i]).empty()) << i;
+
+  // reusing 1 makes it the most recently destroyed one
+  const uint32_t blob_1 = blobs[1];
+  create_and_destroy(1);
+  EXPECT_EQ(blob_1, blobs[1]);
+
+  // each new one evicts the least recently destroyed one
+  create_and_destroy(DrmDevice::kMaxUnusedBlobs);
+  EXPECT_TRUE(fake_->GetBlob(blobs[0]).empty());
+  create_and_destroy(DrmDevice::kMaxUnusedBlobs + 1);
+  EXPECT_TRUE(fake_->GetBlob(blobs[2]).empty());
+  for (uint32_t i = 3; i < blobs.size(); i++)
+    EXPECT_FALSE(fake_->GetBlob(blobs[i]).empty()) << i;
+
+  create_and_destroy(1);
+  EXPECT_EQ(blob_1, blobs[1]);
+
+  // an evicted payload gets a new blob
+  const uint32_t blob_0 = blobs[0];
+  create_and_destroy(0);
+  EXPECT_NE(blob_0, blobs[0]);
+  EXPECT_FALSE(fake_->GetBlob(blobs[0]).empty());
+}
+
+TEST_F(FakeKmsSmokeTest, BlobHashCollision) {
+  drm_.SetBlobHash([](const void *, size_t) -> size_t { return 0; });
+
+  const uint32_t a = 1, b = 2;
+  uint32_t blob_a = 0, blob_b = 0, again = 0;
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&a, sizeof(a), &blob_a));
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&b, sizeof(b), &blob_b));
+  // the same hash is not the same payload
+  EXPECT_NE(blob_a, blob_b);
+  std::vector<uint8_t> data = fake_->GetBlob(blob_b);
+  ASSERT_EQ(sizeof(b), data.size());
+  EXPECT_EQ(0, memcmp(&b, data.data(), sizeof(b)));
+
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&b, sizeof(b), &again));
+  EXPECT_EQ(blob_b, again);
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(again));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob_b));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob_a));
+
+  // evicting a evicts the entry of a only, b is still found
+  for (uint32_t i = 3; i < 3 + DrmDevice::kMaxUnusedBlobs - 1; i++) {
+    uint32_t blob = 0;
+    ASSERT_EQ(0, drm_.CreatePropertyBlob(&i, sizeof(i), &blob));
+    EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob));
+  }
+  EXPECT_TRUE(fake_->GetBlob(blob_b).empty());
+  EXPECT_FALSE(fake_->GetBlob(blob_a).empty());
+  ASSERT_EQ(0, drm_.CreatePropertyBlob(&a, sizeof(a), &again));
+  EXPECT_EQ(blob_a, again);
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(again));
+}
+
+TEST_F(FakeKmsSmokeTest, UnknownBlobIsDestroyed) {
+  // a blob not created through CreatePropertyBlob() is destroyed right away
+  const uint32_t payload = 7;
+  uint32_t blob = 0;
+  ASSERT_EQ(0, drmModeCreatePropertyBlob(drm_.fd(), &payload, sizeof(payload),
+                                         &blob));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(blob));
+  EXPECT_TRUE(fake_->GetBlob(blob).empty());
+
+  // the kernel tells about the ids it does not know
+  EXPECT_NE(0, drm_.DestroyPropertyBlob(blob));
+  EXPECT_EQ(0, drm_.DestroyPropertyBlob(0));
+}
+
+}  // namespace
+}  // namespace android
@@ -23,9 +23,13 @@
 #include "drmeventlistener.h"
 #include "drmplane.h"
 
+#include <list>
 #include <map>
+#include <mutex>
 #include <stdint.h>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -75,8 +79,17 @@ class DrmDevice {
   const std::vector<std::unique_ptr<DrmCrtc>> &crtcs() const;
   uint32_t next_mode_id();
 
+  // Blobs are shared by payload: creating a blob with the payload of a blob
+  // still in use or one of the last kMaxUnusedBlobs destroyed returns its id.
+  // Every CreatePropertyBlob() has to be matched by a DestroyPropertyBlob().
   int CreatePropertyBlob(const void *data, size_t length, uint32_t *blob_id);
   int DestroyPropertyBlob(uint32_t blob_id);
+  static constexpr size_t kMaxUnusedBlobs = 16;
+  // The payloads are told apart by a full compare, tests make them collide
+  using BlobHash = size_t (*)(const void *data, size_t length);
+  void SetBlobHash(BlobHash hash) {
+    blob_hash_ = hash;
+  }
   bool HandlesDisplay(int display) const;
   void RegisterHotplugHandler(const std::shared_ptr<DrmEventHandler> &handler) {
     event_listener_.RegisterHotplugHandler(handler);
@@ -104,6 +117,18 @@ class DrmDevice {
   int CreateDisplayPipe(DrmConnector *connector);
   int AttachWriteback(DrmConnector *display_conn);
 
+  struct PropertyBlob {
+    std::vector<uint8_t> data;
+    size_t hash;
+    uint32_t refs;
+    // position in unused_blobs_ while refs is 0
+    std::list<uint32_t>::iterator unused;
+  };
+
+  static size_t HashBlob(const void *data, size_t length);
+  int DestroyKernelBlob(uint32_t blob_id);
+  void EvictUnusedBlobs(size_t max_unused);
+
   UniqueFd fd_;
   uint32_t mode_id_ = 0;
 
@@ -117,6 +142,12 @@ class DrmDevice {
   std::pair<uint32_t, uint32_t> min_resolution_;
   std::pair<uint32_t, uint32_t> max_resolution_;
   std::map<int, int> displays_;
+
+  std::mutex blobs_lock_;
+  std::unordered_map<uint32_t, PropertyBlob> blobs_;
+  std::unordered_multimap<size_t, uint32_t> blob_ids_;  // by payload hash
+  std::list<uint32_t> unused_blobs_;  // least recently destroyed first
+  BlobHash blob_hash_ = HashBlob;
 };
 }  // namespace android
 
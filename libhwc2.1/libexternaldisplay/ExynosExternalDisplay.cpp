@@ -119,6 +119,7 @@ void ExynosExternalDisplay::closeExternalDisplay()
         layer->mAcquireFence = fence_close(layer->mAcquireFence, this, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_LAYER);
         layer->mReleaseFence = -1;
         layer->mLayerBuffer = NULL;
+        layer->mLayerBufferMeta = BufferMetaInfo();
     }
 
     mClientCompositionInfo.initializeInfosComplete(this);
@@ -406,7 +407,8 @@ int32_t ExynosExternalDisplay::presentDisplay(
 }
 int32_t ExynosExternalDisplay::setClientTarget(
         buffer_handle_t target,
-        int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace) {
+        int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace,
+        hwc_region_t damage) {
     buffer_handle_t handle = NULL;
     if (target != NULL)
         handle = target;
@@ -427,7 +429,7 @@ int32_t ExynosExternalDisplay::setClientTarget(
             return NO_ERROR;
         }
     }
-    return ExynosDisplay::setClientTarget(target, acquireFence, dataspace);
+    return ExynosDisplay::setClientTarget(target, acquireFence, dataspace, damage);
 }
 
 int ExynosExternalDisplay::enable()
@@ -52,7 +52,8 @@ class ExynosExternalDisplay : public ExynosDisplay {
 
         virtual int32_t setClientTarget(
                 buffer_handle_t target,
-                int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace);
+                int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace,
+                hwc_region_t damage);
         virtual int32_t setPowerMode(int32_t /*hwc2_power_mode_t*/ mode);
         virtual void initDisplayInterface(uint32_t interfaceType);
         bool checkRotate();
@@ -317,6 +317,7 @@ int ExynosHWCService::setHWCCtl(uint32_t display, uint32_t ctrl, int32_t val)
     case HWC_CTL_SKIP_VALIDATE:
     case HWC_CTL_DUMP_MID_BUF:
     case HWC_CTL_CAPTURE_READBACK:
+    case HWC_CTL_CAPTURE_READBACK_CONTINUOUS:
     case HWC_CTL_ENABLE_COMPOSITION_CROP:
     case HWC_CTL_ENABLE_EXYNOSCOMPOSITION_OPT:
     case HWC_CTL_ENABLE_CLIENTCOMPOSITION_OPT:
@@ -33,6 +33,7 @@
 #include "ExynosResourceRestriction.h"
 #include "VendorVideoAPI.h"
 #include "exynos_sync.h"
+#include "../libvrr/FileNode.h"
 
 using vendor::graphics::BufferUsage;
 using vendor::graphics::VendorGraphicBufferUsage;
@@ -385,6 +386,80 @@ CompressionInfo getCompressionInfo(buffer_handle_t handle) {
     return compressionInfo;
 }
 
+BufferMetaInfo::BufferMetaInfo(buffer_handle_t handle) {
+    if (handle == NULL) return;
+
+    VendorGraphicBufferMeta gmeta(handle);
+
+    unique_id = gmeta.unique_id;
+    fd = gmeta.fd;
+    fd1 = gmeta.fd1;
+    fd2 = gmeta.fd2;
+    size = gmeta.size;
+    size1 = gmeta.size1;
+    size2 = gmeta.size2;
+    format = gmeta.format;
+    internal_format = VendorGraphicBufferMeta::get_internal_format(handle);
+    producer_usage = gmeta.producer_usage;
+    usage = VendorGraphicBufferMeta::get_usage(handle);
+    flags = gmeta.flags;
+    width = gmeta.width;
+    height = gmeta.height;
+    stride = gmeta.stride;
+    vstride = gmeta.vstride;
+    compressionInfo = getCompressionInfo(handle);
+    drmMode = getDrmMode(usage);
+}
+
+uint64_t BufferMetaCache::signature(buffer_handle_t handle) {
+    /* FNV-1a over the fds and the ints of the native handle */
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](uint32_t val) {
+        hash ^= val;
+        hash *= 0x100000001b3ULL;
+    };
+
+    mix(handle->numFds);
+    mix(handle->numInts);
+    for (int i = 0; i < handle->numFds + handle->numInts; i++)
+        mix(static_cast<uint32_t>(handle->data[i]));
+
+    return hash;
+}
+
+BufferMetaInfo BufferMetaCache::get(buffer_handle_t handle) {
+    if (handle == NULL) return BufferMetaInfo();
+
+    uint64_t sig = signature(handle);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(handle);
+        if ((it != mEntries.end()) && (it->second.signature == sig))
+            return it->second.info;
+    }
+
+    /* decode without the lock held since it calls into the mapper */
+    BufferMetaInfo info(handle);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if ((mEntries.size() >= kMaxEntries) && (mEntries.count(handle) == 0))
+        mEntries.clear();
+    mEntries[handle] = Entry{sig, info};
+
+    return info;
+}
+
+void BufferMetaCache::erase(buffer_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.erase(handle);
+}
+
+void BufferMetaCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
 String8 getCompressionStr(CompressionInfo compression) {
     String8 result;
     if (compression.type == COMP_TYPE_NONE)
@@ -1306,13 +1381,12 @@ void writeFileNode(FILE* fd, int value) {
 }
 
 int32_t writeIntToFile(const char* file, uint32_t value) {
-    FILE* fd = fopen(file, "w+");
-    if (fd == nullptr) {
-        ALOGE("%s open failed! %s", file, strerror(errno));
+    std::string nodeName;
+    auto fileNode = android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(file, nodeName);
+    if (!fileNode->writeValue(nodeName, value)) {
         return -EINVAL;
     }
-    writeFileNode(fd, value);
-    fclose(fd);
     return 0;
 }
 
@@ -1419,15 +1493,18 @@ int32_t load_png_image(const char* filepath, buffer_handle_t buffer) {
 }
 
 int readLineFromFile(const std::string &filename, std::string &out, char delim) {
-    std::ifstream in(filename);
+    std::string nodeName;
+    auto fileNode = android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(filename, nodeName);
+    auto content = fileNode->readString(nodeName);
 
-    if (!in) {
+    if (!content) {
         return -ENOENT;
     }
-    std::getline(in, out, delim);
-    if (!in) {
+    if (content->empty()) {
         return -EIO;
     }
+    out = content->substr(0, content->find(delim));
 
     return android::OK;
 }
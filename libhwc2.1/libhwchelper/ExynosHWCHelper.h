@@ -25,6 +25,7 @@
 
 #include <fstream>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -456,6 +457,64 @@ CompressionInfo getCompressionInfo(buffer_handle_t handle);
 String8 getCompressionStr(CompressionInfo compression);
 bool isAFBC32x8(CompressionInfo compression);
 
+/*
+ * Gralloc metadata of a buffer decoded once when the buffer is first seen.
+ * The fields from VendorGraphicBufferMeta keep their names.
+ */
+struct BufferMetaInfo {
+    uint64_t unique_id = 0;
+    int fd = -1;
+    int fd1 = -1;
+    int fd2 = -1;
+    int size = 0;
+    int size1 = 0;
+    int size2 = 0;
+    int format = 0;
+    uint64_t internal_format = 0;
+    uint64_t producer_usage = 0;
+    uint64_t usage = 0;
+    int flags = 0;
+    int width = 0;
+    int height = 0;
+    uint32_t stride = 0;
+    uint32_t vstride = 0;
+    CompressionInfo compressionInfo;
+    uint32_t drmMode = 0; /* NO_DRM */
+
+    BufferMetaInfo() = default;
+    explicit BufferMetaInfo(buffer_handle_t handle);
+};
+
+/*
+ * Per-display cache of BufferMetaInfo keyed by buffer_handle_t.
+ *
+ * A handle can be freed and its address reused by another buffer without
+ * notice to the HAL. So every entry also keeps a signature of the content
+ * of the native handle, which changes with the buffer, and the entry is
+ * decoded again if the signature does not match.
+ */
+class BufferMetaCache {
+    public:
+        /* returns a copy of the metadata of @handle, empty one for NULL */
+        BufferMetaInfo get(buffer_handle_t handle);
+        void erase(buffer_handle_t handle);
+        void clear();
+
+    private:
+        /* the cache is flushed if it grows over this */
+        static constexpr size_t kMaxEntries = 256;
+
+        struct Entry {
+            uint64_t signature;
+            BufferMetaInfo info;
+        };
+
+        static uint64_t signature(buffer_handle_t handle);
+
+        std::mutex mMutex;
+        std::unordered_map<buffer_handle_t, Entry> mEntries;
+};
+
 bool isFormatRgb(int format);
 bool isFormatYUV(int format);
 bool isFormatYUV420(int format);
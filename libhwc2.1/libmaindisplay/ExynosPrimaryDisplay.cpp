@@ -1806,20 +1806,15 @@ int32_t ExynosPrimaryDisplay::getDisplayTemperature() {
     }
 
     int32_t temperature;
-    std::ifstream ifs(mDisplayTempSysfsNode.c_str());
+    std::string nodeName;
+    auto fileNode = android::hardware::graphics::composer::FileNodeManager::getInstance()
+                            .getFileNodeOfFile(mDisplayTempSysfsNode.c_str(), nodeName);
 
-    if (!ifs.is_open()) {
-        ALOGE("%s: Unable to open node '%s', error = %s", __func__, mDisplayTempSysfsNode.c_str(),
-              strerror(errno));
+    if (!fileNode->readValue(nodeName, temperature)) {
+        ALOGE("%s: Unable to read node '%s'", __func__, mDisplayTempSysfsNode.c_str());
         return UINT_MAX;
     }
 
-    if (!(ifs >> temperature) || !ifs.good()) {
-        ALOGE("%s: Unable to read node '%s', error = %s", __func__, mDisplayTempSysfsNode.c_str(),
-              strerror(errno));
-    }
-
-    ifs.close();
     return temperature / 1000;
 }
 
@@ -155,6 +155,8 @@ ExynosMPP::ExynosMPP(ExynosResourceManager* resourceManager,
     mPrevAssignedDisplayType(-1),
     mReservedDisplay(-1),
     mResourceManageThread(android::sp<ResourceManageThread>::make(this)),
+    mAsyncPostProcessing(false),
+    mTargetDisplayDevice(0),
     mCapacity(-1),
     mUsedCapacity(0),
     mAllocOutBufFlag(true),
@@ -234,6 +236,10 @@ ExynosMPP::ExynosMPP(ExynosResourceManager* resourceManager,
         mAcrylicHandle->setDefaultColor(0, 0, 0, 0);
     }
 
+    if ((mPhysicalType == MPP_G2D) || (mPhysicalType == MPP_MSC))
+        mAsyncPostProcessing =
+            property_get_bool("vendor.display.mpp.async_post_processing", true);
+
     mAssignedSources.clear();
     resetUsedCapacity();
 
@@ -267,6 +273,10 @@ ExynosMPP::ExynosMPP(ExynosResourceManager* resourceManager,
 
 ExynosMPP::~ExynosMPP()
 {
+    if (mPostProcessingThread != NULL) {
+        waitPostProcessing();
+        mPostProcessingThread->stop();
+    }
     mResourceManageThread->mRunning = false;
     mResourceManageThread->requestExitAndWait();
 }
@@ -282,6 +292,64 @@ ExynosMPP::ResourceManageThread::~ResourceManageThread()
 {
 }
 
+ExynosMPP::PostProcessingThread::PostProcessingThread(ExynosMPP *exynosMPP)
+: mExynosMPP(exynosMPP),
+    mJobPending(false),
+    mJobPrevSrcNum(0),
+    mJobResult(NO_ERROR)
+{
+}
+
+bool ExynosMPP::PostProcessingThread::threadLoop()
+{
+    uint32_t prevSrcNum;
+    {
+        Mutex::Autolock lock(mMutex);
+        while (!mJobPending && !exitPending())
+            mCondition.wait(mMutex);
+        if (!mJobPending)
+            return false;
+        prevSrcNum = mJobPrevSrcNum;
+    }
+
+    int32_t ret = mExynosMPP->doPostProcessingInternal(prevSrcNum);
+
+    Mutex::Autolock lock(mMutex);
+    mJobResult = ret;
+    mJobPending = false;
+    mCondition.broadcast();
+    return true;
+}
+
+void ExynosMPP::PostProcessingThread::submit(uint32_t prevSrcNum)
+{
+    Mutex::Autolock lock(mMutex);
+    mJobPending = true;
+    mJobPrevSrcNum = prevSrcNum;
+    mJobResult = NO_ERROR;
+    mCondition.broadcast();
+}
+
+int32_t ExynosMPP::PostProcessingThread::wait()
+{
+    Mutex::Autolock lock(mMutex);
+    while (mJobPending)
+        mCondition.wait(mMutex);
+    int32_t ret = mJobResult;
+    mJobResult = NO_ERROR;
+    return ret;
+}
+
+void ExynosMPP::PostProcessingThread::stop()
+{
+    requestExit();
+    {
+        Mutex::Autolock lock(mMutex);
+        mCondition.broadcast();
+    }
+    join();
+}
+
 bool ExynosMPP::isDataspaceSupportedByMPP(struct exynos_image &src, struct exynos_image &dst)
 {
     uint32_t srcStandard = (src.dataSpace & HAL_DATASPACE_STANDARD_MASK);
@@ -992,6 +1060,7 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
  * @return int32_t
  */
 int32_t ExynosMPP::setOutBuf(buffer_handle_t outbuf, int32_t fence) {
+    waitPostProcessing();
     mDstImgs[mCurrentDstBuf].bufferHandle = NULL;
     if (outbuf != NULL) {
         mDstImgs[mCurrentDstBuf].bufferHandle = outbuf;
@@ -1007,6 +1076,7 @@ int32_t ExynosMPP::setOutBuf(buffer_handle_t outbuf, int32_t fence) {
  * @return int32_t
  */
 int32_t ExynosMPP::freeOutBuf(struct exynos_mpp_img_info dst) {
+    waitPostProcessing();
     mResourceManageThread->addFreedBuffer(dst);
     dst.bufferHandle = NULL;
     return NO_ERROR;
@@ -1463,7 +1533,7 @@ int32_t ExynosMPP::setupDst(exynos_mpp_img_info *dstImgInfo)
     return ret;
 }
 
-int32_t ExynosMPP::doPostProcessingInternal()
+int32_t ExynosMPP::doPostProcessingInternal(uint32_t prevSrcNum)
 {
     ATRACE_CALL();
     int ret = NO_ERROR;
@@ -1490,10 +1560,10 @@ int32_t ExynosMPP::doPostProcessingInternal()
             return ret;
     }
 
-    if (mPrevFrameInfo.srcNum > sourceNum) {
+    if (prevSrcNum > sourceNum) {
         MPP_LOGD(eDebugMPP, "prev sourceNum(%d), current sourceNum(%zu)",
-                mPrevFrameInfo.srcNum, sourceNum);
-        for (size_t i = sourceNum; i < mPrevFrameInfo.srcNum; i++)
+                prevSrcNum, sourceNum);
+        for (size_t i = sourceNum; i < prevSrcNum; i++)
         {
             MPP_LOGD(eDebugMPP, "Remove mSrcImgs[%zu], %p", i, mSrcImgs[i].mppLayer);
             if (mSrcImgs[i].mppLayer != NULL) {
@@ -1694,8 +1764,11 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image& dst) {
     ATRACE_CALL();
     MPP_LOGD(eDebugMPP, "total assigned sources (%zu)++++++++", mAssignedSources.size());
 
+    waitPostProcessing();
+
     int ret = NO_ERROR;
     bool realloc = false;
+    uint32_t prevSrcNum = mPrevFrameInfo.srcNum;
     if (mAssignedSources.size() == 0) {
         MPP_LOGE("Assigned source size(%zu) is not valid",
                 mAssignedSources.size());
@@ -1748,13 +1821,35 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image& dst) {
     }
 
     /* G2D or sclaer case */
-    if ((ret = doPostProcessingInternal()) < 0) {
+    if (mAsyncPostProcessing) {
+        if (mPostProcessingThread == NULL) {
+            mPostProcessingThread = android::sp<PostProcessingThread>::make(this);
+            mPostProcessingThread->run(String8::format("%sPP", mName.c_str()).c_str(),
+                                       PRIORITY_URGENT_DISPLAY);
+        }
+        /*
+         * The job owns the source images once it is submitted,
+         * so the frame information is saved before that.
+         * The result and the fences are collected by waitPostProcessing()
+         */
+        saveFrameInfo();
+        MPP_LOGD(eDebugMPP | eDebugFence, "post processing queued, dstImg[%d]", mCurrentDstBuf);
+        mPostProcessingThread->submit(prevSrcNum);
+        return NO_ERROR;
+    } else if ((ret = doPostProcessingInternal(prevSrcNum)) < 0) {
         MPP_LOGE("%s:: fail to post processing, ret %d",
                 __func__, ret);
         goto save_frame_info;
     }
 
 save_frame_info:
+    saveFrameInfo();
+
+    return ret;
+}
+
+void ExynosMPP::saveFrameInfo()
+{
     /* Save current frame information for next frame*/
     mPrevAssignedDisplayType = mAssignedDisplay->mType;
     mPrevFrameInfo.srcNum = (uint32_t)mAssignedSources.size();
@@ -1765,7 +1860,17 @@ save_frame_info:
 
     MPP_LOGD(eDebugMPP, "mPrevAssignedState: %d, mPrevAssignedDisplayType: %d--------------",
             mAssignedState, mAssignedDisplay->mType);
+}
+
+int32_t ExynosMPP::waitPostProcessing()
+{
+    if (mPostProcessingThread == NULL)
+        return NO_ERROR;
 
+    ATRACE_CALL();
+    int32_t ret = mPostProcessingThread->wait();
+    if (ret < 0)
+        MPP_LOGE("%s:: fail to post processing, ret %d", __func__, ret);
     return ret;
 }
 
@@ -1776,6 +1881,7 @@ save_frame_info:
  */
 int32_t ExynosMPP::getSrcReleaseFence(uint32_t srcIndex)
 {
+    waitPostProcessing();
     if (srcIndex >= NUM_MPP_SRC_BUFS)
         return -EINVAL;
 
@@ -1786,6 +1892,7 @@ int32_t ExynosMPP::getSrcReleaseFence(uint32_t srcIndex)
 
 int32_t ExynosMPP::resetSrcReleaseFence()
 {
+    waitPostProcessing();
     MPP_LOGD(eDebugFence, "");
     for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
         mSrcImgs[i].acrylicReleaseFenceFd = -1;
@@ -1795,6 +1902,7 @@ int32_t ExynosMPP::resetSrcReleaseFence()
 
 int32_t ExynosMPP::getDstImageInfo(exynos_image *img)
 {
+    waitPostProcessing();
     if ((mCurrentDstBuf < 0) || (mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType)) ||
         (mAssignedDisplay == NULL)) {
         MPP_LOGE("mCurrentDstBuf(%d), mAssignedDisplay(%p)", mCurrentDstBuf, mAssignedDisplay);
@@ -1858,6 +1966,7 @@ int32_t ExynosMPP::getDstImageInfo(exynos_image *img)
  */
 int32_t ExynosMPP::setDstAcquireFence(int acquireFence)
 {
+    waitPostProcessing();
 
     int dstBufIndex = 0;
 
@@ -1902,6 +2011,7 @@ int32_t ExynosMPP::setDstAcquireFence(int acquireFence)
 
 int32_t ExynosMPP::resetDstReleaseFence()
 {
+    waitPostProcessing();
     MPP_LOGD(eDebugFence, "");
 
     if (mCurrentDstBuf < 0 || mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType))
@@ -2170,6 +2280,7 @@ int64_t ExynosMPP::isSupported(ExynosDisplay &display, struct exynos_image &src,
 
 int32_t ExynosMPP::resetMPP()
 {
+    waitPostProcessing();
     mAssignedState = MPP_ASSIGN_STATE_FREE;
     mAssignedDisplay = NULL;
     mAssignedSources.clear();
@@ -2182,6 +2293,7 @@ int32_t ExynosMPP::resetMPP()
 
 int32_t ExynosMPP::resetAssignedState()
 {
+    waitPostProcessing();
     for (int i = (int)mAssignedSources.size(); i-- > 0;) {
         ExynosMPPSource *mppSource = mAssignedSources[i];
         if (mppSource->mOtfMPP == this) {
@@ -2208,6 +2320,7 @@ int32_t ExynosMPP::resetAssignedState()
 
 int32_t ExynosMPP::resetAssignedState(ExynosMPPSource *mppSource)
 {
+    waitPostProcessing();
     bool needUpdateCapacity = false;
     for (int i = (int)mAssignedSources.size(); i-- > 0;) {
         ExynosMPPSource *source = mAssignedSources[i];
@@ -2248,6 +2361,7 @@ int32_t ExynosMPP::reserveMPP(int32_t displayId)
 
 int32_t ExynosMPP::assignMPP(ExynosDisplay *display, ExynosMPPSource* mppSource)
 {
+    waitPostProcessing();
     mAssignedState |= MPP_ASSIGN_STATE_ASSIGNED;
 
     if (mMPPType == MPP_TYPE_OTF)
@@ -2843,6 +2957,7 @@ uint32_t ExynosMPP::getRestrictionClassification(const struct exynos_image &img)
 
 int ExynosMPP::prioritize(int priority)
 {
+    waitPostProcessing();
     if ((mPhysicalType != MPP_G2D) ||
         (mAcrylicHandle == NULL)) {
         MPP_LOGE("invalid function call");
@@ -2870,6 +2985,7 @@ uint32_t ExynosMPP::increaseDstBuffIndex()
 
 void ExynosMPP::reloadResourceForHWFC()
 {
+    waitPostProcessing();
     ALOGI("reloadResourceForHWFC()");
     delete mAcrylicHandle;
     mAcrylicHandle = AcrylicFactory::createAcrylic("default_compositor");
@@ -2890,6 +3006,7 @@ void ExynosMPP::reloadResourceForHWFC()
 
 void ExynosMPP::setTargetDisplayLuminance(uint16_t min, uint16_t max)
 {
+    waitPostProcessing();
     MPP_LOGD(eDebugMPP, "%s: min(%d), max(%d)", __func__, min, max);
     if (mAcrylicHandle == NULL) {
         MPP_LOGE("mAcrylicHandle is NULL");
@@ -2899,11 +3016,15 @@ void ExynosMPP::setTargetDisplayLuminance(uint16_t min, uint16_t max)
 
 void ExynosMPP::setTargetDisplayDevice(int device)
 {
+    waitPostProcessing();
     ALOGI("%s: device(%d)", __func__, device);
     if (mAcrylicHandle == NULL) {
         MPP_LOGE("mAcrylicHandle is NULL");
-    } else
-        mAcrylicHandle->setTargetDisplayInfo(&device);
+    } else {
+        /* the plugin reads the device when the commands are generated */
+        mTargetDisplayDevice = device;
+        mAcrylicHandle->setTargetDisplayInfo(&mTargetDisplayDevice);
+    }
 }
 
 void ExynosMPP::dump(String8& result)
@@ -2925,6 +3046,7 @@ void ExynosMPP::dump(String8& result)
 
 void ExynosMPP::closeFences()
 {
+    waitPostProcessing();
     for (uint32_t i = 0; i < mAssignedSources.size(); i++)
     {
         mSrcImgs[i].acrylicAcquireFenceFd =
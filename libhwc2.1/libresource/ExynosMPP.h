@@ -500,6 +500,28 @@ private:
             void addStateFence(int fence);
     };
 
+    /*
+     * Runs doPostProcessingInternal() off the calling thread. The job owns the MPP's
+     * source/destination images until wait() returns.
+     */
+    class PostProcessingThread: public Thread {
+        private:
+            ExynosMPP *mExynosMPP;
+            Mutex mMutex;
+            Condition mCondition;
+            bool mJobPending;
+            /* mPrevFrameInfo.srcNum when the job was submitted */
+            uint32_t mJobPrevSrcNum;
+            int32_t mJobResult;
+        public:
+            PostProcessingThread(ExynosMPP *exynosMPP);
+            virtual bool threadLoop();
+            void submit(uint32_t prevSrcNum);
+            /* Returns the result of the last job, NO_ERROR if there was none */
+            int32_t wait();
+            void stop();
+    };
+
 public:
     ExynosResourceManager *mResourceManager;
     /**
@@ -534,6 +556,11 @@ public:
     int32_t mReservedDisplay;
 
     android::sp<ResourceManageThread> mResourceManageThread;
+    /* Created on the first asynchronous doPostProcessing() */
+    android::sp<PostProcessingThread> mPostProcessingThread;
+    bool mAsyncPostProcessing;
+    /* Told to libacryl by the address */
+    int mTargetDisplayDevice;
     float mCapacity;
     float mUsedCapacity;
 
@@ -583,6 +610,8 @@ public:
     int32_t setOutBuf(buffer_handle_t outbuf, int32_t fence);
     int32_t freeOutBuf(exynos_mpp_img_info dst);
     int32_t doPostProcessing(struct exynos_image& dst);
+    /* Waits for the job queued by doPostProcessing() and returns its result */
+    int32_t waitPostProcessing();
     int32_t setupRestriction();
     int32_t getSrcReleaseFence(uint32_t srcIndex);
     int32_t resetSrcReleaseFence();
@@ -714,7 +743,8 @@ protected:
     bool canUsePrevFrame();
     uint32_t getDstStrideAlignment(int format);
     int32_t setupDst(exynos_mpp_img_info *dstImgInfo);
-    virtual int32_t doPostProcessingInternal();
+    virtual int32_t doPostProcessingInternal(uint32_t prevSrcNum);
+    void saveFrameInfo();
     virtual int32_t setupLayer(exynos_mpp_img_info *srcImgInfo,
             struct exynos_image &src, struct exynos_image &dst);
     virtual int32_t setColorConversionInfo() { return NO_ERROR; };
@@ -14,9 +14,16 @@
  * limitations under the License.
  */
 
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
 #undef LOG_TAG
 #define LOG_TAG "hwc-virt-display"
 #include "ExynosVirtualDisplay.h"
+
+#include <cutils/properties.h>
+#include <sync/sync.h>
+#include <utils/Trace.h>
+
 #include "../libdevice/ExynosDevice.h"
 #include "../libdevice/ExynosLayer.h"
 
@@ -58,6 +65,11 @@ ExynosVirtualDisplay::ExynosVirtualDisplay(uint32_t index, ExynosDevice* device,
     mMinTargetLuminance = 0;
     mMaxTargetLuminance = 100;
     mSinkDeviceType = 0;
+    mG2dCompositionEnabled = false;
+    mUseG2dComposition = false;
+    mG2dSinkWaitFrames = 0;
+    mG2dComposedFrames = 0;
+    mG2dFallback = false;
 
     mUseDpu = false;
     mDisplayControl.enableExynosCompositionOptimization = false;
@@ -86,6 +98,10 @@ void ExynosVirtualDisplay::createVirtualDisplay(uint32_t width, uint32_t height,
     mXres = width;
     mYres = height;
     mGLESFormat = *format;
+
+    mG2dCompositionEnabled = property_get_bool("vendor.display.virtual.g2d_composition", true);
+    if (mG2dCompositionEnabled && (mG2dCompositor == nullptr))
+        mG2dCompositor = std::make_unique<VirtualDisplayCompositor>(this);
 }
 
 void ExynosVirtualDisplay::destroyVirtualDisplay()
@@ -106,6 +122,9 @@ void ExynosVirtualDisplay::destroyVirtualDisplay()
     mResourceManager->setTargetDisplayLuminance(mMinTargetLuminance, mMaxTargetLuminance);
     mResourceManager->setTargetDisplayDevice(mSinkDeviceType);
     mNeedReloadResourceForHWFC = false;
+    if (mG2dCompositor != nullptr)
+        mG2dCompositor->releaseBuffers();
+    mUseG2dComposition = false;
 }
 
 int ExynosVirtualDisplay::setWFDMode(unsigned int mode)
@@ -137,6 +156,9 @@ int ExynosVirtualDisplay::sendWFDCommand(int32_t cmd, int32_t ext1, int32_t ext2
             mMinTargetLuminance = (uint16_t)ext1;
             mMaxTargetLuminance = (uint16_t)ext2;
             mResourceManager->setTargetDisplayLuminance(mMinTargetLuminance, mMaxTargetLuminance);
+            if (mG2dCompositor != nullptr)
+                mG2dCompositor->setTargetDisplayLuminance(mMinTargetLuminance,
+                                                          mMaxTargetLuminance);
             break;
         case SET_TARGET_DISPLAY_DEVICE:
             /* ext1: type, ext2: unused */
@@ -236,6 +258,13 @@ int32_t ExynosVirtualDisplay::validateDisplay(
     if (checkSkipFrame()) {
         handleSkipFrame();
     } else {
+        if (((ret == HWC2_ERROR_NONE) || (ret == HWC2_ERROR_HAS_CHANGES)) &&
+            assignG2dComposition()) {
+            mUseG2dComposition = true;
+            getChangedCompositionTypes(outNumTypes, NULL, NULL);
+            ret = ((*outNumTypes == 0) && (*outNumRequests == 0)) ? HWC2_ERROR_NONE
+                                                                   : HWC2_ERROR_HAS_CHANGES;
+        }
         setDrmMode();
         setSinkBufferUsage();
         setCompositionType();
@@ -290,6 +319,9 @@ int32_t ExynosVirtualDisplay::presentDisplay(
         return ret;
     }
 
+    if (mUseG2dComposition)
+        return presentG2dComposition(outRetireFence);
+
     ret = ExynosDisplay::presentDisplay(outRetireFence);
 
     /* handle outbuf acquireFence */
@@ -422,6 +454,7 @@ void ExynosVirtualDisplay::setCompositionType()
 void ExynosVirtualDisplay::initPerFrameData()
 {
     mIsSkipFrame = false;
+    mUseG2dComposition = false;
     mIsSecureDRM = false;
     mIsNormalDRM = false;
     mCompositionType = COMPOSITION_HWC;
@@ -529,3 +562,163 @@ int32_t ExynosVirtualDisplay::getHdrCapabilities(uint32_t* outNumTypes,
     outTypes[0] = HAL_HDR_HDR10;
     return 0;
 }
+
+bool ExynosVirtualDisplay::assignG2dComposition()
+{
+    if (!mG2dCompositionEnabled || (mG2dCompositor == nullptr) ||
+        !mG2dCompositor->isAvailable())
+        return false;
+    /* The previous frame failed on the 2D engine, this one takes the regular path */
+    if (mG2dFallback) {
+        mG2dFallback = false;
+        return false;
+    }
+    /* The G2D MPP of the display composes the frame */
+    if (mExynosCompositionInfo.mHasCompositionLayer || (mExynosCompositionInfo.mM2mMPP != NULL))
+        return false;
+    if (!mG2dCompositor->canWrite(mGLESFormat))
+        return false;
+
+    int32_t firstClientIndex = -1;
+    int32_t lastClientIndex = -1;
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        ExynosLayer *layer = mLayers[i];
+        if ((layer->getValidateCompositionType() != HWC2_COMPOSITION_CLIENT) ||
+            (layer->mM2mMPP != NULL) || (layer->mOtfMPP != NULL))
+            return false;
+
+        VirtualDisplayCompositor::Source source;
+        layer->setSrcExynosImage(&source.src);
+        layer->setDstExynosImage(&source.dst);
+        if ((layer->mRequestedCompositionType != HWC2_COMPOSITION_CLIENT) &&
+            (layer->mCompositionType != HWC2_COMPOSITION_SOLID_COLOR) && !layer->isDimLayer() &&
+            mG2dCompositor->canCompose(source, mXres, mYres))
+            continue;
+
+        if (firstClientIndex < 0)
+            firstClientIndex = i;
+        lastClientIndex = i;
+    }
+
+    /* The client target takes the place of the layers between the first and the last one */
+    bool hasDeviceLayer = false;
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        if ((firstClientIndex >= 0) && (firstClientIndex <= (int32_t)i) &&
+            ((int32_t)i <= lastClientIndex))
+            continue;
+        mLayers[i]->updateValidateCompositionType(HWC2_COMPOSITION_DEVICE);
+        hasDeviceLayer = true;
+    }
+    if (!hasDeviceLayer)
+        return false;
+
+    mClientCompositionInfo.mHasCompositionLayer = (firstClientIndex >= 0);
+    mClientCompositionInfo.mFirstIndex = firstClientIndex;
+    mClientCompositionInfo.mLastIndex = lastClientIndex;
+    mClientCompositionInfo.mSkipFlag = false;
+
+    DISPLAY_LOGD(eDebugVirtualDisplay, "%s:: client composition [%d, %d] of %zu layers",
+                 __func__, firstClientIndex, lastClientIndex, mLayers.size());
+    return true;
+}
+
+int32_t ExynosVirtualDisplay::presentG2dComposition(int32_t* outRetireFence)
+{
+    ATRACE_CALL();
+
+    if ((mRenderingState != RENDERING_STATE_VALIDATED) &&
+        (mRenderingState != RENDERING_STATE_ACCEPTED_CHANGE)) {
+        DISPLAY_LOGE("%s:: display is not validated : %d", __func__, mRenderingState);
+        return HWC2_ERROR_NOT_VALIDATED;
+    }
+
+    *outRetireFence = -1;
+
+    int32_t ret = HWC2_ERROR_NONE;
+    bool skip = (mOutputBuffer == NULL) ||
+            (mClientCompositionInfo.mHasCompositionLayer &&
+             (mClientCompositionInfo.mTargetBuffer == NULL));
+    /*
+     * Skipping the frame of a busy sink would queue an output buffer nothing wrote. The frame
+     * is composed anyway, the 2D engine waits for the acquire fence of the output buffer.
+     */
+    if (!skip && (mOutputBufferAcquireFenceFd >= 0) &&
+        (sync_wait(mOutputBufferAcquireFenceFd, 0) < 0))
+        mG2dSinkWaitFrames++;
+
+    if (skip) {
+        handleAcquireFence();
+        *outRetireFence = mOutputBufferReleaseFenceFd;
+        mOutputBufferReleaseFenceFd = -1;
+    } else {
+        std::vector<VirtualDisplayCompositor::Source> sources;
+        std::vector<ExynosLayer *> sourceLayers;
+        for (size_t i = 0; i < mLayers.size(); i++) {
+            ExynosLayer *layer = mLayers[i];
+            VirtualDisplayCompositor::Source source;
+
+            if (mClientCompositionInfo.mHasCompositionLayer &&
+                (mClientCompositionInfo.mFirstIndex <= (int32_t)i) &&
+                ((int32_t)i <= mClientCompositionInfo.mLastIndex)) {
+                if ((int32_t)i != mClientCompositionInfo.mFirstIndex)
+                    continue;
+                setCompositionTargetExynosImage(COMPOSITION_CLIENT, &source.src, &source.dst);
+                mClientCompositionInfo.mAcquireFence = -1;
+                layer = NULL;
+            } else {
+                layer->setSrcExynosImage(&source.src);
+                layer->setDstExynosImage(&source.dst);
+                layer->mAcquireFence = -1;
+            }
+            sources.push_back(source);
+            sourceLayers.push_back(layer);
+        }
+
+        std::vector<int32_t> releaseFences;
+        int32_t err = mG2dCompositor->compose(sources, mOutputBuffer, HAL_DATASPACE_UNKNOWN,
+                                              mOutputBufferAcquireFenceFd, releaseFences,
+                                              *outRetireFence);
+        mOutputBufferAcquireFenceFd = -1;
+
+        for (size_t i = 0; i < sourceLayers.size(); i++) {
+            int32_t &releaseFence = (sourceLayers[i] != NULL)
+                    ? sourceLayers[i]->mReleaseFence
+                    : mClientCompositionInfo.mReleaseFence;
+            fence_close(releaseFence, this, FENCE_TYPE_SRC_RELEASE, FENCE_IP_G2D);
+            releaseFence = releaseFences[i];
+        }
+
+        if (err == NO_ERROR) {
+            mG2dComposedFrames++;
+        } else {
+            /*
+             * The output buffer was not written. The composition types of the frame are
+             * already committed, so the next frame is validated again without the 2D engine.
+             */
+            DISPLAY_LOGE("%s:: fail to compose %zu sources (%d)", __func__, sources.size(), err);
+            mG2dFallback = true;
+            setGeometryChanged(GEOMETRY_DISPLAY_FORCE_VALIDATE);
+            ret = HWC2_ERROR_NO_RESOURCES;
+        }
+    }
+
+    mRenderingState = RENDERING_STATE_PRESENTED;
+
+    DISPLAY_LOGD(eDebugVirtualDisplay, "%s:: skip %d, outRetireFence %d", __func__, skip,
+                 *outRetireFence);
+
+    return ret;
+}
+
+void ExynosVirtualDisplay::dump(String8& result, const std::vector<std::string>& args)
+{
+    ExynosDisplay::dump(result, args);
+
+    if (mG2dCompositor == nullptr)
+        return;
+    Mutex::Autolock lock(mDisplayMutex);
+    mG2dCompositor->dump(result);
+    result.appendFormat("\tvirtual display frames: composed %" PRIu64 ", waited for the sink %" PRIu64
+                        "\n\n",
+                        mG2dComposedFrames, mG2dSinkWaitFrames);
+}
@@ -16,8 +16,11 @@
 #ifndef EXYNOS_VIRTUAL_DISPLAY_DISPLAY_H
 #define EXYNOS_VIRTUAL_DISPLAY_DISPLAY_H
 
+#include <memory>
+
 #include "ExynosHWCDebug.h"
 #include "../libdevice/ExynosDisplay.h"
+#include "VirtualDisplayCompositor.h"
 
 #define VIRTUAL_DISLAY_SKIP_LAYER   0x00000100
 
@@ -127,6 +130,8 @@ public:
             int32_t* outTypes, float* outMaxLuminance,
             float* outMaxAverageLuminance, float* outMinLuminance);
 
+    virtual void dump(String8& result, const std::vector<std::string>& args = {}) override;
+
     /**
      * If mIsWFDState is true, VirtualDisplaySurface use HWC
      */
@@ -147,6 +152,17 @@ protected:
 
     void handleAcquireFence();
 
+    /**
+     * Moves the layers the 2D engine can blend from CLIENT to DEVICE composition.
+     * Only used when no G2D MPP is assigned to the display.
+     */
+    bool assignG2dComposition();
+
+    /**
+     * Composes the DEVICE layers and the client target into the output buffer
+     */
+    int32_t presentG2dComposition(int32_t* outRetireFence);
+
     /**
      * Display width, height information set by surfaceflinger
      */
@@ -212,6 +228,22 @@ protected:
      * WFD engine will set this values.
      */
     int32_t mSinkDeviceType;
+
+    /**
+     * 2D engine composition of the frame when no G2D MPP is assigned
+     */
+    std::unique_ptr<VirtualDisplayCompositor> mG2dCompositor;
+    bool mG2dCompositionEnabled;
+    bool mUseG2dComposition;
+    /* The last 2D engine composition failed, skip it for the next frame */
+    bool mG2dFallback;
+
+    /**
+     * Frames composed while the sink still read the output buffer, the 2D
+     * engine waited for its acquire fence
+     */
+    uint64_t mG2dSinkWaitFrames;
+    uint64_t mG2dComposedFrames;
 };
 
 #endif
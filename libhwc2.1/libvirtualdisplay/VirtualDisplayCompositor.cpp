@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+
+#undef LOG_TAG
+#define LOG_TAG "hwc-virt-compositor"
+
+#include "VirtualDisplayCompositor.h"
+
+#include <utils/Trace.h>
+
+#include <algorithm>
+
+#include "../libdevice/ExynosDisplay.h"
+#include "ExynosHWCDebug.h"
+#include "VendorGraphicBuffer.h"
+
+using vendor::graphics::BufferUsage;
+using vendor::graphics::VendorGraphicBufferAllocator;
+using vendor::graphics::VendorGraphicBufferMeta;
+using vendor::graphics::VendorGraphicBufferUsage;
+
+VirtualDisplayCompositor::VirtualDisplayCompositor(ExynosDisplay *display)
+      : mDisplay(display),
+        mAcrylic(Acrylic::createCompositor()),
+        mComposedFrames(0),
+        mMultiPassFrames(0),
+        mFailedFrames(0),
+        mLastSourceCount(0),
+        mLastPassCount(0) {
+    if (mAcrylic == NULL)
+        ALOGI("No 2D engine for virtual display composition");
+    else if (mAcrylic->getCapabilities().maxLayerCount() < 2) {
+        ALOGI("2D engine can not blend, virtual display composition disabled");
+        delete mAcrylic;
+        mAcrylic = NULL;
+    }
+}
+
+VirtualDisplayCompositor::~VirtualDisplayCompositor()
+{
+    releaseBuffers();
+    prepareLayers(0);
+    delete mAcrylic;
+}
+
+static uint32_t getAcrylicFormat(uint32_t format)
+{
+    if (format == HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV)
+        return HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M;
+    return format;
+}
+
+static android_dataspace getDefaultDataspace(uint32_t format, android_dataspace dataspace)
+{
+    if (dataspace != HAL_DATASPACE_UNKNOWN)
+        return dataspace;
+    return isFormatRgb(format) ? HAL_DATASPACE_V0_SRGB : HAL_DATASPACE_V0_BT601_625;
+}
+
+bool VirtualDisplayCompositor::canCompose(const Source &source, uint32_t width, uint32_t height)
+{
+    if (mAcrylic == NULL)
+        return false;
+
+    const exynos_image &src = source.src;
+    const exynos_image &dst = source.dst;
+    const HW2DCapability &cap = mAcrylic->getCapabilities();
+
+    if ((src.bufferHandle == NULL) || (getDrmMode(src.bufferHandle) == SECURE_DRM))
+        return false;
+    if (!cap.isFormatSupported(getAcrylicFormat(src.format)))
+        return false;
+    if ((src.transform & ~cap.getHWCTransformMask()) != 0)
+        return false;
+    if ((src.w == 0) || (src.h == 0) || (dst.w == 0) || (dst.h == 0))
+        return false;
+    /* Layers partially outside of the output are left to the client */
+    if ((dst.x + dst.w > width) || (dst.y + dst.h > height))
+        return false;
+
+    hw2d_coord_t from = {static_cast<int16_t>(src.w), static_cast<int16_t>(src.h)};
+    hw2d_coord_t to = {static_cast<int16_t>(dst.w), static_cast<int16_t>(dst.h)};
+    return cap.supportedResampling(from, to, src.transform);
+}
+
+bool VirtualDisplayCompositor::canWrite(uint32_t format)
+{
+    if (mAcrylic == NULL)
+        return false;
+    return mAcrylic->getCapabilities().isFormatSupported(getAcrylicFormat(format));
+}
+
+int32_t VirtualDisplayCompositor::prepareLayers(size_t count)
+{
+    while (mLayers.size() > count) {
+        delete mLayers.back();
+        mLayers.pop_back();
+    }
+    while (mLayers.size() < count) {
+        AcrylicLayer *layer = mAcrylic->createLayer();
+        if (layer == NULL) {
+            HWC_LOGE(mDisplay, "%s:: Fail to create layer %zu", __func__, mLayers.size());
+            return -EINVAL;
+        }
+        mLayers.push_back(layer);
+    }
+    return NO_ERROR;
+}
+
+int32_t VirtualDisplayCompositor::setupLayer(AcrylicLayer *layer, exynos_image &src,
+                                             const exynos_image &dst, int zOrder)
+{
+    VendorGraphicBufferMeta gmeta(src.bufferHandle);
+    int bufFds[MAX_HW2D_PLANES] = {gmeta.fd, gmeta.fd1, gmeta.fd2};
+    size_t bufLength[MAX_HW2D_PLANES];
+    uint32_t attribute = 0;
+    uint32_t bufferNum = getBufferNumOfFormat(gmeta.format, getCompressionType(src.bufferHandle));
+
+    if (bufferNum == 0) {
+        HWC_LOGE(mDisplay, "%s:: Fail to get bufferNum, format(0x%8x)", __func__, gmeta.format);
+        return -EINVAL;
+    }
+    if (getBufLength(src.bufferHandle, MAX_HW2D_PLANES, bufLength, gmeta.format, src.fullWidth,
+                     src.fullHeight) != NO_ERROR) {
+        HWC_LOGE(mDisplay, "%s:: invalid bufferLength(%zu, %zu, %zu), format(0x%8x)", __func__,
+                 bufLength[0], bufLength[1], bufLength[2], gmeta.format);
+        return -EINVAL;
+    }
+
+    if (src.compressionInfo.type == COMP_TYPE_AFBC) {
+        if ((src.compressionInfo.modifier & AFBC_FORMAT_MOD_BLOCK_SIZE_MASK) ==
+            AFBC_FORMAT_MOD_BLOCK_SIZE_32x8)
+            attribute |= AcrylicCanvas::ATTR_COMPRESSED_WIDEBLK;
+        else
+            attribute |= AcrylicCanvas::ATTR_COMPRESSED;
+    }
+
+    int32_t acquireFence = hwcCheckFenceDebug(mDisplay, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_G2D,
+                                              src.acquireFenceFd);
+    src.acquireFenceFd = -1;
+    setFenceName(acquireFence, FENCE_G2D_SRC_LAYER);
+    setFenceInfo(acquireFence, mDisplay, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_G2D,
+                 HwcFenceDirection::TO);
+
+    layer->setImageDimension(src.fullWidth, src.fullHeight);
+    layer->setImageType(getAcrylicFormat(gmeta.format),
+                        getDefaultDataspace(gmeta.format, src.dataSpace));
+    if (!layer->setImageBuffer(bufFds, bufLength, bufferNum, acquireFence, attribute)) {
+        fence_close(acquireFence, mDisplay, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_G2D);
+        return -EINVAL;
+    }
+    layer->setCompositMode(src.blending, (uint8_t)(255 * src.planeAlpha), zOrder);
+
+    hwc_rect_t src_rect = {(int)src.x, (int)src.y, (int)(src.x + src.w), (int)(src.y + src.h)};
+    hwc_rect_t dst_rect = {(int)dst.x, (int)dst.y, (int)(dst.x + dst.w), (int)(dst.y + dst.h)};
+    layer->setCompositArea(src_rect, dst_rect, src.transform, AcrylicLayer::ATTR_NORESAMPLING);
+
+    return NO_ERROR;
+}
+
+int32_t VirtualDisplayCompositor::setupCanvas(buffer_handle_t handle, android_dataspace dataspace,
+                                              int32_t acquireFence)
+{
+    VendorGraphicBufferMeta gmeta(handle);
+    int bufFds[MAX_HW2D_PLANES] = {gmeta.fd, gmeta.fd1, gmeta.fd2};
+    size_t bufLength[MAX_HW2D_PLANES];
+    uint32_t attribute = 0;
+    uint32_t bufferNum = getBufferNumOfFormat(gmeta.format, getCompressionType(handle));
+
+    if ((bufferNum == 0) ||
+        (getBufLength(handle, MAX_HW2D_PLANES, bufLength, gmeta.format, gmeta.stride,
+                      gmeta.vstride) != NO_ERROR)) {
+        HWC_LOGE(mDisplay, "%s:: invalid output buffer, format(0x%8x)", __func__, gmeta.format);
+        fence_close(acquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D);
+        return -EINVAL;
+    }
+    if (isAFBCCompressed(handle))
+        attribute |= AcrylicCanvas::ATTR_COMPRESSED;
+
+    setFenceName(acquireFence, FENCE_G2D_DST_DPP);
+    setFenceInfo(acquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D,
+                 HwcFenceDirection::TO);
+
+    /* Same as the output of G2D MPP composition into YUV */
+    if ((dataspace == HAL_DATASPACE_UNKNOWN) && !isFormatRgb(gmeta.format))
+        dataspace = (android_dataspace)(HAL_DATASPACE_STANDARD_BT709 |
+                                        HAL_DATASPACE_TRANSFER_GAMMA2_2 |
+                                        HAL_DATASPACE_RANGE_LIMITED);
+
+    mAcrylic->setCanvasDimension(gmeta.stride, gmeta.vstride);
+    mAcrylic->setCanvasImageType(getAcrylicFormat(gmeta.format),
+                                 getDefaultDataspace(gmeta.format, dataspace));
+    if (!mAcrylic->setCanvasBuffer(bufFds, bufLength, bufferNum, acquireFence, attribute)) {
+        fence_close(acquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D);
+        return -EINVAL;
+    }
+    return NO_ERROR;
+}
+
+VirtualDisplayCompositor::IntermediateBuffer *VirtualDisplayCompositor::getIntermediateBuffer(
+        size_t index, uint32_t width, uint32_t height)
+{
+    IntermediateBuffer &buffer = mIntermediateBuffers[index % kNumIntermediateBuffers];
+
+    if ((buffer.handle != NULL) && (buffer.width == width) && (buffer.height == height))
+        return &buffer;
+
+    freeIntermediateBuffer(buffer);
+
+    uint32_t stride = 0;
+    buffer_handle_t handle = NULL;
+    uint64_t usage = BufferUsage::COMPOSER_OVERLAY | VendorGraphicBufferUsage::NO_AFBC;
+    status_t error;
+    {
+        ATRACE_NAME("allocIntermediateBuffer");
+        error = VendorGraphicBufferAllocator::get().allocate(width, height,
+                                                             HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                                             usage, &handle, &stride, "HWC");
+    }
+    if ((error != NO_ERROR) || (handle == NULL)) {
+        HWC_LOGE(mDisplay, "%s:: failed to allocate intermediate buffer(%dx%d): %d", __func__,
+                 width, height, error);
+        return NULL;
+    }
+
+    buffer.handle = handle;
+    buffer.width = width;
+    buffer.height = height;
+    return &buffer;
+}
+
+void VirtualDisplayCompositor::freeIntermediateBuffer(IntermediateBuffer &buffer)
+{
+    buffer.releaseFence =
+            fence_close(buffer.releaseFence, mDisplay, FENCE_TYPE_SRC_RELEASE, FENCE_IP_G2D);
+    buffer.acquireFence =
+            fence_close(buffer.acquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D);
+    if (buffer.handle != NULL)
+        VendorGraphicBufferAllocator::get().free(buffer.handle);
+    buffer.handle = NULL;
+    buffer.width = 0;
+    buffer.height = 0;
+}
+
+void VirtualDisplayCompositor::releaseBuffers()
+{
+    for (auto &buffer : mIntermediateBuffers)
+        freeIntermediateBuffer(buffer);
+}
+
+void VirtualDisplayCompositor::closeFences(std::vector<Source> &sources, size_t from,
+                                           int32_t &outAcquireFence)
+{
+    for (size_t i = from; i < sources.size(); i++)
+        sources[i].src.acquireFenceFd = fence_close(sources[i].src.acquireFenceFd, mDisplay,
+                                                    FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_G2D);
+    outAcquireFence =
+            fence_close(outAcquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D);
+}
+
+void VirtualDisplayCompositor::setTargetDisplayLuminance(uint16_t min, uint16_t max)
+{
+    if (mAcrylic != NULL)
+        mAcrylic->setTargetDisplayLuminance(min, max);
+}
+
+int32_t VirtualDisplayCompositor::compose(std::vector<Source> &sources, buffer_handle_t outBuffer,
+                                          android_dataspace outDataspace, int32_t outAcquireFence,
+                                          std::vector<int32_t> &srcReleaseFences,
+                                          int32_t &outReleaseFence)
+{
+    ATRACE_CALL();
+
+    srcReleaseFences.assign(sources.size(), -1);
+    outReleaseFence = -1;
+
+    if ((mAcrylic == NULL) || (outBuffer == NULL) || sources.empty()) {
+        closeFences(sources, 0, outAcquireFence);
+        mFailedFrames++;
+        return -EINVAL;
+    }
+
+    const size_t maxLayers = mAcrylic->getCapabilities().maxLayerCount();
+    const uint32_t width = mDisplay->mXres;
+    const uint32_t height = mDisplay->mYres;
+    IntermediateBuffer *carried = NULL;
+    size_t next = 0;
+    uint32_t passes = 0;
+    int32_t ret = NO_ERROR;
+
+    /* Anything the layers do not cover is opaque black */
+    mAcrylic->setDefaultColor(0, 0, 0, 0xFFFF);
+
+    while (next < sources.size()) {
+        const size_t first = (carried != NULL) ? 1 : 0;
+        const size_t count = std::min(maxLayers - first, sources.size() - next);
+        const bool lastPass = (next + count == sources.size());
+        IntermediateBuffer *target = NULL;
+
+        if (!lastPass && ((target = getIntermediateBuffer(passes, width, height)) == NULL)) {
+            ret = -ENOMEM;
+            break;
+        }
+        if ((ret = prepareLayers(first + count)) != NO_ERROR)
+            break;
+
+        if (carried != NULL) {
+            VendorGraphicBufferMeta gmeta(carried->handle);
+            exynos_image src;
+            exynos_image dst;
+            src.fullWidth = gmeta.stride;
+            src.fullHeight = gmeta.vstride;
+            src.w = dst.w = width;
+            src.h = dst.h = height;
+            src.format = HAL_PIXEL_FORMAT_RGBA_8888;
+            src.bufferHandle = carried->handle;
+            src.dataSpace = HAL_DATASPACE_V0_SRGB;
+            src.blending = HWC2_BLEND_MODE_NONE;
+            src.planeAlpha = 1;
+            src.acquireFenceFd = carried->acquireFence;
+            carried->acquireFence = -1;
+            if ((ret = setupLayer(mLayers[0], src, dst, 0)) != NO_ERROR) {
+                fence_close(src.acquireFenceFd, mDisplay, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_G2D);
+                break;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            Source &source = sources[next + i];
+            if ((ret = setupLayer(mLayers[first + i], source.src, source.dst,
+                                  first + i)) != NO_ERROR)
+                break;
+        }
+        if (ret != NO_ERROR)
+            break;
+
+        if (target != NULL) {
+            ret = setupCanvas(target->handle, HAL_DATASPACE_V0_SRGB, target->releaseFence);
+            target->releaseFence = -1;
+        } else {
+            ret = setupCanvas(outBuffer, outDataspace, outAcquireFence);
+            outAcquireFence = -1;
+        }
+        if (ret != NO_ERROR)
+            break;
+
+        std::vector<int> fences(first + count + 1, -1);
+        if (!mAcrylic->execute(fences.data(), fences.size())) {
+            HWC_LOGE(mDisplay, "%s:: fail to execute compositor, pass %u, %zu layers", __func__,
+                     passes, first + count);
+            ret = -EPERM;
+            break;
+        }
+
+        for (size_t i = 0; i < fences.size() - 1; i++)
+            setFenceInfo(fences[i], mDisplay, FENCE_TYPE_SRC_RELEASE, FENCE_IP_G2D,
+                         HwcFenceDirection::FROM);
+        setFenceInfo(fences.back(), mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D,
+                     HwcFenceDirection::FROM);
+
+        if (carried != NULL)
+            carried->releaseFence = fences[0];
+        for (size_t i = 0; i < count; i++)
+            srcReleaseFences[next + i] = fences[first + i];
+        if (target != NULL) {
+            fence_close(target->acquireFence, mDisplay, FENCE_TYPE_DST_ACQUIRE, FENCE_IP_G2D);
+            target->acquireFence = fences.back();
+        }
+        else
+            outReleaseFence = fences.back();
+
+        carried = target;
+        next += count;
+        passes++;
+    }
+
+    if (ret != NO_ERROR) {
+        closeFences(sources, next, outAcquireFence);
+        /* Drop the configuration and the fences handed to the layers */
+        prepareLayers(0);
+        mFailedFrames++;
+        return ret;
+    }
+
+    mComposedFrames++;
+    if (passes > 1)
+        mMultiPassFrames++;
+    mLastSourceCount = sources.size();
+    mLastPassCount = passes;
+
+    HDEBUGLOGD(eDebugVirtualDisplay, "%s:: %zu sources in %u passes, outReleaseFence %d",
+               __func__, sources.size(), passes, outReleaseFence);
+
+    return NO_ERROR;
+}
+
+void VirtualDisplayCompositor::dump(String8 &result)
+{
+    result.appendFormat("Virtual display 2D composition: %s\n",
+                        (mAcrylic != NULL) ? "available" : "unavailable");
+    if (mAcrylic == NULL)
+        return;
+
+    result.appendFormat("\tmax layers: %u, composed frames: %" PRIu64 " (multi-pass %" PRIu64
+                        "), failed frames: %" PRIu64 "\n",
+                        mAcrylic->getCapabilities().maxLayerCount(), mComposedFrames,
+                        mMultiPassFrames, mFailedFrames);
+    result.appendFormat("\tlast frame: %u sources in %u passes\n", mLastSourceCount,
+                        mLastPassCount);
+    for (size_t i = 0; i < kNumIntermediateBuffers; i++) {
+        const IntermediateBuffer &buffer = mIntermediateBuffers[i];
+        if (buffer.handle != NULL)
+            result.appendFormat("\tintermediate buffer[%zu]: %p (%ux%u)\n", i, buffer.handle,
+                                buffer.width, buffer.height);
+    }
+}
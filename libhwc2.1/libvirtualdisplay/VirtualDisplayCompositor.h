@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef VIRTUAL_DISPLAY_COMPOSITOR_H
+#define VIRTUAL_DISPLAY_COMPOSITOR_H
+
+#include <hardware/exynos/acryl.h>
+#include <utils/String8.h>
+
+#include <vector>
+
+#include "ExynosHWCHelper.h"
+
+class ExynosDisplay;
+
+/*
+ * Composes the layers of a virtual display into its sink buffer with the 2D engine.
+ *
+ * Sources are blended in the order they are given. If there are more sources than the 2D
+ * engine takes in one run, the first runs blend into intermediate buffers, each following run
+ * reads the previous intermediate buffer as its bottom layer. The intermediate buffers are
+ * allocated on demand, reused across frames and freed by releaseBuffers().
+ */
+class VirtualDisplayCompositor {
+public:
+    struct Source {
+        exynos_image src;
+        /* Area of the output the source is blended to */
+        exynos_image dst;
+    };
+
+    VirtualDisplayCompositor(ExynosDisplay *display);
+    ~VirtualDisplayCompositor();
+
+    bool isAvailable() const { return mAcrylic != NULL; }
+
+    /* Whether source can be blended to a width x height output */
+    bool canCompose(const Source &source, uint32_t width, uint32_t height);
+    bool canWrite(uint32_t format);
+
+    /*
+     * Blends sources into outBuffer. The acquire fences of the sources and outAcquireFence
+     * are consumed even on failure. srcReleaseFences gets one release fence per source, -1 for
+     * the sources not read because of a failure. On success, outReleaseFence is signaled when
+     * outBuffer is written.
+     */
+    int32_t compose(std::vector<Source> &sources, buffer_handle_t outBuffer,
+                    android_dataspace outDataspace, int32_t outAcquireFence,
+                    std::vector<int32_t> &srcReleaseFences, int32_t &outReleaseFence);
+
+    void setTargetDisplayLuminance(uint16_t min, uint16_t max);
+
+    void releaseBuffers();
+
+    void dump(String8 &result);
+
+private:
+    struct IntermediateBuffer {
+        buffer_handle_t handle = NULL;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /* Signaled when the last run reading the buffer is done */
+        int32_t releaseFence = -1;
+        /* Signaled when the last run writing the buffer is done */
+        int32_t acquireFence = -1;
+    };
+    static constexpr size_t kNumIntermediateBuffers = 2;
+
+    int32_t setupLayer(AcrylicLayer *layer, exynos_image &src, const exynos_image &dst,
+                       int zOrder);
+    int32_t setupCanvas(buffer_handle_t handle, android_dataspace dataspace,
+                        int32_t acquireFence);
+    int32_t prepareLayers(size_t count);
+    IntermediateBuffer *getIntermediateBuffer(size_t index, uint32_t width, uint32_t height);
+    void freeIntermediateBuffer(IntermediateBuffer &buffer);
+    void closeFences(std::vector<Source> &sources, size_t from, int32_t &outAcquireFence);
+
+    ExynosDisplay *mDisplay;
+    Acrylic *mAcrylic;
+    std::vector<AcrylicLayer *> mLayers;
+    IntermediateBuffer mIntermediateBuffers[kNumIntermediateBuffers];
+
+    uint64_t mComposedFrames;
+    uint64_t mMultiPassFrames;
+    uint64_t mFailedFrames;
+    uint32_t mLastSourceCount;
+    uint32_t mLastPassCount;
+};
+
+#endif
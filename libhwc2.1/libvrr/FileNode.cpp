@@ -16,8 +16,15 @@
 
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 #include "FileNode.h"
+#include <fcntl.h>
+#include <hardware/hardware.h>
 #include <log/log.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <sstream>
 
 namespace android {
@@ -26,46 +33,99 @@ ANDROID_SINGLETON_STATIC_INSTANCE(hardware::graphics::composer::FileNodeManager)
 
 namespace hardware::graphics::composer {
 
+namespace {
+
+constexpr size_t kInitialReadBufferSize = 256;
+
+} // namespace
+
+void FileNode::IoStats::record(int64_t durationNs, bool success) {
+    count++;
+    if (!success) errors++;
+    totalNs += durationNs;
+    maxNs = std::max(maxNs, durationNs);
+}
+
+void FileNode::IoStats::dump(std::ostringstream& os, const char* name) const {
+    if (count == 0) return;
+    os << ", " << name << " count = " << count << " (errors " << errors
+       << "), avg = " << totalNs / count / 1000 << "us, max = " << maxNs / 1000 << "us";
+}
+
 FileNode::FileNode(const std::string& nodePath) : mNodePath(nodePath) {}
 
 FileNode::~FileNode() {
-    for (auto& fd : mFds) {
-        close(fd.second);
+    for (auto& item : mNodes) {
+        if (item.second.writeFd >= 0) close(item.second.writeFd);
+        if (item.second.readFd >= 0) close(item.second.readFd);
     }
 }
 
 std::string FileNode::dump() {
+    std::lock_guard<std::mutex> lock(mMutex);
     std::ostringstream os;
     os << "FileNode: root path: " << mNodePath << std::endl;
-    for (const auto& item : mFds) {
-        auto lastWrittenString = getLastWrittenString(item.first);
-        if (lastWrittenString)
-            os << "FileNode: sysfs node = " << item.first
-               << ", last written value = " << *lastWrittenString << std::endl;
+    for (const auto& item : mNodes) {
+        const Node& node = item.second;
+        os << "FileNode: sysfs node = " << item.first;
+        if (node.lastWrittenString) os << ", last written value = " << *node.lastWrittenString;
+        node.writes.dump(os, "writes");
+        if (node.skippedWrites) os << ", unchanged writes skipped = " << node.skippedWrites;
+        node.reads.dump(os, "reads");
+        os << std::endl;
     }
     return os.str();
 }
 
 std::optional<std::string> FileNode::getLastWrittenString(const std::string& nodeName) {
-    int fd = getFileHandler(nodeName);
-    if ((fd < 0) || (mLastWrittenString.count(fd) <= 0)) return std::nullopt;
-    return mLastWrittenString[fd];
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mNodes.find(nodeName);
+    if (iter == mNodes.end()) return std::nullopt;
+    return iter->second.lastWrittenString;
 }
 
 std::optional<std::string> FileNode::readString(const std::string& nodeName) {
-    std::string fullPath = mNodePath + nodeName;
-    std::ifstream ifs(fullPath);
-    if (ifs) {
-        std::ostringstream os;
-        os << ifs.rdbuf(); // reading data
-        return os.str();
+    std::lock_guard<std::mutex> lock(mMutex);
+    Node& node = getNodeLocked(nodeName);
+    int fd = getReadFileHandlerLocked(node, nodeName);
+    if (fd < 0) return std::nullopt;
+
+    // sysfs regenerates the content of a file on each read at offset 0
+    if (mReadBuffer.empty()) mReadBuffer.resize(kInitialReadBufferSize);
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    size_t size = 0;
+    ssize_t ret;
+    while ((ret = pread(fd, mReadBuffer.data() + size, mReadBuffer.size() - size, size)) > 0) {
+        size += ret;
+        if (size == mReadBuffer.size()) mReadBuffer.resize(size * 2);
     }
-    return std::nullopt;
+    node.reads.record(systemTime(SYSTEM_TIME_MONOTONIC) - startTime, ret == 0);
+    if (ret < 0) {
+        ALOGE("Read file node %s%s failed, errno = %d", mNodePath.c_str(), nodeName.c_str(),
+              errno);
+        return std::nullopt;
+    }
+    return std::string(mReadBuffer.data(), size);
+}
+
+void FileNode::flush(const std::string& nodeName) {
+    auto& manager = FileNodeManager::getInstance();
+    std::unique_lock<std::mutex> lock(manager.mWriteMutex);
+    manager.waitWritesLocked(lock, this, nodeName);
 }
 
 int FileNode::getFileHandler(const std::string& nodeName) {
-    if (mFds.count(nodeName) > 0) {
-        return mFds[nodeName];
+    std::lock_guard<std::mutex> lock(mMutex);
+    return getFileHandlerLocked(getNodeLocked(nodeName), nodeName);
+}
+
+FileNode::Node& FileNode::getNodeLocked(const std::string& nodeName) {
+    return mNodes[nodeName];
+}
+
+int FileNode::getFileHandlerLocked(Node& node, const std::string& nodeName) {
+    if (node.writeFd >= 0) {
+        return node.writeFd;
     }
     std::string fullPath = mNodePath + nodeName;
     int fd = open(fullPath.c_str(), O_WRONLY, 0);
@@ -73,27 +133,228 @@ int FileNode::getFileHandler(const std::string& nodeName) {
         ALOGE("Open file node %s failed, fd = %d", fullPath.c_str(), fd);
         return fd;
     }
-    mFds[nodeName] = fd;
+    node.writeFd = fd;
+    return fd;
+}
+
+int FileNode::getReadFileHandlerLocked(Node& node, const std::string& nodeName) {
+    if (node.readFd >= 0) {
+        return node.readFd;
+    }
+    std::string fullPath = mNodePath + nodeName;
+    int fd = open(fullPath.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        ALOGE("Open file node %s for read failed, errno = %d", fullPath.c_str(), errno);
+        return fd;
+    }
+    node.readFd = fd;
     return fd;
 }
 
-bool FileNode::writeString(const std::string& nodeName, const std::string& str) {
-    int fd = getFileHandler(nodeName);
+bool FileNode::writeString(const std::string& nodeName, const std::string& str,
+                           bool skipIfUnchanged) {
+    // A queued write must not land after this one
+    FileNodeManager::getInstance().cancelWrites(this, nodeName);
+    return doWriteString(nodeName, str, skipIfUnchanged);
+}
+
+bool FileNode::writeStringAsync(const std::string& nodeName, std::string str,
+                                bool skipIfUnchanged) {
+    auto& manager = FileNodeManager::getInstance();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Node& node = getNodeLocked(nodeName);
+        if (getFileHandlerLocked(node, nodeName) < 0) {
+            ALOGE("Write to invalid file node %s%s", mNodePath.c_str(), nodeName.c_str());
+            return false;
+        }
+        if (skipIfUnchanged && node.lastWrittenString == str &&
+            !manager.hasPendingWrite(this, nodeName)) {
+            node.skippedWrites++;
+            return true;
+        }
+    }
+    if (!manager.queueWrite(shared_from_this(), nodeName, str, skipIfUnchanged)) {
+        // Nothing is queued without the writer thread, this write cannot pass a queued one
+        return doWriteString(nodeName, str, skipIfUnchanged);
+    }
+    return true;
+}
+
+bool FileNode::doWriteString(const std::string& nodeName, const std::string& str,
+                             bool skipIfUnchanged) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Node& node = getNodeLocked(nodeName);
+    int fd = getFileHandlerLocked(node, nodeName);
     if (fd < 0) {
         ALOGE("Write to invalid file node %s%s", mNodePath.c_str(), nodeName.c_str());
         return false;
     }
-    int ret = write(fd, str.c_str(), str.size());
+    if (skipIfUnchanged && node.lastWrittenString == str) {
+        node.skippedWrites++;
+        return true;
+    }
+
+    std::string traceName;
+    if (ATRACE_ENABLED()) {
+        std::ostringstream oss;
+        oss << "Write " << str << " to file node " << mNodePath.c_str() << nodeName.c_str();
+        traceName = oss.str();
+    }
+    ATRACE_NAME(traceName.c_str());
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    int ret = pwrite(fd, str.c_str(), str.size(), 0);
+    node.writes.record(systemTime(SYSTEM_TIME_MONOTONIC) - startTime, ret >= 0);
     if (ret < 0) {
         ALOGE("Write %s to file node %s%s failed, ret = %d errno = %d", str.c_str(),
               mNodePath.c_str(), nodeName.c_str(), ret, errno);
         return false;
     }
-    std::ostringstream oss;
-    oss << "Write " << str << " to file node " << mNodePath.c_str() << nodeName.c_str();
-    ATRACE_NAME(oss.str().c_str());
-    mLastWrittenString[fd] = str;
+    node.lastWrittenString = str;
+    return true;
+}
+
+FileNodeManager::~FileNodeManager() {
+    {
+        std::lock_guard<std::mutex> lock(mWriteMutex);
+        mWriterExit = true;
+    }
+    mWriteCondition.notify_all();
+    if (mWriterStarted) pthread_join(mWriter, nullptr);
+}
+
+std::shared_ptr<FileNode> FileNodeManager::getFileNode(const std::string& nodePath) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& fileNode = mFileNodes[nodePath];
+    if (fileNode == nullptr) {
+        fileNode = std::make_shared<FileNode>(nodePath);
+    }
+    return fileNode;
+}
+
+std::shared_ptr<FileNode> FileNodeManager::getFileNodeOfFile(const std::string& filePath,
+                                                             std::string& nodeName) {
+    const size_t pos = filePath.rfind('/');
+    if (pos == std::string::npos) {
+        nodeName = filePath;
+        return getFileNode("");
+    }
+    nodeName = filePath.substr(pos + 1);
+    return getFileNode(filePath.substr(0, pos + 1));
+}
+
+std::string FileNodeManager::dump() {
+    std::ostringstream os;
+    {
+        std::lock_guard<std::mutex> lock(mWriteMutex);
+        os << "FileNodeManager: async writes queued = " << mQueuedWrites
+           << ", replaced before written = " << mReplacedWrites
+           << ", pending = " << mPendingWrites.size()
+           << ", max queue delay = " << mMaxQueueDelayNs / 1000 << "us" << std::endl;
+    }
+    std::vector<std::shared_ptr<FileNode>> fileNodes;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto& item : mFileNodes) fileNodes.push_back(item.second);
+    }
+    for (const auto& fileNode : fileNodes) os << fileNode->dump();
+    return os.str();
+}
+
+bool FileNodeManager::queueWrite(std::shared_ptr<FileNode> fileNode, const std::string& nodeName,
+                                 std::string str, bool skipIfUnchanged) {
+    {
+        std::lock_guard<std::mutex> lock(mWriteMutex);
+        if (!mWriterStarted) {
+            if (mWriterFailed) return false;
+            int ret = pthread_create(&mWriter, nullptr, &FileNodeManager::writerMain, this);
+            if (ret != 0) {
+                ALOGE("Failed to start the sysfs writer thread (%d), writing synchronously", ret);
+                mWriterFailed = true;
+                return false;
+            }
+            pthread_setname_np(mWriter, "SysfsWriter");
+            mWriterStarted = true;
+        }
+
+        // The file ends up with the latest value either way, drop the older one
+        auto iter = std::find_if(mPendingWrites.begin(), mPendingWrites.end(),
+                                 [&](const PendingWrite& write) {
+                                     return write.fileNode == fileNode &&
+                                             write.nodeName == nodeName;
+                                 });
+        if (iter != mPendingWrites.end()) {
+            mPendingWrites.erase(iter);
+            mReplacedWrites++;
+        }
+        mPendingWrites.push_back({std::move(fileNode), nodeName, std::move(str), skipIfUnchanged,
+                                  systemTime(SYSTEM_TIME_MONOTONIC)});
+        mQueuedWrites++;
+    }
+    mWriteCondition.notify_all();
     return true;
 }
+
+bool FileNodeManager::hasPendingWrite(const FileNode* fileNode, const std::string& nodeName) {
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    return isPendingLocked(fileNode, nodeName);
+}
+
+void FileNodeManager::cancelWrites(const FileNode* fileNode, const std::string& nodeName) {
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    mPendingWrites.erase(std::remove_if(mPendingWrites.begin(), mPendingWrites.end(),
+                                        [&](const PendingWrite& write) {
+                                            return write.fileNode.get() == fileNode &&
+                                                    write.nodeName == nodeName;
+                                        }),
+                         mPendingWrites.end());
+    // Other threads waiting for the node may have been waiting for the cancelled writes only
+    mWriteCondition.notify_all();
+    waitWritesLocked(lock, fileNode, nodeName);
+}
+
+void FileNodeManager::waitWritesLocked(std::unique_lock<std::mutex>& lock,
+                                       const FileNode* fileNode, const std::string& nodeName) {
+    mWriteCondition.wait(lock, [&]() { return !isPendingLocked(fileNode, nodeName); });
+}
+
+bool FileNodeManager::isPendingLocked(const FileNode* fileNode,
+                                      const std::string& nodeName) const {
+    if (mWritingFileNode == fileNode && mWritingNodeName == nodeName) return true;
+    return std::any_of(mPendingWrites.begin(), mPendingWrites.end(),
+                       [&](const PendingWrite& write) {
+                           return write.fileNode.get() == fileNode && write.nodeName == nodeName;
+                       });
+}
+
+void* FileNodeManager::writerMain(void* manager) {
+    static_cast<FileNodeManager*>(manager)->writerLoop();
+    return nullptr;
+}
+
+void FileNodeManager::writerLoop() {
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+
+    std::unique_lock<std::mutex> lock(mWriteMutex);
+    while (true) {
+        mWriteCondition.wait(lock, [this]() { return mWriterExit || !mPendingWrites.empty(); });
+        if (mPendingWrites.empty()) break;
+
+        PendingWrite write = std::move(mPendingWrites.front());
+        mPendingWrites.pop_front();
+        mWritingFileNode = write.fileNode.get();
+        mWritingNodeName = write.nodeName;
+        mMaxQueueDelayNs =
+                std::max(mMaxQueueDelayNs, systemTime(SYSTEM_TIME_MONOTONIC) - write.queuedTimeNs);
+        lock.unlock();
+
+        write.fileNode->doWriteString(write.nodeName, write.str, write.skipIfUnchanged);
+
+        lock.lock();
+        mWritingFileNode = nullptr;
+        mWritingNodeName.clear();
+        mWriteCondition.notify_all();
+    }
+}
 }; // namespace hardware::graphics::composer
 }; // namespace android
@@ -16,18 +16,31 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <utils/Singleton.h>
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <log/log.h>
 
 namespace android::hardware::graphics::composer {
 
-class FileNode {
+/*
+ * The sysfs files of one directory. Files are opened once and kept open, reads are pread() at
+ * offset 0 into a buffer reused across reads, writes are pwrite() at offset 0. Each file keeps
+ * the last written string and the latency of its reads and writes for dump().
+ *
+ * A FileNode must be obtained from FileNodeManager, which owns the thread async writes land on.
+ */
+class FileNode : public std::enable_shared_from_this<FileNode> {
 public:
     FileNode(const std::string& nodePath);
     ~FileNode();
@@ -38,13 +51,10 @@ public:
 
     template <typename T>
     status_t getLastWrittenValue(const std::string& nodeName, T& value) {
-        int fd = getFileHandler(nodeName);
-        if (fd < 0) return BAD_VALUE;
+        auto lastWrittenString = getLastWrittenString(nodeName);
+        if (!lastWrittenString) return BAD_VALUE;
 
-        auto iter = mLastWrittenString.find(fd);
-        if (iter == mLastWrittenString.end()) return BAD_VALUE;
-
-        std::istringstream iss(iter->second);
+        std::istringstream iss(*lastWrittenString);
         iss >> value;
         return NO_ERROR;
     }
@@ -52,33 +62,123 @@ public:
     std::optional<std::string> readString(const std::string& nodeName);
 
     template <typename T>
-    bool writeValue(const std::string& nodeName, const T value) {
-        return writeString(nodeName, std::to_string(value));
+    bool readValue(const std::string& nodeName, T& value) {
+        auto content = readString(nodeName);
+        if (!content) return false;
+
+        std::istringstream iss(*content);
+        return static_cast<bool>(iss >> value);
+    }
+
+    // With skipIfUnchanged, a value equal to the last one written is not written again. Only use
+    // it for files nothing but HWC writes to.
+    template <typename T>
+    bool writeValue(const std::string& nodeName, const T value, bool skipIfUnchanged = false) {
+        return writeString(nodeName, std::to_string(value), skipIfUnchanged);
+    }
+
+    // Queues the write to the sysfs writer thread. Writes to the same file land in the order
+    // they are queued, a queued write not started yet is replaced by the next one. Returns false
+    // if the file cannot be opened, write errors are only logged.
+    template <typename T>
+    bool writeValueAsync(const std::string& nodeName, const T value,
+                         bool skipIfUnchanged = false) {
+        return writeStringAsync(nodeName, std::to_string(value), skipIfUnchanged);
     }
 
+    // Waits for the queued writes to nodeName to land
+    void flush(const std::string& nodeName);
+
     int getFileHandler(const std::string& nodeName);
 
 private:
+    friend class FileNodeManager;
+
+    struct IoStats {
+        uint64_t count = 0;
+        uint64_t errors = 0;
+        int64_t totalNs = 0;
+        int64_t maxNs = 0;
+
+        void record(int64_t durationNs, bool success);
+        void dump(std::ostringstream& os, const char* name) const;
+    };
+
+    struct Node {
+        int writeFd = -1;
+        int readFd = -1;
+        std::optional<std::string> lastWrittenString;
+        IoStats reads;
+        IoStats writes;
+        uint64_t skippedWrites = 0;
+    };
+
     std::string mNodePath;
-    std::unordered_map<std::string, int> mFds;
-    std::unordered_map<int, std::string> mLastWrittenString;
-    bool writeString(const std::string& nodeName, const std::string& str);
+    std::mutex mMutex;
+    std::unordered_map<std::string, Node> mNodes;
+    std::vector<char> mReadBuffer;
+
+    Node& getNodeLocked(const std::string& nodeName);
+    int getFileHandlerLocked(Node& node, const std::string& nodeName);
+    int getReadFileHandlerLocked(Node& node, const std::string& nodeName);
+    bool writeString(const std::string& nodeName, const std::string& str, bool skipIfUnchanged);
+    bool writeStringAsync(const std::string& nodeName, std::string str, bool skipIfUnchanged);
+    // Called on the caller thread by writeString() and on the writer thread for async writes
+    bool doWriteString(const std::string& nodeName, const std::string& str, bool skipIfUnchanged);
 };
 
 class FileNodeManager : public Singleton<FileNodeManager> {
 public:
     FileNodeManager() = default;
-    ~FileNodeManager() = default;
+    ~FileNodeManager();
 
-    std::shared_ptr<FileNode> getFileNode(const std::string& nodePath) {
-        if (mFileNodes.find(nodePath) == mFileNodes.end()) {
-            mFileNodes[nodePath] = std::make_shared<FileNode>(nodePath);
-        }
-        return mFileNodes[nodePath];
-    }
+    std::shared_ptr<FileNode> getFileNode(const std::string& nodePath);
+
+    // Returns the FileNode of the directory of filePath and sets nodeName to the file name
+    std::shared_ptr<FileNode> getFileNodeOfFile(const std::string& filePath,
+                                                std::string& nodeName);
+
+    std::string dump();
 
 private:
+    friend class FileNode;
+
+    struct PendingWrite {
+        std::shared_ptr<FileNode> fileNode;
+        std::string nodeName;
+        std::string str;
+        bool skipIfUnchanged;
+        int64_t queuedTimeNs;
+    };
+
+    // Returns false if the writer thread cannot be started, the caller then writes itself
+    bool queueWrite(std::shared_ptr<FileNode> fileNode, const std::string& nodeName,
+                    std::string str, bool skipIfUnchanged);
+    bool hasPendingWrite(const FileNode* fileNode, const std::string& nodeName);
+    // Drops the queued writes to the file and waits for the one in progress
+    void cancelWrites(const FileNode* fileNode, const std::string& nodeName);
+    void waitWritesLocked(std::unique_lock<std::mutex>& lock, const FileNode* fileNode,
+                          const std::string& nodeName);
+    bool isPendingLocked(const FileNode* fileNode, const std::string& nodeName) const;
+    void writerLoop();
+    static void* writerMain(void* manager);
+
+    std::mutex mMutex;
     std::unordered_map<std::string, std::shared_ptr<FileNode>> mFileNodes;
+
+    std::mutex mWriteMutex;
+    std::condition_variable mWriteCondition;
+    std::deque<PendingWrite> mPendingWrites;
+    const FileNode* mWritingFileNode = nullptr;
+    std::string mWritingNodeName;
+    bool mWriterExit = false;
+    // Started with pthread_create() as std::thread aborts if no thread can be created
+    pthread_t mWriter;
+    bool mWriterStarted = false;
+    bool mWriterFailed = false;
+    uint64_t mQueuedWrites = 0;
+    uint64_t mReplacedWrites = 0;
+    int64_t mMaxQueueDelayNs = 0;
 };
 
 } // namespace android::hardware::graphics::composer
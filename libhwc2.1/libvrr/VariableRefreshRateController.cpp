@@ -470,6 +470,9 @@ const char* VariableRefreshRateController::getDisplayFileNodePath() const {
 }
 
 int VariableRefreshRateController::getEstimatedVideoFrameRate() const {
+    // Prefer the cadence measured on the video layers over the panel side estimate.
+    int videoFrameRate = mDisplay->getVideoLayerFrameRate();
+    if (videoFrameRate > 0) return videoFrameRate;
     return mDisplayContextProvider->getEstimatedVideoFrameRate();
 }
 
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../FileNode.h"
+
+using namespace android::hardware::graphics::composer;
+using namespace std::chrono_literals;
+
+namespace {
+
+/*
+ * pwrite() of the FileNodes lands in the interposer below. A write to gBlockFd
+ * waits until it is released, so the test controls when the writer thread is
+ * busy, and a write to gFailFd fails with EIO.
+ */
+std::mutex gIoMutex;
+std::condition_variable gIoCondition;
+int gBlockFd = -1;
+bool gWriteBlocked = false;
+int gFailFd = -1;
+int gWriteCount = 0;
+
+// pthread_create() fails while set, to start the writer thread without success
+bool gFailThreadCreate = false;
+
+} // namespace
+
+extern "C" ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    {
+        std::unique_lock<std::mutex> lock(gIoMutex);
+        gWriteCount++;
+        if (fd == gFailFd) {
+            errno = EIO;
+            return -1;
+        }
+        if (fd == gBlockFd) {
+            gWriteBlocked = true;
+            gIoCondition.notify_all();
+            gIoCondition.wait(lock, [] { return gBlockFd < 0; });
+            gWriteBlocked = false;
+        }
+    }
+    return syscall(SYS_pwrite64, fd, buf, count, offset);
+}
+
+extern "C" int pthread_create(pthread_t* thread, const pthread_attr_t* attr,
+                              void* (*start)(void*), void* arg) {
+    using PthreadCreate = int (*)(pthread_t*, const pthread_attr_t*, void* (*)(void*), void*);
+    static PthreadCreate real = reinterpret_cast<PthreadCreate>(dlsym(RTLD_NEXT, "pthread_create"));
+    if (gFailThreadCreate) return EAGAIN;
+    return real(thread, attr, start, arg);
+}
+
+class FileNodeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mDir = makeDir({"a", "b", "c"});
+        mNode = FileNodeManager::getInstance().getFileNode(mDir);
+        // A write holds the lock of its FileNode, the one blocking the writer thread is in a
+        // directory of its own
+        mSlowDir = makeDir({"slow"});
+        mSlowNode = FileNodeManager::getInstance().getFileNode(mSlowDir);
+    }
+
+    static std::string makeDir(std::initializer_list<const char*> files) {
+        const char* tmp = getenv("TMPDIR");
+        std::string dir = std::string(tmp ? tmp : "/tmp") + "/file_node_testXXXXXX";
+        if (mkdtemp(dir.data()) == nullptr) return "";
+        dir += "/";
+        for (const char* name : files) std::ofstream(dir + name) << "0";
+        return dir;
+    }
+
+    void TearDown() override {
+        release();
+        mSlowNode->flush("slow");
+        {
+            std::lock_guard<std::mutex> lock(gIoMutex);
+            gFailFd = -1;
+        }
+        // the open files of the FileNodes do not keep the directories from being removed
+        for (const char* name : {"a", "b", "c"}) unlink((mDir + name).c_str());
+        unlink((mSlowDir + "slow").c_str());
+        rmdir(mDir.c_str());
+        rmdir(mSlowDir.c_str());
+    }
+
+    std::string content(const std::string& name) {
+        std::ifstream file(mDir + name);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    }
+
+    // Keeps the writer thread busy in an async write until release()
+    bool blockWriter() {
+        std::unique_lock<std::mutex> lock(gIoMutex);
+        gBlockFd = mSlowNode->getFileHandler("slow");
+        lock.unlock();
+        if (!mSlowNode->writeValueAsync("slow", 1)) return false;
+        lock.lock();
+        return gIoCondition.wait_for(lock, 5s, [] { return gWriteBlocked; });
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(gIoMutex);
+        gBlockFd = -1;
+        gIoCondition.notify_all();
+    }
+
+    int writeCount() {
+        std::lock_guard<std::mutex> lock(gIoMutex);
+        return gWriteCount;
+    }
+
+    std::string mDir;
+    std::string mSlowDir;
+    std::shared_ptr<FileNode> mNode;
+    std::shared_ptr<FileNode> mSlowNode;
+};
+
+TEST_F(FileNodeTest, ReadWrite) {
+    EXPECT_TRUE(mNode->writeValue("a", 42));
+    EXPECT_EQ("42", content("a"));
+
+    int value = 0;
+    EXPECT_TRUE(mNode->readValue("a", value));
+    EXPECT_EQ(42, value);
+    EXPECT_TRUE(mNode->getLastWrittenValue("a", value) == android::NO_ERROR);
+
+    EXPECT_FALSE(mNode->writeValue("missing", 1));
+    EXPECT_FALSE(mNode->writeValueAsync("missing", 1));
+    EXPECT_FALSE(mNode->readString("missing"));
+}
+
+TEST_F(FileNodeTest, AsyncWritesLandInOrder) {
+    ASSERT_TRUE(blockWriter());
+
+    // Queued while the writer is busy: b is replaced by its last value
+    ASSERT_TRUE(mNode->writeValueAsync("a", 1));
+    ASSERT_TRUE(mNode->writeValueAsync("b", 2));
+    ASSERT_TRUE(mNode->writeValueAsync("c", 3));
+    ASSERT_TRUE(mNode->writeValueAsync("b", 4));
+    EXPECT_EQ("0", content("b"));
+
+    release();
+    mNode->flush("b");
+    // a and c were queued before the replacement of b, so they landed first
+    EXPECT_EQ("3", content("c"));
+    EXPECT_EQ("4", content("b"));
+    EXPECT_EQ("1", content("a"));
+    EXPECT_NE(std::string::npos,
+              FileNodeManager::getInstance().dump().find("replaced before written = 1"));
+
+    std::string lastB;
+    mNode->getLastWrittenValue("b", lastB);
+    EXPECT_EQ("4", lastB);
+}
+
+TEST_F(FileNodeTest, SyncWriteCancelsQueuedWrite) {
+    ASSERT_TRUE(blockWriter());
+    ASSERT_TRUE(mNode->writeValueAsync("b", 2));
+
+    // A thread waiting for b is woken when the queued write is cancelled, not when the
+    // writer thread gets to it
+    std::promise<void> flushed;
+    std::thread waiter([&] {
+        mNode->flush("b");
+        flushed.set_value();
+    });
+    std::this_thread::sleep_for(10ms);
+
+    EXPECT_TRUE(mNode->writeValue("b", 5));
+    EXPECT_EQ(std::future_status::ready, flushed.get_future().wait_for(5s));
+    EXPECT_EQ("5", content("b"));
+
+    release();
+    waiter.join();
+    mSlowNode->flush("slow");
+    // the cancelled value never lands
+    EXPECT_EQ("5", content("b"));
+}
+
+TEST_F(FileNodeTest, SkipIfUnchanged) {
+    ASSERT_TRUE(mNode->writeValue("a", 7));
+    int writes = writeCount();
+
+    EXPECT_TRUE(mNode->writeValue("a", 7, true));
+    EXPECT_TRUE(mNode->writeValueAsync("a", 7, true));
+    mNode->flush("a");
+    EXPECT_EQ(writes, writeCount());
+
+    // without the flag the value is written again
+    EXPECT_TRUE(mNode->writeValue("a", 7));
+    EXPECT_EQ(writes + 1, writeCount());
+
+    // The last written value is not the one the file ends up with while another is queued, the
+    // write is queued after it instead of being skipped
+    ASSERT_TRUE(blockWriter());
+    ASSERT_TRUE(mNode->writeValueAsync("a", 8));
+    ASSERT_TRUE(mNode->writeValueAsync("a", 7, true));
+    release();
+    mNode->flush("a");
+    EXPECT_EQ("7", content("a"));
+
+    // it replaced the queued 8 and found 7 written when it got to run
+    EXPECT_NE(std::string::npos, mNode->dump().find("unchanged writes skipped = 3"));
+}
+
+TEST_F(FileNodeTest, Stats) {
+    ASSERT_TRUE(mNode->writeValue("a", 1));
+    ASSERT_TRUE(mNode->writeValue("a", 2));
+    {
+        std::lock_guard<std::mutex> lock(gIoMutex);
+        gFailFd = mNode->getFileHandler("b");
+    }
+    EXPECT_FALSE(mNode->writeValue("b", 1));
+    EXPECT_TRUE(mNode->readString("c"));
+
+    std::string dump = mNode->dump();
+    EXPECT_NE(std::string::npos, dump.find("sysfs node = a, last written value = 2, writes count = 2 (errors 0)"))
+            << dump;
+    EXPECT_NE(std::string::npos, dump.find("sysfs node = b, writes count = 1 (errors 1)")) << dump;
+    EXPECT_NE(std::string::npos, dump.find("sysfs node = c, reads count = 1 (errors 0)")) << dump;
+}
+
+TEST_F(FileNodeTest, WritesWithoutWriterThread) {
+    // In a process of its own, the writer thread of this one is already started
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(
+            {
+                gFailThreadCreate = true;
+                std::shared_ptr<FileNode> node = FileNodeManager::getInstance().getFileNode(mDir);
+                bool written = node->writeValueAsync("c", 9) && content("c") == "9";
+                TearDown();
+                exit(written ? 0 : 1);
+            },
+            ::testing::ExitedWithCode(0), "");
+}
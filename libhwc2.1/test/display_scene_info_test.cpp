@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <iterator>
+
+#include "DisplaySceneInfo.h"
+
+// The scene info only keys on the layers, it never dereferences them
+static ExynosMPPSource* const kLayerA = reinterpret_cast<ExynosMPPSource*>(0x1000);
+static ExynosMPPSource* const kLayerB = reinterpret_cast<ExynosMPPSource*>(0x2000);
+
+/*
+ * Each test drives the frames like a display module: reset() at the start of
+ * the frame, the setters, needDisplayColorSetting() and onDisplaySettingDelivered()
+ * after a successful commit.
+ */
+class DisplaySceneInfoTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // the first frame delivers a scene of two layers
+        beginFrame();
+        setLayer(0, kLayerA, hwc::Dataspace::SRGB);
+        setLayer(1, kLayerB, hwc::Dataspace::DISPLAY_P3);
+        ASSERT_TRUE(mInfo.needDisplayColorSetting());
+        mInfo.onDisplaySettingDelivered();
+    }
+
+    void beginFrame() { mInfo.reset(); }
+
+    void setLayer(uint32_t index, ExynosMPPSource* layer, hwc::Dataspace dataspace) {
+        LayerColorData& data = mInfo.getLayerColorDataInstance(index);
+        mInfo.setLayerDataMappingInfo(layer, index);
+        mInfo.setLayerDataspace(data, dataspace);
+    }
+
+    // The frame of SetUp() again
+    void sameLayers() {
+        setLayer(0, kLayerA, hwc::Dataspace::SRGB);
+        setLayer(1, kLayerB, hwc::Dataspace::DISPLAY_P3);
+    }
+
+    // Whether the current frame needs an update. Asked twice as it must not change anything.
+    bool needUpdate() {
+        bool first = mInfo.needDisplayColorSetting();
+        EXPECT_EQ(first, mInfo.needDisplayColorSetting());
+        return first;
+    }
+
+    DisplaySceneInfo mInfo;
+};
+
+TEST_F(DisplaySceneInfoTest, UnchangedFrame) {
+    for (int i = 0; i < 3; i++) {
+        beginFrame();
+        sameLayers();
+        EXPECT_FALSE(needUpdate());
+    }
+}
+
+TEST_F(DisplaySceneInfoTest, NeverDelivered) {
+    DisplaySceneInfo info;
+    EXPECT_TRUE(info.needDisplayColorSetting());
+    EXPECT_FALSE(info.displaySettingDelivered);
+
+    info.reset();
+    EXPECT_TRUE(info.needDisplayColorSetting());
+
+    info.onDisplaySettingDelivered();
+    EXPECT_TRUE(info.displaySettingDelivered);
+    info.reset();
+    EXPECT_FALSE(info.needDisplayColorSetting());
+}
+
+TEST_F(DisplaySceneInfoTest, LayerChange) {
+    beginFrame();
+    setLayer(0, kLayerA, hwc::Dataspace::SRGB);
+    setLayer(1, kLayerB, hwc::Dataspace::BT2020_PQ);
+    EXPECT_TRUE(needUpdate());
+    mInfo.onDisplaySettingDelivered();
+
+    beginFrame();
+    setLayer(0, kLayerA, hwc::Dataspace::SRGB);
+    setLayer(1, kLayerB, hwc::Dataspace::BT2020_PQ);
+    EXPECT_FALSE(needUpdate());
+}
+
+TEST_F(DisplaySceneInfoTest, AddedLayer) {
+    beginFrame();
+    sameLayers();
+    setLayer(2, reinterpret_cast<ExynosMPPSource*>(0x3000), hwc::Dataspace::SRGB);
+    EXPECT_TRUE(needUpdate());
+}
+
+TEST_F(DisplaySceneInfoTest, MappingChange) {
+    // the same color data, but the layers swap their DPP channels
+    beginFrame();
+    setLayer(0, kLayerB, hwc::Dataspace::SRGB);
+    setLayer(1, kLayerA, hwc::Dataspace::DISPLAY_P3);
+    EXPECT_TRUE(needUpdate());
+    mInfo.onDisplaySettingDelivered();
+
+    beginFrame();
+    setLayer(0, kLayerB, hwc::Dataspace::SRGB);
+    setLayer(1, kLayerA, hwc::Dataspace::DISPLAY_P3);
+    EXPECT_FALSE(needUpdate());
+}
+
+TEST_F(DisplaySceneInfoTest, DisplaySettingChanges) {
+    const std::function<void(DisplayScene&)> changes[] = {
+            [](DisplayScene& scene) { scene.dbv = 1023; },
+            [](DisplayScene& scene) { scene.lhbm_on = true; },
+            [](DisplayScene& scene) { scene.lux = 250.0f; },
+            [](DisplayScene& scene) { scene.ltm_params.roi.right = 540; },
+            [](DisplayScene& scene) { scene.ltm_params.display.width = 1080; },
+            [](DisplayScene& scene) { scene.refresh_rate = 120.0f; },
+            [](DisplayScene& scene) { scene.bm = BrightnessMode::BM_HBM; },
+    };
+
+    for (size_t i = 0; i < std::size(changes); i++) {
+        SCOPED_TRACE(i);
+        beginFrame();
+        sameLayers();
+        changes[i](mInfo.displayScene);
+        EXPECT_TRUE(needUpdate());
+        mInfo.onDisplaySettingDelivered();
+
+        beginFrame();
+        sameLayers();
+        EXPECT_FALSE(needUpdate());
+    }
+}
+
+TEST_F(DisplaySceneInfoTest, UndeliveredChangeIsReported) {
+    beginFrame();
+    sameLayers();
+    mInfo.displayScene.dbv = 512;
+    EXPECT_TRUE(needUpdate());
+    // the commit failed, nothing is delivered
+
+    beginFrame();
+    sameLayers();
+    EXPECT_TRUE(needUpdate());
+    mInfo.onDisplaySettingDelivered();
+
+    beginFrame();
+    sameLayers();
+    EXPECT_FALSE(needUpdate());
+}
+
+TEST_F(DisplaySceneInfoTest, ClearForcesUpdate) {
+    mInfo.clear();
+    beginFrame();
+    sameLayers();
+    EXPECT_TRUE(needUpdate());
+}
@@ -20,14 +20,90 @@
 
 #include "hwjpeg-internal.h"
 
+void ExynosJpegEncoder::SelectCompressor() {
+    m_pCompressor = &m_hwjpeg;
+
+    if (!m_hwjpeg.Okay()) {
+        ALOGW("HWJPEG is not available. Falling back to software compression");
+        m_swjpeg.reset(new CHWJpegSWCompressor());
+        m_pCompressor = m_swjpeg.get();
+    }
+}
+
+void ExynosJpegEncoder::SwitchCompressor(CHWJpegCompressor *compressor) {
+    if (m_pCompressor == compressor) return;
+
+    m_pCompressor = compressor;
+
+    // The configurations given to the previous compressor are applied again
+    SetState(STATE_SIZE_CHANGED | STATE_PIXFMT_CHANGED);
+
+    int jpegFormat = m_jpegFormat;
+    int qfactor = m_nQFactor;
+    m_jpegFormat = 0;
+    m_nQFactor = 0;
+    if (jpegFormat != 0) setJpegFormat(jpegFormat);
+    if (qfactor != 0) setQuality(qfactor);
+}
+
 int ExynosJpegEncoder::lock() {
-    return m_hwjpeg.lock();
+    // No exclusive access is required by the software compressor
+    if (!m_hwjpeg.Okay()) return 0;
+
+    if (m_hwjpeg.tryLock() == 0) {
+        SwitchCompressor(&m_hwjpeg);
+        return 0;
+    }
+
+    if ((errno != EAGAIN) && (errno != EACCES) && (errno != EBUSY)) {
+        ALOGERR("Failed to lock HWJPEG");
+        return -1;
+    }
+
+    // Compressing on CPU is faster than waiting for all compressions queued to H/W
+    ALOGI("HWJPEG is used by another client. Falling back to software compression");
+    if (!m_swjpeg) m_swjpeg.reset(new CHWJpegSWCompressor());
+    SwitchCompressor(m_swjpeg.get());
+
+    return 0;
 }
 
 int ExynosJpegEncoder::unlock() {
+    if (IsSoftwareCompressor()) return 0;
+
     return m_hwjpeg.unlock();
 }
 
+int ExynosJpegEncoder::setQueueDepth(unsigned int depth) {
+    if (IsSoftwareCompressor()) {
+        ALOGE("Pipelined compression is not supported by the software compressor");
+        return -1;
+    }
+
+    return m_hwjpeg.SetQueueDepth(depth) ? 0 : -1;
+}
+
+int ExynosJpegEncoder::submit(void) {
+    if (IsSoftwareCompressor()) {
+        ALOGE("Pipelined compression is not supported by the software compressor");
+        return -1;
+    }
+
+    if (!__EnsureFormatIsApplied()) return -1;
+
+    return m_hwjpeg.Submit();
+}
+
+int ExynosJpegEncoder::wait(int ticket) {
+    if (IsSoftwareCompressor()) {
+        ALOGE("Pipelined compression is not supported by the software compressor");
+        return -1;
+    }
+
+    m_nStreamSize = static_cast<int>(m_hwjpeg.Wait(ticket));
+    return (m_nStreamSize < 0) ? -1 : 0;
+}
+
 int ExynosJpegEncoder::setJpegConfig(void *pConfig) {
     ExynosJpegEncoder *that = reinterpret_cast<ExynosJpegEncoder *>(pConfig);
 
@@ -50,7 +126,8 @@ int ExynosJpegEncoder::getInBuf(int *piBuf, int *piInputSize, int iSize) {
     }
 
     size_t len_buffers[iSize];
-    if (!m_hwjpeg.GetImageBuffers(piBuf, len_buffers, static_cast<unsigned int>(iSize))) return -1;
+    if (!m_pCompressor->GetImageBuffers(piBuf, len_buffers, static_cast<unsigned int>(iSize)))
+        return -1;
 
     for (int i = 0; i < iSize; i++) piInputSize[i] = static_cast<int>(len_buffers[i]);
 
@@ -59,7 +136,7 @@ int ExynosJpegEncoder::getInBuf(int *piBuf, int *piInputSize, int iSize) {
 
 int ExynosJpegEncoder::getOutBuf(int *piBuf, int *piOutputSize) {
     size_t len;
-    if (!m_hwjpeg.GetJpegBuffer(piBuf, &len)) return -1;
+    if (!m_pCompressor->GetJpegBuffer(piBuf, &len)) return -1;
 
     *piOutputSize = static_cast<int>(len);
     return 0;
@@ -71,11 +148,11 @@ int ExynosJpegEncoder::setInBuf(int *piBuf, int *iSize) {
 
     if (!EnsureFormatIsApplied()) return -1;
 
-    if (!m_hwjpeg.GetImageBufferSizes(buflen, &bufnum)) return -1;
+    if (!m_pCompressor->GetImageBufferSizes(buflen, &bufnum)) return -1;
 
     for (unsigned int i = 0; i < bufnum; i++) buflen[i] = static_cast<size_t>(iSize[i]);
 
-    if (!m_hwjpeg.SetImageBuffer(piBuf, buflen, bufnum)) return -1;
+    if (!m_pCompressor->SetImageBuffer(piBuf, buflen, bufnum)) return -1;
 
     m_iInBufType = JPEG_BUF_TYPE_DMA_BUF;
 
@@ -83,7 +160,7 @@ int ExynosJpegEncoder::setInBuf(int *piBuf, int *iSize) {
 }
 
 int ExynosJpegEncoder::setOutBuf(int iBuf, int iSize, int offset) {
-    if (!m_hwjpeg.SetJpegBuffer(iBuf, static_cast<size_t>(iSize), offset)) return -1;
+    if (!m_pCompressor->SetJpegBuffer(iBuf, static_cast<size_t>(iSize), offset)) return -1;
 
     m_iOutBufType = JPEG_BUF_TYPE_DMA_BUF;
 
@@ -97,7 +174,8 @@ int ExynosJpegEncoder::getInBuf(char **pcBuf, int *piInputSize, int iSize) {
     }
 
     size_t len_buffers[iSize];
-    if (!m_hwjpeg.GetImageBuffers(pcBuf, len_buffers, static_cast<unsigned int>(iSize))) return -1;
+    if (!m_pCompressor->GetImageBuffers(pcBuf, len_buffers, static_cast<unsigned int>(iSize)))
+        return -1;
 
     for (int i = 0; i < iSize; i++) piInputSize[i] = static_cast<int>(len_buffers[i]);
 
@@ -106,7 +184,7 @@ int ExynosJpegEncoder::getInBuf(char **pcBuf, int *piInputSize, int iSize) {
 
 int ExynosJpegEncoder::getOutBuf(char **pcBuf, int *piOutputSize) {
     size_t len;
-    if (!m_hwjpeg.GetJpegBuffer(pcBuf, &len)) return -1;
+    if (!m_pCompressor->GetJpegBuffer(pcBuf, &len)) return -1;
 
     *piOutputSize = static_cast<int>(len);
     return 0;
@@ -118,18 +196,18 @@ int ExynosJpegEncoder::setInBuf(char **pcBuf, int *iSize) {
 
     if (!EnsureFormatIsApplied()) return -1;
 
-    if (!m_hwjpeg.GetImageBufferSizes(buflen, &bufnum)) return -1;
+    if (!m_pCompressor->GetImageBufferSizes(buflen, &bufnum)) return -1;
 
     for (unsigned int i = 0; i < bufnum; i++) buflen[i] = static_cast<size_t>(iSize[i]);
 
-    if (!m_hwjpeg.SetImageBuffer(pcBuf, buflen, bufnum)) return -1;
+    if (!m_pCompressor->SetImageBuffer(pcBuf, buflen, bufnum)) return -1;
 
     m_iInBufType = JPEG_BUF_TYPE_USER_PTR;
     return 0;
 }
 
 int ExynosJpegEncoder::setOutBuf(char *pcBuf, int iSize) {
-    if (!m_hwjpeg.SetJpegBuffer(pcBuf, static_cast<size_t>(iSize))) return -1;
+    if (!m_pCompressor->SetJpegBuffer(pcBuf, static_cast<size_t>(iSize))) return -1;
 
     m_iOutBufType = JPEG_BUF_TYPE_USER_PTR;
 
@@ -170,7 +248,7 @@ int ExynosJpegEncoder::setJpegFormat(int iV4l2JpegFormat) {
             return -1;
     }
 
-    if (!m_hwjpeg.SetChromaSampFactor(hfactor, vfactor)) return -1;
+    if (!m_pCompressor->SetChromaSampFactor(hfactor, vfactor)) return -1;
 
     m_jpegFormat = iV4l2JpegFormat;
 
@@ -181,7 +259,7 @@ int ExynosJpegEncoder::setColorBufSize(int *piBufSize, int iSize) {
     size_t len[3];
     unsigned int num = static_cast<unsigned int>(iSize);
 
-    if (!m_hwjpeg.GetImageBufferSizes(len, &num)) return -1;
+    if (!m_pCompressor->GetImageBufferSizes(len, &num)) return -1;
 
     for (unsigned int i = 0; i < num; i++) piBufSize[i] = static_cast<int>(len[i]);
 
@@ -190,7 +268,7 @@ int ExynosJpegEncoder::setColorBufSize(int *piBufSize, int iSize) {
 
 bool ExynosJpegEncoder::__EnsureFormatIsApplied() {
     if (TestStateEither(STATE_SIZE_CHANGED | STATE_PIXFMT_CHANGED) &&
-        !m_hwjpeg.SetImageFormat(m_v4l2Format, m_nWidth, m_nHeight))
+        !m_pCompressor->SetImageFormat(m_v4l2Format, m_nWidth, m_nHeight))
         return false;
 
     ClearState(STATE_SIZE_CHANGED | STATE_PIXFMT_CHANGED);
@@ -198,9 +276,9 @@ bool ExynosJpegEncoder::__EnsureFormatIsApplied() {
 }
 
 int ExynosJpegEncoder::setQuality(const unsigned char q_table[]) {
-    return m_hwjpeg.SetQuality(q_table) ? 0 : -1;
+    return m_pCompressor->SetQuality(q_table) ? 0 : -1;
 }
 
 int ExynosJpegEncoder::setPadding(const unsigned char *padding, unsigned int num_planes) {
-    return m_hwjpeg.SetPadding(padding, num_planes) ? 0 : -1;
+    return m_pCompressor->SetPadding(padding, num_planes) ? 0 : -1;
 }
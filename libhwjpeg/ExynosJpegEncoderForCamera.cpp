@@ -87,6 +87,12 @@ ExynosJpegEncoderForCamera::ExynosJpegEncoderForCamera(bool bBTBComp)
         return;
     }
 
+    if (!m_phwjpeg4thumb->Okay()) {
+        ALOGW("HWJPEG is not available. Thumbnail is compressed by software compressor");
+        delete m_phwjpeg4thumb;
+        m_phwjpeg4thumb = new CHWJpegSWCompressor();
+    }
+
     if (!m_phwjpeg4thumb->SetChromaSampFactor(2, 2)) {
         ALOGE("Failed to configure chroma subsampling factor to YUV420 for thumbnail compression");
     }
@@ -115,6 +121,7 @@ ExynosJpegEncoderForCamera::~ExynosJpegEncoderForCamera() {
     GetCompressor().Release();
 
     delete m_pAppWriter;
+    for (auto& pending : m_PendingFrames) delete pending.appWriter;
     delete m_phwjpeg4thumb;
 
     if (m_pIONThumbImgBuffer != NULL) munmap(m_pIONThumbImgBuffer, m_szIONThumbImgBuffer);
@@ -360,21 +367,12 @@ int ExynosJpegEncoderForCamera::encode(int* size, exif_attribute_t* exifInfo, in
 
     if (!ProcessExif(jpeg_base, m_nStreamSize, exifInfo, appInfo)) return -1;
 
-    int offset = PTR_DIFF(m_pStreamBase, m_pAppWriter->GetMainStreamBase());
-    int buffsize = static_cast<int>(m_nStreamSize - offset);
-    if ((fdJpegBuffer < 0) ||
-        !(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET)) { // JPEG_BUF_TYPE_USER_PTR
-        if (setOutBuf(m_pAppWriter->GetMainStreamBase(), buffsize) < 0) {
-            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d", fdJpegBuffer,
-                  m_pAppWriter->GetMainStreamBase(), buffsize);
-            return -1;
-        }
-    } else { // JPEG_BUF_TYPE_DMA_BUF
-        if (setOutBuf(fdJpegBuffer, buffsize, offset) < 0) {
-            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d", fdJpegBuffer,
-                  m_pAppWriter->GetMainStreamBase(), buffsize);
-            return -1;
-        }
+    if (!SetMainStreamBuffer(fdJpegBuffer)) return -1;
+
+    if (TestState(STATE_PIPELINED)) {
+        // Back-to-back compression is not configured while submit() is used
+        ClearState(STATE_PIPELINED);
+        if (IsBTBCompressionSupported()) SetState(STATE_THUMBSIZE_CHANGED);
     }
 
     bool block_mode = !TestState(STATE_HWFC_ENABLED);
@@ -441,7 +439,150 @@ int ExynosJpegEncoderForCamera::encode(int* size, exif_attribute_t* exifInfo, in
     return 0;
 }
 
-ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thumblen) {
+bool ExynosJpegEncoderForCamera::SetMainStreamBuffer(int fdJpegBuffer) {
+    int offset = PTR_DIFF(m_pStreamBase, m_pAppWriter->GetMainStreamBase());
+    int buffsize = static_cast<int>(m_nStreamSize - offset);
+    if ((fdJpegBuffer < 0) ||
+        !(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_DMABUF_OFFSET)) { // JPEG_BUF_TYPE_USER_PTR
+        if (setOutBuf(m_pAppWriter->GetMainStreamBase(), buffsize) < 0) {
+            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d", fdJpegBuffer,
+                  m_pAppWriter->GetMainStreamBase(), buffsize);
+            return false;
+        }
+    } else { // JPEG_BUF_TYPE_DMA_BUF
+        if (setOutBuf(fdJpegBuffer, buffsize, offset) < 0) {
+            ALOGE("Failed to configure stream buffer : fd %d, addr %p, streamSize %d", fdJpegBuffer,
+                  m_pAppWriter->GetMainStreamBase(), buffsize);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int ExynosJpegEncoderForCamera::submit(int size, exif_attribute_t* exifInfo, int fdJpegBuffer,
+                                       char* pcJpegBuffer, extra_appinfo_t* appInfo) {
+    if (IsSoftwareCompressor()) {
+        ALOGE("Pipelined compression is not supported by the software compressor");
+        return -1;
+    }
+
+    if (TestState(STATE_HWFC_ENABLED)) {
+        ALOGE("Pipelined compression is not supported with HWFC");
+        return -1;
+    }
+
+    if (!pcJpegBuffer) {
+        ALOGE("Target stream buffer is not specified");
+        return -1;
+    }
+
+    if (size <= 0) {
+        ALOGE("Too small stram buffer length %d bytes", size);
+        return -1;
+    }
+
+    PendingFrame* frame = NULL;
+    for (auto& pending : m_PendingFrames) {
+        if (pending.ticket < 0) {
+            frame = &pending;
+            break;
+        }
+    }
+
+    if (!frame) {
+        ALOGE("No room to submit: %zu images are not waited", ARRSIZE(m_PendingFrames));
+        return -1;
+    }
+
+    if (!frame->appWriter) {
+        frame->appWriter = new CAppMarkerWriter();
+        if (!frame->appWriter) {
+            ALOGE("Failed to allocated an instance of CAppMarkerWriter");
+            return -1;
+        }
+    }
+
+    // The thumbnail is compressed separately instead of back-to-back compression
+    // because the thumbnail stream buffer of H/W is shared by all images.
+    if (!TestState(STATE_PIPELINED)) SetState(STATE_PIPELINED | STATE_THUMBSIZE_CHANGED);
+
+    m_pStreamBase = pcJpegBuffer;
+    m_nStreamSize = size;
+
+    if (!ProcessExif(m_pStreamBase, m_nStreamSize, exifInfo, appInfo)) return -1;
+
+    if (!SetMainStreamBuffer(fdJpegBuffer)) return -1;
+
+    bool thumbenc = m_pAppWriter->GetThumbStreamBase() != NULL;
+    if (!thumbenc) {
+        setThumbnailSize(0, 0);
+    } else if (!IsThumbGenerationNeeded() && (m_fThumbBufferType == 0)) {
+        ThumbGenerationNeeded();
+    }
+
+    if (!EnsureFormatIsApplied()) {
+        ALOGE("Failed to confirm format");
+        return -1;
+    }
+
+    int ticket = ExynosJpegEncoder::submit();
+    if (ticket < 0) return -1;
+
+    // H/W is compressing the main image now
+    size_t thumblen = 0;
+    if (thumbenc) {
+        if (IsThumbGenerationNeeded())
+            thumblen = CompressThumbnail();
+        else if (AllocThumbJpegBuffer())
+            thumblen = CompressThumbnailOnly(m_pAppWriter->GetMaxThumbnailSize(), m_nThumbQuality,
+                                             getColorFormat(), checkInBufType());
+
+        ALOGE_IF(thumblen == 0,
+                 "Error occurred during thumbnail creation: no thumbnail is embedded");
+    }
+
+    frame->ticket = ticket;
+    frame->streamBase = m_pStreamBase;
+    frame->streamSize = m_nStreamSize;
+    frame->thumbStream.assign(m_pIONThumbJpegBuffer, m_pIONThumbJpegBuffer + thumblen);
+    // The APP segments written above belong to the image until wait()
+    std::swap(m_pAppWriter, frame->appWriter);
+
+    return ticket;
+}
+
+int ExynosJpegEncoderForCamera::wait(int ticket, int* size) {
+    PendingFrame* frame = NULL;
+    for (auto& pending : m_PendingFrames) {
+        if ((ticket >= 0) && (pending.ticket == ticket)) {
+            frame = &pending;
+            break;
+        }
+    }
+
+    if (!frame) {
+        ALOGE("Unknown ticket %d to wait", ticket);
+        return -1;
+    }
+
+    frame->ticket = -1;
+    std::swap(m_pAppWriter, frame->appWriter);
+    m_pStreamBase = frame->streamBase;
+    m_nStreamSize = frame->streamSize;
+
+    if (ExynosJpegEncoder::wait(ticket) < 0) return -1;
+
+    ssize_t streamlen = FinishCompression(getJpegSize(), 0, &frame->thumbStream);
+    if (streamlen < 0) return -1;
+
+    *size = static_cast<int>(streamlen);
+
+    return 0;
+}
+
+ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thumblen,
+                                                      const std::vector<char>* thumbstream) {
     bool btb = false;
     size_t max_streamsize = m_nStreamSize;
     char* mainbase = m_pAppWriter->GetMainStreamBase();
@@ -456,7 +597,10 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
     m_pAppWriter->GetMainStreamBase()[1] = 0;
 
     if (thumbbase) {
-        if (IsThumbGenerationNeeded()) {
+        if (thumbstream) {
+            // compressed by submit()
+            thumblen = thumbstream->size();
+        } else if (IsThumbGenerationNeeded()) {
             void* len;
             int ret = pthread_join(m_threadWorker, &len);
             if (ret != 0) {
@@ -478,7 +622,12 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
         size_t max_thumb = min(m_pAppWriter->GetMaxThumbnailSize(),
                                max_streamsize - m_pAppWriter->CalculateAPPSize(0) - mainlen);
 
-        if (thumblen > max_thumb) {
+        if ((thumblen > max_thumb) && thumbstream) {
+            // The thumbnail image may be overwritten by the next image already
+            ALOGE("Too large thumbnail stream size %zu (max: %zu): no thumbnail is embedded",
+                  thumblen, max_thumb);
+            thumblen = 0;
+        } else if (thumblen > max_thumb) {
             ALOGI("Too large thumbnail (%dx%d) stream size %zu (max: %zu, quality factor %d)",
                   m_nThumbWidth, m_nThumbHeight, thumblen, max_thumb, m_nThumbQuality);
             ALOGI("Retrying thumbnail compression with quality factor 50");
@@ -507,7 +656,8 @@ ssize_t ExynosJpegEncoderForCamera::FinishCompression(size_t mainlen, size_t thu
         }
 
         if (thumblen > 0) {
-            memcpy(m_pAppWriter->GetThumbStreamBase(), m_pIONThumbJpegBuffer, thumblen);
+            memcpy(m_pAppWriter->GetThumbStreamBase(),
+                   thumbstream ? thumbstream->data() : m_pIONThumbJpegBuffer, thumblen);
             m_pAppWriter->Finalize(thumblen);
         }
 
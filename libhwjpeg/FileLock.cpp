@@ -8,6 +8,10 @@ int FileLock::lock() {
     return lockf(fd_, F_LOCK, 0);
 }
 
+int FileLock::tryLock() {
+    return lockf(fd_, F_TLOCK, 0);
+}
+
 int FileLock::unlock() {
     return lockf(fd_, F_ULOCK, 0);
 }
@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <exynos-hwjpeg.h>
+#include <linux/videodev2.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Compression time of an image by the stand-in device
+#define STANDIN_HW_DELAY_US 4000
+// Number of buffers the stand-in device allocates at most for each queue
+#define STANDIN_MAX_BUFFERS 3
+// CPU time to write the APP segments of an image and to finish its stream
+#define CPU_WORK_US 3000
+
+#define IMAGE_WIDTH 1920
+#define IMAGE_HEIGHT 1080
+#define IMAGE_SIZE (IMAGE_WIDTH * IMAGE_HEIGHT * 3 / 2)
+#define STREAM_SIZE (IMAGE_SIZE / 4)
+
+/*
+ * A stand-in of /dev/video12 on a regular file. ioctl() on the file is served
+ * by StandInDevice instead of the driver. A pair of the image and the stream
+ * buffers is "compressed" by the thread of the device in the order of QBUF
+ * for STANDIN_HW_DELAY_US, so the CPU runs in parallel with the device like
+ * it does with H/W. Only the user pointer buffers are supported.
+ */
+class StandInDevice {
+    struct Buffer {
+        unsigned int index;
+        char *base;
+        size_t length;
+    };
+
+    string mPath;
+    dev_t mDev = 0;
+    ino_t mIno = 0;
+
+    mutex mLock;
+    condition_variable mCond;
+    bool mExit = false;
+    unsigned int mCount[2] = {0, 0};
+    bool mStreaming[2] = {false, false};
+    deque<Buffer> mQueued[2];
+    deque<Buffer> mDone[2];
+    thread mThread;
+
+    static int Queue(unsigned int type) {
+        return (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) ? 0 : 1;
+    }
+
+    void Run() {
+        unique_lock<mutex> lock(mLock);
+
+        while (true) {
+            mCond.wait(lock, [this] {
+                return mExit || (!mQueued[0].empty() && !mQueued[1].empty());
+            });
+            if (mExit) return;
+
+            Buffer src = mQueued[0].front();
+            Buffer dst = mQueued[1].front();
+
+            lock.unlock();
+            this_thread::sleep_for(chrono::microseconds(STANDIN_HW_DELAY_US));
+            // SOI and EOI of the stream
+            dst.base[0] = 0xFF;
+            dst.base[1] = 0xD8;
+            dst.base[STREAM_SIZE - 2] = 0xFF;
+            dst.base[STREAM_SIZE - 1] = 0xD9;
+            lock.lock();
+
+            // STREAMOFF during the compression cancels the buffers
+            if (mQueued[0].empty() || mQueued[1].empty()) continue;
+
+            mQueued[0].pop_front();
+            mQueued[1].pop_front();
+            mDone[0].push_back(src);
+            mDone[1].push_back(dst);
+            mCond.notify_all();
+        }
+    }
+
+    int SetFormat(v4l2_format *fmt) {
+        if (fmt->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+            unsigned int width = fmt->fmt.pix_mp.width & 0xFFFF;
+            unsigned int height = fmt->fmt.pix_mp.height & 0xFFFF;
+            fmt->fmt.pix_mp.num_planes = 1;
+            fmt->fmt.pix_mp.plane_fmt[0].sizeimage = width * height * 3 / 2;
+        }
+        return 0;
+    }
+
+    int ReqBufs(v4l2_requestbuffers *reqbufs) {
+        lock_guard<mutex> lock(mLock);
+
+        int q = Queue(reqbufs->type);
+        if (mStreaming[q]) {
+            errno = EBUSY;
+            return -1;
+        }
+
+        reqbufs->count = min(reqbufs->count, static_cast<unsigned int>(STANDIN_MAX_BUFFERS));
+        mCount[q] = reqbufs->count;
+        return 0;
+    }
+
+    int Stream(unsigned int type, bool on) {
+        lock_guard<mutex> lock(mLock);
+
+        int q = Queue(type);
+        mStreaming[q] = on;
+        if (!on) {
+            mQueued[q].clear();
+            mDone[q].clear();
+        }
+        mCond.notify_all();
+        return 0;
+    }
+
+    int QBuf(v4l2_buffer *buf) {
+        lock_guard<mutex> lock(mLock);
+
+        int q = Queue(buf->type);
+        if ((buf->memory != V4L2_MEMORY_USERPTR) || (buf->index >= mCount[q]) || !mStreaming[q]) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        mQueued[q].push_back({buf->index, reinterpret_cast<char *>(buf->m.planes[0].m.userptr),
+                              buf->m.planes[0].length});
+        mCond.notify_all();
+        return 0;
+    }
+
+    int DQBuf(v4l2_buffer *buf) {
+        unique_lock<mutex> lock(mLock);
+
+        int q = Queue(buf->type);
+        mCond.wait(lock, [this, q] { return !mDone[q].empty() || !mStreaming[q]; });
+        if (mDone[q].empty()) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        Buffer done = mDone[q].front();
+        mDone[q].pop_front();
+
+        buf->index = done.index;
+        buf->flags = 0;
+        if (q == 1) {
+            buf->m.planes[0].bytesused = STREAM_SIZE;
+            if (buf->length > 1) buf->m.planes[1].bytesused = 0;
+            buf->reserved2 = STANDIN_HW_DELAY_US;
+        }
+        return 0;
+    }
+
+public:
+    StandInDevice() {
+        char tmpl[] = "/data/local/tmp/hwjpeg_standinXXXXXX";
+        int fd = mkstemp(tmpl);
+        if (fd < 0) {
+            // on the host
+            char host_tmpl[] = "/tmp/hwjpeg_standinXXXXXX";
+            fd = mkstemp(host_tmpl);
+            mPath = host_tmpl;
+        } else {
+            mPath = tmpl;
+        }
+
+        struct stat st;
+        if ((fd >= 0) && (fstat(fd, &st) == 0)) {
+            mDev = st.st_dev;
+            mIno = st.st_ino;
+        }
+        if (fd >= 0) close(fd);
+
+        mThread = thread(&StandInDevice::Run, this);
+    }
+
+    ~StandInDevice() {
+        {
+            lock_guard<mutex> lock(mLock);
+            mExit = true;
+        }
+        mCond.notify_all();
+        mThread.join();
+        unlink(mPath.c_str());
+    }
+
+    const char *Path() { return mPath.c_str(); }
+
+    bool Owns(int fd) {
+        struct stat st;
+        return (fstat(fd, &st) == 0) && (st.st_dev == mDev) && (st.st_ino == mIno);
+    }
+
+    int Ioctl(unsigned long request, void *arg) {
+        switch (request) {
+            case VIDIOC_QUERYCAP: {
+                v4l2_capability *cap = static_cast<v4l2_capability *>(arg);
+                cap->device_caps = V4L2_CAP_VIDEO_M2M_MPLANE | V4L2_CAP_STREAMING;
+                cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+                return 0;
+            }
+            case VIDIOC_TRY_FMT:
+            case VIDIOC_S_FMT:
+                return SetFormat(static_cast<v4l2_format *>(arg));
+            case VIDIOC_S_EXT_CTRLS:
+                return 0;
+            case VIDIOC_REQBUFS:
+                return ReqBufs(static_cast<v4l2_requestbuffers *>(arg));
+            case VIDIOC_STREAMON:
+            case VIDIOC_STREAMOFF:
+                return Stream(*static_cast<unsigned int *>(arg), request == VIDIOC_STREAMON);
+            case VIDIOC_QBUF:
+                return QBuf(static_cast<v4l2_buffer *>(arg));
+            case VIDIOC_DQBUF:
+                return DQBuf(static_cast<v4l2_buffer *>(arg));
+        }
+
+        errno = ENOTTY;
+        return -1;
+    }
+};
+
+static StandInDevice *gStandIn;
+
+// The calls to ioctl() by libhwjpeg linked in this benchmark come here
+#if defined(__BIONIC__)
+extern "C" int ioctl(int fd, int request, ...) {
+#else
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+#endif
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (gStandIn && gStandIn->Owns(fd))
+        return gStandIn->Ioctl(static_cast<unsigned long>(request), arg);
+
+    return static_cast<int>(syscall(SYS_ioctl, fd, request, arg));
+}
+
+/*
+ * Images and streams of the frames of a burst with the user pointer buffers.
+ * There are more frames than the queue depth so that the buffers of a frame
+ * are not reused while it is compressed.
+ */
+class Burst {
+    vector<vector<char>> mImages;
+    vector<vector<char>> mStreams;
+
+public:
+    static const unsigned int kFrames = HWJPEG_V4L2_MAX_QUEUE_DEPTH + 1;
+
+    Burst()
+          : mImages(kFrames, vector<char>(IMAGE_SIZE)),
+            mStreams(kFrames, vector<char>(STREAM_SIZE)) {}
+
+    bool Configure(CHWJpegV4L2Compressor &hwjpeg, unsigned int frame) {
+        char *image = mImages[frame % kFrames].data();
+        size_t len = IMAGE_SIZE;
+        vector<char> &stream = mStreams[frame % kFrames];
+
+        return hwjpeg.SetImageBuffer(&image, &len, 1) &&
+                hwjpeg.SetJpegBuffer(stream.data(), stream.size());
+    }
+};
+
+// The APP segments of an image are written and its stream is finished by the CPU
+static void CpuWork() {
+    this_thread::sleep_for(chrono::microseconds(CPU_WORK_US));
+}
+
+static bool Prepare(CHWJpegV4L2Compressor &hwjpeg, benchmark::State &state) {
+    if (!hwjpeg.Okay() || !hwjpeg.SetImageFormat(V4L2_PIX_FMT_NV21, IMAGE_WIDTH, IMAGE_HEIGHT) ||
+        !hwjpeg.SetChromaSampFactor(2, 2) || !hwjpeg.SetQuality(95)) {
+        state.SkipWithError("Failed to configure the stand-in device");
+        return false;
+    }
+
+    return true;
+}
+
+// Compress() and the CPU work of each image one after another
+static void BM_HwjpegSerial(benchmark::State &state) {
+    StandInDevice device;
+    gStandIn = &device;
+    {
+        CHWJpegV4L2Compressor hwjpeg(device.Path());
+        Burst burst;
+        unsigned int frame = 0;
+
+        if (Prepare(hwjpeg, state)) {
+            for (auto _ : state) {
+                if (!burst.Configure(hwjpeg, frame++) || (hwjpeg.Compress() < 0)) {
+                    state.SkipWithError("Compress() failed");
+                    break;
+                }
+                CpuWork();
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+    }
+    gStandIn = NULL;
+}
+BENCHMARK(BM_HwjpegSerial)->UseRealTime();
+
+// Submit() of an image while the CPU works on the images waited
+static void BM_HwjpegPipelined(benchmark::State &state) {
+    StandInDevice device;
+    gStandIn = &device;
+    {
+        CHWJpegV4L2Compressor hwjpeg(device.Path());
+        Burst burst;
+        deque<int> tickets;
+        unsigned int frame = 0;
+
+        if (Prepare(hwjpeg, state) && hwjpeg.SetQueueDepth(state.range(0))) {
+            for (auto _ : state) {
+                if (!burst.Configure(hwjpeg, frame++)) {
+                    state.SkipWithError("Failed to configure buffers");
+                    break;
+                }
+
+                int ticket = hwjpeg.Submit();
+                if (ticket < 0) {
+                    state.SkipWithError("Submit() failed");
+                    break;
+                }
+                tickets.push_back(ticket);
+
+                // The depth is the number of the buffers granted by the device
+                if (tickets.size() >= hwjpeg.GetQueueDepth()) {
+                    if (hwjpeg.Wait(tickets.front()) < 0) {
+                        state.SkipWithError("Wait() failed");
+                        break;
+                    }
+                    tickets.pop_front();
+                    CpuWork();
+                }
+            }
+
+            for (int ticket : tickets) hwjpeg.Wait(ticket);
+
+            state.SetItemsProcessed(state.iterations());
+            state.counters["depth"] = hwjpeg.GetQueueDepth();
+        }
+    }
+    gStandIn = NULL;
+}
+BENCHMARK(BM_HwjpegPipelined)->Arg(1)->Arg(2)->Arg(HWJPEG_V4L2_MAX_QUEUE_DEPTH)->UseRealTime();
+
+/*
+ * Compress() of the software compressor that ExynosJpegEncoder falls back to
+ * and the CPU work one after another. The image is a gradient rather than a
+ * flat color so that the entropy coding is not trivial.
+ */
+static void BM_HwjpegSW(benchmark::State &state) {
+    CHWJpegSWCompressor swjpeg;
+    vector<char> image(IMAGE_SIZE);
+    vector<char> stream(IMAGE_SIZE);
+
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = static_cast<char>((i % IMAGE_WIDTH) + (i / IMAGE_WIDTH));
+
+    char *buffer = image.data();
+    size_t len = image.size();
+    if (!swjpeg.SetImageFormat(V4L2_PIX_FMT_NV21, IMAGE_WIDTH, IMAGE_HEIGHT) ||
+        !swjpeg.SetChromaSampFactor(2, 2) || !swjpeg.SetQuality(95) ||
+        !swjpeg.SetImageBuffer(&buffer, &len, 1) ||
+        !swjpeg.SetJpegBuffer(stream.data(), stream.size())) {
+        state.SkipWithError("Failed to configure the software compressor");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (swjpeg.Compress() < 0) {
+            state.SkipWithError("Compress() failed");
+            break;
+        }
+        CpuWork();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["compress_us"] = swjpeg.GetHWDelay();
+}
+BENCHMARK(BM_HwjpegSW)->UseRealTime();
+
+BENCHMARK_MAIN();
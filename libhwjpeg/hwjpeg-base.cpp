@@ -26,6 +26,9 @@
 #include "hwjpeg-internal.h"
 
 CHWJpegBase::CHWJpegBase(const char *path) : m_iFD(-1), m_uiDeviceCaps(0), m_uiAuxFlags(0) {
+    // No device is required by the software implementations
+    if (!path) return;
+
     m_iFD = open(path, O_RDWR);
     if (m_iFD < 0) ALOGERR("Failed to open '%s'", path);
 }
@@ -0,0 +1,1126 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exynos-hwjpeg.h>
+#include <linux/dma-buf.h>
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "hwjpeg-internal.h"
+
+namespace {
+
+// Maximum number of threads to compress an image
+constexpr unsigned int kMaxThreads = 4;
+// Minimum number of MCU rows to be compressed by a thread
+constexpr unsigned int kMinRowsPerThread = 16;
+
+const unsigned char kZigzagToNatural[64] = {
+        0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Quantization tables in ITU-T T.81 Annex K.1 in the natural order
+const unsigned char kStdQTable[2][64] = {
+        {
+                16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+                14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+                18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+                49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+        },
+        {
+                17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+                24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+                99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+                99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        },
+};
+
+// Huffman tables in ITU-T T.81 Annex K.3
+const unsigned char kDCLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const unsigned char kDCChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const unsigned char kDCValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+const unsigned char kACLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const unsigned char kACLumaValues[162] = {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51,
+        0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1,
+        0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18,
+        0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57,
+        0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+        0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92,
+        0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+        0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2,
+        0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+const unsigned char kACChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const unsigned char kACChromaValues[162] = {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07,
+        0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09,
+        0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25,
+        0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+        0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+        0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+        0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+        0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
+        0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2,
+        0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+struct HuffmanSpec {
+    unsigned char id; // Tc << 4 | Th
+    const unsigned char *bits;
+    const unsigned char *values;
+    unsigned int num_values;
+};
+
+const HuffmanSpec kHuffmanSpecs[4] = {
+        {0x00, kDCLumaBits, kDCValues, ARRSIZE(kDCValues)},
+        {0x10, kACLumaBits, kACLumaValues, ARRSIZE(kACLumaValues)},
+        {0x01, kDCChromaBits, kDCValues, ARRSIZE(kDCValues)},
+        {0x11, kACChromaBits, kACChromaValues, ARRSIZE(kACChromaValues)},
+};
+
+// Huffman codes and code lengths of each symbol derived from a HuffmanSpec
+struct HuffmanCode {
+    unsigned short code[256];
+    unsigned char size[256];
+};
+
+const HuffmanCode *GetHuffmanCodes() {
+    static const struct HuffmanCodeTable {
+        HuffmanCode codes[4];
+        HuffmanCodeTable() {
+            memset(codes, 0, sizeof(codes));
+            for (unsigned int t = 0; t < 4; t++) {
+                unsigned int code = 0;
+                unsigned int k = 0;
+                for (unsigned int len = 1; len <= 16; len++) {
+                    for (unsigned int i = 0; i < kHuffmanSpecs[t].bits[len - 1]; i++) {
+                        codes[t].code[kHuffmanSpecs[t].values[k]] = code++;
+                        codes[t].size[kHuffmanSpecs[t].values[k]] = len;
+                        k++;
+                    }
+                    code <<= 1;
+                }
+            }
+        }
+    } table;
+
+    return table.codes;
+}
+
+// AAN scale factors: cos(k * PI / 16) * sqrt(2) for k > 0
+const float kAANScale[8] = {1.0f,         1.387039845f, 1.306562965f, 1.175875602f,
+                            1.0f,         0.785694958f, 0.541196100f, 0.275899379f};
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+// A line of 8 samples of a block
+struct BlockLine {
+    v4sf lo;
+    v4sf hi;
+};
+
+/*
+ * The forward DCT by Arai, Agui and Nakajima on 4 lines of 8 samples at once.
+ * The outputs are scaled by the AAN scale factors that are compensated during
+ * quantization.
+ */
+inline void FDCT8(v4sf &d0, v4sf &d1, v4sf &d2, v4sf &d3, v4sf &d4, v4sf &d5, v4sf &d6,
+                  v4sf &d7) {
+    v4sf tmp0 = d0 + d7;
+    v4sf tmp7 = d0 - d7;
+    v4sf tmp1 = d1 + d6;
+    v4sf tmp6 = d1 - d6;
+    v4sf tmp2 = d2 + d5;
+    v4sf tmp5 = d2 - d5;
+    v4sf tmp3 = d3 + d4;
+    v4sf tmp4 = d3 - d4;
+
+    // even part
+    v4sf tmp10 = tmp0 + tmp3;
+    v4sf tmp13 = tmp0 - tmp3;
+    v4sf tmp11 = tmp1 + tmp2;
+    v4sf tmp12 = tmp1 - tmp2;
+
+    d0 = tmp10 + tmp11;
+    d4 = tmp10 - tmp11;
+
+    v4sf z1 = (tmp12 + tmp13) * 0.707106781f;
+    d2 = tmp13 + z1;
+    d6 = tmp13 - z1;
+
+    // odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    v4sf z5 = (tmp10 - tmp12) * 0.382683433f;
+    v4sf z2 = tmp10 * 0.541196100f + z5;
+    v4sf z4 = tmp12 * 1.306562965f + z5;
+    v4sf z3 = tmp11 * 0.707106781f;
+
+    v4sf z11 = tmp7 + z3;
+    v4sf z13 = tmp7 - z3;
+
+    d5 = z13 + z2;
+    d3 = z13 - z2;
+    d1 = z11 + z4;
+    d7 = z11 - z4;
+}
+
+inline void FDCTColumns(BlockLine l[8]) {
+    FDCT8(l[0].lo, l[1].lo, l[2].lo, l[3].lo, l[4].lo, l[5].lo, l[6].lo, l[7].lo);
+    FDCT8(l[0].hi, l[1].hi, l[2].hi, l[3].hi, l[4].hi, l[5].hi, l[6].hi, l[7].hi);
+}
+
+inline void Transpose(BlockLine l[8]) {
+    float *m = reinterpret_cast<float *>(l);
+    for (int i = 0; i < 8; i++)
+        for (int j = i + 1; j < 8; j++) std::swap(m[i * 8 + j], m[j * 8 + i]);
+}
+
+struct SWJpegPlane {
+    const unsigned char *base;
+    size_t stride;     // bytes per line
+    unsigned int step; // bytes per sample
+};
+
+struct SWJpegImage {
+    SWJpegPlane plane[3]; // Y, Cb and Cr
+    unsigned int width;
+    unsigned int height;
+    unsigned int src_hfactor; // chroma subsampling factors of the source image
+    unsigned int src_vfactor;
+    unsigned int hfactor; // chroma subsampling factors of the stream. Zero for gray.
+    unsigned int vfactor;
+    unsigned int mcu_width;
+    unsigned int mcu_height;
+    unsigned int mcus_per_row;
+    unsigned int mcu_rows;
+    // reciprocals of the quantizers multiplied by the AAN scale factors.
+    // The order is the transposed natural order that the output of FDCT() has.
+    float quantizer[2][64];
+    // zig-zag scan order to the transposed natural order
+    unsigned char scan_order[64];
+};
+
+class BitWriter {
+    std::vector<unsigned char> &m_out;
+    uint64_t m_acc;
+    unsigned int m_bits;
+
+public:
+    BitWriter(std::vector<unsigned char> &out) : m_out(out), m_acc(0), m_bits(0) {}
+
+    inline void Put(unsigned int code, unsigned int size) {
+        m_acc = (m_acc << size) | (code & ((1U << size) - 1));
+        m_bits += size;
+        while (m_bits >= 8) {
+            unsigned char c = static_cast<unsigned char>(m_acc >> (m_bits - 8));
+            m_out.push_back(c);
+            if (c == 0xFF) m_out.push_back(0); // byte stuffing
+            m_bits -= 8;
+        }
+    }
+
+    // Pad the remaining bits with ones to be byte aligned
+    void Flush() {
+        if (m_bits > 0) Put(0x7F, 8 - m_bits);
+        m_acc = 0;
+    }
+
+    void PutMarker(unsigned char marker) {
+        Flush();
+        m_out.push_back(0xFF);
+        m_out.push_back(marker);
+    }
+};
+
+void FetchLumaBlock(const SWJpegImage &img, unsigned int x, unsigned int y, BlockLine blk[8]) {
+    const SWJpegPlane &p = img.plane[0];
+    float *out = reinterpret_cast<float *>(blk);
+
+    for (unsigned int j = 0; j < 8; j++) {
+        const unsigned char *line = p.base + min(y + j, img.height - 1) * p.stride;
+        for (unsigned int i = 0; i < 8; i++)
+            out[j * 8 + i] = static_cast<float>(line[min(x + i, img.width - 1) * p.step]) - 128.0f;
+    }
+}
+
+void FetchChromaBlock(const SWJpegImage &img, unsigned int comp, unsigned int mcux,
+                      unsigned int mcuy, BlockLine blk[8]) {
+    const SWJpegPlane &p = img.plane[comp];
+    float *out = reinterpret_cast<float *>(blk);
+
+    for (unsigned int j = 0; j < 8; j++) {
+        unsigned int y = min(mcuy * img.mcu_height + j * img.vfactor, img.height - 1);
+        const unsigned char *line = p.base + (y / img.src_vfactor) * p.stride;
+        for (unsigned int i = 0; i < 8; i++) {
+            unsigned int x = min(mcux * img.mcu_width + i * img.hfactor, img.width - 1);
+            out[j * 8 + i] = static_cast<float>(line[(x / img.src_hfactor) * p.step]) - 128.0f;
+        }
+    }
+}
+
+void QuantizeBlock(BlockLine blk[8], const float quantizer[64], short coef[64]) {
+    FDCTColumns(blk);
+    Transpose(blk);
+    FDCTColumns(blk);
+
+    const float *in = reinterpret_cast<const float *>(blk);
+    for (int i = 0; i < 64; i++) {
+        float v = in[i] * quantizer[i];
+        coef[i] = static_cast<short>(v + ((v >= 0.0f) ? 0.5f : -0.5f));
+    }
+}
+
+inline unsigned int BitLength(int v) {
+    unsigned int a = static_cast<unsigned int>((v < 0) ? -v : v);
+    return (a == 0) ? 0 : 32 - __builtin_clz(a);
+}
+
+void EncodeBlock(BitWriter &bw, const short coef[64], const unsigned char scan_order[64],
+                 int &dcpred, const HuffmanCode &dc, const HuffmanCode &ac) {
+    int diff = coef[0] - dcpred;
+    dcpred = coef[0];
+
+    unsigned int nbits = BitLength(diff);
+    bw.Put(dc.code[nbits], dc.size[nbits]);
+    if (nbits > 0) bw.Put((diff < 0) ? diff - 1 : diff, nbits);
+
+    unsigned int run = 0;
+    for (unsigned int k = 1; k < 64; k++) {
+        int v = coef[scan_order[k]];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+
+        while (run > 15) {
+            bw.Put(ac.code[0xF0], ac.size[0xF0]); // ZRL
+            run -= 16;
+        }
+
+        nbits = BitLength(v);
+        unsigned int symbol = (run << 4) | nbits;
+        bw.Put(ac.code[symbol], ac.size[symbol]);
+        bw.Put((v < 0) ? v - 1 : v, nbits);
+        run = 0;
+    }
+
+    if (run > 0) bw.Put(ac.code[0x00], ac.size[0x00]); // EOB
+}
+
+/*
+ * Compress the MCU rows in [first_row, last_row) to @out. If @restart is set,
+ * RSTn marker is placed in front of each MCU row except the first row of the
+ * image. The restart interval is a MCU row.
+ */
+void CompressRows(const SWJpegImage &img, unsigned int first_row, unsigned int last_row,
+                  bool restart, std::vector<unsigned char> *out) {
+    const HuffmanCode *codes = GetHuffmanCodes();
+    BitWriter bw(*out);
+    BlockLine blk[8];
+    short coef[64];
+    int dcpred[3] = {0, 0, 0};
+    bool gray = img.hfactor == 0;
+    unsigned int hblocks = gray ? 1 : img.hfactor;
+    unsigned int vblocks = gray ? 1 : img.vfactor;
+
+    out->clear();
+
+    for (unsigned int row = first_row; row < last_row; row++) {
+        if (restart && (row > 0)) {
+            bw.PutMarker(0xD0 + ((row - 1) & 7));
+            dcpred[0] = dcpred[1] = dcpred[2] = 0;
+        }
+
+        for (unsigned int mcux = 0; mcux < img.mcus_per_row; mcux++) {
+            for (unsigned int v = 0; v < vblocks; v++) {
+                for (unsigned int h = 0; h < hblocks; h++) {
+                    FetchLumaBlock(img, mcux * img.mcu_width + h * 8,
+                                   row * img.mcu_height + v * 8, blk);
+                    QuantizeBlock(blk, img.quantizer[0], coef);
+                    EncodeBlock(bw, coef, img.scan_order, dcpred[0], codes[0], codes[1]);
+                }
+            }
+
+            if (gray) continue;
+
+            for (unsigned int comp = 1; comp < 3; comp++) {
+                FetchChromaBlock(img, comp, mcux, row, blk);
+                QuantizeBlock(blk, img.quantizer[1], coef);
+                EncodeBlock(bw, coef, img.scan_order, dcpred[comp], codes[2], codes[3]);
+            }
+        }
+    }
+
+    bw.Flush();
+}
+
+class StreamWriter {
+    unsigned char *m_base;
+    size_t m_len;
+    size_t m_pos;
+
+public:
+    StreamWriter(char *base, size_t len)
+          : m_base(reinterpret_cast<unsigned char *>(base)), m_len(len), m_pos(0) {}
+
+    bool Overflow() { return m_pos > m_len; }
+    size_t GetSize() { return m_pos; }
+
+    void Byte(unsigned char c) {
+        if (m_pos < m_len) m_base[m_pos] = c;
+        m_pos++;
+    }
+    void Word(unsigned int v) {
+        Byte(static_cast<unsigned char>(v >> 8));
+        Byte(static_cast<unsigned char>(v));
+    }
+    void Marker(unsigned char marker, unsigned int seglen) {
+        Byte(0xFF);
+        Byte(marker);
+        if (seglen > 0) Word(seglen);
+    }
+    void Bytes(const unsigned char *data, size_t len) {
+        if ((m_pos + len) <= m_len) memcpy(m_base + m_pos, data, len);
+        m_pos += len;
+    }
+};
+
+void WriteHeaders(StreamWriter &sw, const SWJpegImage &img, const unsigned char qtable[2][64],
+                  bool restart) {
+    unsigned int ncomp = (img.hfactor == 0) ? 1 : 3;
+    unsigned int ntables = (ncomp == 1) ? 1 : 2;
+
+    sw.Marker(0xD8, 0); // SOI
+
+    sw.Marker(0xDB, 2 + ntables * 65); // DQT
+    for (unsigned int t = 0; t < ntables; t++) {
+        sw.Byte(t);
+        sw.Bytes(qtable[t], 64);
+    }
+
+    sw.Marker(0xC0, 8 + ncomp * 3); // SOF0
+    sw.Byte(8);
+    sw.Word(img.height);
+    sw.Word(img.width);
+    sw.Byte(ncomp);
+    sw.Byte(1);
+    sw.Byte((ncomp == 1) ? 0x11 : ((img.hfactor << 4) | img.vfactor));
+    sw.Byte(0);
+    for (unsigned int c = 2; c <= ncomp; c++) {
+        sw.Byte(c);
+        sw.Byte(0x11);
+        sw.Byte(1);
+    }
+
+    unsigned int dhtlen = 2;
+    for (unsigned int t = 0; t < ntables * 2; t++) dhtlen += 17 + kHuffmanSpecs[t].num_values;
+    sw.Marker(0xC4, dhtlen); // DHT
+    for (unsigned int t = 0; t < ntables * 2; t++) {
+        sw.Byte(kHuffmanSpecs[t].id);
+        sw.Bytes(kHuffmanSpecs[t].bits, 16);
+        sw.Bytes(kHuffmanSpecs[t].values, kHuffmanSpecs[t].num_values);
+    }
+
+    if (restart) {
+        sw.Marker(0xDD, 4); // DRI
+        sw.Word(img.mcus_per_row);
+    }
+
+    sw.Marker(0xDA, 6 + ncomp * 2); // SOS
+    sw.Byte(ncomp);
+    sw.Byte(1);
+    sw.Byte(0x00);
+    for (unsigned int c = 2; c <= ncomp; c++) {
+        sw.Byte(c);
+        sw.Byte(0x11);
+    }
+    sw.Byte(0);  // Ss
+    sw.Byte(63); // Se
+    sw.Byte(0);  // Ah/Al
+}
+
+/*
+ * Describe the planes of @fmt. Returns the number of buffers that the image
+ * of @fmt requires. Zero if @fmt is not supported.
+ * @offsets[i] and @buffer[i] are the offset and the buffer index of plane i.
+ */
+unsigned int GetSourceLayout(unsigned int fmt, unsigned int width, unsigned int height,
+                             const unsigned char padding[3], SWJpegPlane planes[3],
+                             unsigned int buffer[3], size_t offsets[3], size_t buf_sizes[3],
+                             unsigned int *src_hfactor, unsigned int *src_vfactor) {
+    unsigned int cwidth = (width + 1) / 2;
+    unsigned int cheight = (height + 1) / 2;
+    size_t ystride = width + padding[0];
+
+    memset(planes, 0, sizeof(SWJpegPlane) * 3);
+    memset(offsets, 0, sizeof(size_t) * 3);
+    buffer[0] = buffer[1] = buffer[2] = 0;
+
+    switch (fmt) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YVYU:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_VYUY: {
+            static const unsigned char kOffsets[4][3] = {
+                    {0, 1, 3}, // YUYV
+                    {0, 3, 1}, // YVYU
+                    {1, 0, 2}, // UYVY
+                    {1, 2, 0}, // VYUY
+            };
+            unsigned int idx = (fmt == V4L2_PIX_FMT_YUYV) ? 0
+                    : (fmt == V4L2_PIX_FMT_YVYU)          ? 1
+                    : (fmt == V4L2_PIX_FMT_UYVY)          ? 2
+                                                          : 3;
+            size_t stride = cwidth * 4 + padding[0];
+            for (unsigned int i = 0; i < 3; i++) {
+                planes[i].stride = stride;
+                planes[i].step = (i == 0) ? 2 : 4;
+                offsets[i] = kOffsets[idx][i];
+            }
+            *src_hfactor = 2;
+            *src_vfactor = 1;
+            buf_sizes[0] = stride * height;
+            return 1;
+        }
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+        case V4L2_PIX_FMT_NV12M:
+        case V4L2_PIX_FMT_NV21M:
+        case V4L2_PIX_FMT_NV16:
+        case V4L2_PIX_FMT_NV61: {
+            bool crcb = (fmt == V4L2_PIX_FMT_NV21) || (fmt == V4L2_PIX_FMT_NV21M) ||
+                    (fmt == V4L2_PIX_FMT_NV61);
+            bool multi = (fmt == V4L2_PIX_FMT_NV12M) || (fmt == V4L2_PIX_FMT_NV21M);
+            bool yuv422 = (fmt == V4L2_PIX_FMT_NV16) || (fmt == V4L2_PIX_FMT_NV61);
+            size_t cstride = cwidth * 2 + padding[1];
+            size_t csize = cstride * (yuv422 ? height : cheight);
+
+            planes[0].stride = ystride;
+            planes[0].step = 1;
+            for (unsigned int i = 1; i < 3; i++) {
+                planes[i].stride = cstride;
+                planes[i].step = 2;
+                buffer[i] = multi ? 1 : 0;
+                offsets[i] = (multi ? 0 : ystride * height) + (((i == 1) == crcb) ? 1 : 0);
+            }
+            *src_hfactor = 2;
+            *src_vfactor = yuv422 ? 1 : 2;
+            if (multi) {
+                buf_sizes[0] = ystride * height;
+                buf_sizes[1] = csize;
+                return 2;
+            }
+            buf_sizes[0] = ystride * height + csize;
+            return 1;
+        }
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_YVU420:
+        case V4L2_PIX_FMT_YUV420M:
+        case V4L2_PIX_FMT_YVU420M: {
+            bool crcb = (fmt == V4L2_PIX_FMT_YVU420) || (fmt == V4L2_PIX_FMT_YVU420M);
+            bool multi = (fmt == V4L2_PIX_FMT_YUV420M) || (fmt == V4L2_PIX_FMT_YVU420M);
+            size_t psize[3];
+
+            planes[0].stride = ystride;
+            planes[0].step = 1;
+            psize[0] = ystride * height;
+            // The second and the third planes are Cr and Cb if crcb is true
+            for (unsigned int i = 1; i < 3; i++) {
+                unsigned int p = crcb ? 3 - i : i;
+                planes[i].stride = cwidth + padding[p];
+                planes[i].step = 1;
+                psize[p] = planes[i].stride * cheight;
+            }
+            for (unsigned int i = 1; i < 3; i++) {
+                unsigned int p = crcb ? 3 - i : i;
+                buffer[i] = multi ? p : 0;
+                offsets[i] = multi ? 0 : ((p == 1) ? psize[0] : psize[0] + psize[1]);
+            }
+            *src_hfactor = 2;
+            *src_vfactor = 2;
+            if (multi) {
+                memcpy(buf_sizes, psize, sizeof(psize));
+                return 3;
+            }
+            buf_sizes[0] = psize[0] + psize[1] + psize[2];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+bool SyncDmabuf(int fd, bool start, bool write) {
+    dma_buf_sync sync;
+    sync.flags = (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) |
+            (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ);
+    if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
+        ALOGERR("Failed to %s CPU access to dmabuf %d", start ? "begin" : "end", fd);
+        return false;
+    }
+    return true;
+}
+
+char *MapDmabuf(int fd, size_t len, bool write) {
+    void *p = mmap(NULL, len, write ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        ALOGERR("Failed to map dmabuf %d of %zu bytes", fd, len);
+        return NULL;
+    }
+
+    SyncDmabuf(fd, true, write);
+
+    return reinterpret_cast<char *>(p);
+}
+
+void UnmapDmabuf(int fd, char *addr, size_t len, bool write) {
+    SyncDmabuf(fd, false, write);
+    munmap(addr, len);
+}
+
+} // namespace
+
+/*
+ * Helper threads compressing the restart interval groups of the images. They
+ * are started by the first image large enough to be split and live as long as
+ * the compressor, so no thread is created for each image. The caller of Run()
+ * compresses the groups left, so an image is still compressed if no thread
+ * could be started.
+ */
+class CHWJpegSWWorkers {
+    std::vector<pthread_t> m_vecThreads;
+    std::mutex m_mtxLock;
+    std::condition_variable m_cvWork;
+    std::condition_variable m_cvDone;
+    const std::function<void(unsigned int)> *m_pJob = NULL;
+    unsigned int m_uiGroups = 0;
+    unsigned int m_uiNextGroup = 0;
+    unsigned int m_uiPending = 0;
+    bool m_bExit = false;
+
+    static void *ThreadMain(void *p) {
+        reinterpret_cast<CHWJpegSWWorkers *>(p)->Loop();
+        return NULL;
+    }
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(m_mtxLock);
+
+        while (true) {
+            m_cvWork.wait(lock, [this] { return m_bExit || (m_uiNextGroup < m_uiGroups); });
+            if (m_bExit) return;
+
+            unsigned int group = m_uiNextGroup++;
+            lock.unlock();
+            (*m_pJob)(group);
+            lock.lock();
+
+            if (--m_uiPending == 0) m_cvDone.notify_one();
+        }
+    }
+
+public:
+    ~CHWJpegSWWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(m_mtxLock);
+            m_bExit = true;
+        }
+        m_cvWork.notify_all();
+
+        for (pthread_t thread : m_vecThreads) pthread_join(thread, NULL);
+    }
+
+    // Starts threads until @count threads run. Returns the number of the running threads.
+    unsigned int Start(unsigned int count) {
+        while (m_vecThreads.size() < count) {
+            pthread_t thread;
+            int ret = pthread_create(&thread, NULL, ThreadMain, this);
+            if (ret != 0) {
+                ALOGE("Failed to create a compression thread: %s", strerror(ret));
+                break;
+            }
+            m_vecThreads.push_back(thread);
+        }
+
+        return static_cast<unsigned int>(m_vecThreads.size());
+    }
+
+    // Runs @job for the groups from 0 to @groups - 1 and returns when all of them are done
+    void Run(unsigned int groups, const std::function<void(unsigned int)> &job) {
+        std::unique_lock<std::mutex> lock(m_mtxLock);
+
+        m_pJob = &job;
+        m_uiPending = groups;
+        m_uiNextGroup = 0;
+        m_uiGroups = groups;
+        m_cvWork.notify_all();
+
+        while (m_uiNextGroup < m_uiGroups) {
+            unsigned int group = m_uiNextGroup++;
+            lock.unlock();
+            job(group);
+            lock.lock();
+            m_uiPending--;
+        }
+
+        m_cvDone.wait(lock, [this] { return m_uiPending == 0; });
+
+        m_uiGroups = 0;
+        m_uiNextGroup = 0;
+        m_pJob = NULL;
+    }
+};
+
+CHWJpegSWCompressor::CHWJpegSWCompressor()
+      : CHWJpegCompressor(NULL),
+        m_uiV4L2Format(0),
+        m_uiWidth(0),
+        m_uiHeight(0),
+        m_uiHFactor(2),
+        m_uiVFactor(2),
+        m_uiHWDelay(0),
+        m_uiSrcMemory(0),
+        m_uiNumSrcBuffers(0),
+        m_uiDstMemory(0),
+        m_pDstBuffer(NULL),
+        m_szDstBuffer(0),
+        m_iDstOffset(0) {
+    memset(m_ucPadding, 0, sizeof(m_ucPadding));
+    memset(m_pSrcBuffer, 0, sizeof(m_pSrcBuffer));
+    memset(m_szSrcBuffer, 0, sizeof(m_szSrcBuffer));
+    SetQuality(90);
+
+    ALOGD("CHWJpegSWCompressor Created: %p", this);
+}
+
+CHWJpegSWCompressor::~CHWJpegSWCompressor() {
+    ALOGD("CHWJpegSWCompressor Destroyed: %p", this);
+}
+
+bool CHWJpegSWCompressor::SetChromaSampFactor(unsigned int horizontal, unsigned int vertical) {
+    switch ((horizontal << 4) | vertical) {
+        case 0x00:
+        case 0x11:
+        case 0x21:
+        case 0x22:
+        case 0x12:
+        case 0x41:
+            break;
+        default:
+            ALOGE("Unsupported chroma subsampling %ux%u", horizontal, vertical);
+            return false;
+    }
+
+    m_uiHFactor = horizontal;
+    m_uiVFactor = vertical;
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetQuality(unsigned int quality_factor, unsigned int quality_factor2) {
+    if (quality_factor > 100) {
+        ALOGE("Unsupported quality factor %u", quality_factor);
+        return false;
+    }
+
+    // The secondary image is not supported
+    ALOGW_IF(quality_factor2 > 0, "Ignoring quality factor %u for the secondary image",
+             quality_factor2);
+
+    if (quality_factor == 0) return true;
+
+    // The scaling of IJG libjpeg
+    unsigned int scale = (quality_factor < 50) ? 5000 / quality_factor : 200 - quality_factor * 2;
+    for (unsigned int t = 0; t < 2; t++) {
+        for (unsigned int k = 0; k < 64; k++) {
+            unsigned int q = (kStdQTable[t][kZigzagToNatural[k]] * scale + 50) / 100;
+            m_ucQTable[t][k] = static_cast<unsigned char>(max(1U, min(255U, q)));
+        }
+    }
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetQuality(const unsigned char qtable[]) {
+    for (unsigned int i = 0; i < 128; i++) {
+        if (qtable[i] == 0) {
+            ALOGE("Invalid quantizer 0 at %u", i);
+            return false;
+        }
+    }
+
+    memcpy(m_ucQTable, qtable, sizeof(m_ucQTable));
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetPadding(const unsigned char padding[], unsigned int num_planes) {
+    if (num_planes > 3 || num_planes < 1) {
+        ALOGE("Attempting to set padding for incorrect number of buffers");
+        return false;
+    }
+
+    memset(m_ucPadding, 0, sizeof(m_ucPadding));
+    memcpy(m_ucPadding, padding, num_planes);
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetImageFormat(unsigned int v4l2_fmt, unsigned int width,
+                                         unsigned int height, unsigned int sec_width,
+                                         unsigned int sec_height) {
+    if ((sec_width | sec_height) != 0) {
+        ALOGE("Back-to-back compression is not supported by software compressor");
+        return false;
+    }
+
+    if ((width < 8) || (height < 8) || (width > 0xFFFF) || (height > 0xFFFF)) {
+        ALOGE("Unsupported image size %ux%u", width, height);
+        return false;
+    }
+
+    SWJpegPlane planes[3];
+    unsigned int buffer[3], hfactor, vfactor;
+    size_t offsets[3], sizes[3];
+    if (GetSourceLayout(v4l2_fmt, width, height, m_ucPadding, planes, buffer, offsets, sizes,
+                        &hfactor, &vfactor) == 0) {
+        ALOGE("Unsupported image format %#010x", v4l2_fmt);
+        return false;
+    }
+
+    m_uiV4L2Format = v4l2_fmt;
+    m_uiWidth = width;
+    m_uiHeight = height;
+
+    return true;
+}
+
+unsigned int CHWJpegSWCompressor::GetBufferSizes(size_t buf_sizes[]) {
+    SWJpegPlane planes[3];
+    unsigned int buffer[3], hfactor, vfactor;
+    size_t offsets[3];
+
+    return GetSourceLayout(m_uiV4L2Format, m_uiWidth, m_uiHeight, m_ucPadding, planes, buffer,
+                           offsets, buf_sizes, &hfactor, &vfactor);
+}
+
+bool CHWJpegSWCompressor::GetImageBufferSizes(size_t buf_sizes[], unsigned int *num_buffers) {
+    size_t sizes[3];
+    unsigned int num = GetBufferSizes(sizes);
+
+    if (num == 0) {
+        ALOGE("Image format is not configured");
+        return false;
+    }
+
+    if (num_buffers) {
+        if (*num_buffers < num) {
+            ALOGE("The size array length %u is smaller than the number of required buffers %u",
+                  *num_buffers, num);
+            return false;
+        }
+
+        *num_buffers = num;
+    }
+
+    if (buf_sizes) memcpy(buf_sizes, sizes, sizeof(sizes[0]) * num);
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetImageBuffer(char *buffers[], size_t len_buffers[],
+                                         unsigned int num_buffers) {
+    size_t sizes[3];
+    unsigned int num = GetBufferSizes(sizes);
+
+    if ((num == 0) || (num_buffers < num)) {
+        ALOGE("The number of buffers %u is smaller than the required %u", num_buffers, num);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < num; i++) {
+        if (len_buffers[i] < sizes[i]) {
+            ALOGE("The size of the buffer[%u] %zu is smaller than required %zu", i, len_buffers[i],
+                  sizes[i]);
+            return false;
+        }
+        m_pSrcBuffer[i] = buffers[i];
+        m_szSrcBuffer[i] = len_buffers[i];
+    }
+
+    m_uiNumSrcBuffers = num;
+    m_uiSrcMemory = V4L2_MEMORY_USERPTR;
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetImageBuffer(int buffers[], size_t len_buffers[],
+                                         unsigned int num_buffers) {
+    size_t sizes[3];
+    unsigned int num = GetBufferSizes(sizes);
+
+    if ((num == 0) || (num_buffers < num)) {
+        ALOGE("The number of buffers %u is smaller than the required %u", num_buffers, num);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < num; i++) {
+        if (len_buffers[i] < sizes[i]) {
+            ALOGE("The size of the buffer[%u] %zu is smaller than required %zu", i, len_buffers[i],
+                  sizes[i]);
+            return false;
+        }
+        m_fdSrcBuffer[i] = buffers[i];
+        m_szSrcBuffer[i] = len_buffers[i];
+    }
+
+    m_uiNumSrcBuffers = num;
+    m_uiSrcMemory = V4L2_MEMORY_DMABUF;
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetJpegBuffer(char *buffer, size_t len_buffer) {
+    m_pDstBuffer = buffer;
+    m_szDstBuffer = len_buffer;
+    m_iDstOffset = 0;
+    m_uiDstMemory = V4L2_MEMORY_USERPTR;
+    return true;
+}
+
+bool CHWJpegSWCompressor::SetJpegBuffer(int buffer, size_t len_buffer, int offset) {
+    m_fdDstBuffer = buffer;
+    m_szDstBuffer = len_buffer;
+    m_iDstOffset = offset;
+    m_uiDstMemory = V4L2_MEMORY_DMABUF;
+    return true;
+}
+
+ssize_t CHWJpegSWCompressor::CompressImage(char *src[], char *dst, size_t dstlen) {
+    SWJpegImage img;
+    unsigned int buffer[3];
+    size_t offsets[3], sizes[3];
+
+    if (GetSourceLayout(m_uiV4L2Format, m_uiWidth, m_uiHeight, m_ucPadding, img.plane, buffer,
+                        offsets, sizes, &img.src_hfactor, &img.src_vfactor) == 0) {
+        ALOGE("Image format is not configured");
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < 3; i++)
+        img.plane[i].base = reinterpret_cast<unsigned char *>(src[buffer[i]]) + offsets[i];
+
+    img.width = m_uiWidth;
+    img.height = m_uiHeight;
+    img.hfactor = m_uiHFactor;
+    img.vfactor = m_uiVFactor;
+    img.mcu_width = (m_uiHFactor == 0) ? 8 : m_uiHFactor * 8;
+    img.mcu_height = (m_uiVFactor == 0) ? 8 : m_uiVFactor * 8;
+    img.mcus_per_row = (img.width + img.mcu_width - 1) / img.mcu_width;
+    img.mcu_rows = (img.height + img.mcu_height - 1) / img.mcu_height;
+
+    for (unsigned int k = 0; k < 64; k++) {
+        unsigned int n = kZigzagToNatural[k];
+        // the output of FDCT is transposed: [horizontal frequency][vertical frequency]
+        unsigned int t = (n % 8) * 8 + n / 8;
+        img.scan_order[k] = t;
+        for (unsigned int c = 0; c < 2; c++)
+            img.quantizer[c][t] =
+                    1.0f / (m_ucQTable[c][k] * kAANScale[n / 8] * kAANScale[n % 8] * 8.0f);
+    }
+
+    unsigned int nthreads = min(kMaxThreads, std::max(1U, std::thread::hardware_concurrency()));
+    nthreads = max(1U, min(nthreads, img.mcu_rows / kMinRowsPerThread));
+
+    // The caller compresses a group in addition to the helper threads
+    if (nthreads > 1) {
+        if (!m_pWorkers) m_pWorkers.reset(new CHWJpegSWWorkers());
+        nthreads = m_pWorkers->Start(nthreads - 1) + 1;
+    }
+    bool restart = nthreads > 1;
+
+    StreamWriter sw(dst, dstlen);
+    WriteHeaders(sw, img, m_ucQTable, restart);
+
+    if (m_vecSegments.size() < nthreads) m_vecSegments.resize(nthreads);
+
+    unsigned int rows_per_thread = (img.mcu_rows + nthreads - 1) / nthreads;
+    auto compress_group = [&](unsigned int t) {
+        unsigned int first = min(t * rows_per_thread, img.mcu_rows);
+        unsigned int last = min(first + rows_per_thread, img.mcu_rows);
+        CompressRows(img, first, last, restart, &m_vecSegments[t]);
+    };
+
+    if (nthreads > 1)
+        m_pWorkers->Run(nthreads, compress_group);
+    else
+        compress_group(0);
+
+    for (unsigned int t = 0; t < nthreads; t++)
+        sw.Bytes(m_vecSegments[t].data(), m_vecSegments[t].size());
+
+    sw.Marker(0xD9, 0); // EOI
+
+    if (sw.Overflow()) {
+        ALOGE("Too small stream buffer %zu bytes (required %zu bytes)", dstlen, sw.GetSize());
+        return -1;
+    }
+
+    return static_cast<ssize_t>(sw.GetSize());
+}
+
+ssize_t CHWJpegSWCompressor::Compress(size_t *secondary_stream_size, bool block_mode) {
+    if (m_uiNumSrcBuffers == 0) {
+        ALOGE("Source image buffer is not specified");
+        return -1;
+    }
+
+    if (m_uiDstMemory == 0) {
+        ALOGE("Output JPEG stream buffer is not specified");
+        return -1;
+    }
+
+    CStopWatch stopwatch(true);
+
+    char *src[3] = {NULL, NULL, NULL};
+    char *dst = NULL;
+    ssize_t len = -1;
+
+    for (unsigned int i = 0; i < m_uiNumSrcBuffers; i++) {
+        if (m_uiSrcMemory == V4L2_MEMORY_USERPTR) {
+            src[i] = m_pSrcBuffer[i];
+        } else {
+            src[i] = MapDmabuf(m_fdSrcBuffer[i], m_szSrcBuffer[i], false);
+            if (!src[i]) goto err;
+        }
+    }
+
+    if (m_uiDstMemory == V4L2_MEMORY_USERPTR) {
+        dst = m_pDstBuffer;
+    } else {
+        dst = MapDmabuf(m_fdDstBuffer, m_szDstBuffer + m_iDstOffset, true);
+        if (!dst) goto err;
+    }
+
+    len = CompressImage(src, dst + ((m_uiDstMemory == V4L2_MEMORY_DMABUF) ? m_iDstOffset : 0),
+                        m_szDstBuffer);
+
+    if (m_uiDstMemory == V4L2_MEMORY_DMABUF)
+        UnmapDmabuf(m_fdDstBuffer, dst, m_szDstBuffer + m_iDstOffset, true);
+err:
+    if (m_uiSrcMemory == V4L2_MEMORY_DMABUF) {
+        for (unsigned int i = 0; i < m_uiNumSrcBuffers; i++)
+            if (src[i]) UnmapDmabuf(m_fdSrcBuffer[i], src[i], m_szSrcBuffer[i], false);
+    }
+
+    if (len < 0) return -1;
+
+    m_uiHWDelay = static_cast<unsigned int>(stopwatch.GetElapsed());
+
+    SetStreamSize(static_cast<size_t>(len));
+    if (secondary_stream_size) *secondary_stream_size = 0;
+
+    // The compression is already completed. WaitForCompression() returns the stream size.
+    return block_mode ? len : 0;
+}
+
+bool CHWJpegSWCompressor::GetImageBuffers(int buffers[], size_t len_buffers[],
+                                          unsigned int num_buffers) {
+    if (m_uiSrcMemory != V4L2_MEMORY_DMABUF) {
+        ALOGE("Current image buffer type is not dma-buf but attempted to retrieve dma-buf buffers");
+        return false;
+    }
+
+    if (num_buffers < m_uiNumSrcBuffers) {
+        ALOGE("Number of planes are %u but attemts to retrieve %u buffers", m_uiNumSrcBuffers,
+              num_buffers);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < m_uiNumSrcBuffers; i++) {
+        buffers[i] = m_fdSrcBuffer[i];
+        len_buffers[i] = m_szSrcBuffer[i];
+    }
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::GetImageBuffers(char *buffers[], size_t len_buffers[],
+                                          unsigned int num_buffers) {
+    if (m_uiSrcMemory != V4L2_MEMORY_USERPTR) {
+        ALOGE("Current image buffer type is not userptr but attempted to retrieve userptr buffers");
+        return false;
+    }
+
+    if (num_buffers < m_uiNumSrcBuffers) {
+        ALOGE("Number of planes are %u but attemts to retrieve %u buffers", m_uiNumSrcBuffers,
+              num_buffers);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < m_uiNumSrcBuffers; i++) {
+        buffers[i] = m_pSrcBuffer[i];
+        len_buffers[i] = m_szSrcBuffer[i];
+    }
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::GetJpegBuffer(int *buffer, size_t *len_buffer) {
+    if (m_uiDstMemory != V4L2_MEMORY_DMABUF) {
+        ALOGE("Current jpeg buffer type is not dma-buf but attempted to retrieve dma-buf buffer");
+        return false;
+    }
+
+    *buffer = m_fdDstBuffer;
+    *len_buffer = m_szDstBuffer;
+
+    return true;
+}
+
+bool CHWJpegSWCompressor::GetJpegBuffer(char **buffer, size_t *len_buffer) {
+    if (m_uiDstMemory != V4L2_MEMORY_USERPTR) {
+        ALOGE("Current jpeg buffer type is not userptr but attempted to retrieve userptr buffer");
+        return false;
+    }
+
+    *buffer = m_pDstBuffer;
+    *len_buffer = m_szDstBuffer;
+
+    return true;
+}
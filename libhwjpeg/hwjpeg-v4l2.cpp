@@ -19,11 +19,15 @@
 #include <linux/v4l2-controls.h>
 #include <linux/videodev2.h>
 
+#include <climits>
+
 #include "hwjpeg-internal.h"
 #include "log/log_main.h"
 
-CHWJpegV4L2Compressor::CHWJpegV4L2Compressor()
-      : CHWJpegCompressor("/dev/video12"), file_lock_(FileLock(GetDeviceFD())) {
+CHWJpegV4L2Compressor::CHWJpegV4L2Compressor() : CHWJpegV4L2Compressor("/dev/video12") {}
+
+CHWJpegV4L2Compressor::CHWJpegV4L2Compressor(const char *path)
+      : CHWJpegCompressor(path), file_lock_(FileLock(GetDeviceFD())) {
     memset(&m_v4l2Format, 0, sizeof(m_v4l2Format));
     memset(&m_v4l2SrcBuffer, 0, sizeof(m_v4l2SrcBuffer));
     memset(&m_v4l2DstBuffer, 0, sizeof(m_v4l2DstBuffer));
@@ -50,10 +54,15 @@ CHWJpegV4L2Compressor::CHWJpegV4L2Compressor()
 
     m_bEnableHWFC = false;
 
+    m_uiQueueDepth = 1;
+    m_uiQueueSlots = 1;
+    m_iNextTicket = 0;
+    ResetJobs();
+
     v4l2_capability cap;
     memset(&cap, 0, sizeof(cap));
     if (ioctl(GetDeviceFD(), VIDIOC_QUERYCAP, &cap) < 0) {
-        ALOGERR("Failed to query capability of /dev/video12");
+        ALOGERR("Failed to query capability of %s", path);
     } else if (!!(cap.capabilities & V4L2_CAP_DEVICE_CAPS)) {
         SetDeviceCapabilities(cap.device_caps);
     }
@@ -75,6 +84,22 @@ int CHWJpegV4L2Compressor::lock() {
     return file_lock_.lock();
 }
 
+int CHWJpegV4L2Compressor::tryLock() {
+    if (!mutex_.try_lock()) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (file_lock_.tryLock() < 0) {
+        int err = errno;
+        mutex_.unlock();
+        errno = err;
+        return -1;
+    }
+
+    return 0;
+}
+
 int CHWJpegV4L2Compressor::unlock() {
     mutex_.unlock();
     return file_lock_.unlock();
@@ -399,6 +424,7 @@ bool CHWJpegV4L2Compressor::StopStreaming() {
 
     // Stream off dequeues all queued buffers
     ClearFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
+    ResetJobs();
 
     // It is OK to skip DQBUF because STREAMOFF dequeues all queued buffers
     if (TestFlag(HWJPEG_FLAG_REQBUFS)) {
@@ -409,19 +435,43 @@ bool CHWJpegV4L2Compressor::StopStreaming() {
     return true;
 }
 
-ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool block_mode) {
+void CHWJpegV4L2Compressor::ResetJobs() {
+    for (unsigned int i = 0; i < HWJPEG_V4L2_MAX_QUEUE_DEPTH; i++) {
+        m_v4l2Jobs[i].ticket = -1;
+        m_v4l2Jobs[i].done = false;
+    }
+
+    m_uiJobsInFlight = 0;
+    m_uiNextSlot = 0;
+}
+
+bool CHWJpegV4L2Compressor::IsJobPending() {
+    for (unsigned int i = 0; i < m_uiQueueSlots; i++) {
+        if (m_v4l2Jobs[i].ticket >= 0) return true;
+    }
+
+    return false;
+}
+
+bool CHWJpegV4L2Compressor::PrepareCompression() {
     if (TestFlag(HWJPEG_FLAG_PIX_FMT)) {
-        if (!StopStreaming() || !SetFormat()) return -1;
+        if (IsJobPending()) {
+            ALOGE("Unable to change the image format while %u compressions are in flight",
+                  m_uiJobsInFlight);
+            return false;
+        }
+
+        if (!StopStreaming() || !SetFormat()) return false;
     }
 
     if (!TestFlag(HWJPEG_FLAG_SRC_BUFFER)) {
         ALOGE("Source image buffer is not specified");
-        return -1;
+        return false;
     }
 
     if (!TestFlag(HWJPEG_FLAG_DST_BUFFER)) {
         ALOGE("Output JPEG stream buffer is not specified");
-        return -1;
+        return false;
     }
 
     m_v4l2SrcBuffer.length = m_v4l2Format.fmt.pix_mp.num_planes;
@@ -431,7 +481,7 @@ ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool bloc
             ALOGE("Either of source or destination buffer of secondary image is not specified "
                   "(%#x)",
                   GetFlags());
-            return -1;
+            return false;
         }
         // The SMFC Driver expects the number of buffers to be doubled
         // if back-to-back compression is enabled
@@ -444,11 +494,175 @@ ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool bloc
     if (!!(GetAuxFlags() & EXYNOS_HWJPEG_AUXOPT_DST_NOCACHECLEAN))
         m_v4l2DstBuffer.flags |= V4L2_BUF_FLAG_NO_CACHE_CLEAN;
 
-    if (!ReqBufs() || !StreamOn() || !UpdateControls() || !QBuf()) return -1;
+    return ReqBufs(m_uiQueueDepth) && StreamOn() && UpdateControls();
+}
+
+ssize_t CHWJpegV4L2Compressor::Compress(size_t *secondary_stream_size, bool block_mode) {
+    if (IsJobPending()) {
+        ALOGE("Compress() is not allowed while %u compressions submitted are not waited",
+              m_uiJobsInFlight);
+        return -1;
+    }
+
+    if (!PrepareCompression()) return -1;
+
+    m_v4l2SrcBuffer.index = 0;
+    m_v4l2DstBuffer.index = 0;
+
+    if (!QBuf()) return -1;
 
     return block_mode ? DQBuf(secondary_stream_size) : 0;
 }
 
+bool CHWJpegV4L2Compressor::SetQueueDepth(unsigned int depth) {
+    if ((depth < 1) || (depth > HWJPEG_V4L2_MAX_QUEUE_DEPTH)) {
+        ALOGE("Invalid queue depth %u (max %u)", depth, HWJPEG_V4L2_MAX_QUEUE_DEPTH);
+        return false;
+    }
+
+    if (depth == m_uiQueueDepth) return true;
+
+    if (IsJobPending()) {
+        ALOGE("Unable to change queue depth while compressions are not waited");
+        return false;
+    }
+
+    // REQBUFS with the new number of buffers is required
+    if (!StopStreaming()) return false;
+
+    m_uiQueueDepth = depth;
+    m_uiQueueSlots = depth;
+
+    return true;
+}
+
+int CHWJpegV4L2Compressor::Submit() {
+    if (TestFlagEither(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP)) {
+        ALOGE("Submit() is not allowed until the non-blocking Compress() is waited");
+        return -1;
+    }
+
+    unsigned int slot = m_uiNextSlot;
+    if (m_v4l2Jobs[slot].ticket >= 0) {
+        ALOGE("No free slot to submit: ticket %d is not waited yet (depth %u)",
+              m_v4l2Jobs[slot].ticket, m_uiQueueSlots);
+        return -1;
+    }
+
+    if (!PrepareCompression()) return -1;
+
+    m_v4l2SrcBuffer.index = slot;
+    m_v4l2DstBuffer.index = slot;
+
+    if (!QBuf()) return -1;
+
+    // The queued buffers are tracked by m_v4l2Jobs rather than the flags
+    ClearFlag(HWJPEG_FLAG_QBUF_OUT | HWJPEG_FLAG_QBUF_CAP);
+
+    int ticket = m_iNextTicket;
+    m_iNextTicket = (m_iNextTicket == INT_MAX) ? 0 : m_iNextTicket + 1;
+
+    m_v4l2Jobs[slot].ticket = ticket;
+    m_v4l2Jobs[slot].done = false;
+    m_uiJobsInFlight++;
+    m_uiNextSlot = (slot + 1) % m_uiQueueSlots;
+
+    return ticket;
+}
+
+bool CHWJpegV4L2Compressor::DQBufJob() {
+    v4l2_buffer buffer_src, buffer_dst;
+    v4l2_plane planes_src[6], planes_dst[2];
+
+    memset(&buffer_src, 0, sizeof(buffer_src));
+    memset(&buffer_dst, 0, sizeof(buffer_dst));
+    memset(&planes_src, 0, sizeof(planes_src));
+    memset(&planes_dst, 0, sizeof(planes_dst));
+
+    buffer_src.type = m_v4l2SrcBuffer.type;
+    buffer_src.memory = m_v4l2SrcBuffer.memory;
+    buffer_src.length = m_v4l2SrcBuffer.length;
+    buffer_src.m.planes = planes_src;
+
+    buffer_dst.type = m_v4l2DstBuffer.type;
+    buffer_dst.memory = m_v4l2DstBuffer.memory;
+    buffer_dst.length = m_v4l2DstBuffer.length;
+    buffer_dst.m.planes = planes_dst;
+
+    if (ioctl(GetDeviceFD(), VIDIOC_DQBUF, &buffer_src) < 0) {
+        ALOGERR("Failed to DQBUF of the image buffer");
+        return false;
+    }
+
+    if (ioctl(GetDeviceFD(), VIDIOC_DQBUF, &buffer_dst) < 0) {
+        ALOGERR("Failed to DQBUF of the JPEG stream buffer");
+        return false;
+    }
+
+    // H/W processes the buffers in the order of QBUF
+    ALOGW_IF(buffer_src.index != buffer_dst.index, "Dequeued image buffer %u and stream buffer %u",
+             buffer_src.index, buffer_dst.index);
+
+    if ((buffer_dst.index >= m_uiQueueSlots) || (m_v4l2Jobs[buffer_dst.index].ticket < 0)) {
+        ALOGE("Dequeued unknown buffer index %u", buffer_dst.index);
+        return false;
+    }
+
+    hwjpeg_v4l2_job &job = m_v4l2Jobs[buffer_dst.index];
+
+    job.done = true;
+    if (!!((buffer_src.flags | buffer_dst.flags) & V4L2_BUF_FLAG_ERROR)) {
+        ALOGE("Error occurred during compression of ticket %d", job.ticket);
+        job.stream_size = -1;
+        job.secondary_stream_size = 0;
+    } else {
+        job.stream_size = static_cast<ssize_t>(buffer_dst.m.planes[0].bytesused);
+        job.secondary_stream_size = buffer_dst.m.planes[1].bytesused;
+    }
+    job.hw_delay = buffer_dst.reserved2;
+
+    m_uiJobsInFlight--;
+
+    return true;
+}
+
+ssize_t CHWJpegV4L2Compressor::Wait(int ticket, size_t *secondary_stream_size) {
+    hwjpeg_v4l2_job *job = NULL;
+
+    for (unsigned int i = 0; i < m_uiQueueSlots; i++) {
+        if ((ticket >= 0) && (m_v4l2Jobs[i].ticket == ticket)) {
+            job = &m_v4l2Jobs[i];
+            break;
+        }
+    }
+
+    if (!job) {
+        ALOGE("Unknown ticket %d to wait", ticket);
+        return -1;
+    }
+
+    while (!job->done) {
+        if (!DQBufJob()) {
+            // The state of the queued buffers is unknown. Cancel all of them.
+            StopStreaming();
+            return -1;
+        }
+    }
+
+    ssize_t stream_size = job->stream_size;
+
+    if (stream_size >= 0) {
+        SetStreamSize(static_cast<size_t>(stream_size), job->secondary_stream_size);
+        m_uiHWDelay = job->hw_delay;
+        if (secondary_stream_size) *secondary_stream_size = job->secondary_stream_size;
+    }
+
+    job->ticket = -1;
+    job->done = false;
+
+    return stream_size;
+}
+
 bool CHWJpegV4L2Compressor::TryFormat() {
     if (ioctl(GetDeviceFD(), VIDIOC_TRY_FMT, &m_v4l2Format) < 0) {
         ALOGERR("Failed to TRY_FMT for compression");
@@ -539,6 +753,9 @@ bool CHWJpegV4L2Compressor::ReqBufs(unsigned int count) {
         return false;
     }
 
+    // The driver may allocate less buffers than requested
+    unsigned int granted = reqbufs.count;
+
     memset(&reqbufs, 0, sizeof(reqbufs));
     reqbufs.count = count;
     reqbufs.memory = m_v4l2DstBuffer.memory;
@@ -553,10 +770,29 @@ bool CHWJpegV4L2Compressor::ReqBufs(unsigned int count) {
         return false;
     }
 
-    if (count > 0)
+    granted = min(granted, reqbufs.count);
+
+    if (count > 0) {
+        if (granted == 0) {
+            ALOGE("No buffer is allocated by REQBUFS(%u)", count);
+            // rolling back the reqbufs of the both queues
+            reqbufs.count = 0;
+            ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs); // don't care if it fails
+            reqbufs.count = 0;
+            reqbufs.memory = m_v4l2SrcBuffer.memory;
+            reqbufs.type = m_v4l2SrcBuffer.type;
+            ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs); // don't care if it fails
+            return false;
+        }
+
+        // Submit() uses only the slots backed by buffers of the both queues
+        m_uiQueueSlots = min(count, granted);
+        ALOGW_IF(m_uiQueueSlots < count, "Queue depth is reduced to %u from %u by the driver",
+                 m_uiQueueSlots, count);
         SetFlag(HWJPEG_FLAG_REQBUFS);
-    else
+    } else {
         ClearFlag(HWJPEG_FLAG_REQBUFS);
+    }
 
     return true;
 }
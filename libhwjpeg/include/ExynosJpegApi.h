@@ -28,6 +28,8 @@
 
 #include <exynos-hwjpeg.h>
 
+#include <memory>
+
 #ifndef JPEG_CACHE_ON
 #define JPEG_CACHE_ON 1
 #endif
@@ -64,6 +66,10 @@ class ExynosJpegEncoder {
      * of CHWJpegV4L2Compressor.
      */
     CHWJpegV4L2Compressor m_hwjpeg;
+    // Created only if HWJPEG is not available
+    std::unique_ptr<CHWJpegSWCompressor> m_swjpeg;
+    // Either of m_hwjpeg or m_swjpeg
+    CHWJpegCompressor *m_pCompressor;
 
     char m_iInBufType;
     char m_iOutBufType;
@@ -78,6 +84,8 @@ class ExynosJpegEncoder {
     int m_nStreamSize;
 
     bool __EnsureFormatIsApplied();
+    void SelectCompressor();
+    void SwitchCompressor(CHWJpegCompressor *compressor);
 
 protected:
     enum {
@@ -86,9 +94,11 @@ protected:
         STATE_BASE_MAX = 1 << 16,
     };
 
-    unsigned int GetDeviceCapabilities() { return m_hwjpeg.GetDeviceCapabilities(); }
-    CHWJpegCompressor &GetCompressor() { return m_hwjpeg; }
-    unsigned int GetHWDelay() { return m_hwjpeg.GetHWDelay(); }
+    unsigned int GetDeviceCapabilities() { return m_pCompressor->GetDeviceCapabilities(); }
+    CHWJpegCompressor &GetCompressor() { return *m_pCompressor; }
+    unsigned int GetHWDelay() {
+        return IsSoftwareCompressor() ? m_swjpeg->GetHWDelay() : m_hwjpeg.GetHWDelay();
+    }
 
     void SetState(unsigned int state) { m_uiState |= state; }
     void ClearState(unsigned int state) { m_uiState &= ~state; }
@@ -111,16 +121,23 @@ public:
             m_nStreamSize(0) {
         /* To detect setInBuf() call without format setting */
         SetState(STATE_SIZE_CHANGED | STATE_PIXFMT_CHANGED);
+        SelectCompressor();
     }
     virtual ~ExynosJpegEncoder() { destroy(); }
 
-    // Acquire exclusive lock to V4L2 device. This is a blocking call.
+    // Acquire exclusive lock to V4L2 device. This must be called before the
+    // configuration of the image. If another client holds the lock, the image
+    // is compressed by the software compressor instead of blocking until the
+    // lock is released. The quantization tables and the paddings given before
+    // lock() are not carried over to the software compressor.
     int lock();
     // Release exclusive lock to V4L2 device.
     int unlock();
 
     // Return 0 on success, -1 on error
-    int flagCreate() { return m_hwjpeg.Okay() ? 0 : -1; }
+    int flagCreate() { return m_pCompressor->Okay() ? 0 : -1; }
+    // True if images are compressed by CPU because HWJPEG is not available
+    bool IsSoftwareCompressor() { return m_pCompressor != &m_hwjpeg; }
     virtual int create(void) { return flagCreate(); }
     virtual int destroy(void) { return 0; }
     int updateConfig(void) { return 0; }
@@ -169,7 +186,7 @@ public:
 
     int setQuality(int iQuality) {
         if (m_nQFactor != iQuality) {
-            if (!m_hwjpeg.SetQuality(static_cast<unsigned int>(iQuality))) return -1;
+            if (!m_pCompressor->SetQuality(static_cast<unsigned int>(iQuality))) return -1;
             m_nQFactor = iQuality;
         }
         return 0;
@@ -184,9 +201,23 @@ public:
     int encode(void) {
         if (!__EnsureFormatIsApplied()) return false;
 
-        m_nStreamSize = static_cast<int>(m_hwjpeg.Compress());
+        m_nStreamSize = static_cast<int>(m_pCompressor->Compress());
         return (m_nStreamSize < 0) ? -1 : 0;
     }
+
+    // Pipelined compression: the image and the stream buffers configured by
+    // setInBuf() and setOutBuf() are handed over to H/W by submit(). The
+    // buffers for the next image can be configured right after submit()
+    // returns while the previous images are being compressed.
+    // It is not supported by the software compressor.
+    int setQueueDepth(unsigned int depth);
+
+    // Return the ticket of the submitted compression, -1 on error
+    int submit(void);
+
+    // Return 0 on success, -1 on error. getJpegSize() returns the size of
+    // the stream compressed for @ticket.
+    int wait(int ticket);
 };
 
 #endif //__HARDWARE_EXYNOS_EXYNOS_JPEG_API_H__
@@ -23,6 +23,7 @@
 #include <pthread.h>
 
 #include <memory>
+#include <vector>
 
 #include "ExynosJpegApi.h"
 
@@ -35,6 +36,20 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
         STATE_HWFC_ENABLED = STATE_BASE_MAX << 1,
         STATE_NO_CREATE_THUMBIMAGE = STATE_BASE_MAX << 2,
         STATE_NO_BTBCOMP = STATE_BASE_MAX << 3,
+        STATE_PIPELINED = STATE_BASE_MAX << 4,
+    };
+
+    /*
+     * An image submitted by submit(). The APP segments of the image are kept
+     * in its own CAppMarkerWriter and its thumbnail is compressed in advance
+     * because the next image can be configured before wait().
+     */
+    struct PendingFrame {
+        int ticket = -1;
+        CAppMarkerWriter* appWriter = NULL;
+        char* streamBase = NULL;
+        size_t streamSize = 0;
+        std::vector<char> thumbStream;
     };
 
     CHWJpegCompressor* m_phwjpeg4thumb;
@@ -72,6 +87,8 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
 
     pthread_t m_threadWorker;
 
+    PendingFrame m_PendingFrames[HWJPEG_V4L2_MAX_QUEUE_DEPTH];
+
     extra_appinfo_t m_extraInfo;
     app_info_t m_appInfo[15];
 
@@ -82,7 +99,9 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
     size_t CompressThumbnailOnly(size_t limit, int quality, unsigned int v4l2Format,
                                  int src_buftype);
     size_t RemoveTrailingDummies(char* base, size_t len);
-    ssize_t FinishCompression(size_t mainlen, size_t thumblen);
+    ssize_t FinishCompression(size_t mainlen, size_t thumblen,
+                              const std::vector<char>* thumbstream = NULL);
+    bool SetMainStreamBuffer(int fdJpegBuffer);
     bool ProcessExif(char* base, size_t limit, exif_attribute_t* exifInfo, extra_appinfo_t* extra);
     static void* tCompressThumbnail(void* p);
     bool PrepareCompression(bool thumbnail);
@@ -96,7 +115,7 @@ class ExynosJpegEncoderForCamera : public ExynosJpegEncoder {
 
     inline bool IsBTBCompressionSupported() {
         return !!(GetDeviceCapabilities() & V4L2_CAP_EXYNOS_JPEG_B2B_COMPRESSION) &&
-                !TestState(STATE_NO_BTBCOMP);
+                !TestStateEither(STATE_NO_BTBCOMP | STATE_PIPELINED);
     }
 
 protected:
@@ -131,6 +150,21 @@ public:
 
     ssize_t WaitForCompression();
 
+    /*
+     * Pipelined compression of camera images with the queue depth configured by
+     * setQueueDepth(). submit() writes the APP segments of the image to
+     * @pcJpegBuffer, queues the image to H/W and compresses the thumbnail while
+     * H/W compresses the main image. The buffers of the next image can be
+     * configured right after submit() returns, so the APP segments of an image
+     * are written while H/W compresses the previous images.
+     * submit() returns the ticket of the image, -1 on error. wait() stores the
+     * length of the complete stream of @ticket to @size. Back-to-back
+     * compression and HWFC are not used by the pipelined compression.
+     */
+    int submit(int size, exif_attribute_t* exifInfo, int fdJpegBuffer, char* pcJpegBuffer,
+               extra_appinfo_t* appInfo = 0);
+    int wait(int ticket, int* size);
+
     size_t GetThumbnailImage(char* buffer, size_t buflen);
 };
 
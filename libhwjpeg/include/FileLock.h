@@ -8,6 +8,8 @@ public:
 
     // Acquires advisory file lock. This will block only if called from different processes.
     int lock() ACQUIRE();
+    // Acquires advisory file lock without blocking. Returns -1 if another process holds it.
+    int tryLock() TRY_ACQUIRE(0);
     // Releases advisory file lock.
     int unlock() RELEASE();
 
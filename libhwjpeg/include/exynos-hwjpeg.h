@@ -21,6 +21,9 @@
 #include <linux/videodev2.h>
 
 #include <cstddef> // size_t
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #if VIDEO_MAX_PLANES < 6
 #error VIDEO_MAX_PLANES should not be smaller than 6
@@ -95,7 +98,7 @@ public:
      * A user that creates this object *must* test if the object is successfully
      * created because some initialization in the constructor may fail.
      */
-    bool Okay() { return m_iFD >= 0; }
+    virtual bool Okay() { return m_iFD >= 0; }
     operator bool() { return Okay(); }
 
     /*
@@ -542,6 +545,9 @@ class CHWJpegM2M1SHOTCompressor: public CHWJpegCompressor {
 
 #define TO_SEC_IMG_SIZE(val) (((val) >> 16) & 0xFFFF)
 
+// The maximum number of compressions that can be in flight in CHWJpegV4L2Compressor
+#define HWJPEG_V4L2_MAX_QUEUE_DEPTH 4
+
 class CAPABILITY("CHWJpegV4L2Compressor") CHWJpegV4L2Compressor : public CHWJpegCompressor,
                                                                   private CHWJpegFlagManager {
     enum {
@@ -586,6 +592,24 @@ class CAPABILITY("CHWJpegV4L2Compressor") CHWJpegV4L2Compressor : public CHWJpeg
 
     bool m_bEnableHWFC;
 
+    /*
+     * The state of the compression submitted to a V4L2 buffer index by Submit().
+     * The index of the job slot is the same as the V4L2 buffer index.
+     */
+    struct hwjpeg_v4l2_job {
+        int ticket; // negative if the slot is free
+        bool done;  // true if the buffers of the slot are dequeued
+        ssize_t stream_size;
+        size_t secondary_stream_size;
+        unsigned int hw_delay;
+    } m_v4l2Jobs[HWJPEG_V4L2_MAX_QUEUE_DEPTH];
+
+    unsigned int m_uiQueueDepth; // requested by SetQueueDepth()
+    unsigned int m_uiQueueSlots; // granted by the driver, at most m_uiQueueDepth
+    unsigned int m_uiJobsInFlight;
+    unsigned int m_uiNextSlot;
+    int m_iNextTicket;
+
     // File lock required for interprocess synchronization.
     FileLock file_lock_;
 
@@ -607,15 +631,24 @@ class CAPABILITY("CHWJpegV4L2Compressor") CHWJpegV4L2Compressor : public CHWJpeg
     bool StreamOff() REQUIRES(this);
     bool QBuf() REQUIRES(this);
     ssize_t DQBuf(size_t *secondary_stream_size) REQUIRES(this);
+    bool DQBufJob() REQUIRES(this);
     bool StopStreaming() REQUIRES(this);
+    bool PrepareCompression() REQUIRES(this);
+    void ResetJobs();
+    bool IsJobPending();
 
 public:
     CHWJpegV4L2Compressor();
+    // Compresses with the device of @path instead of /dev/video12
+    explicit CHWJpegV4L2Compressor(const char *path);
     virtual ~CHWJpegV4L2Compressor();
 
     // Acquires exclusive lock to V4L2 device. This must be called before starting image
     // configuration. This is a blocking call.
     int lock();
+    // Acquires exclusive lock to V4L2 device without blocking. Returns -1 with errno set if
+    // another thread or process holds the lock.
+    int tryLock();
     // Releases exclusive lock to V4L2 device. This should be called after encoding is complete.
     int unlock();
 
@@ -646,6 +679,118 @@ public:
     virtual bool GetJpegBuffer(int *buffer, size_t *len_buffer);
     virtual ssize_t WaitForCompression(size_t *secondary_stream_size = NULL);
     virtual void Release();
+
+    /*
+     * SetQueueDepth - Configure the number of compressions that can be in flight
+     * @depth[in] : The number of V4L2 buffers requested to the driver for each queue.
+     *              It should be between 1 and HWJPEG_V4L2_MAX_QUEUE_DEPTH.
+     * @return    : true if the depth is configured. false if @depth is invalid or
+     *              a compression submitted by Submit() is not waited yet.
+     *
+     * The new depth is applied by the next Submit() or Compress(). The driver may
+     * allocate less buffers than @depth. Then the depth is reduced to the number of
+     * the allocated buffers, which GetQueueDepth() returns after Submit().
+     */
+    bool SetQueueDepth(unsigned int depth);
+    unsigned int GetQueueDepth() { return m_uiQueueSlots; }
+    /*
+     * Submit - Queue the compression with the buffers configured currently
+     * @return : The ticket of the submitted compression. Negative value on error.
+     *
+     * The image and stream buffers configured by SetImageBuffer() and SetJpegBuffer()
+     * are copied to the V4L2 buffer of the next slot. Therefore, the users are allowed
+     * to configure another buffers for the next compression as soon as Submit() returns
+     * while H/W compresses the submitted image. Submit() fails if all slots are busy.
+     * The users should call Wait() with the oldest ticket to make room for a new job.
+     */
+    int Submit();
+    /*
+     * Wait - Wait for the compression submitted by Submit()
+     * @ticket[in] : The ticket returned by Submit()
+     * @secondary_stream_size[out] : The size of secondary JPEG stream
+     * @return : The size of the compressed JPEG stream. Negative value on error.
+     *
+     * The jobs submitted earlier than @ticket are also reaped because H/W processes
+     * the jobs in order. Their results are kept until Wait() is called with their tickets.
+     */
+    ssize_t Wait(int ticket, size_t *secondary_stream_size = NULL);
+};
+
+/*
+ * CHWJpegSWCompressor - JPEG compression by CPU
+ *
+ * CHWJpegSWCompressor implements the same interface with CHWJpegV4L2Compressor
+ * so that the users are able to keep compressing images when HWJPEG is absent
+ * or not available. It produces baseline JPEG streams with the standard Huffman
+ * tables. The forward DCT and the quantization are vectorized with the generic
+ * vector extension of the compiler that is lowered to NEON or SSE.
+ * If an image is large enough, it is divided into restart intervals of a MCU
+ * row and the intervals are compressed by multiple threads concurrently.
+ *
+ * Back-to-back compression and HWFC are not supported.
+ */
+class CHWJpegSWWorkers; // defined in libhwjpeg/hwjpeg-sw.cpp
+
+class CHWJpegSWCompressor : public CHWJpegCompressor {
+    unsigned int m_uiV4L2Format;
+    unsigned int m_uiWidth;
+    unsigned int m_uiHeight;
+    unsigned int m_uiHFactor; // horizontal chroma subsampling factor of the stream
+    unsigned int m_uiVFactor; // vertical chroma subsampling factor of the stream
+    unsigned int m_uiHWDelay; // time spent for the last compression in usec.
+
+    unsigned char m_ucQTable[2][64]; // quantization tables in the zig-zag scan order
+    unsigned char m_ucPadding[3];    // padding bytes at the end of each line of planes
+
+    unsigned int m_uiSrcMemory; // V4L2_MEMORY_USERPTR or V4L2_MEMORY_DMABUF
+    unsigned int m_uiNumSrcBuffers;
+    union {
+        char *m_pSrcBuffer[3];
+        int m_fdSrcBuffer[3];
+    };
+    size_t m_szSrcBuffer[3];
+
+    unsigned int m_uiDstMemory;
+    union {
+        char *m_pDstBuffer;
+        int m_fdDstBuffer;
+    };
+    size_t m_szDstBuffer;
+    int m_iDstOffset;
+
+    // compressed stream of each restart interval group compressed by a thread
+    std::vector<std::vector<unsigned char>> m_vecSegments;
+    // threads compressing the segments other than the one compressed by the caller
+    std::unique_ptr<CHWJpegSWWorkers> m_pWorkers;
+
+    unsigned int GetBufferSizes(size_t buf_sizes[]);
+    ssize_t CompressImage(char *src[], char *dst, size_t dstlen);
+
+public:
+    CHWJpegSWCompressor();
+    virtual ~CHWJpegSWCompressor();
+
+    virtual bool Okay() { return true; }
+
+    unsigned int GetHWDelay() { return m_uiHWDelay; }
+
+    virtual bool SetChromaSampFactor(unsigned int horizontal, unsigned int vertical);
+    virtual bool SetQuality(unsigned int quality_factor, unsigned int quality_factor2 = 0);
+    virtual bool SetQuality(const unsigned char qtable[]);
+    virtual bool SetPadding(const unsigned char padding[], unsigned int num_planes);
+
+    virtual bool SetImageFormat(unsigned int v4l2_fmt, unsigned int width, unsigned int height,
+                                unsigned int sec_width = 0, unsigned sec_height = 0);
+    virtual bool GetImageBufferSizes(size_t buf_sizes[], unsigned int *num_bufffers);
+    virtual bool SetImageBuffer(char *buffers[], size_t len_buffers[], unsigned int num_buffers);
+    virtual bool SetImageBuffer(int buffers[], size_t len_buffers[], unsigned int num_buffers);
+    virtual bool SetJpegBuffer(char *buffer, size_t len_buffer);
+    virtual bool SetJpegBuffer(int buffer, size_t len_buffer, int offset = 0);
+    virtual ssize_t Compress(size_t *secondary_stream_size = NULL, bool block_mode = true);
+    virtual bool GetImageBuffers(int buffers[], size_t len_buffers[], unsigned int num_buffers);
+    virtual bool GetImageBuffers(char *buffers[], size_t len_buffers[], unsigned int num_buffers);
+    virtual bool GetJpegBuffer(char **buffer, size_t *len_buffer);
+    virtual bool GetJpegBuffer(int *buffer, size_t *len_buffer);
 };
 
 class CHWJpegV4L2Decompressor : public CHWJpegDecompressor, private CHWJpegFlagManager {
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <exynos-hwjpeg.h>
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+using namespace std;
+
+/*
+ * The layout of a source image written independently of the compressor: where
+ * the samples of Y, Cb and Cr are in the buffers of the image.
+ */
+struct Component {
+    unsigned int buffer;
+    size_t offset;
+    size_t stride;
+    unsigned int step;
+};
+
+struct SourceImage {
+    unsigned int fmt;
+    unsigned int width;
+    unsigned int height;
+    unsigned int hfactor; // chroma subsampling of the source
+    unsigned int vfactor;
+    Component comp[3];
+    vector<vector<char>> buffers;
+
+    unsigned char &At(unsigned int c, unsigned int x, unsigned int y) {
+        const Component &p = comp[c];
+        return reinterpret_cast<unsigned char &>(
+                buffers[p.buffer][p.offset + y * p.stride + x * p.step]);
+    }
+
+    unsigned char Sample(unsigned int c, unsigned int x, unsigned int y) {
+        return (c == 0) ? At(0, x, y) : At(c, x / hfactor, y / vfactor);
+    }
+};
+
+// A smooth picture with details in both directions, so the error is dominated by the quantization
+static unsigned char Pixel(unsigned int c, double x, double y) {
+    double v;
+    if (c == 0)
+        v = 128 + 60 * sin(x / 23) + 40 * cos(y / 17) + 15 * sin((x + y) / 5);
+    else if (c == 1)
+        v = 128 + 50 * sin((x + y) / 40);
+    else
+        v = 128 + 50 * cos((x - y) / 35);
+    return static_cast<unsigned char>(min(255.0, max(0.0, v)));
+}
+
+/*
+ * Creates the source image of @fmt in the user pointer buffers. Every padding
+ * byte is 0xA5 so that a compressor reading the padding fails the comparison.
+ */
+static SourceImage CreateImage(unsigned int fmt, unsigned int width, unsigned int height,
+                               const unsigned char padding[3]) {
+    SourceImage img = {fmt, width, height, 2, 2, {}, {}};
+    unsigned int cwidth = (width + 1) / 2;
+    unsigned int cheight = (height + 1) / 2;
+    size_t ysize = (width + padding[0]) * height;
+    vector<size_t> sizes;
+
+    switch (fmt) {
+        case V4L2_PIX_FMT_YUYV: {
+            size_t stride = cwidth * 4 + padding[0];
+            img.hfactor = 2;
+            img.vfactor = 1;
+            img.comp[0] = {0, 0, stride, 2};
+            img.comp[1] = {0, 1, stride, 4};
+            img.comp[2] = {0, 3, stride, 4};
+            sizes = {stride * height};
+            break;
+        }
+        case V4L2_PIX_FMT_NV21:
+        case V4L2_PIX_FMT_NV16: {
+            size_t cstride = cwidth * 2 + padding[1];
+            unsigned int crows = (fmt == V4L2_PIX_FMT_NV16) ? height : cheight;
+            bool crcb = fmt == V4L2_PIX_FMT_NV21;
+            img.vfactor = (fmt == V4L2_PIX_FMT_NV16) ? 1 : 2;
+            img.comp[0] = {0, 0, width + padding[0], 1};
+            img.comp[1] = {0, ysize + (crcb ? 1 : 0), cstride, 2};
+            img.comp[2] = {0, ysize + (crcb ? 0 : 1), cstride, 2};
+            sizes = {ysize + cstride * crows};
+            break;
+        }
+        case V4L2_PIX_FMT_NV12M: {
+            size_t cstride = cwidth * 2 + padding[1];
+            img.comp[0] = {0, 0, width + padding[0], 1};
+            img.comp[1] = {1, 0, cstride, 2};
+            img.comp[2] = {1, 1, cstride, 2};
+            sizes = {ysize, cstride * cheight};
+            break;
+        }
+        case V4L2_PIX_FMT_YUV420M: {
+            img.comp[0] = {0, 0, width + padding[0], 1};
+            img.comp[1] = {1, 0, cwidth + padding[1], 1};
+            img.comp[2] = {2, 0, cwidth + padding[2], 1};
+            sizes = {ysize, (cwidth + padding[1]) * cheight, (cwidth + padding[2]) * cheight};
+            break;
+        }
+    }
+
+    for (size_t size : sizes) img.buffers.emplace_back(size, static_cast<char>(0xA5));
+
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) img.At(0, x, y) = Pixel(0, x, y);
+    for (unsigned int c = 1; c < 3; c++)
+        for (unsigned int y = 0; y < (height + img.vfactor - 1) / img.vfactor; y++)
+            for (unsigned int x = 0; x < (width + img.hfactor - 1) / img.hfactor; x++)
+                img.At(c, x, y) = Pixel(c, x * img.hfactor, y * img.vfactor);
+
+    return img;
+}
+
+struct Decoded {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    int components = 0;
+    int hfactor = 0; // the sampling factors of the luma component
+    int vfactor = 0;
+    vector<unsigned char> pixels; // YCbCr or gray, chroma replicated to the full resolution
+};
+
+static bool Decode(const char *stream, size_t len, Decoded *out) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = [](j_common_ptr cinfo) {
+        (*cinfo->err->output_message)(cinfo);
+        ADD_FAILURE() << "libjpeg rejected the stream";
+        // libjpeg does not return after error_exit. Give up the test binary.
+        abort();
+    };
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, reinterpret_cast<unsigned char *>(const_cast<char *>(stream)), len);
+
+    bool ok = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK;
+    if (ok) {
+        out->components = cinfo.num_components;
+        out->hfactor = cinfo.comp_info[0].h_samp_factor;
+        out->vfactor = cinfo.comp_info[0].v_samp_factor;
+        if (cinfo.num_components == 3) cinfo.out_color_space = JCS_YCbCr;
+        // The samples of a chroma block are replicated, not interpolated
+        cinfo.do_fancy_upsampling = FALSE;
+        jpeg_start_decompress(&cinfo);
+
+        out->width = cinfo.output_width;
+        out->height = cinfo.output_height;
+        size_t row = cinfo.output_width * cinfo.output_components;
+        out->pixels.resize(row * cinfo.output_height);
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW line = &out->pixels[cinfo.output_scanline * row];
+            jpeg_read_scanlines(&cinfo, &line, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+    }
+    jpeg_destroy_decompress(&cinfo);
+
+    return ok;
+}
+
+static double Psnr(double sse, size_t count) {
+    if (sse == 0) return 99.0;
+    return 10 * log10(255.0 * 255.0 * count / sse);
+}
+
+/*
+ * Compares each component of the decoded image with the source. The chroma of
+ * the source is compared at the resolution of the stream: the average of the
+ * source chroma in a stream chroma sample.
+ */
+static void ComparePsnr(SourceImage &src, const Decoded &dec, unsigned int hfactor,
+                        unsigned int vfactor, double psnr[3]) {
+    double sse[3] = {0, 0, 0};
+    size_t count[3] = {0, 0, 0};
+    unsigned int ncomp = dec.components;
+
+    for (unsigned int y = 0; y < src.height; y++) {
+        for (unsigned int x = 0; x < src.width; x++) {
+            const unsigned char *px = &dec.pixels[(y * dec.width + x) * ncomp];
+            double d = static_cast<double>(px[0]) - src.Sample(0, x, y);
+            sse[0] += d * d;
+            count[0]++;
+        }
+    }
+
+    if (ncomp == 3) {
+        // the top-left pixel of each stream chroma sample
+        for (unsigned int y = 0; y < src.height; y += vfactor) {
+            for (unsigned int x = 0; x < src.width; x += hfactor) {
+                const unsigned char *px = &dec.pixels[(y * dec.width + x) * ncomp];
+                for (unsigned int c = 1; c < 3; c++) {
+                    double sum = 0;
+                    unsigned int n = 0;
+                    for (unsigned int j = y; j < min(y + vfactor, src.height); j++)
+                        for (unsigned int i = x; i < min(x + hfactor, src.width); i++, n++)
+                            sum += src.Sample(c, i, j);
+                    double d = px[c] - sum / n;
+                    sse[c] += d * d;
+                    count[c]++;
+                }
+            }
+        }
+    }
+
+    for (unsigned int c = 0; c < 3; c++) psnr[c] = (c < ncomp) ? Psnr(sse[c], count[c]) : 0;
+}
+
+struct SWJpegParam {
+    unsigned int fmt;
+    unsigned int width;
+    unsigned int height;
+    unsigned int hfactor; // chroma subsampling of the stream
+    unsigned int vfactor;
+    unsigned int quality;
+    unsigned char padding[3];
+    double min_luma_psnr;
+    double min_chroma_psnr;
+};
+
+static string ParamName(const ::testing::TestParamInfo<SWJpegParam> &info) {
+    const SWJpegParam &p = info.param;
+    char fourcc[5] = {static_cast<char>(p.fmt), static_cast<char>(p.fmt >> 8),
+                      static_cast<char>(p.fmt >> 16), static_cast<char>(p.fmt >> 24), 0};
+    char name[128];
+    snprintf(name, sizeof(name), "%s_%ux%u_%u%u_Q%u_Pad%u_%u_%u", fourcc, p.width, p.height,
+             p.hfactor, p.vfactor, p.quality, p.padding[0], p.padding[1], p.padding[2]);
+    return name;
+}
+
+class SWJpegRoundTrip : public ::testing::TestWithParam<SWJpegParam> {};
+
+TEST_P(SWJpegRoundTrip, DecodesToSource) {
+    const SWJpegParam &p = GetParam();
+    CHWJpegSWCompressor jpeg;
+
+    ASSERT_TRUE(jpeg.SetPadding(p.padding, 3));
+    ASSERT_TRUE(jpeg.SetImageFormat(p.fmt, p.width, p.height));
+    ASSERT_TRUE(jpeg.SetChromaSampFactor(p.hfactor, p.vfactor));
+    ASSERT_TRUE(jpeg.SetQuality(p.quality));
+
+    SourceImage src = CreateImage(p.fmt, p.width, p.height, p.padding);
+
+    size_t sizes[3];
+    unsigned int num_buffers = 3;
+    ASSERT_TRUE(jpeg.GetImageBufferSizes(sizes, &num_buffers));
+    ASSERT_EQ(src.buffers.size(), num_buffers);
+    char *buffers[3];
+    size_t lens[3];
+    for (unsigned int i = 0; i < num_buffers; i++) {
+        EXPECT_EQ(src.buffers[i].size(), sizes[i]) << "buffer " << i;
+        buffers[i] = src.buffers[i].data();
+        lens[i] = src.buffers[i].size();
+    }
+    ASSERT_TRUE(jpeg.SetImageBuffer(buffers, lens, num_buffers));
+
+    vector<char> stream(p.width * p.height * 3 + 4096);
+    ASSERT_TRUE(jpeg.SetJpegBuffer(stream.data(), stream.size()));
+    ssize_t len = jpeg.Compress();
+    ASSERT_GT(len, 0);
+
+    Decoded dec;
+    ASSERT_TRUE(Decode(stream.data(), len, &dec));
+    EXPECT_EQ(p.width, dec.width);
+    EXPECT_EQ(p.height, dec.height);
+    if (p.hfactor == 0) {
+        ASSERT_EQ(1, dec.components);
+    } else {
+        ASSERT_EQ(3, dec.components);
+        EXPECT_EQ(static_cast<int>(p.hfactor), dec.hfactor);
+        EXPECT_EQ(static_cast<int>(p.vfactor), dec.vfactor);
+    }
+
+    double psnr[3];
+    ComparePsnr(src, dec, max(1U, p.hfactor), max(1U, p.vfactor), psnr);
+    EXPECT_GE(psnr[0], p.min_luma_psnr);
+    if (p.hfactor != 0) {
+        EXPECT_GE(psnr[1], p.min_chroma_psnr);
+        EXPECT_GE(psnr[2], p.min_chroma_psnr);
+    }
+    RecordProperty("psnr_y", to_string(psnr[0]));
+    RecordProperty("psnr_cb", to_string(psnr[1]));
+    RecordProperty("psnr_cr", to_string(psnr[2]));
+    RecordProperty("stream_size", to_string(len));
+}
+
+// The PSNR limits are about 3 dB below what the encoder achieves on the picture of Pixel()
+INSTANTIATE_TEST_SUITE_P(
+        ChromaFactors, SWJpegRoundTrip,
+        ::testing::Values(
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 1, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 1, 1, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 1, 2, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 4, 1, 90, {0, 0, 0}, 48, 43},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 0, 0, 90, {0, 0, 0}, 48, 0},
+                SWJpegParam{V4L2_PIX_FMT_YUYV, 640, 480, 2, 1, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_YUYV, 640, 480, 2, 2, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV16, 640, 480, 2, 1, 90, {0, 0, 0}, 48, 46}),
+        ParamName);
+
+INSTANTIATE_TEST_SUITE_P(
+        Qualities, SWJpegRoundTrip,
+        ::testing::Values(
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 100, {0, 0, 0}, 56, 58},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 95, {0, 0, 0}, 51, 50},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 75, {0, 0, 0}, 45, 43},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 50, {0, 0, 0}, 41, 41},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 10, {0, 0, 0}, 31, 28}),
+        ParamName);
+
+// Partial MCUs at the right and the bottom edges, and the padding at the end of the lines
+INSTANTIATE_TEST_SUITE_P(
+        Padding, SWJpegRoundTrip,
+        ::testing::Values(
+                SWJpegParam{V4L2_PIX_FMT_NV21, 641, 479, 2, 2, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 640, 480, 2, 2, 90, {32, 64, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV12M, 637, 475, 2, 2, 90, {3, 5, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_YUV420M, 630, 470, 2, 2, 90, {16, 8, 24}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_YUV420M, 631, 471, 1, 1, 90, {1, 2, 3}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_YUYV, 633, 477, 2, 1, 90, {12, 0, 0}, 48, 46}),
+        ParamName);
+
+// Large enough to be split into the restart interval groups of the helper threads
+INSTANTIATE_TEST_SUITE_P(
+        Threads, SWJpegRoundTrip,
+        ::testing::Values(
+                SWJpegParam{V4L2_PIX_FMT_NV21, 1920, 1080, 2, 2, 90, {0, 0, 0}, 48, 46},
+                SWJpegParam{V4L2_PIX_FMT_NV21, 4000, 3000, 2, 2, 95, {64, 64, 0}, 51, 50},
+                SWJpegParam{V4L2_PIX_FMT_YUYV, 1923, 1081, 2, 1, 90, {0, 0, 0}, 48, 46}),
+        ParamName);
+
+TEST(SWJpeg, RejectsSmallStreamBuffer) {
+    CHWJpegSWCompressor jpeg;
+    const unsigned char padding[3] = {0, 0, 0};
+
+    ASSERT_TRUE(jpeg.SetImageFormat(V4L2_PIX_FMT_NV21, 640, 480));
+    SourceImage src = CreateImage(V4L2_PIX_FMT_NV21, 640, 480, padding);
+    char *buffer = src.buffers[0].data();
+    size_t len = src.buffers[0].size();
+    ASSERT_TRUE(jpeg.SetImageBuffer(&buffer, &len, 1));
+
+    vector<char> stream(1024);
+    ASSERT_TRUE(jpeg.SetJpegBuffer(stream.data(), stream.size()));
+    EXPECT_LT(jpeg.Compress(), 0);
+}
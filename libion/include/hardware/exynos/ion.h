@@ -63,6 +63,28 @@
 #define ION_FLAG_MAY_HWRENDER 64
 #define ION_FLAG_HW_EXTRA 128
 
+/*
+ * Buffer pool of exynos_ion_alloc(), disabled by default. While max_bytes is
+ * not zero, the buffers released by exynos_ion_free() are kept for the
+ * requests of the same heap, flags and size class. The contents of a recycled
+ * buffer are not cleared.
+ */
+struct exynos_ion_pool_config {
+    size_t max_bytes;        /* memory retained by the pool, 0 disables it */
+    unsigned int max_age_ms; /* buffers unused for longer are released, 0 for no limit */
+    int allow_secure;        /* recycle the buffers of the protected heaps */
+};
+
+struct exynos_ion_pool_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long recycled;          /* buffers kept by exynos_ion_free() */
+    unsigned long trimmed;           /* retained buffers released by the limits */
+    unsigned long pressure_releases; /* pool emptied on allocation failure */
+    size_t retained_bytes;
+    unsigned int retained_buffers;
+};
+
 __BEGIN_DECLS
 
 int exynos_ion_open(void);
@@ -79,6 +101,13 @@ const char *exynos_ion_get_heap_name(unsigned int legacy_heap_id);
 int exynos_ion_sync_start(int ion_fd, int fd, int direction);
 int exynos_ion_sync_end(int ion_fd, int fd, int direction);
 
+/* Closes fd or keeps it in the pool if it is from exynos_ion_alloc() */
+int exynos_ion_free(int fd);
+void exynos_ion_pool_configure(const struct exynos_ion_pool_config *config);
+/* Releases the least recently released buffers until max_bytes are retained */
+void exynos_ion_pool_trim(size_t max_bytes);
+void exynos_ion_pool_get_stats(struct exynos_ion_pool_stats *stats);
+
 __END_DECLS
 
 #endif /* __HARDWARE_EXYNOS_ION_H__ */
@@ -30,6 +30,8 @@
 
 #include <mutex>
 
+#include "ion_pool.h"
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
 static const struct {
@@ -73,14 +75,23 @@ BufferAllocator& exynos_ion_get_allocator(void) {
     return bufallocator;
 }
 
+static IonBufferPool& exynos_ion_get_pool(void) {
+    static IonBufferPool pool([](const std::string& heap_name, size_t len, unsigned int flags) {
+        return exynos_ion_get_allocator().Alloc(heap_name, len, flags);
+    });
+
+    return pool;
+}
+
 int exynos_ion_alloc(int /* ion_fd */, size_t len, unsigned int heap_mask, unsigned int flags) {
     unsigned int heapflags = flags & (ION_FLAG_PROTECTED | ION_FLAG_CACHED);
 
-    auto& bufallocator = exynos_ion_get_allocator();
+    auto& pool = exynos_ion_get_pool();
 
     for (const auto& it : heap_map_table) {
         if ((heap_mask == it.legacy_ion_heap_mask) && (heapflags == it.ion_heap_flags)) {
-            int ret = bufallocator.Alloc(it.heap_name, len, flags);
+            bool secure = (it.ion_heap_flags & ION_FLAG_PROTECTED) != 0;
+            int ret = pool.alloc(it.heap_name, secure, len, flags);
             if (ret < 0)
                 ALOGE("Failed to alloc %s, %zu %x (%d)", it.heap_name.c_str(), len, flags, ret);
 
@@ -119,3 +130,19 @@ int exynos_ion_sync_end(int __unused ion_fd, int fd, int direction) {
 
     return bufallocator.CpuSyncEnd(fd, static_cast<SyncType>(direction));
 }
+
+int exynos_ion_free(int fd) {
+    return exynos_ion_get_pool().free(fd);
+}
+
+void exynos_ion_pool_configure(const struct exynos_ion_pool_config* config) {
+    exynos_ion_get_pool().configure(*config);
+}
+
+void exynos_ion_pool_trim(size_t max_bytes) {
+    exynos_ion_get_pool().trim(max_bytes);
+}
+
+void exynos_ion_pool_get_stats(struct exynos_ion_pool_stats* stats) {
+    exynos_ion_get_pool().getStats(stats);
+}
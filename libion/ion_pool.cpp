@@ -0,0 +1,251 @@
+/*
+ *  ion_pool.cpp
+ *
+ *   Copyright 2021 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "ion_pool.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+IonBufferPool::IonBufferPool(AllocFunc alloc) : mAlloc(alloc) {
+    memset(&mConfig, 0, sizeof(mConfig));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+IonBufferPool::~IonBufferPool() {
+    std::vector<int> closing;
+
+    trimLocked(0, closing);
+    closeAll(closing);
+}
+
+size_t IonBufferPool::classSize(size_t len) {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    len = (len + page_size - 1) & ~(page_size - 1);
+    if (len <= 4 * page_size)
+        return len;
+
+    /* four classes between two powers of two */
+    size_t step = 1;
+    while ((step << 3) <= len)
+        step <<= 1;
+
+    return (len + step - 1) & ~(step - 1);
+}
+
+void IonBufferPool::closeAll(std::vector<int> &fds) {
+    for (int fd : fds)
+        close(fd);
+    fds.clear();
+}
+
+void IonBufferPool::trackLocked(int fd, const Key &key) {
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        ALOGE("%s: failed to stat fd %d: %s", __func__, fd, strerror(errno));
+        return;
+    }
+
+    mOutstanding[fd] = {key, st.st_ino};
+}
+
+void IonBufferPool::evictOldestLocked(std::vector<int> &closing) {
+    auto oldest = mFree.end();
+
+    for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+        if ((oldest == mFree.end()) ||
+            (it->second.front().released < oldest->second.front().released))
+            oldest = it;
+    }
+
+    if (oldest == mFree.end())
+        return;
+
+    closing.push_back(oldest->second.front().fd);
+    oldest->second.pop_front();
+    mStats.retained_bytes -= oldest->first.size;
+    mStats.retained_buffers--;
+    mStats.trimmed++;
+
+    if (oldest->second.empty())
+        mFree.erase(oldest);
+}
+
+void IonBufferPool::trimLocked(size_t max_bytes, std::vector<int> &closing) {
+    while (mStats.retained_bytes > max_bytes)
+        evictOldestLocked(closing);
+}
+
+void IonBufferPool::trimAgedLocked(Clock::time_point now, std::vector<int> &closing) {
+    if (mConfig.max_age_ms == 0)
+        return;
+
+    auto expiry = now - std::chrono::milliseconds(mConfig.max_age_ms);
+
+    for (auto it = mFree.begin(); it != mFree.end();) {
+        auto &buffers = it->second;
+
+        while (!buffers.empty() && (buffers.front().released < expiry)) {
+            closing.push_back(buffers.front().fd);
+            buffers.pop_front();
+            mStats.retained_bytes -= it->first.size;
+            mStats.retained_buffers--;
+            mStats.trimmed++;
+        }
+
+        if (buffers.empty())
+            it = mFree.erase(it);
+        else
+            ++it;
+    }
+}
+
+int IonBufferPool::alloc(const std::string &heap, bool secure, size_t len, unsigned int flags) {
+    std::vector<int> closing;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (!enabledLocked() || (secure && !mConfig.allow_secure)) {
+        lock.unlock();
+        return mAlloc(heap, len, flags);
+    }
+
+    trimAgedLocked(Clock::now(), closing);
+
+    Key key{heap, flags, classSize(len)};
+    auto it = mFree.find(key);
+    if (it != mFree.end()) {
+        /* the most recently released one is the most likely to be still warm */
+        Buffer buffer = it->second.back();
+
+        it->second.pop_back();
+        if (it->second.empty())
+            mFree.erase(it);
+
+        mStats.retained_bytes -= key.size;
+        mStats.retained_buffers--;
+        mStats.hits++;
+        mOutstanding[buffer.fd] = {key, buffer.ino};
+
+        lock.unlock();
+        closeAll(closing);
+
+        return buffer.fd;
+    }
+
+    mStats.misses++;
+    lock.unlock();
+    closeAll(closing);
+
+    int fd = mAlloc(heap, key.size, flags);
+    if (fd < 0) {
+        /* the heap is short of memory, give the retained buffers back */
+        lock.lock();
+        if (mStats.retained_bytes > 0) {
+            trimLocked(0, closing);
+            mStats.pressure_releases++;
+            lock.unlock();
+
+            ALOGI("%s: released %zu buffers of the pool to allocate %zu bytes of %s", __func__,
+                  closing.size(), key.size, heap.c_str());
+            closeAll(closing);
+
+            fd = mAlloc(heap, key.size, flags);
+        } else {
+            lock.unlock();
+        }
+    }
+
+    if (fd >= 0) {
+        lock.lock();
+        trackLocked(fd, key);
+    }
+
+    return fd;
+}
+
+int IonBufferPool::free(int fd) {
+    std::vector<int> closing;
+    struct stat st;
+
+    if (fd < 0)
+        return -EINVAL;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    auto it = mOutstanding.find(fd);
+    if (it == mOutstanding.end()) {
+        lock.unlock();
+        return (close(fd) < 0) ? -errno : 0;
+    }
+
+    Outstanding buffer = it->second;
+    mOutstanding.erase(it);
+
+    if (!enabledLocked() || (buffer.key.size > mConfig.max_bytes) || (fstat(fd, &st) < 0) ||
+        (st.st_ino != buffer.ino)) {
+        lock.unlock();
+        return (close(fd) < 0) ? -errno : 0;
+    }
+
+    auto now = Clock::now();
+
+    trimAgedLocked(now, closing);
+    trimLocked(mConfig.max_bytes - buffer.key.size, closing);
+
+    mFree[buffer.key].push_back({fd, buffer.ino, now});
+    mStats.retained_bytes += buffer.key.size;
+    mStats.retained_buffers++;
+    mStats.recycled++;
+
+    lock.unlock();
+    closeAll(closing);
+
+    return 0;
+}
+
+void IonBufferPool::configure(const exynos_ion_pool_config &config) {
+    std::vector<int> closing;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mConfig = config;
+    trimAgedLocked(Clock::now(), closing);
+    trimLocked(mConfig.max_bytes, closing);
+
+    lock.unlock();
+    closeAll(closing);
+}
+
+void IonBufferPool::trim(size_t max_bytes) {
+    std::vector<int> closing;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    trimLocked(max_bytes, closing);
+
+    lock.unlock();
+    closeAll(closing);
+}
+
+void IonBufferPool::getStats(exynos_ion_pool_stats *stats) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    *stats = mStats;
+}
@@ -0,0 +1,105 @@
+/*
+ *  ion_pool.h
+ *
+ *   Copyright 2021 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef __ION_POOL_H__
+#define __ION_POOL_H__
+
+#include <hardware/exynos/ion.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Recycles the dmabufs of exynos_ion_alloc() released by exynos_ion_free().
+ *
+ * Requests are rounded up to a size class, at most a quarter of the size is
+ * wasted, and a released buffer is returned again for a request of the same
+ * heap, flags and size class. The buffers retained are bounded in bytes and
+ * in age, and they are all released when an allocation fails. The buffers
+ * of the protected heaps are only recycled if allowed.
+ *
+ * The heap is reached through the allocation function, so the pool can be
+ * tested with a fake heap.
+ */
+class IonBufferPool {
+public:
+    using AllocFunc = std::function<int(const std::string &heap, size_t len, unsigned int flags)>;
+
+    explicit IonBufferPool(AllocFunc alloc);
+    ~IonBufferPool();
+
+    int alloc(const std::string &heap, bool secure, size_t len, unsigned int flags);
+    int free(int fd);
+
+    void configure(const exynos_ion_pool_config &config);
+    void trim(size_t max_bytes);
+    void getStats(exynos_ion_pool_stats *stats);
+
+    static size_t classSize(size_t len);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Key {
+        std::string heap;
+        unsigned int flags;
+        size_t size;
+
+        bool operator<(const Key &other) const {
+            return std::tie(heap, flags, size) < std::tie(other.heap, other.flags, other.size);
+        }
+    };
+
+    struct Buffer {
+        int fd;
+        ino_t ino; // to tell the buffer from a file that reused a closed fd
+        Clock::time_point released;
+    };
+
+    struct Outstanding {
+        Key key;
+        ino_t ino;
+    };
+
+    bool enabledLocked() { return mConfig.max_bytes > 0; }
+    void trackLocked(int fd, const Key &key);
+    void evictOldestLocked(std::vector<int> &closing);
+    void trimLocked(size_t max_bytes, std::vector<int> &closing);
+    void trimAgedLocked(Clock::time_point now, std::vector<int> &closing);
+    static void closeAll(std::vector<int> &fds);
+
+    const AllocFunc mAlloc;
+
+    std::mutex mMutex;
+    exynos_ion_pool_config mConfig;
+    exynos_ion_pool_stats mStats;
+    // released buffers per size class, the least recently released first
+    std::map<Key, std::deque<Buffer>> mFree;
+    // buffers given out while the pool is enabled
+    std::unordered_map<int, Outstanding> mOutstanding;
+};
+
+#endif /* __ION_POOL_H__ */
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2021 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <gtest/gtest.h>
+
+#include "ion_test_define.h"
+#include "../ion_pool.h"
+
+/*
+ * Heap backed by memfd. The pages are cleared on allocation like the kernel
+ * heaps do, that is the cost the pool saves.
+ */
+class FakeHeap {
+public:
+    unsigned int allocations = 0;
+    unsigned int failures = 0; // number of the next allocations to fail
+
+    int alloc(const std::string &heap_name, size_t len, unsigned int /* flags */) {
+        allocations++;
+        if (failures > 0) {
+            failures--;
+            return -ENOMEM;
+        }
+
+        int fd = memfd_create(heap_name.c_str(), MFD_CLOEXEC);
+        if (fd < 0)
+            return -errno;
+
+        if (ftruncate(fd, len) < 0) {
+            int ret = -errno;
+            close(fd);
+            return ret;
+        }
+
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            memset(p, 0, len);
+            munmap(p, len);
+        }
+
+        return fd;
+    }
+};
+
+class IonPool : public ::testing::Test {
+protected:
+    FakeHeap heap;
+    IonBufferPool pool{[this](const std::string &heap_name, size_t len, unsigned int flags) {
+        return heap.alloc(heap_name, len, flags);
+    }};
+
+    void enable(size_t max_bytes, unsigned int max_age_ms = 0, int allow_secure = 0) {
+        exynos_ion_pool_config config;
+        config.max_bytes = max_bytes;
+        config.max_age_ms = max_age_ms;
+        config.allow_secure = allow_secure;
+        pool.configure(config);
+    }
+
+    exynos_ion_pool_stats stats() {
+        exynos_ion_pool_stats stats;
+        pool.getStats(&stats);
+        return stats;
+    }
+
+    static bool isOpen(int fd) { return fcntl(fd, F_GETFD) >= 0; }
+
+    static off_t bufferSize(int fd) { return lseek(fd, 0, SEEK_END); }
+};
+
+TEST_F(IonPool, ClassSize)
+{
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    static const size_t lengths[] = {
+        1, kb(4), kb(5), kb(16), kb(17), kb(100), mkb(1, 1), mb(3), mkb(8, 912), mb(16),
+    };
+
+    for (size_t len : lengths) {
+        size_t size = IonBufferPool::classSize(len);
+
+        EXPECT_GE(size, len);
+        EXPECT_EQ(0u, size % page_size) << "len " << len;
+        EXPECT_LE(size, len + len / 4 + page_size) << "len " << len;
+        EXPECT_EQ(size, IonBufferPool::classSize(size)) << "len " << len;
+    }
+
+    EXPECT_EQ(IonBufferPool::classSize(mb(1) + 1), IonBufferPool::classSize(mkb(1, 200)));
+}
+
+TEST_F(IonPool, Disabled)
+{
+    int fd = pool.alloc("system", false, kb(100), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(kb(100), bufferSize(fd));
+
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_FALSE(isOpen(fd));
+
+    exynos_ion_pool_stats st = stats();
+    EXPECT_EQ(0u, st.hits);
+    EXPECT_EQ(0u, st.misses);
+    EXPECT_EQ(0u, st.retained_buffers);
+}
+
+TEST_F(IonPool, Recycle)
+{
+    enable(mb(16));
+
+    int fd = pool.alloc("system", false, kb(100), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(static_cast<off_t>(IonBufferPool::classSize(kb(100))), bufferSize(fd));
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_TRUE(isOpen(fd));
+    EXPECT_EQ(1u, stats().retained_buffers);
+
+    int fd2 = pool.alloc("system", false, kb(100), 0);
+    EXPECT_EQ(fd, fd2);
+    EXPECT_EQ(1u, heap.allocations);
+
+    exynos_ion_pool_stats st = stats();
+    EXPECT_EQ(1u, st.hits);
+    EXPECT_EQ(1u, st.misses);
+    EXPECT_EQ(1u, st.recycled);
+    EXPECT_EQ(0u, st.retained_buffers);
+    EXPECT_EQ(0u, st.retained_bytes);
+
+    EXPECT_EQ(0, pool.free(fd2));
+}
+
+TEST_F(IonPool, SizeClassHeapAndFlags)
+{
+    enable(mb(16));
+
+    int fd = pool.alloc("system", false, mkb(1, 1), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+
+    int other_heap = pool.alloc("system-uncached", false, mkb(1, 1), 0);
+    int other_flags = pool.alloc("system", false, mkb(1, 1), ION_FLAG_CACHED);
+    int other_class = pool.alloc("system", false, mb(4), 0);
+    EXPECT_NE(fd, other_heap);
+    EXPECT_NE(fd, other_flags);
+    EXPECT_NE(fd, other_class);
+    EXPECT_EQ(0u, stats().hits);
+
+    int same_class = pool.alloc("system", false, mkb(1, 200), 0);
+    EXPECT_EQ(fd, same_class);
+    EXPECT_EQ(1u, stats().hits);
+
+    for (int it : {other_heap, other_flags, other_class, same_class})
+        EXPECT_EQ(0, pool.free(it));
+}
+
+TEST_F(IonPool, BoundedMemory)
+{
+    enable(mb(2));
+
+    int fds[3];
+    for (int &fd : fds) {
+        fd = pool.alloc("system", false, mb(1), 0);
+        ASSERT_GE(fd, 0);
+    }
+    for (int fd : fds)
+        EXPECT_EQ(0, pool.free(fd));
+
+    // the least recently released one is dropped
+    exynos_ion_pool_stats st = stats();
+    EXPECT_EQ(2u, st.retained_buffers);
+    EXPECT_EQ(static_cast<size_t>(mb(2)), st.retained_bytes);
+    EXPECT_EQ(1u, st.trimmed);
+    EXPECT_FALSE(isOpen(fds[0]));
+
+    // larger than the pool
+    int fd = pool.alloc("system", false, mb(3), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_EQ(2u, stats().retained_buffers);
+
+    pool.trim(mb(1));
+    EXPECT_EQ(1u, stats().retained_buffers);
+    EXPECT_FALSE(isOpen(fds[1]));
+    EXPECT_TRUE(isOpen(fds[2]));
+
+    enable(0);
+    EXPECT_EQ(0u, stats().retained_buffers);
+    EXPECT_FALSE(isOpen(fds[2]));
+}
+
+TEST_F(IonPool, AgeTrimming)
+{
+    enable(mb(16), 10);
+
+    int fd = pool.alloc("system", false, kb(64), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_EQ(1u, stats().retained_buffers);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    int fd2 = pool.alloc("system", false, kb(64), 0);
+    ASSERT_GE(fd2, 0);
+
+    exynos_ion_pool_stats st = stats();
+    EXPECT_EQ(0u, st.hits);
+    EXPECT_EQ(1u, st.trimmed);
+    EXPECT_EQ(0u, st.retained_buffers);
+    EXPECT_EQ(2u, heap.allocations);
+
+    EXPECT_EQ(0, pool.free(fd2));
+}
+
+TEST_F(IonPool, Secure)
+{
+    enable(mb(16));
+
+    int fd = pool.alloc("vframe-secure", true, kb(64), ION_FLAG_PROTECTED);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_FALSE(isOpen(fd));
+    EXPECT_EQ(0u, stats().retained_buffers);
+
+    enable(mb(16), 0, 1);
+
+    fd = pool.alloc("vframe-secure", true, kb(64), ION_FLAG_PROTECTED);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_TRUE(isOpen(fd));
+    EXPECT_EQ(1u, stats().retained_buffers);
+}
+
+TEST_F(IonPool, Pressure)
+{
+    enable(mb(16));
+
+    int fd = pool.alloc("system", false, mb(1), 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+
+    heap.failures = 1;
+    int fd2 = pool.alloc("system", false, mb(4), 0);
+    ASSERT_GE(fd2, 0);
+
+    exynos_ion_pool_stats st = stats();
+    EXPECT_EQ(1u, st.pressure_releases);
+    EXPECT_EQ(0u, st.retained_buffers);
+    EXPECT_FALSE(isOpen(fd) && (fd != fd2));
+
+    // nothing to release
+    heap.failures = 1;
+    EXPECT_EQ(-ENOMEM, pool.alloc("system", false, mb(8), 0));
+    EXPECT_EQ(1u, stats().pressure_releases);
+
+    EXPECT_EQ(0, pool.free(fd2));
+}
+
+TEST_F(IonPool, ForeignFd)
+{
+    enable(mb(16));
+
+    int fd = memfd_create("foreign", MFD_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(0, pool.free(fd));
+    EXPECT_FALSE(isOpen(fd));
+    EXPECT_EQ(0u, stats().retained_buffers);
+
+    EXPECT_EQ(-EINVAL, pool.free(-1));
+}
+
+TEST_F(IonPool, ClosedByOwner)
+{
+    enable(mb(16));
+
+    int fd = pool.alloc("system", false, kb(64), 0);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // the lowest fd number is reused
+    int reused = memfd_create("reused", MFD_CLOEXEC);
+    ASSERT_EQ(fd, reused);
+
+    EXPECT_EQ(0, pool.free(reused));
+    EXPECT_FALSE(isOpen(reused));
+    EXPECT_EQ(0u, stats().retained_buffers);
+}
+
+TEST_F(IonPool, Latency)
+{
+    static const int kIterations = 100;
+    using Clock = std::chrono::steady_clock;
+
+    auto run = [this]() {
+        auto start = Clock::now();
+
+        for (int i = 0; i < kIterations; i++) {
+            int fd = pool.alloc("system", false, mb(2), 0);
+            if (fd < 0)
+                return std::chrono::microseconds(-1);
+            pool.free(fd);
+        }
+
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    };
+
+    auto unpooled = run();
+    ASSERT_GE(unpooled.count(), 0);
+
+    enable(mb(16));
+    auto pooled = run();
+    ASSERT_GE(pooled.count(), 0);
+
+    EXPECT_EQ(static_cast<unsigned long>(kIterations - 1), stats().hits);
+    EXPECT_EQ(static_cast<unsigned int>(kIterations + 1), heap.allocations);
+
+    RecordProperty("unpooled_us_per_alloc", static_cast<int>(unpooled.count() / kIterations));
+    RecordProperty("pooled_us_per_alloc", static_cast<int>(pooled.count() / kIterations));
+}
@@ -29,3 +29,17 @@ LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
 LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
+
+# dmabuf accounting on synthetic debugfs files of up to 10k buffers
+include $(CLEAR_VARS)
+
+LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers
+LOCAL_SHARED_LIBRARIES := liblog libion_google
+LOCAL_SRC_FILES := dmabuf.cpp benchmark/dmabuf_benchmark.cpp
+LOCAL_MODULE := memtrack_dmabuf_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <benchmark/benchmark.h>
+
+#include <hardware/memtrack.h>
+#include <hardware/exynos/ion.h>
+
+#include "../memtrack_exynos.h"
+
+using namespace std;
+
+// Number of the processes sharing the synthetic buffers
+#define NUM_PROCESSES 8
+
+/*
+ * Synthetic debugfs files of @count buffers: the ion buffer list of the
+ * system and the footprint of NUM_PROCESSES processes, each mapping every
+ * NUM_PROCESSES-th buffer. A quarter of the buffers are GPU buffers.
+ */
+class SyntheticDebugfs {
+    string mRoot;
+public:
+    string footprintDir;
+    string ionBuffers;
+
+    explicit SyntheticDebugfs(unsigned int count) {
+        char tmpl[] = "/data/local/tmp/memtrack_benchXXXXXX";
+        char *root = mkdtemp(tmpl);
+        if (root == NULL) {
+            // on the host
+            char host_tmpl[] = "/tmp/memtrack_benchXXXXXX";
+            root = mkdtemp(host_tmpl);
+        }
+        mRoot = root ? root : ".";
+        footprintDir = mRoot + "/footprint/";
+        ionBuffers = mRoot + "/buffers";
+        mkdir(footprintDir.c_str(), 0700);
+
+        FILE *ion = fopen(ionBuffers.c_str(), "w");
+        fprintf(ion, "[  id]            heap heaptype flags size(kb) : iommu_mapped...\n");
+        for (unsigned int id = 0; id < count; id++) {
+            unsigned int flags = (id % 4 == 0) ? ION_FLAG_MAY_HWRENDER : 0;
+            fprintf(ion, "[%4u] ion_system_heap   system  %#x    %u : 19080000.dsim(0)\n",
+                    id, flags, 4 * (1 + id % 64));
+        }
+        fclose(ion);
+
+        for (pid_t pid = 1; pid <= NUM_PROCESSES; pid++) {
+            FILE *footprint = fopen(footprintPath(pid).c_str(), "w");
+            fprintf(footprint, "exp_name      size     share\n");
+            for (unsigned int id = pid - 1; id < count; id += NUM_PROCESSES) {
+                size_t size = 4096 * (1 + id % 64);
+                fprintf(footprint, "ion-%u   %zu  %zu\n", id, size, size / 2);
+            }
+            fclose(footprint);
+        }
+    }
+
+    ~SyntheticDebugfs() {
+        for (pid_t pid = 1; pid <= NUM_PROCESSES; pid++)
+            unlink(footprintPath(pid).c_str());
+        rmdir(footprintDir.c_str());
+        unlink(ionBuffers.c_str());
+        rmdir(mRoot.c_str());
+    }
+
+    string footprintPath(pid_t pid) { return footprintDir + to_string(pid); }
+};
+
+static void query(SyntheticDebugfs &debugfs, pid_t pid, int type, benchmark::State &state)
+{
+    struct memtrack_record records[4];
+    size_t num_records = 4;
+
+    if (dmabuf_memtrack_get_memory_at(debugfs.footprintDir.c_str(), debugfs.ionBuffers.c_str(),
+                                      pid, type, records, &num_records) < 0)
+        state.SkipWithError("dmabuf_memtrack_get_memory_at failed");
+    benchmark::DoNotOptimize(records);
+}
+
+// A query that parses the ion buffer list again like the first of a sweep
+static void BM_DmabufQueryCold(benchmark::State &state)
+{
+    SyntheticDebugfs debugfs(state.range(0));
+
+    for (auto _ : state) {
+        dmabuf_memtrack_drop_cache();
+        query(debugfs, 1, MEMTRACK_TYPE_GRAPHICS, state);
+    }
+}
+BENCHMARK(BM_DmabufQueryCold)->Arg(1000)->Arg(10000);
+
+// A meminfo sweep: both types of every process on the cached ion buffer list
+static void BM_DmabufSweep(benchmark::State &state)
+{
+    SyntheticDebugfs debugfs(state.range(0));
+
+    for (auto _ : state) {
+        for (pid_t pid = 1; pid <= NUM_PROCESSES; pid++) {
+            query(debugfs, pid, MEMTRACK_TYPE_OTHER, state);
+            query(debugfs, pid, MEMTRACK_TYPE_GRAPHICS, state);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_PROCESSES * 2);
+}
+BENCHMARK(BM_DmabufSweep)->Arg(1000)->Arg(10000);
+
+BENCHMARK_MAIN();
@@ -1,10 +1,17 @@
-#include <fstream>
-#include <sstream>
-#include <regex>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
-#include <algorithm>
 
+#include <cctype>
 #include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
 #include <sys/stat.h>
 
 #include <hardware/memtrack.h>
@@ -30,64 +37,235 @@ struct DmabufBuffer {
     DmabufBuffer(unsigned int _id, size_t _size, size_t _pss)
         : id(_id), type(MEMTRACK_FLAG_SMAPS_UNACCOUNTED | MEMTRACK_FLAG_SHARED_PSS), size(_size), pss(_pss)
     { }
-    void setPoolType(string _type) { type |= (_type == "carveout") ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM; }
+    void setPoolType(bool carveout) { type |= carveout ? MEMTRACK_FLAG_DEDICATED : MEMTRACK_FLAG_SYSTEM; }
     void setFlags(unsigned int flags) { type |= (flags & ION_FLAG_PROTECTED) ? MEMTRACK_FLAG_SECURE : MEMTRACK_FLAG_NONSECURE; }
 };
 
+// Reads the whole file into @buf that is reused by the following calls from
+// the same thread. The content is terminated by '\0'.
+static bool read_file(const char *path, vector<char> &buf)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    if (buf.size() < 4096)
+        buf.resize(4096);
+
+    size_t len = 0;
+    for (;;) {
+        // keep one byte for the terminating null
+        if (len + 1 == buf.size())
+            buf.resize(buf.size() * 2);
+
+        ssize_t ret = read(fd, buf.data() + len, buf.size() - len - 1);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return false;
+        }
+        if (ret == 0)
+            break;
+        len += ret;
+    }
+
+    close(fd);
+
+    buf[len] = '\0';
+
+    return true;
+}
+
+// Tokenizer over a line of the debugfs files. Every parse function returns
+// false without consuming anything useful if the text does not match and
+// the rest of the line is then skipped by nextLine().
+class LineParser {
+    const char *mPos;
+public:
+    LineParser(const char *text) : mPos(text) { }
+
+    bool eof() const { return *mPos == '\0'; }
+
+    void nextLine() {
+        while ((*mPos != '\0') && (*mPos++ != '\n'))
+            ;
+    }
+
+    // returns true if at least one space is skipped
+    bool skipSpaces() {
+        const char *start = mPos;
+        while ((*mPos == ' ') || (*mPos == '\t'))
+            mPos++;
+        return mPos != start;
+    }
+
+    bool expect(const char *str) {
+        const char *p = mPos;
+        for (; *str != '\0'; str++, p++)
+            if (*p != *str)
+                return false;
+        mPos = p;
+        return true;
+    }
+
+    bool number(unsigned long &val, int base = 10) {
+        char *end;
+        if ((base == 10) ? !isdigit(*mPos) : !isxdigit(*mPos))
+            return false;
+        val = strtoul(mPos, &end, base);
+        mPos = end;
+        return true;
+    }
+
+    // a word of alphanumeric characters and the characters in @extra
+    bool word(const char *&str, size_t &len, const char *extra = "_") {
+        const char *start = mPos;
+        while ((*mPos != '\0') && (isalnum(*mPos) || (strchr(extra, *mPos) != NULL)))
+            mPos++;
+        str = start;
+        len = mPos - start;
+        return len > 0;
+    }
+};
+
+static vector<char> &get_read_buffer()
+{
+    static thread_local vector<char> buf;
+    return buf;
+}
+
 const char DMABUF_FOOTPRINT_PATH[] = "/sys/kernel/debug/dma_buf/footprint/";
-static bool build_dmabuf_footprint(vector<DmabufBuffer> &buffers, pid_t pid)
+static bool build_dmabuf_footprint(vector<DmabufBuffer> &buffers, const char *footprint_dir, pid_t pid)
 {
-    ostringstream dmabuf_path;
-    dmabuf_path << DMABUF_FOOTPRINT_PATH << pid;
+    char dmabuf_path[PATH_MAX];
+    snprintf(dmabuf_path, sizeof(dmabuf_path), "%s%d", footprint_dir, pid);
 
-    ifstream dmabuf(dmabuf_path.str());
-    if (!dmabuf)
+    vector<char> &buf = get_read_buffer();
+    if (!read_file(dmabuf_path, buf))
         return false;
     //
     // exp_name      size     share
     // ion-102   69271552  34635776
-    regex rex("\\s*ion-(\\d+)\\s+(\\d+)\\s+(\\d+).*");
-    smatch mch;
-    // 1-id, 2-size, 3-pss
-    for (string line; getline(dmabuf, line); )
-        if (regex_match(line, mch, rex))
-            buffers.emplace_back(stoul(mch[1], 0, 10), stoul(mch[2], 0, 10), stoul(mch[3], 0, 10));
+    for (LineParser parser(buf.data()); !parser.eof(); parser.nextLine()) {
+        unsigned long id, size, pss;
+
+        parser.skipSpaces();
+        if (parser.expect("ion-") && parser.number(id) &&
+                parser.skipSpaces() && parser.number(size) &&
+                parser.skipSpaces() && parser.number(pss))
+            buffers.emplace_back(id, size, pss);
+    }
 
     return true;
 }
 
 const char ION_BUFFERS_PATH[] = "/sys/kernel/debug/ion/buffers";
-static bool complete_dmabuf_footprint(int type, vector<DmabufBuffer> &buffers)
+// ion buffers is the list of all buffers in the system. Parsing it once for
+// a sweep over all processes is enough since the result is kept for a while.
+#define ION_BUFFERS_CACHE_TTL chrono::milliseconds(500)
+
+struct IonBuffer {
+    unsigned int id;
+    unsigned int flags;
+    size_t size;
+    bool carveout;
+};
+
+static mutex ion_buffers_lock;
+static vector<IonBuffer> ion_buffers;
+static string ion_buffers_path;
+static chrono::steady_clock::time_point ion_buffers_timestamp;
+static bool ion_buffers_valid = false;
+
+static bool parse_ion_buffers(vector<IonBuffer> &ionbufs, const char *path)
 {
-    ifstream ion(ION_BUFFERS_PATH);
-    if (!ion)
+    vector<char> &buf = get_read_buffer();
+    if (!read_file(path, buf))
         return false;
 
+    ionbufs.clear();
+
     // [  id]            heap heaptype flags size(kb) : iommu_mapped...
     // [ 106] ion_system_heap   system  0x40    16912 : 19080000.dsim(0)
-    regex rexion("\\[ *(\\d+)\\] +[[:alnum:]\\-_]+ +(\\w+) +([x[:xdigit:]]+) +(\\d+).*");
-    smatch mch;
-    // 1-id, 2-heaptype, 3-flags, 4-size
-    for (string line; getline(ion, line); ) {
-        if (regex_match(line, mch, rexion)) {
-            unsigned int id = stoul(mch[1], 0, 10);
-            unsigned int flags = stoul(mch[3], 0, 16);
-            size_t len = stoul(mch[4], 0, 10) * 1024;
-            auto elem = find_if(begin(buffers), end(buffers), [id, len] (auto &item) {
-                                    return (item.id == id) && (item.size == len);
-                                });
-            // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
-            if ((elem != end(buffers)) && ((type == MEMTRACK_TYPE_OTHER) == !(flags & ION_FLAG_MAY_HWRENDER))) {
-                elem->setFlags(flags);
-                elem->setPoolType(mch[2]);
-            }
+    for (LineParser parser(buf.data()); !parser.eof(); parser.nextLine()) {
+        unsigned long id, flags, len;
+        const char *heap, *heaptype;
+        size_t heaplen, heaptypelen;
+
+        if (!parser.expect("["))
+            continue;
+        parser.skipSpaces();
+        if (!parser.number(id) || !parser.expect("]") || !parser.skipSpaces() ||
+                !parser.word(heap, heaplen, "-_") || !parser.skipSpaces() ||
+                !parser.word(heaptype, heaptypelen) || !parser.skipSpaces())
+            continue;
+        parser.expect("0x");
+        if (!parser.number(flags, 16) || !parser.skipSpaces() || !parser.number(len))
+            continue;
+
+        ionbufs.push_back({static_cast<unsigned int>(id), static_cast<unsigned int>(flags), len * 1024,
+                           (heaptypelen == 8) && !strncmp(heaptype, "carveout", 8)});
+    }
+
+    return true;
+}
+
+static bool complete_dmabuf_footprint(int type, vector<DmabufBuffer> &buffers, const char *ion_path)
+{
+    lock_guard<mutex> lock(ion_buffers_lock);
+
+    auto now = chrono::steady_clock::now();
+    if (!ion_buffers_valid || (ion_buffers_path != ion_path) ||
+            ((now - ion_buffers_timestamp) >= ION_BUFFERS_CACHE_TTL)) {
+        ion_buffers_valid = parse_ion_buffers(ion_buffers, ion_path);
+        if (!ion_buffers_valid)
+            return false;
+        ion_buffers_path = ion_path;
+        ion_buffers_timestamp = now;
+    }
+
+    // buffer id -> indices in @buffers in the order of the footprint
+    unordered_multimap<unsigned int, size_t> index;
+    index.reserve(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++)
+        index.emplace(buffers[i].id, i);
+
+    for (auto &ionbuf: ion_buffers) {
+        // the first buffer with the same id and size is the one, as it has always been
+        size_t first = buffers.size();
+        auto range = index.equal_range(ionbuf.id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if ((buffers[it->second].size == ionbuf.size) && (it->second < first))
+                first = it->second;
+        }
+        DmabufBuffer *elem = (first < buffers.size()) ? &buffers[first] : NULL;
+
+        // passes if type = OTHER && not flag & hwrender or type == GRAPHIC && flag & hwrender
+        if ((elem != NULL) && ((type == MEMTRACK_TYPE_OTHER) == !(ionbuf.flags & ION_FLAG_MAY_HWRENDER))) {
+            elem->setFlags(ionbuf.flags);
+            elem->setPoolType(ionbuf.carveout);
         }
     }
 
     return true;
 }
 
+void dmabuf_memtrack_drop_cache()
+{
+    lock_guard<mutex> lock(ion_buffers_lock);
+    ion_buffers_valid = false;
+}
+
 int dmabuf_memtrack_get_memory(pid_t pid, int type, struct memtrack_record *records, size_t *num_records)
+{
+    return dmabuf_memtrack_get_memory_at(DMABUF_FOOTPRINT_PATH, ION_BUFFERS_PATH,
+                                         pid, type, records, num_records);
+}
+
+int dmabuf_memtrack_get_memory_at(const char *footprint_dir, const char *ion_buffers_path,
+                                  pid_t pid, int type, struct memtrack_record *records,
+                                  size_t *num_records)
 {
     if ((type != MEMTRACK_TYPE_OTHER) && (type != MEMTRACK_TYPE_GRAPHICS))
         return -ENODEV;
@@ -106,16 +284,16 @@ int dmabuf_memtrack_get_memory(pid_t pid, int type, struct memtrack_record *reco
 
     vector<DmabufBuffer> buffers;
 
-    if (!build_dmabuf_footprint(buffers, pid))
+    if (!build_dmabuf_footprint(buffers, footprint_dir, pid))
         return -ENODEV;
 
     if (buffers.size() == 0)
         return 0;
 
-    if (!complete_dmabuf_footprint(type, buffers))
+    if (!complete_dmabuf_footprint(type, buffers, ion_buffers_path))
         return -ENODEV;
 
-    for (auto item: buffers) {
+    for (auto &item: buffers) {
         for (size_t i = 0; i < *num_records; i++) {
             if (item.type == available_flags[i]) {
                 records[i].size_in_bytes += item.pss;
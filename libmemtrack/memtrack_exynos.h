@@ -26,5 +26,13 @@ int ion_memtrack_get_memory(pid_t pid, int type,
 int dmabuf_memtrack_get_memory(pid_t pid, int type,
                                struct memtrack_record *records,
                                size_t *num_records);
+/* dmabuf_memtrack_get_memory() on other debugfs files, for benchmarks */
+int dmabuf_memtrack_get_memory_at(const char *footprint_dir,
+                                  const char *ion_buffers_path,
+                                  pid_t pid, int type,
+                                  struct memtrack_record *records,
+                                  size_t *num_records);
+/* Parses the ion buffers again on the next query */
+void dmabuf_memtrack_drop_cache();
 
 #endif
@@ -43,3 +43,44 @@ ifeq ($(BOARD_USES_VENDORIMAGE), true)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Software scaler on the camera preview, video and thumbnail sizes
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
+LOCAL_SRC_FILES := libscaler-swscaler.cpp benchmark/swscaler_benchmark.cpp
+LOCAL_MODULE := libexynosscaler_swscaler_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+
+ifeq ($(BOARD_USES_VENDORIMAGE), true)
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+include $(BUILD_NATIVE_BENCHMARK)
+
+# RunAsync() against a fake Scaler node
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils
+LOCAL_HEADER_LIBRARIES := libcutils_headers libsystem_headers libhardware_headers google_hal_headers
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include $(LOCAL_PATH)
+LOCAL_SRC_FILES := \
+	libscaler.cpp \
+	libscaler-v4l2.cpp \
+	libscalerblend-v4l2.cpp \
+	libscaler-m2m1shot.cpp \
+	libscaler-swscaler.cpp \
+	test/scaler_v4l2_test.cpp
+LOCAL_MODULE := libexynosscaler_v4l2_test
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/NOTICE
+
+ifeq ($(BOARD_USES_VENDORIMAGE), true)
+    LOCAL_PROPRIETARY_MODULE := true
+endif
+
+include $(BUILD_NATIVE_TEST)
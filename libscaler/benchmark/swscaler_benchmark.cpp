@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../libscaler-swscaler.h"
+
+using namespace std;
+
+/*
+ * The software scaler on the sizes of the camera: the preview and the video
+ * scaled from the sensor, and the thumbnails of the JPEG images. Each case is
+ * run with nearest and bilinear sampling.
+ * Arguments: source width, source height, target width, target height, mode
+ */
+static void SizeArgs(benchmark::internal::Benchmark *b) {
+    static const int sizes[][4] = {
+        { 4032, 3024, 1920, 1440 }, // 12MP to the preview
+        { 4032, 3024, 3840, 2160 }, // 12MP to 4K video
+        { 1920, 1080, 1280,  720 }, // 1080p to 720p
+        {  640,  480, 1920, 1080 }, // upscaling
+        { 4032, 3024,  512,  384 }, // thumbnail of a 12MP image
+        { 1920, 1080,  320,  180 }, // thumbnail of a 1080p image
+        {  640,  480,  160,  120 }, // small thumbnail
+    };
+
+    for (const auto &size : sizes)
+        for (int mode : { CScalerSW::SWSC_NEAREST, CScalerSW::SWSC_BILINEAR })
+            b->Args({ size[0], size[1], size[2], size[3], mode });
+}
+
+// a gradient rather than a flat color so that the scaled samples differ
+static void Fill(vector<char> &buf) {
+    for (size_t i = 0; i < buf.size(); i++)
+        buf[i] = static_cast<char>(i * 7 + i / 4096);
+}
+
+static void Run(benchmark::State &state, CScalerSW &scaler, size_t dst_bytes) {
+    unsigned int src_width = state.range(0), src_height = state.range(1);
+    unsigned int dst_width = state.range(2), dst_height = state.range(3);
+
+    scaler.SetSrcRect(0, 0, src_width, src_height, src_width);
+    scaler.SetDstRect(0, 0, dst_width, dst_height, dst_width);
+    scaler.SetMode(state.range(4));
+
+    for (auto _ : state) {
+        if (!scaler.Scale()) {
+            state.SkipWithError("Scale() failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * dst_bytes);
+    state.SetLabel(state.range(4) == CScalerSW::SWSC_BILINEAR ? "bilinear" : "nearest");
+}
+
+static void BM_SWScaleNV21(benchmark::State &state) {
+    size_t src_luma = state.range(0) * state.range(1);
+    size_t dst_luma = state.range(2) * state.range(3);
+    vector<char> src(src_luma * 3 / 2), dst(dst_luma * 3 / 2);
+    Fill(src);
+
+    CScalerSW_NV21 scaler(src.data(), src.data() + src_luma, dst.data(), dst.data() + dst_luma);
+    Run(state, scaler, dst.size());
+}
+BENCHMARK(BM_SWScaleNV21)->Apply(SizeArgs)->UseRealTime();
+
+static void BM_SWScaleYUYV(benchmark::State &state) {
+    vector<char> src(state.range(0) * state.range(1) * 2), dst(state.range(2) * state.range(3) * 2);
+    Fill(src);
+
+    CScalerSW_YUYV scaler(src.data(), dst.data());
+    Run(state, scaler, dst.size());
+}
+BENCHMARK(BM_SWScaleYUYV)->Apply(SizeArgs)->UseRealTime();
+
+BENCHMARK_MAIN();
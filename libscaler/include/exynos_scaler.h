@@ -200,6 +200,33 @@ int exynos_sc_destroy(void *handle);
  */
 int exynos_sc_convert(void *handle);
 
+/*!
+ * Convert color space with presetup color format without waiting for the H/W
+ *
+ * \ingroup exynos_scaler
+ *
+ * \param handle
+ *   libscaler handle[in]
+ *
+ * \param src_acquire_fence
+ *   fence the H/W waits for before reading the source, closed by libscaler[in]
+ *
+ * \param dst_acquire_fence
+ *   fence the H/W waits for before writing the target, closed by libscaler[in]
+ *
+ * \param src_release_fence
+ *   signaled when the source is no longer read, -1 if already done[out]
+ *
+ * \param dst_release_fence
+ *   signaled when the target is written, -1 if already done[out]
+ *
+ * \return
+ *   error code
+ */
+int exynos_sc_convert_async(void *handle,
+        int src_acquire_fence, int dst_acquire_fence,
+        int *src_release_fence, int *dst_release_fence);
+
 /*!
  * Convert color space with presetup color format
  *
@@ -32,6 +32,8 @@
 #include <log/log.h>
 #include <cerrno>
 #include <cstring>
+#include <poll.h>
+#include <unistd.h>
 
 //#define LOG_NDEBUG 0
 
@@ -90,6 +92,34 @@ static inline bool UnderOne16thScaling(unsigned int srcw, unsigned int srch,
     return ((srcw > (dstw * 16)) || (srch > (dsth * 16)));
 }
 
+#define SC_FENCE_TIMEOUT_MS 1000
+
+// Waits for a sync fence on the CPU and closes it
+static inline bool WaitFence(int &fd) {
+    if (fd < 0)
+        return true;
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret;
+    do {
+        ret = poll(&pfd, 1, SC_FENCE_TIMEOUT_MS);
+    } while ((ret < 0) && (errno == EINTR));
+
+    close(fd);
+    fd = -1;
+
+    if (ret <= 0) {
+        SC_LOGE("Failed to wait fence (%d)", ret);
+        return false;
+    }
+
+    return true;
+}
+
 };
 // marker for output parameters
 #define __out
@@ -314,6 +314,42 @@ bool CScalerM2M1SHOT::RunSWScaling()
 
             swsc = new CScalerSW_NV12(src[0], src[1], dst[0], dst[1]);
             break;
+        case V4L2_PIX_FMT_YVU420M:
+        case V4L2_PIX_FMT_YUV420M:
+        case V4L2_PIX_FMT_YVU420:
+        case V4L2_PIX_FMT_YUV420:
+            if (!GetBuffer(m_task.buf_out, src))
+                return false;
+
+            if (!GetBuffer(m_task.buf_cap, dst)) {
+                PutBuffer(m_task.buf_out, src);
+                return false;
+            }
+
+            if (m_task.buf_out.num_planes == 1) {
+                src[1] = src[0] + m_task.fmt_out.width * m_task.fmt_out.height;
+                src[2] = src[1] + m_task.fmt_out.width * m_task.fmt_out.height / 4;
+            }
+
+            if (m_task.buf_cap.num_planes == 1) {
+                dst[1] = dst[0] + m_task.fmt_cap.width * m_task.fmt_cap.height;
+                dst[2] = dst[1] + m_task.fmt_cap.width * m_task.fmt_cap.height / 4;
+            }
+
+            swsc = new CScalerSW_YV12(src[0], src[1], src[2], dst[0], dst[1], dst[2]);
+            break;
+        case V4L2_PIX_FMT_RGB32:
+        case V4L2_PIX_FMT_BGR32:
+            if (!GetBuffer(m_task.buf_out, src))
+                return false;
+
+            if (!GetBuffer(m_task.buf_cap, dst)) {
+                PutBuffer(m_task.buf_out, src);
+                return false;
+            }
+
+            swsc = new CScalerSW_RGBA8888(src[0], dst[0]);
+            break;
         case V4L2_PIX_FMT_UYVY: // TODO: UYVY is not implemented yet.
         default:
             SC_LOGE("Format %x is not supported", m_task.fmt_out.fmt);
@@ -1,5 +1,193 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+
 #include "libscaler-swscaler.h"
 
+// Planes smaller than this are scaled by the calling thread only
+#define SWSC_MT_MIN_BYTES   (512 * 1024)
+// Minimum number of lines that a thread is given
+#define SWSC_MT_MIN_LINES   16
+#define SWSC_MAX_THREADS    4
+
+/*
+ * A small pool of worker threads shared by all software scalers in the
+ * process. The caller of Run() also works on the jobs and Run() returns after
+ * all the jobs are finished. The pool is never destroyed because the worker
+ * threads can outlive the static destructors of the library. The threads are
+ * started with pthread_create() since std::thread aborts without exceptions
+ * if no thread can be created. The pool keeps the threads started, and the
+ * jobs run on the caller alone if none was.
+ */
+class CScalerSWWorkers {
+    std::mutex m_runLock;
+    std::mutex m_lock;
+    std::condition_variable m_condWork;
+    std::condition_variable m_condDone;
+    const std::function<void(unsigned int)> *m_pJob;
+    unsigned int m_nJobs;
+    unsigned int m_nNext;
+    unsigned int m_nDone;
+    unsigned int m_nThreads;
+
+    static void *ThreadMain(void *p) {
+        reinterpret_cast<CScalerSWWorkers *>(p)->Worker();
+        return NULL;
+    }
+
+    void Worker() {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        for (;;) {
+            m_condWork.wait(lock, [this] { return m_nNext < m_nJobs; });
+            RunJob(lock);
+        }
+    }
+
+    // called with m_lock held and at least one job not taken
+    void RunJob(std::unique_lock<std::mutex> &lock) {
+        unsigned int idx = m_nNext++;
+        const std::function<void(unsigned int)> *job = m_pJob;
+
+        lock.unlock();
+        (*job)(idx);
+        lock.lock();
+
+        if (++m_nDone == m_nJobs)
+            m_condDone.notify_all();
+    }
+
+    CScalerSWWorkers(unsigned int threads)
+        : m_pJob(NULL), m_nJobs(0), m_nNext(0), m_nDone(0), m_nThreads(0) {
+        pthread_attr_t attr;
+
+        if (pthread_attr_init(&attr) != 0)
+            return;
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+        for (unsigned int i = 0; i < threads; i++) {
+            pthread_t thread;
+            int ret = pthread_create(&thread, &attr, ThreadMain, this);
+            if (ret != 0) {
+                SC_LOGE("Failed to start a scaler thread (%u/%u): %s", i, threads, strerror(ret));
+                break;
+            }
+            m_nThreads++;
+        }
+
+        pthread_attr_destroy(&attr);
+    }
+
+public:
+    static CScalerSWWorkers &Get() {
+        static CScalerSWWorkers *workers = new CScalerSWWorkers(
+                LibScaler::min(std::max(std::thread::hardware_concurrency(), 1U),
+                               static_cast<unsigned int>(SWSC_MAX_THREADS)) - 1);
+        return *workers;
+    }
+
+    // number of threads that can run the jobs concurrently including the caller
+    unsigned int GetConcurrency() { return m_nThreads + 1; }
+
+    void Run(unsigned int count, const std::function<void(unsigned int)> &job) {
+        std::lock_guard<std::mutex> run(m_runLock);
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        m_pJob = &job;
+        m_nNext = 0;
+        m_nDone = 0;
+        m_nJobs = count;
+        m_condWork.notify_all();
+
+        while (m_nNext < m_nJobs)
+            RunJob(lock);
+
+        m_condDone.wait(lock, [this] { return m_nDone == m_nJobs; });
+
+        m_nJobs = 0;
+        m_nNext = 0;
+        m_pJob = NULL;
+    }
+};
+
+namespace {
+
+// A source sample position: two neighbouring samples and the weight of the
+// second one in 1/128 unit. Nearest neighbour only uses idx0.
+struct Tap {
+    unsigned int idx0;
+    unsigned int idx1;
+    uint16_t frac;
+};
+
+// Maps the centers of the target samples to the source samples
+void BuildTaps(std::vector<Tap> &taps, unsigned int src_start, unsigned int src_len,
+               unsigned int dst_len, bool bilinear)
+{
+    taps.resize(dst_len);
+
+    for (unsigned int i = 0; i < dst_len; i++) {
+        Tap &tap = taps[i];
+        uint64_t center = (2 * static_cast<uint64_t>(i) + 1) * src_len;
+
+        if (bilinear) {
+            int64_t pos = static_cast<int64_t>((center << 16) / (2 * dst_len)) - 0x8000;
+            if (pos < 0)
+                pos = 0;
+
+            unsigned int idx = static_cast<unsigned int>(pos >> 16);
+            tap.frac = static_cast<uint16_t>((pos & 0xFFFF) >> 9);
+            if (idx >= src_len - 1) {
+                idx = src_len - 1;
+                tap.frac = 0;
+            }
+            tap.idx0 = src_start + idx;
+            tap.idx1 = src_start + LibScaler::min(idx + 1, src_len - 1);
+        } else {
+            unsigned int idx = static_cast<unsigned int>(center / (2 * dst_len));
+            tap.idx0 = src_start + LibScaler::min(idx, src_len - 1);
+            tap.idx1 = tap.idx0;
+            tap.frac = 0;
+        }
+    }
+}
+
+typedef uint8_t v16u8 __attribute__((vector_size(16)));
+typedef uint16_t v16u16 __attribute__((vector_size(32)));
+
+// out[i] = (a[i] * (128 - frac) + b[i] * frac) / 128 with rounding
+void BlendLines(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t len, uint16_t frac)
+{
+    const uint16_t wa = 128 - frac;
+    size_t i = 0;
+
+    for (; i + sizeof(v16u8) <= len; i += sizeof(v16u8)) {
+        v16u8 va, vb;
+
+        memcpy(&va, a + i, sizeof(va));
+        memcpy(&vb, b + i, sizeof(vb));
+
+        v16u16 res = __builtin_convertvector(va, v16u16) * wa;
+        res += __builtin_convertvector(vb, v16u16) * frac;
+        res = (res + 64) >> 7;
+
+        va = __builtin_convertvector(res, v16u8);
+        memcpy(out + i, &va, sizeof(va));
+    }
+
+    for (; i < len; i++)
+        out[i] = static_cast<uint8_t>((a[i] * wa + b[i] * frac + 64) >> 7);
+}
+
+} // namespace
+
 void CScalerSW::Clear() {
     m_pSrc[0] = NULL;
     m_pSrc[1] = NULL;
@@ -18,46 +206,164 @@ void CScalerSW::Clear() {
     m_nDstWidth = 0;
     m_nDstHeight = 0;
     m_nDstStride = 0;
+
+    m_nMode = SWSC_NEAREST;
 }
 
-bool CScalerSW_YUYV::Scale() {
-    if (((m_nSrcLeft | m_nSrcWidth | m_nDstWidth | m_nSrcStride) % 2) != 0) {
-        SC_LOGE("Width of YUV422 should be even");
-        return false;
+bool CScalerSW::ScalePlane(const Plane &plane)
+{
+    const bool bilinear = (m_nMode == SWSC_BILINEAR);
+    const size_t src_stride = m_nSrcStride * plane.stride_mul / plane.stride_div;
+    const size_t dst_stride = m_nDstStride * plane.stride_mul / plane.stride_div;
+    const unsigned int src_top = m_nSrcTop / plane.vdiv;
+    const unsigned int src_height = m_nSrcHeight / plane.vdiv;
+    const unsigned int dst_top = m_nDstTop / plane.vdiv;
+    const unsigned int dst_height = m_nDstHeight / plane.vdiv;
+
+    if ((src_height == 0) || (dst_height == 0))
+        return true;
+
+    // Horizontal taps are shared by the components of the same subsampling.
+    std::vector<Tap> htaps[4];
+    const std::vector<Tap> *comp_taps[4];
+    unsigned int dst_start[4];
+    size_t line_begin = SIZE_MAX;
+    size_t line_end = 0;
+
+    for (unsigned int c = 0; c < plane.num_comps; c++) {
+        const Component &comp = plane.comps[c];
+        unsigned int src_width = m_nSrcWidth / comp.hdiv;
+        unsigned int dst_width = m_nDstWidth / comp.hdiv;
+
+        dst_start[c] = m_nDstLeft / comp.hdiv;
+
+        if ((src_width == 0) || (dst_width == 0))
+            return true;
+
+        if ((c > 0) && (plane.comps[c - 1].hdiv == comp.hdiv)) {
+            comp_taps[c] = comp_taps[c - 1];
+        } else {
+            BuildTaps(htaps[c], m_nSrcLeft / comp.hdiv, src_width, dst_width, bilinear);
+            comp_taps[c] = &htaps[c];
+        }
+
+        line_begin = LibScaler::min(line_begin,
+                static_cast<size_t>(comp.offset + dst_start[c] * comp.step));
+        line_end = std::max(line_end,
+                static_cast<size_t>(comp.offset + (dst_start[c] + dst_width - 1) * comp.step + 1));
     }
 
-    unsigned int h_ratio = (m_nSrcWidth << 16) / m_nDstWidth;
-    unsigned int v_ratio = (m_nSrcHeight << 16) / m_nDstHeight;
+    std::vector<Tap> vtaps;
+    BuildTaps(vtaps, src_top, src_height, dst_height, bilinear);
 
-    unsigned int src_x;
-    unsigned int src_y = m_nSrcTop << 16;
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(m_pSrc[plane.index]);
+    uint8_t *dst = reinterpret_cast<uint8_t *>(m_pDst[plane.index]);
+    const size_t line_len = line_end - line_begin;
 
-    // Luminance + Chrominance at once
-    for (unsigned int y = m_nDstTop; y < (m_nDstTop + m_nDstHeight); y++) {
-        src_x = m_nSrcLeft << 16;
-        for (unsigned int x = m_nDstLeft; x < (m_nDstLeft + m_nDstWidth); x++) {
-            m_pDst[0][y * (m_nDstStride * 2) + x * 2] =
-                m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + (src_x >> 16) * 2];
+    // Scales the source line 'y' horizontally into 'out' that is the line
+    // at 'line_begin' in the target.
+    auto hscale = [&](uint8_t *out, unsigned int y) {
+        const uint8_t *in = src + y * src_stride;
 
-            if (!(x & 1)) {
-                unsigned int cx = (src_x >> 16) & ~1;
+        out -= line_begin;
+        for (unsigned int c = 0; c < plane.num_comps; c++) {
+            const Component &comp = plane.comps[c];
+            const Tap *tap = comp_taps[c]->data();
+            uint8_t *o = out + comp.offset + dst_start[c] * comp.step;
+            const uint8_t *i = in + comp.offset;
+            unsigned int count = static_cast<unsigned int>(comp_taps[c]->size());
 
-                m_pDst[0][y * (m_nDstStride * 2) + x * 2 + 1] =
-                    m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + cx * 2 + 1];
-                m_pDst[0][y * (m_nDstStride * 2) + x * 2 + 3] =
-                    m_pSrc[0][(src_y >> 16) * (m_nSrcStride * 2) + cx * 2 + 3];
+            if (bilinear) {
+                for (unsigned int x = 0; x < count; x++, o += comp.step) {
+                    unsigned int a = i[tap[x].idx0 * comp.step];
+                    unsigned int b = i[tap[x].idx1 * comp.step];
+                    *o = static_cast<uint8_t>((a * (128 - tap[x].frac) + b * tap[x].frac + 64) >> 7);
+                }
+            } else {
+                for (unsigned int x = 0; x < count; x++, o += comp.step)
+                    *o = i[tap[x].idx0 * comp.step];
+            }
+        }
+    };
+
+    // Scales the target lines from 'first' to 'last' (exclusive)
+    auto scale_lines = [&](unsigned int first, unsigned int last) {
+        uint8_t *out = dst + (dst_top + first) * dst_stride + line_begin;
+
+        if (!bilinear) {
+            for (unsigned int y = first; y < last; y++, out += dst_stride) {
+                if ((y > first) && (vtaps[y].idx0 == vtaps[y - 1].idx0))
+                    memcpy(out, out - dst_stride, line_len);
+                else
+                    hscale(out, vtaps[y].idx0);
+            }
+            return;
+        }
+
+        // the last two horizontally scaled source lines
+        std::vector<uint8_t> buf(line_len * 2);
+        uint8_t *line[2] = { buf.data(), buf.data() + line_len };
+        unsigned int tag[2] = { UINT_MAX, UINT_MAX };
 
+        for (unsigned int y = first; y < last; y++, out += dst_stride) {
+            const Tap &tap = vtaps[y];
+
+            if (tag[0] != tap.idx0) {
+                if (tag[1] == tap.idx0) {
+                    std::swap(line[0], line[1]);
+                    std::swap(tag[0], tag[1]);
+                } else {
+                    hscale(line[0], tap.idx0);
+                    tag[0] = tap.idx0;
+                }
+            }
+
+            if (tap.frac == 0) {
+                memcpy(out, line[0], line_len);
+                continue;
             }
 
-            src_x = LibScaler::min(src_x + h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
+            if (tag[1] != tap.idx1) {
+                hscale(line[1], tap.idx1);
+                tag[1] = tap.idx1;
+            }
+
+            BlendLines(out, line[0], line[1], line_len, tap.frac);
         }
+    };
+
+    unsigned int bands = 1;
+    if (line_len * dst_height >= SWSC_MT_MIN_BYTES) {
+        bands = LibScaler::min(CScalerSWWorkers::Get().GetConcurrency(),
+                               dst_height / SWSC_MT_MIN_LINES);
+        bands = std::max(bands, 1U);
+    }
+
+    if (bands == 1) {
+        scale_lines(0, dst_height);
+    } else {
+        std::function<void(unsigned int)> job = [&](unsigned int band) {
+            scale_lines(dst_height * band / bands, dst_height * (band + 1) / bands);
+        };
 
-        src_y = LibScaler::min(src_y + v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
+        CScalerSWWorkers::Get().Run(bands, job);
     }
 
     return true;
 }
 
+bool CScalerSW_YUYV::Scale() {
+    if (((m_nSrcLeft | m_nSrcWidth | m_nDstLeft | m_nDstWidth | m_nSrcStride) % 2) != 0) {
+        SC_LOGE("Width of YUV422 should be even");
+        return false;
+    }
+
+    // Luminance + Chrominance at once
+    static const Plane plane = { 0, 1, 2, 1, 3, { { 0, 2, 1 }, { 1, 4, 2 }, { 3, 4, 2 } } };
+
+    return ScalePlane(plane);
+}
+
 bool CScalerSW_NV12::Scale() {
     if (((m_nSrcLeft | m_nSrcTop | m_nSrcWidth | m_nSrcHeight | m_nSrcStride |
                     m_nDstLeft | m_nDstTop | m_nDstWidth | m_nDstHeight | m_nDstStride) % 2) != 0) {
@@ -65,42 +371,29 @@ bool CScalerSW_NV12::Scale() {
         return false;
     }
 
-    unsigned int h_ratio = (m_nSrcWidth << 16) / m_nDstWidth;
-    unsigned int v_ratio = (m_nSrcHeight << 16) / m_nDstHeight;
-
-    unsigned int src_x;
-    unsigned int src_y = m_nSrcTop << 16;
-
-    // Luminance
-    for (unsigned int y = m_nDstTop; y < (m_nDstTop + m_nDstHeight); y++) {
-        src_x = m_nSrcLeft << 16;
-        for (unsigned int x = m_nDstLeft; x < (m_nDstLeft + m_nDstWidth); x++) {
-            m_pDst[0][y * m_nDstStride + x] = m_pSrc[0][(src_y >> 16) * m_nSrcStride + (src_x >> 16)];
+    static const Plane luma = { 0, 1, 1, 1, 1, { { 0, 1, 1 } } };
+    static const Plane chroma = { 1, 2, 1, 1, 2, { { 0, 2, 2 }, { 1, 2, 2 } } };
 
-            src_x = LibScaler::min(src_x + h_ratio, (m_nSrcLeft + m_nSrcWidth) << 16);
-        }
+    return ScalePlane(luma) && ScalePlane(chroma);
+}
 
-        src_y = LibScaler::min(src_y + v_ratio, (m_nSrcTop + m_nSrcHeight) << 16);
+bool CScalerSW_YV12::Scale() {
+    if (((m_nSrcLeft | m_nSrcTop | m_nSrcWidth | m_nSrcHeight | m_nSrcStride |
+                    m_nDstLeft | m_nDstTop | m_nDstWidth | m_nDstHeight | m_nDstStride) % 2) != 0) {
+        SC_LOGE("Both of width and height of YUV420 should be even");
+        return false;
     }
 
-    // Chrominance
+    static const Plane luma = { 0, 1, 1, 1, 1, { { 0, 1, 1 } } };
+    static const Plane chroma1 = { 1, 2, 1, 2, 1, { { 0, 1, 2 } } };
+    static const Plane chroma2 = { 2, 2, 1, 2, 1, { { 0, 1, 2 } } };
 
-    // change pointers to 1-byte to pointers to 2-byte storage.
-    unsigned short *src = reinterpret_cast<unsigned short *>(m_pSrc[1]);
-    unsigned short *dst = reinterpret_cast<unsigned short *>(m_pDst[1]);
-
-    src_y = (m_nSrcTop / 2) << 16;
-    for (unsigned int y = m_nDstTop / 2; y < ((m_nDstTop + m_nDstHeight) / 2); y++) {
-        // Move 2 pixels at once (CbCr)
-        src_x = (m_nSrcLeft / 2) << 16;
-        for (unsigned int x = m_nDstLeft / 2; x < ((m_nDstLeft + m_nDstWidth) / 2); x++) {
-            dst[y * (m_nDstStride / 2) + x] = src[(src_y >> 16) * (m_nSrcStride / 2) + (src_x >> 16)];
-
-            src_x = LibScaler::min(src_x + h_ratio, ((m_nSrcLeft + m_nSrcWidth) / 2) << 16);
-        }
+    return ScalePlane(luma) && ScalePlane(chroma1) && ScalePlane(chroma2);
+}
 
-        src_y = LibScaler::min(src_y + v_ratio, ((m_nSrcTop + m_nSrcHeight) / 2) << 16);
-    }
+bool CScalerSW_RGBA8888::Scale() {
+    static const Plane plane = { 0, 1, 4, 1, 4,
+                                 { { 0, 4, 1 }, { 1, 4, 1 }, { 2, 4, 1 }, { 3, 4, 1 } } };
 
-    return true;
+    return ScalePlane(plane);
 }
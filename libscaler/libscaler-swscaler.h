@@ -4,6 +4,12 @@
 #include "libscaler-common.h"
 
 class CScalerSW {
+    public:
+        enum {
+            SWSC_NEAREST,   // pick the closest source sample (default)
+            SWSC_BILINEAR,  // 2x2 weighted average of the neighbouring samples
+        };
+
     protected:
         char *m_pSrc[3];
         char *m_pDst[3];
@@ -13,12 +19,38 @@ class CScalerSW {
         unsigned int m_nDstLeft, m_nDstTop;
         unsigned int m_nDstWidth, m_nDstHeight;
         unsigned int m_nDstStride;
+        unsigned int m_nMode;
+
+        // Description of a plane for the generic scaling engine.
+        // Samples of a component in a line are placed at
+        // (offset + index * step) bytes from the start of the line and
+        // component sample 'index' covers the pixels from index * hdiv.
+        struct Component {
+            unsigned int offset;
+            unsigned int step;
+            unsigned int hdiv;
+        };
+
+        struct Plane {
+            unsigned int index;         // index to m_pSrc and m_pDst
+            unsigned int vdiv;          // vertical subsampling of the plane
+            unsigned int stride_mul;    // bytes per line is
+            unsigned int stride_div;    //   stride * stride_mul / stride_div
+            unsigned int num_comps;
+            Component comps[4];
+        };
+
+        bool ScalePlane(const Plane &plane);
+
     public:
         CScalerSW() { Clear(); }
         virtual ~CScalerSW() { };
         void Clear();
         virtual bool Scale() = 0;
 
+        void SetMode(unsigned int mode) { m_nMode = mode; }
+        unsigned int GetMode() { return m_nMode; }
+
         void SetSrcRect(unsigned int left, unsigned int top, unsigned int width, unsigned int height, unsigned int stride) {
             m_nSrcLeft = left;
             m_nSrcTop = top;
@@ -36,6 +68,7 @@ class CScalerSW {
         }
 };
 
+// YUYV and YVYU
 class CScalerSW_YUYV: public CScalerSW {
     public:
         CScalerSW_YUYV(char *src, char *dst) {
@@ -46,6 +79,7 @@ class CScalerSW_YUYV: public CScalerSW {
         virtual bool Scale();
 };
 
+// NV12 and NV21: the order of the chroma samples does not matter to scaling
 class CScalerSW_NV12: public CScalerSW {
     public:
         CScalerSW_NV12(char *src0, char *src1, char *dst0, char *dst1) {
@@ -58,4 +92,32 @@ class CScalerSW_NV12: public CScalerSW {
         virtual bool Scale();
 };
 
+typedef CScalerSW_NV12 CScalerSW_NV21;
+
+// YV12 and YUV420 (I420): stride of the chroma planes is the half of the luma
+class CScalerSW_YV12: public CScalerSW {
+    public:
+        CScalerSW_YV12(char *src0, char *src1, char *src2, char *dst0, char *dst1, char *dst2) {
+            m_pSrc[0] = src0;
+            m_pDst[0] = dst0;
+            m_pSrc[1] = src1;
+            m_pDst[1] = dst1;
+            m_pSrc[2] = src2;
+            m_pDst[2] = dst2;
+        }
+
+        virtual bool Scale();
+};
+
+// Any 32-bit packed format including RGBA8888 and BGRA8888
+class CScalerSW_RGBA8888: public CScalerSW {
+    public:
+        CScalerSW_RGBA8888(char *src, char *dst) {
+            m_pSrc[0] = src;
+            m_pDst[0] = dst;
+        }
+
+        virtual bool Scale();
+};
+
 #endif //__LIBSCALER_SWSCALER_H__
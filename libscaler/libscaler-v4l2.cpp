@@ -54,6 +54,23 @@ void CScalerV4L2::Initialize(int instance)
     }
 
     m_fdValidate = -m_fdScaler;
+    m_ctx[0].fd = m_fdScaler;
+}
+
+bool CScalerV4L2::OpenContext(int idx)
+{
+    int fd = open(m_cszNode, O_RDWR);
+    if (fd < 0) {
+        SC_LOGI("No more context than %d of '%s' is available", idx, m_cszNode);
+        m_nMaxCtx = idx;
+        return false;
+    }
+
+    m_ctx[idx].fd = fd;
+
+    SC_LOGD("Opened context %d of '%s'; returned fd %d", idx, m_cszNode, fd);
+
+    return true;
 }
 
 CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
@@ -77,6 +94,23 @@ CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
     m_frmDst.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 
     m_frameRate = 0;
+    m_colorspace = V4L2_COLORSPACE_DEFAULT;
+
+    SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+    SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
+    memset(&m_ctrl, 0xff, sizeof(m_ctrl));
+
+    for (int i = 0; i < SC_MAX_CONTEXTS; i++) {
+        m_ctx[i].fd = -1;
+        m_ctx[i].last_used = 0;
+        m_ctx[i].src = m_frmSrc;
+        m_ctx[i].dst = m_frmDst;
+        m_ctx[i].ctrl = m_ctrl;
+    }
+
+    m_iCurCtx = 0;
+    m_nMaxCtx = SC_MAX_CONTEXTS;
+    m_nUseCount = 0;
 
     Initialize(instance);
 
@@ -90,13 +124,126 @@ CScalerV4L2::CScalerV4L2(int instance, int allow_drm)
 
 CScalerV4L2::~CScalerV4L2()
 {
-    if (m_fdScaler >= 0)
-        close(m_fdScaler);
+    for (int i = 0; i < SC_MAX_CONTEXTS; i++) {
+        if (m_ctx[i].fd >= 0)
+            close(m_ctx[i].fd);
+    }
 
     m_fdScaler = -1;
 }
 
-bool CScalerV4L2::Stop()
+bool CScalerV4L2::IsFormatApplied(FrameInfo &state, FrameInfo &frm)
+{
+    return !TestFlag(state.flags, SCFF_BUF_FRESH) &&
+            (state.applied.width == frm.width) &&
+            (state.applied.height == frm.height) &&
+            (state.applied.color_format == frm.color_format) &&
+            (state.applied.memory == frm.memory) &&
+            (state.applied.premultiplied == TestFlag(frm.flags, SCFF_PREMULTIPLIED));
+}
+
+bool CScalerV4L2::IsConfiguredFor(FrameInfo &src, FrameInfo &dst, CtrlState &ctrl)
+{
+    // changing the rotation restarts the streaming as well
+    return IsFormatApplied(src, m_frmSrc) && IsFormatApplied(dst, m_frmDst) &&
+            (ctrl.rot == static_cast<int>(m_nRotDegree)) &&
+            (ctrl.hflip == TestFlag(m_fStatus, SCF_HFLIP)) &&
+            (ctrl.vflip == TestFlag(m_fStatus, SCF_VFLIP));
+}
+
+int CScalerV4L2::FindContext()
+{
+    if (IsConfiguredFor(m_frmSrc, m_frmDst, m_ctrl))
+        return m_iCurCtx;
+
+    for (int i = 0; i < m_nMaxCtx; i++) {
+        if ((i != m_iCurCtx) && (m_ctx[i].fd >= 0) &&
+                IsConfiguredFor(m_ctx[i].src, m_ctx[i].dst, m_ctx[i].ctrl))
+            return i;
+    }
+
+    // an unused context, a new one, or the least recently used one
+    int lru = m_iCurCtx;
+    for (int i = 0; i < m_nMaxCtx; i++) {
+        if (m_ctx[i].fd < 0) {
+            if (OpenContext(i))
+                return i;
+            break;
+        }
+
+        if (m_ctx[i].last_used == 0)
+            return i;
+
+        if (m_ctx[i].last_used < m_ctx[lru].last_used)
+            lru = i;
+    }
+
+    return lru;
+}
+
+void CScalerV4L2::LoadQueueState(FrameInfo &frm, FrameInfo &state)
+{
+    unsigned long mask = (1 << SCFF_BUF_FRESH) | (1 << SCFF_REQBUFS) |
+                         (1 << SCFF_QBUF) | (1 << SCFF_STREAMING);
+
+    // the parameters of the next frame in frm are kept
+    frm.out_num_planes = state.out_num_planes;
+    memcpy(frm.out_plane_size, state.out_plane_size, sizeof(frm.out_plane_size));
+    frm.buf_count = state.buf_count;
+    frm.buf_index = state.buf_index;
+    frm.queued = state.queued;
+    frm.applied = state.applied;
+    frm.flags = (frm.flags & ~mask) | (state.flags & mask);
+}
+
+void CScalerV4L2::SwitchContext(int idx)
+{
+    if (idx == m_iCurCtx)
+        return;
+
+    // the jobs queued to the current context keep running
+    m_ctx[m_iCurCtx].src = m_frmSrc;
+    m_ctx[m_iCurCtx].dst = m_frmDst;
+    m_ctx[m_iCurCtx].ctrl = m_ctrl;
+
+    LoadQueueState(m_frmSrc, m_ctx[idx].src);
+    LoadQueueState(m_frmDst, m_ctx[idx].dst);
+    m_ctrl = m_ctx[idx].ctrl;
+
+    m_fdScaler = m_ctx[idx].fd;
+    m_fdValidate = -m_fdScaler;
+    m_iCurCtx = idx;
+
+    SC_LOGD("Switched to context %d; fd %d", idx, m_fdScaler);
+}
+
+void CScalerV4L2::SelectContext()
+{
+    SwitchContext(FindContext());
+
+    m_ctx[m_iCurCtx].last_used = ++m_nUseCount;
+}
+
+bool CScalerV4L2::ForEachContext(bool (CScalerV4L2::*func)())
+{
+    int cur = m_iCurCtx;
+    bool ret = true;
+
+    for (int i = 0; i < SC_MAX_CONTEXTS; i++) {
+        if (m_ctx[i].fd < 0)
+            continue;
+
+        SwitchContext(i);
+        if (!(this->*func)())
+            ret = false;
+    }
+
+    SwitchContext(cur);
+
+    return ret;
+}
+
+bool CScalerV4L2::ResetDevice()
 {
     if (!ResetDevice(m_frmSrc)) {
         SC_LOGE("Failed to stop Scaler for the output frame");
@@ -111,6 +258,24 @@ bool CScalerV4L2::Stop()
     return true;
 }
 
+bool CScalerV4L2::DrainDevice()
+{
+    if (!DrainBufs(m_frmSrc))
+        return false;
+
+    return DrainBufs(m_frmDst);
+}
+
+bool CScalerV4L2::Stop()
+{
+    return ForEachContext(&CScalerV4L2::ResetDevice);
+}
+
+bool CScalerV4L2::DQBuf()
+{
+    return ForEachContext(&CScalerV4L2::DrainDevice);
+}
+
 bool CScalerV4L2::Run()
 {
     if (LibScaler::UnderOne16thScaling(
@@ -119,6 +284,8 @@ bool CScalerV4L2::Run()
                 m_nRotDegree))
         return RunSWScaling();
 
+    SelectContext();
+
     if (!DevSetCtrl())
         return false;
 
@@ -132,35 +299,85 @@ bool CScalerV4L2::Run()
         return false;
 
     if (!QBuf()) {
-        Stop();
+        ResetDevice();
         return false;
     }
 
-    return DQBuf();
+    return DrainDevice();
+}
+
+bool CScalerV4L2::RunAsync(int *pfdSrcReleaseFence, int *pfdDstReleaseFence)
+{
+    *pfdSrcReleaseFence = -1;
+    *pfdDstReleaseFence = -1;
+
+    if (LibScaler::UnderOne16thScaling(
+                m_frmSrc.crop.width, m_frmSrc.crop.height,
+                m_frmDst.crop.width, m_frmDst.crop.height,
+                m_nRotDegree)) {
+        // S/W scaling completes before returning without release fences
+        if (!LibScaler::WaitFence(m_frmSrc.fdAcquireFence) ||
+                !LibScaler::WaitFence(m_frmDst.fdAcquireFence))
+            return false;
+
+        return DQBuf() && RunSWScaling();
+    }
+
+    SelectContext();
+
+    if (!DevSetCtrl())
+        return false;
+
+    if (!DevSetFormat())
+        return false;
+
+    if (!ReqBufs())
+        return false;
+
+    if (!QBuf(pfdSrcReleaseFence, pfdDstReleaseFence))
+        return false;
+
+    if (!StreamOn()) {
+        if (*pfdSrcReleaseFence >= 0)
+            close(*pfdSrcReleaseFence);
+        if (*pfdDstReleaseFence >= 0)
+            close(*pfdDstReleaseFence);
+        *pfdSrcReleaseFence = -1;
+        *pfdDstReleaseFence = -1;
+        ResetDevice();
+        return false;
+    }
+
+    return true;
 }
 
 bool CScalerV4L2::SetCtrl()
 {
     struct v4l2_control ctrl;
 
-    if (TestFlag(m_fStatus, SCF_DRM_FRESH)) {
-        if (!Stop())
+    // the controls are of the device fd, only the changed ones are applied
+    int drm = TestFlag(m_fStatus, SCF_DRM);
+    if (m_ctrl.drm != drm) {
+        if (!ResetDevice())
             return false;
 
         ctrl.id = V4L2_CID_CONTENT_PROTECTION;
-        ctrl.value = TestFlag(m_fStatus, SCF_DRM);
+        ctrl.value = drm;
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
-            SC_LOGERR("Failed configure V4L2_CID_CONTENT_PROTECTION to %d", TestFlag(m_fStatus, SCF_DRM));
+            SC_LOGERR("Failed configure V4L2_CID_CONTENT_PROTECTION to %d", drm);
             return false;
         }
 
-        ClearFlag(m_fStatus, SCF_DRM_FRESH);
+        m_ctrl.drm = drm;
     } else {
         SC_LOGD("Skipping DRM configuration");
     }
 
-    if (TestFlag(m_fStatus, SCF_ROTATION_FRESH)) {
-        if (!Stop())
+    int hflip = TestFlag(m_fStatus, SCF_HFLIP);
+    int vflip = TestFlag(m_fStatus, SCF_VFLIP);
+    if ((m_ctrl.rot != static_cast<int>(m_nRotDegree)) ||
+            (m_ctrl.hflip != hflip) || (m_ctrl.vflip != vflip)) {
+        if (!ResetDevice())
             return false;
 
         ctrl.id = V4L2_CID_ROTATE;
@@ -171,28 +388,35 @@ bool CScalerV4L2::SetCtrl()
         }
 
         ctrl.id = V4L2_CID_VFLIP;
-        ctrl.value = TestFlag(m_fStatus, SCF_HFLIP);
+        ctrl.value = hflip;
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
-            SC_LOGERR("Failed V4L2_CID_VFLIP - %d", TestFlag(m_fStatus, SCF_VFLIP));
+            SC_LOGERR("Failed V4L2_CID_VFLIP - %d", vflip);
             return false;
         }
 
         ctrl.id = V4L2_CID_HFLIP;
-        ctrl.value = TestFlag(m_fStatus, SCF_VFLIP);
+        ctrl.value = vflip;
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
-            SC_LOGERR("Failed V4L2_CID_HFLIP - %d", TestFlag(m_fStatus, SCF_HFLIP));
+            SC_LOGERR("Failed V4L2_CID_HFLIP - %d", hflip);
             return false;
         }
 
         SC_LOGD("Successfully set CID_ROTATE(%d), CID_VFLIP(%d) and CID_HFLIP(%d)",
-                m_nRotDegree, TestFlag(m_fStatus, SCF_VFLIP), TestFlag(m_fStatus, SCF_HFLIP));
-        ClearFlag(m_fStatus, SCF_ROTATION_FRESH);
+                m_nRotDegree, vflip, hflip);
+
+        m_ctrl.rot = m_nRotDegree;
+        m_ctrl.hflip = hflip;
+        m_ctrl.vflip = vflip;
+
+        // the crop is validated against the rotation on S_FMT and S_CROP
+        SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+        SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
     } else {
         SC_LOGD("Skipping rotation and flip setting due to no change");
     }
 
-    if (m_filter > 0) {
-        if (!Stop())
+    if ((m_filter > 0) && (m_ctrl.filter != static_cast<int>(m_filter))) {
+        if (!ResetDevice())
             return false;
 
         ctrl.id = LIBSC_V4L2_CID_DNOISE_FT;
@@ -201,16 +425,20 @@ bool CScalerV4L2::SetCtrl()
             SC_LOGERR("Failed LIBSC_V4L2_CID_DNOISE_FT to %d", m_filter);
             return false;
         }
+
+        m_ctrl.filter = m_filter;
     }
 
-    if (TestFlag(m_fStatus, SCF_CSC_FRESH)) {
-        if (!Stop())
+    int csc_wide = TestFlag(m_fStatus, SCF_CSC_WIDE);
+    if ((m_ctrl.csc_wide != csc_wide) ||
+            (m_ctrl.colorspace != static_cast<int>(m_colorspace))) {
+        if (!ResetDevice())
             return false;
 
         ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = TestFlag(m_fStatus, SCF_CSC_WIDE) ? 1 : 0;
+        ctrl.value = csc_wide;
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
-            SC_LOGERR("Failed V4L2_CID_CSC_RANGE to %d", TestFlag(m_fStatus, SCF_CSC_WIDE));
+            SC_LOGERR("Failed V4L2_CID_CSC_RANGE to %d", csc_wide);
             return false;
         }
 
@@ -219,12 +447,15 @@ bool CScalerV4L2::SetCtrl()
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
             SC_LOGERR("Failed V4L2_CID_CSC_EQ to %d", m_colorspace);
         }
-        ClearFlag(m_fStatus, SCF_CSC_FRESH);
+
+        m_ctrl.csc_wide = csc_wide;
+        m_ctrl.colorspace = m_colorspace;
     }
 
     /* This is optional, so we don't return failure. */
-    if (TestFlag(m_fStatus, SCF_FRAMERATE)) {
-        if (!Stop())
+    if (TestFlag(m_fStatus, SCF_FRAMERATE) &&
+            (m_ctrl.framerate != static_cast<int>(m_frameRate))) {
+        if (!ResetDevice())
             return false;
 
         ctrl.id = SC_CID_FRAMERATE;
@@ -232,7 +463,8 @@ bool CScalerV4L2::SetCtrl()
         if (ioctl(m_fdScaler, VIDIOC_S_CTRL, &ctrl) < 0) {
             SC_LOGD("Failed SC_CID_FRAMERATE to %d", m_frameRate);
         }
-        ClearFlag(m_fStatus, SCF_FRAMERATE);
+
+        m_ctrl.framerate = m_frameRate;
     }
 
     return true;
@@ -245,7 +477,8 @@ bool CScalerV4L2::DevSetCtrl()
 
 bool CScalerV4L2::ResetDevice(FrameInfo &frm)
 {
-    DQBuf(frm);
+    // STREAMOFF would drop the jobs that are not processed yet
+    DrainBufs(frm);
 
     if (TestFlag(frm.flags, SCFF_STREAMING)) {
         if (ioctl(m_fdScaler, VIDIOC_STREAMOFF, &frm.type) < 0) {
@@ -254,17 +487,22 @@ bool CScalerV4L2::ResetDevice(FrameInfo &frm)
         ClearFlag(frm.flags, SCFF_STREAMING);
     }
 
+    frm.queued = 0;
+    frm.buf_index = 0;
+    ClearFlag(frm.flags, SCFF_QBUF);
+
     SC_LOGD("VIDIC_STREAMOFF is successful for the %s", frm.name);
 
     if (TestFlag(frm.flags, SCFF_REQBUFS)) {
         v4l2_requestbuffers reqbufs;
         memset(&reqbufs, 0, sizeof(reqbufs));
         reqbufs.type = frm.type;
-        reqbufs.memory = frm.memory;
+        reqbufs.memory = frm.applied.memory;
         if (ioctl(m_fdScaler, VIDIOC_REQBUFS, &reqbufs) < 0 ) {
             SC_LOGERR("Failed to REQBUFS(0) for the %s", frm.name);
         }
 
+        frm.buf_count = 0;
         ClearFlag(frm.flags, SCFF_REQBUFS);
     }
 
@@ -275,10 +513,21 @@ bool CScalerV4L2::ResetDevice(FrameInfo &frm)
 
 bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
 {
+    if (IsFormatApplied(frm, frm)) {
+        if ((frm.applied.crop.left == frm.crop.left) &&
+                (frm.applied.crop.top == frm.crop.top) &&
+                (frm.applied.crop.width == frm.crop.width) &&
+                (frm.applied.crop.height == frm.crop.height)) {
+            SC_LOGD("Skipping S_FMT for the %s since it is already done", frm.name);
+            return true;
+        }
 
-    if (!TestFlag(frm.flags, SCFF_BUF_FRESH)) {
-        SC_LOGD("Skipping S_FMT for the %s since it is already done", frm.name);
-        return true;
+        // S_CROP is allowed while streaming but it is applied to the
+        // jobs that are not processed yet
+        if (!DrainDevice())
+            return false;
+
+        return DevSetCrop(frm);
     }
 
     if (!ResetDevice(frm)) {
@@ -308,12 +557,33 @@ bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
         return false;
     }
 
+    if (fmt.fmt.pix_mp.num_planes > SC_MAX_PLANES) {
+        SC_LOGE("Number of planes exceeds %d of %s", fmt.fmt.pix_mp.num_planes, frm.name);
+        return false;
+    }
+
     // returned fmt.fmt.pix_mp.num_planes and fmt.fmt.pix_mp.plane_fmt[i].sizeimage
     frm.out_num_planes = fmt.fmt.pix_mp.num_planes;
 
     for (int i = 0; i < frm.out_num_planes; i++)
         frm.out_plane_size[i] = fmt.fmt.pix_mp.plane_fmt[i].sizeimage;
 
+    frm.applied.width = frm.width;
+    frm.applied.height = frm.height;
+    frm.applied.color_format = frm.color_format;
+    frm.applied.memory = frm.memory;
+    frm.applied.premultiplied = TestFlag(frm.flags, SCFF_PREMULTIPLIED);
+
+    ClearFlag(frm.flags, SCFF_BUF_FRESH);
+
+    SC_LOGD("Successfully S_FMT for the %s", frm.name);
+
+    // S_FMT resets the crop
+    return DevSetCrop(frm);
+}
+
+bool CScalerV4L2::DevSetCrop(FrameInfo &frm)
+{
     v4l2_crop crop;
     crop.type = frm.type;
     crop.c = frm.crop;
@@ -325,14 +595,9 @@ bool CScalerV4L2::DevSetFormat(FrameInfo &frm)
         return false;
     }
 
-    if (frm.out_num_planes > SC_MAX_PLANES) {
-        SC_LOGE("Number of planes exceeds %d of %s", frm.out_num_planes, frm.name);
-        return false;
-    }
+    frm.applied.crop = frm.crop;
 
-    ClearFlag(frm.flags, SCFF_BUF_FRESH);
-
-    SC_LOGD("Successfully S_FMT and S_CROP for the %s", frm.name);
+    SC_LOGD("Successfully S_CROP for the %s", frm.name);
 
     return true;
 }
@@ -356,7 +621,8 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
         return false;
     }
 
-    if (!DQBuf(frm))
+    // the oldest job is waited for only when its buffer is needed again
+    if ((frm.queued >= frm.buf_count) && !DQBuf(frm))
         return false;
 
     memset(&buffer, 0, sizeof(buffer));
@@ -364,7 +630,7 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
 
     buffer.type   = frm.type;
     buffer.memory = frm.memory;
-    buffer.index  = 0;
+    buffer.index  = frm.buf_index;
     buffer.length = frm.out_num_planes;
 
     if (pfdReleaseFence) {
@@ -385,11 +651,13 @@ bool CScalerV4L2::QBuf(FrameInfo &frm, int *pfdReleaseFence)
 
 
     if (ioctl(m_fdScaler, VIDIOC_QBUF, &buffer) < 0) {
-        SC_LOGERR("Failed to QBUF for the %s", frm.name);
+        SC_LOGERR("Failed to QBUF(%d) for the %s", frm.buf_index, frm.name);
         return false;
     }
 
     SetFlag(frm.flags, SCFF_QBUF);
+    frm.queued++;
+    frm.buf_index = (frm.buf_index + 1) % frm.buf_count;
 
     if (pfdReleaseFence) {
         if (frm.fdAcquireFence >= 0)
@@ -417,13 +685,21 @@ bool CScalerV4L2::ReqBufs(FrameInfo &frm)
 
     reqbufs.type    = frm.type;
     reqbufs.memory  = frm.memory;
-    reqbufs.count   = 1;
+    reqbufs.count   = SC_MAX_INFLIGHT;
 
     if (ioctl(m_fdScaler, VIDIOC_REQBUFS, &reqbufs) < 0) {
         SC_LOGERR("Failed to REQBUFS for the %s", frm.name);
         return false;
     }
 
+    if (reqbufs.count == 0) {
+        SC_LOGE("No buffer is allocated for the %s", frm.name);
+        return false;
+    }
+
+    frm.buf_count = LibScaler::min(reqbufs.count, static_cast<__u32>(SC_MAX_INFLIGHT));
+    frm.buf_index = 0;
+    frm.queued = 0;
     SetFlag(frm.flags, SCFF_REQBUFS);
 
     SC_LOGD("Successfully REQBUFS for the %s", frm.name);
@@ -450,8 +726,6 @@ bool CScalerV4L2::SetRotate(int rot, int flip_h, int flip_v)
     else
         ClearFlag(m_fStatus, SCF_HFLIP);
 
-    SetFlag(m_fStatus, SCF_ROTATION_FRESH);
-
     return true;
 }
 
@@ -479,7 +753,7 @@ bool CScalerV4L2::StreamOn(FrameInfo &frm)
 
 bool CScalerV4L2::DQBuf(FrameInfo &frm)
 {
-    if (!TestFlag(frm.flags, SCFF_QBUF))
+    if (frm.queued == 0)
         return true;
 
     v4l2_buffer buffer;
@@ -497,7 +771,10 @@ bool CScalerV4L2::DQBuf(FrameInfo &frm)
         buffer.m.planes = plane;
     }
 
-    ClearFlag(frm.flags, SCFF_QBUF);
+    // jobs complete in order, this is the oldest one
+    frm.queued--;
+    if (frm.queued == 0)
+        ClearFlag(frm.flags, SCFF_QBUF);
 
     if (ioctl(m_fdScaler, VIDIOC_DQBUF, &buffer) < 0 ) {
         SC_LOGERR("Failed to DQBuf the %s", frm.name);
@@ -514,6 +791,18 @@ bool CScalerV4L2::DQBuf(FrameInfo &frm)
     return true;
 }
 
+bool CScalerV4L2::DrainBufs(FrameInfo &frm)
+{
+    bool ret = true;
+
+    while (frm.queued > 0) {
+        if (!DQBuf(frm))
+            ret = false;
+    }
+
+    return ret;
+}
+
 static bool GetBuffer(CScalerV4L2::FrameInfo &frm, char *addr[])
 {
     for (int i = 0; i < frm.out_num_planes; i++) {
@@ -556,6 +845,10 @@ bool CScalerV4L2::RunSWScaling()
         return false;
     }
 
+    // the plane sizes of S_FMT are overwritten below
+    SetFlag(m_frmSrc.flags, SCFF_BUF_FRESH);
+    SetFlag(m_frmDst.flags, SCFF_BUF_FRESH);
+
     SC_LOGI("Running S/W Scaler: %dx%d -> %dx%d",
             m_frmSrc.crop.width, m_frmSrc.crop.height,
             m_frmDst.crop.width, m_frmDst.crop.height);
@@ -622,6 +915,68 @@ bool CScalerV4L2::RunSWScaling()
 
             swsc = new CScalerSW_NV12(src[0], src[1], dst[0], dst[1]);
             break;
+        case V4L2_PIX_FMT_YVU420M:
+        case V4L2_PIX_FMT_YUV420M:
+            m_frmSrc.out_num_planes = 3;
+            m_frmDst.out_num_planes = 3;
+            m_frmSrc.out_plane_size[0] = m_frmSrc.width * m_frmSrc.height;
+            m_frmDst.out_plane_size[0] = m_frmDst.width * m_frmDst.height;
+            m_frmSrc.out_plane_size[1] = m_frmSrc.out_plane_size[0] / 4;
+            m_frmDst.out_plane_size[1] = m_frmDst.out_plane_size[0] / 4;
+            m_frmSrc.out_plane_size[2] = m_frmSrc.out_plane_size[1];
+            m_frmDst.out_plane_size[2] = m_frmDst.out_plane_size[1];
+
+            if (!GetBuffer(m_frmSrc, src))
+                return false;
+
+            if (!GetBuffer(m_frmDst, dst)) {
+                PutBuffer(m_frmSrc, src);
+                return false;
+            }
+
+            swsc = new CScalerSW_YV12(src[0], src[1], src[2], dst[0], dst[1], dst[2]);
+            break;
+        case V4L2_PIX_FMT_YVU420:
+        case V4L2_PIX_FMT_YUV420:
+            m_frmSrc.out_num_planes = 1;
+            m_frmDst.out_num_planes = 1;
+            m_frmSrc.out_plane_size[0] = m_frmSrc.width * m_frmSrc.height;
+            m_frmDst.out_plane_size[0] = m_frmDst.width * m_frmDst.height;
+            m_frmSrc.out_plane_size[0] += m_frmSrc.out_plane_size[0] / 2;
+            m_frmDst.out_plane_size[0] += m_frmDst.out_plane_size[0] / 2;
+
+            if (!GetBuffer(m_frmSrc, src))
+                return false;
+
+            if (!GetBuffer(m_frmDst, dst)) {
+                PutBuffer(m_frmSrc, src);
+                return false;
+            }
+
+            src[1] = src[0] + m_frmSrc.width * m_frmSrc.height;
+            dst[1] = dst[0] + m_frmDst.width * m_frmDst.height;
+            src[2] = src[1] + m_frmSrc.width * m_frmSrc.height / 4;
+            dst[2] = dst[1] + m_frmDst.width * m_frmDst.height / 4;
+
+            swsc = new CScalerSW_YV12(src[0], src[1], src[2], dst[0], dst[1], dst[2]);
+            break;
+        case V4L2_PIX_FMT_RGB32:
+        case V4L2_PIX_FMT_BGR32:
+            m_frmSrc.out_num_planes = 1;
+            m_frmSrc.out_plane_size[0] = m_frmSrc.width * m_frmSrc.height * 4;
+            m_frmDst.out_num_planes = 1;
+            m_frmDst.out_plane_size[0] = m_frmDst.width * m_frmDst.height * 4;
+
+            if (!GetBuffer(m_frmSrc, src))
+                return false;
+
+            if (!GetBuffer(m_frmDst, dst)) {
+                PutBuffer(m_frmSrc, src);
+                return false;
+            }
+
+            swsc = new CScalerSW_RGBA8888(src[0], dst[0]);
+            break;
         case V4L2_PIX_FMT_UYVY: // TODO: UYVY is not implemented yet.
         default:
             SC_LOGE("Format %x is not supported", m_frmSrc.color_format);
@@ -29,6 +29,7 @@
 #define _LIBSCALER_V4L2_H_
 
 #include <fcntl.h>
+#include <unistd.h>
 
 #include <exynos_scaler.h>
 
@@ -52,6 +53,10 @@ public:
     enum { SC_MAX_PLANES = SC_NUM_OF_PLANES };
     enum { SC_MAX_NODENAME = 14 };
     enum { SC_V4L2_FMT_PREMULTI_FLAG = 10 };
+    // jobs queued without waiting for the previous ones to complete
+    enum { SC_MAX_INFLIGHT = 3 };
+    // device fds kept configured for different geometries
+    enum { SC_MAX_CONTEXTS = 3 };
 
     enum SC_FRAME_FLAG {
         // frame status
@@ -67,10 +72,6 @@ public:
 
     enum SC_FLAG {
         SCF_RESERVED = 0,
-        // session status
-        SCF_ROTATION_FRESH,
-        SCF_CSC_FRESH,
-        SCF_DRM_FRESH,
         // h/w setting setting
         SCF_HFLIP,
         SCF_VFLIP,
@@ -93,11 +94,50 @@ public:
         int out_num_planes;
         unsigned long out_plane_size[SC_MAX_PLANES];
         unsigned long flags; // enum SC_FRAME_FLAG
+        int buf_count; // buffers allocated by REQBUFS
+        int buf_index; // next buffer to queue
+        int queued;    // buffers not dequeued yet
+        // configured by S_FMT and S_CROP
+        struct {
+            unsigned int width, height;
+            unsigned int color_format;
+            enum v4l2_memory memory;
+            bool premultiplied;
+            v4l2_rect crop;
+        } applied;
     };
 
 private:
+    // controls applied to a device fd, -1 if not applied yet
+    struct CtrlState {
+        int rot;
+        int hflip, vflip;
+        int drm;
+        int csc_wide;
+        int colorspace;
+        int filter;
+        int framerate;
+    };
+
+    // A device fd with its own queues and controls. Switching to the context
+    // configured for a geometry avoids the STREAMOFF, REQBUFS(0) and S_FMT
+    // of reconfiguring a single fd.
+    struct Context {
+        int fd;
+        unsigned int last_used; // 0 if never used
+        // state of the queues and the controls while another context is used
+        FrameInfo src, dst;
+        CtrlState ctrl;
+    };
+
     FrameInfo m_frmSrc;
     FrameInfo m_frmDst;
+    CtrlState m_ctrl; // of m_fdScaler
+
+    Context m_ctx[SC_MAX_CONTEXTS];
+    int m_iCurCtx;
+    int m_nMaxCtx; // contexts that can be opened
+    unsigned int m_nUseCount;
 
     unsigned int m_nRotDegree;
     unsigned int m_frameRate;
@@ -111,6 +151,17 @@ private:
 
     void Initialize(int instance);
     bool ResetDevice(FrameInfo &frm);
+    bool ResetDevice();
+    bool DrainDevice();
+
+    bool OpenContext(int idx);
+    bool IsFormatApplied(FrameInfo &state, FrameInfo &frm);
+    bool IsConfiguredFor(FrameInfo &src, FrameInfo &dst, CtrlState &ctrl);
+    int FindContext();
+    void LoadQueueState(FrameInfo &frm, FrameInfo &state);
+    void SwitchContext(int idx);
+    void SelectContext();
+    bool ForEachContext(bool (CScalerV4L2::*func)());
 
     inline void SetRotDegree(int rot) {
         rot = rot % 360;
@@ -118,21 +169,21 @@ private:
             rot = 360 + rot;
 
         m_nRotDegree = rot;
-        SetFlag(m_fStatus, SCF_ROTATION_FRESH);
     }
 
     bool DevSetFormat(FrameInfo &frm);
+    bool DevSetCrop(FrameInfo &frm);
     bool ReqBufs(FrameInfo &frm);
     bool QBuf(FrameInfo &frm, int *pfdReleaseFence);
     bool StreamOn(FrameInfo &frm);
     bool DQBuf(FrameInfo &frm);
+    bool DrainBufs(FrameInfo &frm);
 
     inline bool SetFormat(FrameInfo &frm, unsigned int width, unsigned int height,
                    unsigned int v4l2_colorformat) {
         frm.color_format = v4l2_colorformat;
         frm.width = width;
         frm.height = height;
-        SetFlag(frm.flags, SCFF_BUF_FRESH);
         return true;
     }
 
@@ -142,7 +193,6 @@ private:
         frm.crop.top = top;
         frm.crop.width = width;
         frm.crop.height = height;
-        SetFlag(frm.flags, SCFF_BUF_FRESH);
         return true;
     }
 
@@ -166,6 +216,12 @@ private:
         frm.fdAcquireFence = fence;
     }
 
+    inline void CloseAcquireFence(FrameInfo &frm) {
+        if (frm.fdAcquireFence >= 0)
+            close(frm.fdAcquireFence);
+        frm.fdAcquireFence = -1;
+    }
+
     bool RunSWScaling();
 
 protected:
@@ -197,8 +253,16 @@ public:
     inline bool IsDRMAllowed() { return TestFlag(m_fStatus, SCF_ALLOW_DRM); }
     inline int GetScalerID() { return m_iInstance; }
 
-    bool Stop();
+    // S_FMT is skipped if the format is not changed, S_CROP is issued without
+    // restarting the streaming if only the crop is changed. Run() and
+    // RunAsync() switch to the context configured for the formats and the
+    // rotation if there is one, or reconfigure the least recently used one.
+    bool Stop(); // all the contexts
     bool Run(); // Blocking mode
+    // Non-blocking mode: the H/W waits for the acquire fences of the addresses
+    // and signals the release fences. Up to SC_MAX_INFLIGHT jobs are queued,
+    // the completed ones are dequeued when their buffer is needed again.
+    bool RunAsync(int *pfdSrcReleaseFence, int *pfdDstReleaseFence);
 
     // H/W Control
     virtual bool DevSetCtrl();
@@ -216,7 +280,15 @@ public:
             return false;
 
         if (!QBuf(m_frmDst, pfdDstReleaseFence)) {
-            ClearFlag(m_frmSrc.flags, SCFF_QBUF);
+            // the queued source would be processed into the next destination
+            m_frmSrc.queued--;
+            if (m_frmSrc.queued == 0)
+                ClearFlag(m_frmSrc.flags, SCFF_QBUF);
+            if (pfdSrcReleaseFence && *pfdSrcReleaseFence >= 0) {
+                close(*pfdSrcReleaseFence);
+                *pfdSrcReleaseFence = -1;
+            }
+            ResetDevice();
             return false;
         }
         return true;
@@ -229,11 +301,12 @@ public:
         return StreamOn(m_frmDst);
     }
 
-    inline bool DQBuf() {
-        if (!DQBuf(m_frmSrc))
-            return false;
+    // waits for all the queued jobs of all the contexts
+    bool DQBuf();
 
-        return DQBuf(m_frmDst);
+    inline void CloseAcquireFences() {
+        CloseAcquireFence(m_frmSrc);
+        CloseAcquireFence(m_frmDst);
     }
 
     inline bool SetSrcFormat(unsigned int width, unsigned int height,
@@ -257,13 +330,10 @@ public:
     }
 
     inline void SetDRM(bool drm) {
-        if (drm != TestFlag(m_fStatus, SCF_DRM)) {
-            if (drm)
-                SetFlag(m_fStatus, SCF_DRM);
-            else
-                ClearFlag(m_fStatus, SCF_DRM);
-            SetFlag(m_fStatus, SCF_DRM_FRESH);
-        }
+        if (drm)
+            SetFlag(m_fStatus, SCF_DRM);
+        else
+            ClearFlag(m_fStatus, SCF_DRM);
     }
 
     inline void SetCSCWide(bool wide) {
@@ -271,8 +341,6 @@ public:
             SetFlag(m_fStatus, SCF_CSC_WIDE);
         else
             ClearFlag(m_fStatus, SCF_CSC_WIDE);
-
-        SetFlag(m_fStatus, SCF_CSC_FRESH);
     }
 
     inline void SetCSCEq(unsigned int v4l2_colorspace) {
@@ -280,7 +348,6 @@ public:
             m_colorspace = V4L2_COLORSPACE_DEFAULT;
         else
             m_colorspace = v4l2_colorspace;
-        SetFlag(m_fStatus, SCF_CSC_FRESH);
     }
 
     inline void SetFilter(unsigned int filter) {
@@ -316,6 +383,14 @@ public:
         return true;
     }
 
+    inline void SetSrcAcquireFence(int fence) {
+        m_frmSrc.fdAcquireFence = fence;
+    }
+
+    inline void SetDstAcquireFence(int fence) {
+        m_frmDst.fdAcquireFence = fence;
+    }
+
     inline void SetFrameRate(int framerate) {
         m_frameRate = framerate;
         SetFlag(m_fStatus, SCF_FRAMERATE);
@@ -430,6 +430,43 @@ int exynos_sc_convert(void *handle)
     return sc->Run() ? 0 : -1;
 }
 
+int exynos_sc_convert_async(void *handle,
+        int src_acquire_fence, int dst_acquire_fence,
+        int *src_release_fence, int *dst_release_fence)
+{
+    *src_release_fence = -1;
+    *dst_release_fence = -1;
+
+    CScalerNonStream *sc = GetNonStreamScaler(handle);
+    if (!sc) {
+        if (src_acquire_fence >= 0)
+            close(src_acquire_fence);
+        if (dst_acquire_fence >= 0)
+            close(dst_acquire_fence);
+        return -1;
+    }
+
+#ifdef SCALER_USE_M2M1SHOT
+    // m2m1shot processes the job in the ioctl
+    bool waited = LibScaler::WaitFence(src_acquire_fence);
+    waited = LibScaler::WaitFence(dst_acquire_fence) && waited;
+    if (!waited)
+        return -1;
+
+    return sc->Run() ? 0 : -1;
+#else
+    sc->SetSrcAcquireFence(src_acquire_fence);
+    sc->SetDstAcquireFence(dst_acquire_fence);
+
+    if (!sc->RunAsync(src_release_fence, dst_release_fence)) {
+        sc->CloseAcquireFences();
+        return -1;
+    }
+
+    return 0;
+#endif
+}
+
 static CScalerBlendV4L2 *GetScalerBlend(void *handle)
 {
     if (handle == NULL) {
@@ -615,26 +652,11 @@ int exynos_sc_run_exclusive(
     addr[2] = (void *)dst_img->vaddr;
     sc->SetDstAddr(addr, dst_img->mem_type, dst_img->acquireFenceFd);
 
-    if (!sc->DevSetCtrl())
-        return -1;
-
-    if (!sc->DevSetFormat())
-        return -1;
-
-    if (!sc->ReqBufs())
-        return -1;
-
     int fdSrcReleaseFence, fdDstReleaseFence;
 
-    if (!sc->QBuf(&fdSrcReleaseFence, &fdDstReleaseFence))
+    if (!sc->RunAsync(&fdSrcReleaseFence, &fdDstReleaseFence))
         return -1;
 
-    if (!sc->StreamOn()) {
-        close(fdSrcReleaseFence);
-        close(fdDstReleaseFence);
-        return -1;
-    }
-
     src_img->releaseFenceFd = fdSrcReleaseFence;
     dst_img->releaseFenceFd = fdDstReleaseFence;
 
@@ -0,0 +1,809 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "exynos_scaler.h"
+#include "libscaler-v4l2.h"
+
+using namespace std;
+
+/*
+ * A stand-in of the Scaler node on a regular file. open() of the node and
+ * ioctl() on the opened files are served by FakeScaler instead of the driver.
+ * Every open file is a context with queues of its own, like the m2m contexts
+ * of the driver. Like videobuf2, it rejects S_FMT while buffers are allocated
+ * and REQBUFS while streaming, and it grants at most kMaxBuffers buffers. A job
+ * is done as soon as both of its buffers are queued. A release fence is the
+ * read end of a pipe, signaled by closing the write end that FakeScaler keeps.
+ * Each ioctl is logged as a string like "QBUF src 1".
+ */
+class FakeScaler {
+    struct Queue {
+        bool streaming = false;
+        unsigned int count = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int num_planes = 0;
+        deque<unsigned int> queued;
+        deque<unsigned int> done;
+    };
+
+    struct Context {
+        Queue queue[2];
+    };
+
+    string mPath;
+    dev_t mDev = 0;
+    ino_t mIno = 0;
+    map<int, Context> mContexts; // by fd
+
+    static int QueueOf(unsigned int type) {
+        return (type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) ? 0 : 1;
+    }
+
+    static const char *Name(unsigned int type) {
+        return (QueueOf(type) == 0) ? "src" : "dst";
+    }
+
+    static string CtrlName(unsigned int id) {
+        switch (id) {
+            case V4L2_CID_ROTATE: return "ROTATE";
+            case V4L2_CID_VFLIP: return "VFLIP";
+            case V4L2_CID_HFLIP: return "HFLIP";
+            case V4L2_CID_CSC_EQ: return "CSC_EQ";
+            case V4L2_CID_CSC_RANGE: return "CSC_RANGE";
+            case V4L2_CID_CONTENT_PROTECTION: return "CONTENT_PROTECTION";
+        }
+        return to_string(id);
+    }
+
+    int Fail(int err) {
+        errno = err;
+        return -1;
+    }
+
+    void Log(const string &call) { log.push_back(call); }
+
+    static unsigned int TypeOf(unsigned long request, void *arg) {
+        switch (request) {
+            case VIDIOC_S_FMT: return static_cast<v4l2_format *>(arg)->type;
+            case VIDIOC_REQBUFS: return static_cast<v4l2_requestbuffers *>(arg)->type;
+            case VIDIOC_QBUF: return static_cast<v4l2_buffer *>(arg)->type;
+            case VIDIOC_STREAMON: return *static_cast<unsigned int *>(arg);
+        }
+        return 0;
+    }
+
+    // the files closed by the library are not contexts any more
+    void Prune() {
+        for (auto it = mContexts.begin(); it != mContexts.end();) {
+            if (Owns(it->first))
+                ++it;
+            else
+                it = mContexts.erase(it);
+        }
+    }
+
+    int SetFormat(Context &ctx, v4l2_format *fmt) {
+        Queue &q = ctx.queue[QueueOf(fmt->type)];
+        Log(string("S_FMT ") + Name(fmt->type) + " " + to_string(fmt->fmt.pix_mp.width) + "x" +
+            to_string(fmt->fmt.pix_mp.height));
+        if (q.count > 0) return Fail(EBUSY);
+        q.width = fmt->fmt.pix_mp.width;
+        q.height = fmt->fmt.pix_mp.height;
+        q.num_planes = 1;
+        fmt->fmt.pix_mp.num_planes = 1;
+        fmt->fmt.pix_mp.plane_fmt[0].sizeimage = q.width * q.height * 4;
+        return 0;
+    }
+
+    int ReqBufs(Context &ctx, v4l2_requestbuffers *req) {
+        Queue &q = ctx.queue[QueueOf(req->type)];
+        Log(string("REQBUFS ") + Name(req->type) + " " + to_string(req->count));
+        if (q.streaming) return Fail(EBUSY);
+        if ((req->count > 0) && (q.num_planes == 0)) return Fail(EINVAL);
+        q.count = min(req->count, kMaxBuffers);
+        q.queued.clear();
+        q.done.clear();
+        req->count = q.count;
+        return 0;
+    }
+
+    int Stream(Context &ctx, unsigned int type, bool on) {
+        Queue &q = ctx.queue[QueueOf(type)];
+        Log(string(on ? "STREAMON " : "STREAMOFF ") + Name(type));
+        if (on && (q.count == 0)) return Fail(EINVAL);
+        q.streaming = on;
+        if (!on) {
+            q.queued.clear();
+            q.done.clear();
+        }
+        return 0;
+    }
+
+    int QBuf(Context &ctx, v4l2_buffer *buf) {
+        Queue &q = ctx.queue[QueueOf(buf->type)];
+        Log(string("QBUF ") + Name(buf->type) + " " + to_string(buf->index));
+        bool busy = (find(q.queued.begin(), q.queued.end(), buf->index) != q.queued.end()) ||
+                    (find(q.done.begin(), q.done.end(), buf->index) != q.done.end());
+        if ((buf->index >= q.count) || busy || (buf->length != q.num_planes))
+            return Fail(EINVAL);
+
+        if (buf->flags & V4L2_BUF_FLAG_USE_SYNC) {
+            int acquire = static_cast<int>(buf->reserved);
+            if ((acquire >= 0) && (fcntl(acquire, F_GETFD) < 0)) return Fail(EINVAL);
+            int fence[2];
+            if (pipe(fence) < 0) return -1;
+            releases.push_back(fence[1]);
+            buf->reserved = fence[0];
+        }
+
+        q.queued.push_back(buf->index);
+
+        while (!ctx.queue[0].queued.empty() && !ctx.queue[1].queued.empty()) {
+            for (Queue &job : ctx.queue) {
+                job.done.push_back(job.queued.front());
+                job.queued.pop_front();
+            }
+        }
+        for (Queue &each : ctx.queue)
+            maxInFlight = max(maxInFlight, (unsigned int)(each.queued.size() + each.done.size()));
+        return 0;
+    }
+
+    int DQBuf(Context &ctx, v4l2_buffer *buf) {
+        Queue &q = ctx.queue[QueueOf(buf->type)];
+        Log(string("DQBUF ") + Name(buf->type));
+        /* the driver would block forever */
+        if (q.done.empty()) return Fail(EAGAIN);
+        buf->index = q.done.front();
+        q.done.pop_front();
+        return 0;
+    }
+
+public:
+    static constexpr unsigned int kMaxBuffers = 3;
+
+    vector<string> log;
+    unsigned int maxInFlight = 0;
+    // the contexts the driver allows to open
+    unsigned int maxContexts = 3;
+    // the request that fails once, like VIDIOC_QBUF of failType
+    unsigned long failRequest = 0;
+    unsigned int failType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    // write ends of the release fences, in the order of QBUF
+    vector<int> releases;
+
+    FakeScaler() {
+        char tmpl[] = "/data/local/tmp/scaler_fakeXXXXXX";
+        int fd = mkstemp(tmpl);
+        if (fd < 0) {
+            /* on the host */
+            char host_tmpl[] = "/tmp/scaler_fakeXXXXXX";
+            fd = mkstemp(host_tmpl);
+            mPath = host_tmpl;
+        } else {
+            mPath = tmpl;
+        }
+
+        struct stat st;
+        if ((fd >= 0) && (fstat(fd, &st) == 0)) {
+            mDev = st.st_dev;
+            mIno = st.st_ino;
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    ~FakeScaler() {
+        for (int fd : releases)
+            close(fd);
+        unlink(mPath.c_str());
+    }
+
+    int Open() {
+        Prune();
+        if (mContexts.size() >= maxContexts) return Fail(EBUSY);
+
+        int fd = static_cast<int>(syscall(SYS_openat, AT_FDCWD, mPath.c_str(), O_RDWR));
+        if (fd >= 0)
+            mContexts[fd] = Context();
+        return fd;
+    }
+
+    bool Owns(int fd) {
+        struct stat st;
+        return (fstat(fd, &st) == 0) && (st.st_dev == mDev) && (st.st_ino == mIno);
+    }
+
+    size_t Contexts() {
+        Prune();
+        return mContexts.size();
+    }
+
+    // The calls logged since the last call of TakeLog()
+    vector<string> TakeLog() {
+        vector<string> taken;
+        taken.swap(log);
+        return taken;
+    }
+
+    unsigned int Count(const string &request) {
+        return count_if(log.begin(), log.end(), [&](const string &call) {
+            return call.compare(0, request.size() + 1, request + " ") == 0;
+        });
+    }
+
+    // The calls logged exactly as call
+    unsigned int Calls(const string &call) {
+        return count(log.begin(), log.end(), call);
+    }
+
+    int Ioctl(int fd, unsigned long request, void *arg) {
+        Context &ctx = mContexts[fd];
+
+        if ((request == failRequest) && (TypeOf(request, arg) == failType)) {
+            failRequest = 0;
+            Log(string("FAIL ") + Name(failType));
+            return Fail(EIO);
+        }
+
+        switch (request) {
+            case VIDIOC_S_FMT:
+                return SetFormat(ctx, static_cast<v4l2_format *>(arg));
+            case VIDIOC_S_CROP: {
+                v4l2_crop *crop = static_cast<v4l2_crop *>(arg);
+                Log(string("S_CROP ") + Name(crop->type) + " " + to_string(crop->c.left) + "," +
+                    to_string(crop->c.top) + " " + to_string(crop->c.width) + "x" +
+                    to_string(crop->c.height));
+                return 0;
+            }
+            case VIDIOC_S_CTRL: {
+                v4l2_control *ctrl = static_cast<v4l2_control *>(arg);
+                Log("S_CTRL " + CtrlName(ctrl->id) + " " + to_string(ctrl->value));
+                return 0;
+            }
+            case VIDIOC_REQBUFS:
+                return ReqBufs(ctx, static_cast<v4l2_requestbuffers *>(arg));
+            case VIDIOC_STREAMON:
+            case VIDIOC_STREAMOFF:
+                return Stream(ctx, *static_cast<unsigned int *>(arg), request == VIDIOC_STREAMON);
+            case VIDIOC_QBUF:
+                return QBuf(ctx, static_cast<v4l2_buffer *>(arg));
+            case VIDIOC_DQBUF:
+                return DQBuf(ctx, static_cast<v4l2_buffer *>(arg));
+        }
+
+        return Fail(ENOTTY);
+    }
+};
+
+static FakeScaler *gFake;
+
+// The Scaler node opened by libscaler linked in this test is the fake one
+extern "C" int open(const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+
+    if (gFake && (strncmp(path, SC_DEV_NODE, strlen(SC_DEV_NODE)) == 0))
+        return gFake->Open();
+
+    return static_cast<int>(syscall(SYS_openat, AT_FDCWD, path, flags, mode));
+}
+
+// The calls to ioctl() by libscaler linked in this test come here
+#if defined(__BIONIC__)
+extern "C" int ioctl(int fd, int request, ...) {
+#else
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+#endif
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (gFake && gFake->Owns(fd))
+        return gFake->Ioctl(fd, static_cast<unsigned long>(request), arg);
+
+    return static_cast<int>(syscall(SYS_ioctl, fd, request, arg));
+}
+
+/*
+ * An acquire fence of the caller: the read end of a pipe, signaled by writing
+ * to the write end. The write end tells whether the library closed the fence.
+ */
+struct Fence {
+    int fd = -1;
+    int signal = -1;
+
+    Fence() {
+        int fds[2];
+        if (pipe(fds) == 0) {
+            fd = fds[0];
+            signal = fds[1];
+        }
+    }
+
+    ~Fence() {
+        if (signal >= 0)
+            close(signal);
+    }
+
+    void Signal() { write(signal, "", 1); }
+};
+
+// Whether the read end of the pipe with the write end signal is closed
+static bool Closed(int signal) {
+    return (write(signal, "", 1) < 0) && (errno == EPIPE);
+}
+
+struct Image {
+    unsigned int width, height;
+    unsigned int left, top, crop_width, crop_height;
+};
+
+class ScalerV4L2Test : public ::testing::Test {
+protected:
+    FakeScaler mFake;
+    void *mSc = NULL;
+    Image mSrc = {1920, 1080, 0, 0, 1920, 1080};
+    Image mDst = {1280, 720, 0, 0, 1280, 720};
+    vector<char> mSrcBuf = vector<char>(1920 * 1080 * 4, 0x11);
+    vector<char> mDstBuf = vector<char>(1280 * 720 * 4, 0);
+
+    void SetUp() override {
+        // a closed fence is told by EPIPE
+        signal(SIGPIPE, SIG_IGN);
+        gFake = &mFake;
+        mSc = exynos_sc_create(0);
+        ASSERT_NE(nullptr, mSc);
+    }
+
+    void TearDown() override {
+        if (mSc)
+            exynos_sc_destroy(mSc);
+        gFake = NULL;
+    }
+
+    // One job the way a caller runs it: the configuration is set for every job
+    int Run(int src_acquire, int dst_acquire, int *src_release, int *dst_release) {
+        EXPECT_EQ(0, exynos_sc_set_src_format(mSc, mSrc.width, mSrc.height, mSrc.left, mSrc.top,
+                                              mSrc.crop_width, mSrc.crop_height,
+                                              V4L2_PIX_FMT_RGB32, 0, 0, 0));
+        EXPECT_EQ(0, exynos_sc_set_dst_format(mSc, mDst.width, mDst.height, mDst.left, mDst.top,
+                                              mDst.crop_width, mDst.crop_height,
+                                              V4L2_PIX_FMT_RGB32, 0, 0, 0));
+
+        void *src[SC_NUM_OF_PLANES] = {mSrcBuf.data(), NULL, NULL};
+        void *dst[SC_NUM_OF_PLANES] = {mDstBuf.data(), NULL, NULL};
+        EXPECT_EQ(0, exynos_sc_set_src_addr(mSc, src, V4L2_MEMORY_USERPTR, -1));
+        EXPECT_EQ(0, exynos_sc_set_dst_addr(mSc, dst, V4L2_MEMORY_USERPTR, -1));
+
+        return exynos_sc_convert_async(mSc, src_acquire, dst_acquire, src_release, dst_release);
+    }
+
+    // A job without acquire fences, its release fences are dropped
+    bool Run() {
+        int src_release, dst_release;
+        if (Run(-1, -1, &src_release, &dst_release) < 0)
+            return false;
+        close(src_release);
+        close(dst_release);
+        return true;
+    }
+
+    // Runs until the queues are streaming and every slot holds a job
+    void WarmUp() {
+        for (unsigned int i = 0; i < FakeScaler::kMaxBuffers; i++)
+            ASSERT_TRUE(Run());
+        mFake.TakeLog();
+    }
+
+    // Runs jobs to the destinations in turn, records the average time of a job
+    void RunCycle(const vector<Image> &dsts, unsigned int jobs) {
+        auto start = chrono::steady_clock::now();
+        for (unsigned int i = 0; i < jobs; i++) {
+            mDst = dsts[i % dsts.size()];
+            ASSERT_TRUE(Run());
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        RecordProperty("job_time_ns_avg",
+                       to_string(chrono::duration_cast<chrono::nanoseconds>(elapsed).count() / jobs));
+    }
+
+    // The device is never reconfigured, only the crops may be sent again
+    void ExpectNoReconfiguration() {
+        EXPECT_EQ(0u, mFake.Count("STREAMOFF"));
+        EXPECT_EQ(0u, mFake.Calls("REQBUFS src 0") + mFake.Calls("REQBUFS dst 0"));
+        EXPECT_EQ(0u, mFake.Count("REQBUFS"));
+        EXPECT_EQ(0u, mFake.Count("S_FMT"));
+        EXPECT_EQ(0u, mFake.Count("S_CTRL"));
+    }
+};
+
+TEST_F(ScalerV4L2Test, FirstJob) {
+    Fence src_acquire, dst_acquire;
+    int src_release, dst_release;
+    ASSERT_EQ(0, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+
+    const vector<string> expected = {
+            "S_CTRL CONTENT_PROTECTION 0",
+            "S_CTRL ROTATE 0",
+            "S_CTRL VFLIP 0",
+            "S_CTRL HFLIP 0",
+            "S_CTRL CSC_RANGE 0",
+            "S_CTRL CSC_EQ 0",
+            "S_FMT src 1920x1080",
+            "S_CROP src 0,0 1920x1080",
+            "S_FMT dst 1280x720",
+            "S_CROP dst 0,0 1280x720",
+            "REQBUFS src 3",
+            "REQBUFS dst 3",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(expected, mFake.log);
+
+    // the acquire fences are handed to the driver and closed, the release fences are the caller's
+    EXPECT_TRUE(Closed(src_acquire.signal));
+    EXPECT_TRUE(Closed(dst_acquire.signal));
+    ASSERT_EQ(2u, mFake.releases.size());
+    EXPECT_GE(fcntl(src_release, F_GETFD), 0);
+    EXPECT_GE(fcntl(dst_release, F_GETFD), 0);
+    close(src_release);
+    close(dst_release);
+    EXPECT_TRUE(Closed(mFake.releases[0]));
+    EXPECT_TRUE(Closed(mFake.releases[1]));
+}
+
+TEST_F(ScalerV4L2Test, RoundRobin) {
+    // no job is waited for until every slot holds one
+    WarmUp();
+    EXPECT_EQ(FakeScaler::kMaxBuffers, mFake.maxInFlight);
+
+    const unsigned int kJobs = 10;
+    for (unsigned int i = 0; i < kJobs; i++)
+        ASSERT_TRUE(Run());
+
+    // the slots are used round-robin, the oldest job is dequeued only when its slot is needed
+    vector<string> expected;
+    for (unsigned int i = 0; i < kJobs; i++) {
+        string index = to_string(i % FakeScaler::kMaxBuffers);
+        expected.insert(expected.end(), {"DQBUF src", "QBUF src " + index, "DQBUF dst",
+                                         "QBUF dst " + index});
+    }
+    EXPECT_EQ(expected, mFake.log);
+    EXPECT_EQ(FakeScaler::kMaxBuffers, mFake.maxInFlight);
+    EXPECT_EQ(1u, mFake.Contexts());
+}
+
+TEST_F(ScalerV4L2Test, WaitFrameDone) {
+    WarmUp();
+
+    ASSERT_EQ(0, exynos_sc_wait_frame_done_exclusive(mSc));
+    EXPECT_EQ(6u, mFake.Count("DQBUF"));
+    mFake.TakeLog();
+
+    // nothing is in flight, the next job takes the next slot without a dequeue
+    ASSERT_TRUE(Run());
+    EXPECT_EQ(vector<string>({"QBUF src 0", "QBUF dst 0"}), mFake.TakeLog());
+}
+
+TEST_F(ScalerV4L2Test, FailedDstQbuf) {
+    WarmUp();
+
+    mFake.failRequest = VIDIOC_QBUF;
+    Fence src_acquire, dst_acquire;
+    int src_release, dst_release;
+    EXPECT_EQ(-1, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+
+    // the queued source is dropped with the jobs in flight, not run into the next destination
+    const vector<string> failed = {
+            "DQBUF src",
+            "QBUF src 0",
+            "DQBUF dst",
+            "FAIL dst",
+            "DQBUF src",
+            "DQBUF src",
+            "STREAMOFF src",
+            "REQBUFS src 0",
+            "DQBUF dst",
+            "DQBUF dst",
+            "STREAMOFF dst",
+            "REQBUFS dst 0",
+    };
+    EXPECT_EQ(failed, mFake.TakeLog());
+
+    // no fence is left behind
+    EXPECT_EQ(-1, src_release);
+    EXPECT_EQ(-1, dst_release);
+    EXPECT_TRUE(Closed(mFake.releases.back()));
+    EXPECT_TRUE(Closed(src_acquire.signal));
+    EXPECT_TRUE(Closed(dst_acquire.signal));
+
+    // the formats are kept, only the buffers are requested again
+    ASSERT_TRUE(Run());
+    const vector<string> restart = {
+            "REQBUFS src 3",
+            "REQBUFS dst 3",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(restart, mFake.TakeLog());
+}
+
+TEST_F(ScalerV4L2Test, FailedStreamOn) {
+    mFake.failRequest = VIDIOC_STREAMON;
+    mFake.failType = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+    Fence src_acquire, dst_acquire;
+    int src_release, dst_release;
+    EXPECT_EQ(-1, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+
+    // the jobs never run, their release fences are closed
+    EXPECT_EQ(-1, src_release);
+    EXPECT_EQ(-1, dst_release);
+    ASSERT_EQ(2u, mFake.releases.size());
+    EXPECT_TRUE(Closed(mFake.releases[0]));
+    EXPECT_TRUE(Closed(mFake.releases[1]));
+    EXPECT_TRUE(Closed(src_acquire.signal));
+    EXPECT_TRUE(Closed(dst_acquire.signal));
+    const vector<string> failed = {
+            "QBUF src 0",
+            "QBUF dst 0",
+            "FAIL src",
+            "DQBUF src",
+            "REQBUFS src 0",
+            "DQBUF dst",
+            "REQBUFS dst 0",
+    };
+    vector<string> log = mFake.TakeLog();
+    EXPECT_EQ(failed, vector<string>(log.end() - min(log.size(), failed.size()), log.end()));
+
+    ASSERT_TRUE(Run());
+    const vector<string> restart = {
+            "REQBUFS src 3",
+            "REQBUFS dst 3",
+            "QBUF src 0",
+            "QBUF dst 0",
+            "STREAMON src",
+            "STREAMON dst",
+    };
+    EXPECT_EQ(restart, mFake.TakeLog());
+}
+
+TEST_F(ScalerV4L2Test, SwFallback) {
+    WarmUp();
+
+    // more than 16 times smaller is scaled by the CPU
+    mDst = {100, 60, 0, 0, 100, 60};
+    Fence src_acquire, dst_acquire;
+    src_acquire.Signal();
+    dst_acquire.Signal();
+    int src_release, dst_release;
+    ASSERT_EQ(0, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+
+    // the jobs in flight are done before, the scaled image is ready on return
+    vector<string> drained(FakeScaler::kMaxBuffers, "DQBUF src");
+    drained.insert(drained.end(), FakeScaler::kMaxBuffers, "DQBUF dst");
+    EXPECT_EQ(drained, mFake.TakeLog());
+    EXPECT_EQ(-1, src_release);
+    EXPECT_EQ(-1, dst_release);
+    EXPECT_TRUE(Closed(src_acquire.signal));
+    EXPECT_TRUE(Closed(dst_acquire.signal));
+    EXPECT_EQ(0x11, mDstBuf[0]);
+    EXPECT_EQ(0x11, mDstBuf[(100 * 60 - 1) * 4]);
+    EXPECT_EQ(0, mDstBuf[100 * 60 * 4]);
+
+    // the H/W is configured again after the CPU job
+    mDst = {1280, 720, 0, 0, 1280, 720};
+    ASSERT_TRUE(Run());
+    EXPECT_EQ(1u, mFake.Count("S_FMT dst"));
+}
+
+TEST_F(ScalerV4L2Test, SwFallbackFenceTimeout) {
+    mDst = {100, 60, 0, 0, 100, 60};
+    Fence src_acquire, dst_acquire;
+    src_acquire.Signal();
+    int src_release, dst_release;
+
+    // the destination is never released, the job is not run but the fences are closed
+    EXPECT_EQ(-1, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+    EXPECT_EQ(-1, src_release);
+    EXPECT_EQ(-1, dst_release);
+    EXPECT_TRUE(Closed(src_acquire.signal));
+    EXPECT_TRUE(Closed(dst_acquire.signal));
+    EXPECT_EQ(0, mDstBuf[0]);
+}
+
+TEST_F(ScalerV4L2Test, ConvertAsyncFenceOwnership) {
+    // the acquire fences are closed whatever fails
+    {
+        Fence src_acquire, dst_acquire;
+        int src_release = 0, dst_release = 0;
+        EXPECT_EQ(-1, exynos_sc_convert_async(NULL, src_acquire.fd, dst_acquire.fd,
+                                              &src_release, &dst_release));
+        EXPECT_EQ(-1, src_release);
+        EXPECT_EQ(-1, dst_release);
+        EXPECT_TRUE(Closed(src_acquire.signal));
+        EXPECT_TRUE(Closed(dst_acquire.signal));
+    }
+
+    {
+        mFake.failRequest = VIDIOC_S_FMT;
+        Fence src_acquire, dst_acquire;
+        int src_release, dst_release;
+        EXPECT_EQ(-1, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+        EXPECT_EQ(-1, src_release);
+        EXPECT_EQ(-1, dst_release);
+        EXPECT_TRUE(Closed(src_acquire.signal));
+        EXPECT_TRUE(Closed(dst_acquire.signal));
+        EXPECT_TRUE(mFake.releases.empty());
+    }
+
+    // one release fence for each job and buffer, the caller owns them
+    vector<int> released;
+    for (unsigned int i = 0; i < 2 * FakeScaler::kMaxBuffers; i++) {
+        Fence src_acquire, dst_acquire;
+        int src_release, dst_release;
+        ASSERT_EQ(0, Run(src_acquire.fd, dst_acquire.fd, &src_release, &dst_release));
+        EXPECT_TRUE(Closed(src_acquire.signal));
+        EXPECT_TRUE(Closed(dst_acquire.signal));
+        released.insert(released.end(), {src_release, dst_release});
+    }
+    ASSERT_EQ(released.size(), mFake.releases.size());
+    for (size_t i = 0; i < released.size(); i++) {
+        EXPECT_GE(fcntl(released[i], F_GETFD), 0);
+        EXPECT_FALSE(Closed(mFake.releases[i]));
+        close(released[i]);
+        EXPECT_TRUE(Closed(mFake.releases[i]));
+    }
+}
+
+TEST_F(ScalerV4L2Test, AlternatingTwoGeometries) {
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {720, 480, 0, 0, 720, 480},
+    };
+    // each geometry gets a context of its own
+    RunCycle(dsts, 2 * FakeScaler::kMaxBuffers);
+    EXPECT_EQ(2u, mFake.Contexts());
+    mFake.TakeLog();
+
+    const unsigned int kJobs = 30;
+    RunCycle(dsts, kJobs);
+    ExpectNoReconfiguration();
+    EXPECT_EQ(2 * kJobs, mFake.Count("QBUF"));
+    EXPECT_EQ(0u, mFake.Count("S_CROP"));
+}
+
+TEST_F(ScalerV4L2Test, AlternatingThreeGeometries) {
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {720, 480, 0, 0, 720, 480},
+            {1920, 1080, 0, 0, 1920, 1080},
+    };
+    RunCycle(dsts, 3 * FakeScaler::kMaxBuffers);
+    EXPECT_EQ(3u, mFake.Contexts());
+    mFake.TakeLog();
+
+    const unsigned int kJobs = 30;
+    RunCycle(dsts, kJobs);
+    ExpectNoReconfiguration();
+    EXPECT_EQ(0u, mFake.Count("S_CROP"));
+
+    // the jobs of the other contexts are still in flight while switching
+    vector<string> log = mFake.TakeLog();
+    const vector<string> job = {"DQBUF src", "QBUF src 0", "DQBUF dst", "QBUF dst 0"};
+    EXPECT_EQ(job, vector<string>(log.begin(), log.begin() + job.size()));
+}
+
+TEST_F(ScalerV4L2Test, CropOnlyChanges) {
+    WarmUp();
+
+    // a crop inside the same frame is set on the context of the frame
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {1280, 720, 160, 0, 960, 720},
+    };
+    const unsigned int kJobs = 10;
+    RunCycle(dsts, kJobs);
+    ExpectNoReconfiguration();
+    EXPECT_EQ(1u, mFake.Contexts());
+    EXPECT_EQ(kJobs - 1, mFake.Count("S_CROP"));
+    EXPECT_EQ(0u, mFake.Calls("S_CROP src 0,0 1920x1080"));
+    mFake.TakeLog();
+
+    // only the jobs in flight are waited for before the crop
+    mDst = dsts[0];
+    ASSERT_TRUE(Run());
+    const vector<string> crop = {
+            "DQBUF src",
+            "DQBUF dst",
+            "S_CROP dst 0,0 1280x720",
+            "QBUF src 1",
+            "QBUF dst 1",
+    };
+    EXPECT_EQ(crop, mFake.TakeLog());
+}
+
+TEST_F(ScalerV4L2Test, CropChangesOfTwoGeometries) {
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {720, 480, 0, 0, 720, 480},
+            {1280, 720, 0, 0, 640, 360},
+            {720, 480, 0, 0, 360, 240},
+    };
+    RunCycle(dsts, dsts.size());
+    mFake.TakeLog();
+
+    const unsigned int kJobs = 20;
+    RunCycle(dsts, kJobs);
+    ExpectNoReconfiguration();
+    EXPECT_EQ(2u, mFake.Contexts());
+    EXPECT_EQ(kJobs, mFake.Count("S_CROP"));
+}
+
+TEST_F(ScalerV4L2Test, MoreGeometriesThanContexts) {
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {720, 480, 0, 0, 720, 480},
+            {1920, 1080, 0, 0, 1920, 1080},
+            {640, 480, 0, 0, 640, 480},
+    };
+    RunCycle(dsts, dsts.size());
+    mFake.TakeLog();
+
+    // the least recently used context is reconfigured for every job
+    RunCycle(dsts, dsts.size());
+    EXPECT_EQ(3u, mFake.Contexts());
+    EXPECT_EQ(dsts.size(), mFake.Calls("STREAMOFF dst"));
+    EXPECT_EQ(dsts.size(), mFake.Calls("REQBUFS dst 0"));
+    EXPECT_EQ(dsts.size(), mFake.Count("S_FMT"));
+}
+
+TEST_F(ScalerV4L2Test, SingleContextDriver) {
+    mFake.maxContexts = 1;
+    const vector<Image> dsts = {
+            {1280, 720, 0, 0, 1280, 720},
+            {720, 480, 0, 0, 720, 480},
+    };
+    RunCycle(dsts, dsts.size());
+    mFake.TakeLog();
+
+    // without another context the device is reconfigured as before
+    const unsigned int kJobs = 4;
+    RunCycle(dsts, kJobs);
+    EXPECT_EQ(1u, mFake.Contexts());
+    EXPECT_EQ(kJobs, mFake.Calls("STREAMOFF dst"));
+    EXPECT_EQ(kJobs, mFake.Calls("S_FMT dst 1280x720") + mFake.Calls("S_FMT dst 720x480"));
+}
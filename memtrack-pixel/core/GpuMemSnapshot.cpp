@@ -0,0 +1,82 @@
+#include "GpuMemSnapshot.h"
+
+#include <dirent.h>
+#include <log/log.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+
+#include "GpuSysfsReader.h"
+
+#undef LOG_TAG
+#define LOG_TAG "memtrack-gpumemsnapshot"
+
+using namespace GpuSysfsReader;
+
+namespace {
+GpuMemSnapshot::Usage readUsage(const std::string& dir) {
+    return {
+            .gpuTotal = readNodeAt(dir + "/" + kTotalGpuMemNode),
+            .dmaBuf = readNodeAt(dir + "/" + kDmaBufGpuMemNode),
+    };
+}
+
+std::string processDir(pid_t pid) {
+    return std::string(kSysfsDevicePath) + "/" + kProcessDir + "/" + std::to_string(pid);
+}
+} // namespace
+
+void GpuMemSnapshot::refreshLocked() {
+    auto now = std::chrono::steady_clock::now();
+    if (mValid && (now - mTimestamp) < mTtl)
+        return;
+
+    mProcesses.clear();
+    mDevice = readUsage(kSysfsDevicePath);
+
+    const std::string kprcs = std::string(kSysfsDevicePath) + "/" + kProcessDir;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kprcs.c_str()), &closedir);
+    if (dir) {
+        struct dirent* dent;
+        while ((dent = readdir(dir.get()))) {
+            char* end;
+            long pid = strtol(dent->d_name, &end, 10);
+            if (end == dent->d_name || *end != '\0' || pid <= 0)
+                continue;
+
+            mProcesses.emplace(static_cast<pid_t>(pid), readUsage(kprcs + "/" + dent->d_name));
+        }
+    } else {
+        ALOGV("Failed to open %s directory", kprcs.c_str());
+    }
+
+    mTimestamp = now;
+    mValid = true;
+}
+
+GpuMemSnapshot::Usage GpuMemSnapshot::lookup(pid_t pid) {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    refreshLocked();
+
+    if (pid == 0)
+        return mDevice;
+
+    auto it = mProcesses.find(pid);
+    if (it != mProcesses.end())
+        return it->second;
+
+    // The process has appeared after the snapshot was taken. Its result is
+    // kept until the next refresh including when it has no GPU memory.
+    auto usage = readUsage(processDir(pid));
+    mProcesses.emplace(pid, usage);
+    return usage;
+}
+
+uint64_t GpuMemSnapshot::getDmaBufGpuMem(pid_t pid) { return lookup(pid).dmaBuf; }
+
+uint64_t GpuMemSnapshot::getPrivateGpuMem(pid_t pid) {
+    auto usage = lookup(pid);
+    return privateGpuMem(usage.gpuTotal, usage.dmaBuf);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+// System-wide snapshot of the GPU memory accounting in sysfs.
+//
+// The accounting of all processes is read in a single walk over the kprcs
+// directory and per-pid queries are answered from it until the snapshot is
+// older than the TTL. Sweeps over all processes by meminfo then cost one walk
+// instead of one per process and memory type.
+class GpuMemSnapshot {
+public:
+    static constexpr std::chrono::milliseconds kDefaultTtl{500};
+
+    explicit GpuMemSnapshot(std::chrono::milliseconds ttl = kDefaultTtl) : mTtl(ttl) {}
+
+    uint64_t getDmaBufGpuMem(pid_t pid = 0);
+    uint64_t getPrivateGpuMem(pid_t pid = 0);
+
+    // Values of kTotalGpuMemNode and kDmaBufGpuMemNode
+    struct Usage {
+        uint64_t gpuTotal;
+        uint64_t dmaBuf;
+    };
+
+private:
+    void refreshLocked() REQUIRES(mLock);
+    Usage lookup(pid_t pid);
+
+    const std::chrono::milliseconds mTtl;
+    std::mutex mLock;
+    bool mValid GUARDED_BY(mLock) = false;
+    std::chrono::steady_clock::time_point mTimestamp GUARDED_BY(mLock);
+    Usage mDevice GUARDED_BY(mLock) = {};
+    std::unordered_map<pid_t, Usage> mProcesses GUARDED_BY(mLock);
+};
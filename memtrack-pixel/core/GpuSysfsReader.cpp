@@ -1,17 +1,50 @@
 #include "GpuSysfsReader.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <log/log.h>
+#include <stdlib.h>
+#include <unistd.h>
 
-#include <fstream>
 #include <sstream>
 
-#include "filesystem.h"
-
 #undef LOG_TAG
 #define LOG_TAG "memtrack-gpusysfsreader"
 
 using namespace GpuSysfsReader;
 
+uint64_t GpuSysfsReader::readNodeAt(const std::string& path) {
+    int fd = TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        if (errno == ENOENT)
+            ALOGV("File not found: %s", path.c_str());
+        else
+            ALOGW("Failed to open %s path", path.c_str());
+        return 0;
+    }
+
+    char buf[32];
+    ssize_t len = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+    close(fd);
+
+    if (len <= 0)
+        return 0;
+
+    buf[len] = '\0';
+    return strtoull(buf, nullptr, 10);
+}
+
+uint64_t GpuSysfsReader::privateGpuMem(uint64_t gpuTotal, uint64_t dmaBuf) {
+    if (dmaBuf > gpuTotal) {
+        ALOGE("Bug in reader, dma-buf size (%" PRIu64 ") is higher than total gpu size (%" PRIu64
+              ")",
+              dmaBuf, gpuTotal);
+        return 0;
+    }
+
+    return gpuTotal - dmaBuf;
+}
+
 namespace {
 uint64_t readNode(const std::string node, pid_t pid) {
     std::stringstream ss;
@@ -19,24 +52,8 @@ uint64_t readNode(const std::string node, pid_t pid) {
         ss << kSysfsDevicePath << "/" << kProcessDir << "/" << pid << "/" << node;
     else
         ss << kSysfsDevicePath << "/" << node;
-    const std::string path = ss.str();
-
-    if (!filesystem::exists(filesystem::path(path))) {
-        ALOGV("File not found: %s", path.c_str());
-        return 0;
-    }
-
-    std::ifstream file(path.c_str());
-    if (!file.is_open()) {
-        ALOGW("Failed to open %s path", path.c_str());
-        return 0;
-    }
-
-    uint64_t out;
-    file >> out;
-    file.close();
 
-    return out;
+    return readNodeAt(ss.str());
 }
 } // namespace
 
@@ -48,12 +65,5 @@ uint64_t GpuSysfsReader::getPrivateGpuMem(pid_t pid) {
     auto dma_buf_size = getDmaBufGpuMem(pid);
     auto gpu_total_size = getGpuMemTotal(pid);
 
-    if (dma_buf_size > gpu_total_size) {
-        ALOGE("Bug in reader, dma-buf size (%" PRIu64 ") is higher than total gpu size (%" PRIu64
-              ")",
-              dma_buf_size, gpu_total_size);
-        return 0;
-    }
-
-    return gpu_total_size - dma_buf_size;
+    return privateGpuMem(gpu_total_size, dma_buf_size);
 }
@@ -4,11 +4,18 @@
 #include <inttypes.h>
 #include <sys/types.h>
 
+#include <string>
+
 namespace GpuSysfsReader {
 uint64_t getDmaBufGpuMem(pid_t pid = 0);
 uint64_t getGpuMemTotal(pid_t pid = 0);
 uint64_t getPrivateGpuMem(pid_t pid = 0);
 
+// Reads a single decimal value from a sysfs node. Returns 0 on failure.
+uint64_t readNodeAt(const std::string& path);
+// Private GPU memory out of the values of kTotalGpuMemNode and kDmaBufGpuMemNode
+uint64_t privateGpuMem(uint64_t gpuTotal, uint64_t dmaBuf);
+
 constexpr char kSysfsDevicePath[] = "/sys/class/misc/mali0/device";
 constexpr char kProcessDir[] = "kprcs";
 constexpr char kMappedDmaBufsDir[] = "dma_bufs";
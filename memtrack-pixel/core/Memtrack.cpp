@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "GpuMemSnapshot.h"
 #include "GpuSysfsReader.h"
 #include "filesystem.h"
 
@@ -16,6 +17,13 @@ namespace android {
 namespace hardware {
 namespace memtrack {
 
+namespace {
+GpuMemSnapshot& gpuMemSnapshot() {
+    static GpuMemSnapshot* snapshot = new GpuMemSnapshot();
+    return *snapshot;
+}
+} // namespace
+
 ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
                                        std::vector<MemtrackRecord>* _aidl_return) {
     if (pid < 0)
@@ -38,13 +46,13 @@ ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
     uint64_t size = 0;
     switch (type) {
         case MemtrackType::GL:
-            size = GpuSysfsReader::getPrivateGpuMem(pid);
+            size = gpuMemSnapshot().getPrivateGpuMem(pid);
             break;
         case MemtrackType::GRAPHICS:
             // TODO(b/194483693): This is not PSS as required by memtrack HAL
             // but complete dmabuf allocations. Reporting PSS requires reading
             // procfs. This HAL does not have that permission yet.
-            size = GpuSysfsReader::getDmaBufGpuMem(pid);
+            size = gpuMemSnapshot().getDmaBufGpuMem(pid);
             break;
         default:
             break;